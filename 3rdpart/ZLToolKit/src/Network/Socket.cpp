@@ -14,6 +14,8 @@
 #include "Util/util.h"
 #include "Util/logger.h"
 #include "Util/uv_errno.h"
+#include "Util/TraceContext.h"
+#include "Util/Metrics.h"
 #include "Thread/semaphore.h"
 #include "Poller/EventPoller.h"
 #include "Thread/WorkThreadPool.h"
@@ -44,6 +46,9 @@ Socket::Socket(const EventPoller::Ptr &poller, bool enable_mutex) :
 
 Socket::~Socket() {
     closeSock();
+    if (!_sendable) {
+        ToolkitMetrics::Instance().send_blocked.sub();
+    }
 }
 
 void Socket::setOnRead(onReadCB cb) {
@@ -336,6 +341,7 @@ int Socket::send(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len, boo
     if (!size) {
         return 0;
     }
+    TraceContext::markCurrent(TraceStageSocketSend);
 
     SockFD::Ptr sock;
     {
@@ -351,6 +357,7 @@ int Socket::send(Buffer::Ptr buf, struct sockaddr *addr, socklen_t addr_len, boo
     {
         LOCK_GUARD(_mtx_send_buf_waiting);
         _send_buf_waiting.emplace_back(sock->type() == SockNum::Sock_UDP ? std::make_shared<BufferSock>(std::move(buf), addr, addr_len) : buf);
+        ToolkitMetrics::Instance().send_queue_depth.observe(_send_buf_waiting.size());
     }
 
     if(try_flush){
@@ -432,17 +439,17 @@ bool Socket::listen(const SockFD::Ptr &sock){
     return true;
 }
 
-bool Socket::listen(uint16_t port, const string &local_ip, int backlog) {
-    int sock = SockUtil::listen(port, local_ip.data(), backlog);
+bool Socket::listen(uint16_t port, const string &local_ip, int backlog, bool reuse_port) {
+    int sock = SockUtil::listen(port, local_ip.data(), backlog, reuse_port);
     if (sock == -1) {
         return false;
     }
     return listen(makeSock(sock, SockNum::Sock_TCP));
 }
 
-bool Socket::bindUdpSock(uint16_t port, const string &local_ip) {
+bool Socket::bindUdpSock(uint16_t port, const string &local_ip, bool reuse_port) {
     closeSock();
-    int fd = SockUtil::bindUdpSock(port, local_ip.data());
+    int fd = SockUtil::bindUdpSock(port, local_ip.data(), reuse_port);
     if (fd == -1) {
         return false;
     }
@@ -589,6 +596,7 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
             if (poller_thread) {
                 //poller线程触发该函数，那么该socket应该已经加入了可写事件的监听；
                 //那么在数据列队清空的情况下，我们需要关闭监听以免触发无意义的事件回调
+                _wait_writeable = false;
                 stopWriteAbleEvent(sock);
                 onFlushed(sock);
             }
@@ -642,6 +650,7 @@ bool Socket::flushData(const SockFD::Ptr &sock, bool poller_thread) {
     }
 
     //二级缓存已经全部发送完毕，说明该socket还可写，我们尝试继续写
+    TraceContext::markCurrent(TraceStageSocketFlush);
     //如果是poller线程，我们尝试再次写一次(因为可能其他线程调用了send函数又有新数据了)
     return poller_thread ? flushData(sock, poller_thread) : true;
 }
@@ -662,6 +671,10 @@ void Socket::onWriteAble(const SockFD::Ptr &sock) {
     if (empty_waiting && empty_sending) {
         //数据已经清空了，我们停止监听可写事件
         stopWriteAbleEvent(sock);
+        if (_wait_writeable.exchange(false)) {
+            //通过waitWriteAble等待可写事件
+            onFlushed(sock);
+        }
     } else {
         //socket可写，我们尝试发送剩余的数据
         flushData(sock, true);
@@ -670,14 +683,18 @@ void Socket::onWriteAble(const SockFD::Ptr &sock) {
 
 void Socket::startWriteAbleEvent(const SockFD::Ptr &sock) {
     //开始监听socket可写事件
-    _sendable = false;
+    if (_sendable.exchange(false)) {
+        ToolkitMetrics::Instance().send_blocked.add();
+    }
     int flag = _enable_recv ? Event_Read : 0;
     _poller->modifyEvent(sock->rawFd(), flag | Event_Error | Event_Write);
 }
 
 void Socket::stopWriteAbleEvent(const SockFD::Ptr &sock) {
     //停止监听socket可写事件
-    _sendable = true;
+    if (!_sendable.exchange(true)) {
+        ToolkitMetrics::Instance().send_blocked.sub();
+    }
     int flag = _enable_recv ? Event_Read : 0;
     _poller->modifyEvent(sock->rawFd(), flag | Event_Error);
 }
@@ -717,6 +734,19 @@ bool Socket::isSocketBusy() const{
     return !_sendable.load();
 }
 
+void Socket::waitWriteAble() {
+    SockFD::Ptr sock;
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        sock = _sock_fd;
+    }
+    if (!sock) {
+        return;
+    }
+    _wait_writeable = true;
+    startWriteAbleEvent(sock);
+}
+
 const EventPoller::Ptr &Socket::getPoller() const{
     return _poller;
 }
@@ -734,6 +764,48 @@ bool Socket::cloneFromListenSocket(const Socket &other){
     return listen(sock);
 }
 
+bool Socket::moveTo(const EventPoller::Ptr &poller, const function<void()> &cb) {
+    assert(_poller->isCurrentThread());
+    if (!poller || poller == _poller) {
+        return false;
+    }
+
+    SockFD::Ptr sock;
+    {
+        LOCK_GUARD(_mtx_sock_fd);
+        if (!_sock_fd || _sock_fd->type() != SockNum::Sock_TCP) {
+            return false;
+        }
+        //在新的poller线程中复制fd，旧的SockFD析构时会从原poller线程移除监听(fd不会被关闭)
+        sock = std::make_shared<SockFD>(*_sock_fd, poller);
+        _sock_fd = sock;
+    }
+    _poller = poller;
+
+    weak_ptr<Socket> weak_self = shared_from_this();
+    poller->async([weak_self, sock, cb]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        {
+            LOCK_GUARD(strong_self->_mtx_sock_fd);
+            if (strong_self->_sock_fd != sock) {
+                //迁移期间socket已经被关闭
+                return;
+            }
+        }
+        if (!strong_self->attachEvent(sock, false)) {
+            strong_self->emitErr(SockException(Err_other, "add event to poller failed when move socket"));
+            return;
+        }
+        if (cb) {
+            cb();
+        }
+    }, false);
+    return true;
+}
+
 bool Socket::setSendPeerAddr(const struct sockaddr *dst_addr, socklen_t addr_len) {
     LOCK_GUARD(_mtx_sock_fd);
     if (!_sock_fd) {
@@ -291,17 +291,19 @@ public:
      * @param port 监听端口，0则随机
      * @param local_ip 监听的网卡ip
      * @param backlog tcp最大积压数
+     * @param reuse_port 是否开启SO_REUSEPORT，以便多个socket监听同一端口
      * @return 是否成功
      */
-    virtual bool listen(uint16_t port, const string &local_ip = "0.0.0.0", int backlog = 1024);
+    virtual bool listen(uint16_t port, const string &local_ip = "0.0.0.0", int backlog = 1024, bool reuse_port = false);
 
     /**
      * 创建udp套接字,udp是无连接的，所以可以作为服务器和客户端
      * @param port 绑定的端口为0则随机
      * @param local_ip 绑定的网卡ip
+     * @param reuse_port 是否开启SO_REUSEPORT，以便多个socket绑定同一端口
      * @return 是否成功
      */
-    virtual bool bindUdpSock(uint16_t port, const string &local_ip = "0.0.0.0");
+    virtual bool bindUdpSock(uint16_t port, const string &local_ip = "0.0.0.0", bool reuse_port = false);
 
     ////////////设置事件回调////////////
 
@@ -396,6 +398,12 @@ public:
      */
     virtual bool isSocketBusy() const;
 
+    /**
+     * 等待套接字可写，可写且发送缓存为空时触发onFlush回调，请在poller线程中调用
+     * 用于绕过发送缓存直接写fd(例如sendfile)遇到EAGAIN后，等待内核写缓存有空闲
+     */
+    virtual void waitWriteAble();
+
     /**
      * 获取poller线程对象
      * @return poller线程对象
@@ -410,6 +418,15 @@ public:
      */
     virtual bool cloneFromListenSocket(const Socket &other);
 
+    /**
+     * 把已连接的tcp socket迁移至其他poller线程，必须在原poller线程中调用
+     * 迁移期间收到的数据保留在内核缓存中，迁移完成后在新的poller线程中触发读事件
+     * @param poller 新的poller线程
+     * @param cb 迁移完成回调，在新的poller线程中执行
+     * @return 是否开始迁移
+     */
+    virtual bool moveTo(const EventPoller::Ptr &poller, const function<void()> &cb = nullptr);
+
     /**
      * 设置UDP发送数据时的目标地址，后续发送时就不用再单独指定了
      * @param dst_addr 目标地址
@@ -470,6 +487,8 @@ private:
     atomic<bool> _enable_recv {true};
     //标记该socket是否可写，socket写缓存满了就不可写
     atomic<bool> _sendable {true};
+    //是否有人通过waitWriteAble等待可写事件
+    atomic<bool> _wait_writeable {false};
 
     //tcp连接超时定时器
     Timer::Ptr _con_timer;
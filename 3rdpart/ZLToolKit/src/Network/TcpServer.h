@@ -109,6 +109,11 @@ public:
         return _session;
     }
 
+    //会话迁移至其他TcpServer管理
+    void setServer(const std::weak_ptr<TcpServer> &server) {
+        _server = server;
+    }
+
 private:
     string _identifier;
     TcpSession::Ptr _session;
@@ -129,6 +134,7 @@ public:
      * 这些子TcpServer对象通过Socket对象克隆的方式在多个poller线程中监听同一个listen fd
      * 这样这个TCP服务器将会通过抢占式accept的方式把客户端均匀的分布到不同的poller线程
      * 通过该方式能实现客户端负载均衡以及提高连接接收速度
+     * 也可以通过setReusePort让每个poller线程独立监听，由内核分配连接
      */
     TcpServer(const EventPoller::Ptr &poller = nullptr) {
         setOnCreateSocket(nullptr);
@@ -166,6 +172,22 @@ public:
                 serverRef->cloneFrom(*this);
             }
         });
+        if (_reuse_port && _reuse_port_steering) {
+            //分流程序对整个端口的socket组生效，序号为各socket开始监听的顺序
+            SockUtil::setReusePortSteering(_socket->rawFD(), _reuse_port_steering, 1 + _cloned_server.size());
+        }
+    }
+
+    /**
+     * 设置每个poller线程独立监听同一端口(SO_REUSEPORT)，请在start之前调用
+     * 默认各poller线程监听同一个listen fd并抢占式accept，连接风暴时会惊群且分布取决于唤醒顺序；
+     * 开启后由内核在各线程的listen fd间分配连接，同时也允许多个进程监听同一端口
+     * @param enable 是否开启
+     * @param steering 挂载的cBPF分流程序类型，0为内核默认(4元组哈希)，其他见SockUtil::setReusePortSteering
+     */
+    void setReusePort(bool enable, int steering = 0) {
+        _reuse_port = enable;
+        _reuse_port_steering = steering;
     }
 
     /**
@@ -178,6 +200,14 @@ public:
         return _socket->get_local_port();
     }
 
+    /**
+     * 本TcpServer管理的会话个数，必须在本TcpServer的poller线程中调用
+     */
+    size_t getSessionCount() const {
+        assert(_poller->isCurrentThread());
+        return _session_map.size();
+    }
+
     void setOnCreateSocket(Socket::onCreateSocket cb) {
         if (cb) {
             _on_create_socket = std::move(cb);
@@ -207,7 +237,17 @@ protected:
         }
         _on_create_socket = that._on_create_socket;
         _session_alloc = that._session_alloc;
-        _socket->cloneFromListenSocket(*(that._socket));
+        _reuse_port = that._reuse_port;
+        _reuse_port_steering = that._reuse_port_steering;
+        if (_reuse_port) {
+            //本poller线程独立监听，端口可能是随机分配的，以实际监听端口为准
+            if (!_socket->listen(that._socket->get_local_port(), that._host, that._backlog, true)) {
+                string err = (StrPrinter << "listen on " << that._host << ":" << that._socket->get_local_port() << " failed:" << get_uv_errmsg(true));
+                throw std::runtime_error(err);
+            }
+        } else {
+            _socket->cloneFromListenSocket(*(that._socket));
+        }
         weak_ptr<TcpServer> weak_self = shared_from_this();
         _timer = std::make_shared<Timer>(2, [weak_self]() -> bool {
             auto strong_self = weak_self.lock();
@@ -219,12 +259,28 @@ protected:
         }, _poller);
         this->mINI::operator=(that);
         _cloned = true;
+        _parent = const_cast<TcpServer &>(that).shared_from_this();
+    }
+
+    /**
+     * 获取某poller线程对应的TcpServer(包括克隆的子TcpServer)
+     */
+    TcpServer::Ptr getServer(const EventPoller *poller) {
+        auto parent = _parent.lock();
+        auto &ref = parent ? *parent : *this;
+        if (ref._poller.get() == poller) {
+            return ref.shared_from_this();
+        }
+        auto it = ref._cloned_server.find(const_cast<EventPoller *>(poller));
+        if (it == ref._cloned_server.end()) {
+            return nullptr;
+        }
+        return it->second;
     }
 
     // 接收到客户端连接请求
     virtual void onAcceptConnection(const Socket::Ptr &sock) {
         assert(_poller->isCurrentThread());
-        weak_ptr<TcpServer> weak_self = shared_from_this();
         //创建一个TcpSession;这里实现创建不同的服务会话实例
         auto helper = _session_alloc(shared_from_this(), sock);
         auto &session = helper->session();
@@ -246,6 +302,71 @@ protected:
         });
 
         TcpSessionHelper *ptr = helper.get();
+        setOnSessionErr(sock, weak_session, ptr);
+        setOnSessionMigrate(sock, session, ptr);
+    }
+
+    /**
+     * 把会话迁移至其他poller线程对应的TcpServer中管理
+     * @param sock 会话的socket
+     * @param ptr 会话
+     * @param poller 目标poller线程
+     * @param cb 迁移完成回调，在目标poller线程中执行
+     * @return 是否开始迁移
+     */
+    virtual bool onMigrateSession(const Socket::Ptr &sock, TcpSessionHelper *ptr, const EventPoller::Ptr &poller, const function<void()> &cb) {
+        assert(_poller->isCurrentThread());
+        auto target = getServer(poller.get());
+        if (!target || target.get() == this || sock->rawFD() == -1) {
+            return false;
+        }
+        auto it = _session_map.find(ptr);
+        if (it == _session_map.end()) {
+            return false;
+        }
+        auto helper = it->second;
+        weak_ptr<TcpServer> weak_target = target;
+        //socket在目标poller线程中开始监听后、处理任何事件前执行，此时再把会话交给目标TcpServer管理
+        auto on_moved = [weak_target, helper, sock, ptr, cb]() {
+            auto strong_target = weak_target.lock();
+            if (!strong_target) {
+                //目标TcpServer已销毁，会话随helper释放
+                return;
+            }
+            helper->setServer(strong_target);
+            //会话错误、迁移事件改由目标TcpServer处理
+            strong_target->setOnSessionErr(sock, helper->session(), ptr);
+            strong_target->setOnSessionMigrate(sock, helper->session(), ptr);
+            strong_target->_session_map.emplace(helper.get(), helper);
+            if (cb) {
+                cb();
+            }
+        };
+        if (!sock->moveTo(poller, on_moved)) {
+            //迁移失败，会话仍由本TcpServer管理
+            return false;
+        }
+        _session_map.erase(ptr);
+        return true;
+    }
+
+private:
+    void setOnSessionMigrate(const Socket::Ptr &sock, const TcpSession::Ptr &session, TcpSessionHelper *ptr) {
+        weak_ptr<TcpServer> weak_self = shared_from_this();
+        weak_ptr<Socket> weak_sock = sock;
+        //会话迁移至其他poller线程事件
+        session->setOnMigrate([weak_self, weak_sock, ptr](const EventPoller::Ptr &poller, const function<void()> &cb) {
+            auto strong_self = weak_self.lock();
+            auto strong_sock = weak_sock.lock();
+            if (!strong_self || !strong_sock) {
+                return false;
+            }
+            return strong_self->onMigrateSession(strong_sock, ptr, poller, cb);
+        });
+    }
+
+    void setOnSessionErr(const Socket::Ptr &sock, const weak_ptr<TcpSession> &weak_session, TcpSessionHelper *ptr) {
+        weak_ptr<TcpServer> weak_self = shared_from_this();
         //会话接收到错误事件
         sock->setOnErr([weak_self, weak_session, ptr](const SockException &err) {
             //在本函数作用域结束时移除会话对象
@@ -282,7 +403,6 @@ protected:
         });
     }
 
-private:
     Socket::Ptr onBeforeAcceptConnection_l(const EventPoller::Ptr &poller) {
         return onBeforeAcceptConnection(poller);
     }
@@ -301,7 +421,9 @@ private:
             return std::make_shared<TcpSessionHelper>(server, session);
         };
 
-        if (!_socket->listen(port, host.c_str(), backlog)) {
+        _host = host;
+        _backlog = backlog;
+        if (!_socket->listen(port, host.c_str(), backlog, _reuse_port)) {
             //创建tcp监听失败，可能是由于端口占用或权限问题
             string err = (StrPrinter << "listen on " << host << ":" << port << " failed:" << get_uv_errmsg(true));
             throw std::runtime_error(err);
@@ -317,7 +439,7 @@ private:
             strong_self->onManagerSession();
             return true;
         }, _poller);
-        InfoL << "TCP Server listening on " << host << ":" << port;
+        InfoL << "TCP Server listening on " << host << ":" << port << (_reuse_port ? " with SO_REUSEPORT" : "");
     }
 
     //定时管理Session
@@ -347,6 +469,10 @@ private:
 private:
     bool _cloned = false;
     bool _is_on_manager = false;
+    bool _reuse_port = false;
+    int _reuse_port_steering = 0;
+    uint32_t _backlog = 1024;
+    string _host;
     Socket::Ptr _socket;
     EventPoller::Ptr _poller;
     std::shared_ptr<Timer> _timer;
@@ -354,6 +480,8 @@ private:
     unordered_map<TcpSessionHelper *, TcpSessionHelper::Ptr> _session_map;
     function<TcpSessionHelper::Ptr(const TcpServer::Ptr &server, const Socket::Ptr &)> _session_alloc;
     unordered_map<EventPoller *, Ptr> _cloned_server;
+    //克隆的子TcpServer所属的父TcpServer
+    std::weak_ptr<TcpServer> _parent;
 };
 
 } /* namespace toolkit */
@@ -33,5 +33,41 @@ void TcpSession::safeShutdown(const SockException &ex){
     });
 }
 
+int TcpSession::getSendFileFd() {
+    auto &sock = getSock();
+    return sock ? sock->rawFD() : -1;
+}
+
+void TcpSession::migrateTo(const EventPoller::Ptr &poller, const function<void(bool success)> &cb) {
+    std::weak_ptr<TcpSession> weakSelf = shared_from_this();
+    //确保当前读事件处理完毕后再迁移
+    getPoller()->async([weakSelf, poller, cb]() {
+        auto strongSelf = weakSelf.lock();
+        if (!strongSelf) {
+            return;
+        }
+        auto on_moved = [weakSelf, cb]() {
+            if (weakSelf.lock()) {
+                cb(true);
+            }
+        };
+        auto old_poller = strongSelf->getPoller();
+        if (poller == old_poller || !strongSelf->_on_migrate) {
+            cb(false);
+            return;
+        }
+        //迁移回调可能立即在新的poller线程中执行，所以需要提前切换
+        strongSelf->setPoller(poller);
+        if (!strongSelf->_on_migrate(poller, on_moved)) {
+            strongSelf->setPoller(old_poller);
+            cb(false);
+        }
+    }, false);
+}
+
+void TcpSession::setOnMigrate(onMigrate cb) {
+    _on_migrate = std::move(cb);
+}
+
 } /* namespace toolkit */
 
@@ -28,6 +28,8 @@ class TcpServer;
 class TcpSession : public std::enable_shared_from_this<TcpSession>, public SocketHelper{
 public:
     typedef std::shared_ptr<TcpSession> Ptr;
+    //迁移会话所属poller线程，迁移完成后在新的poller线程中执行回调
+    typedef function<bool(const EventPoller::Ptr &poller, const function<void()> &cb)> onMigrate;
 
     TcpSession(const Socket::Ptr &sock);
     ~TcpSession() override;
@@ -67,6 +69,30 @@ public:
      * @param ex 触发onError事件的原因
      */
     void safeShutdown(const SockException &ex = SockException(Err_shutdown, "self shutdown"));
+
+    /**
+     * 把本会话迁移至其他poller线程，必须在本会话的poller线程中调用
+     * 迁移完成后本会话的一切事件都将在新的poller线程中触发
+     * @param poller 目标poller线程
+     * @param cb 迁移结果回调，迁移成功时在新的poller线程中执行，否则在原poller线程中执行
+     */
+    void migrateTo(const EventPoller::Ptr &poller, const function<void(bool success)> &cb);
+
+    /**
+     * 设置会话迁移的实现，由TcpServer在创建会话时设置
+     * @param cb 迁移实现，返回false代表无法迁移
+     */
+    void setOnMigrate(onMigrate cb);
+
+    /**
+     * 获取可以绕过发送缓存直接写入明文的socket fd，用于sendfile等零拷贝发送
+     * 写入前请确认发送缓存为空，写入遇到EAGAIN后请调用Socket::waitWriteAble等待onFlush回调
+     * @return 不支持直接写入(例如未开启kTLS的TLS会话)时返回-1
+     */
+    virtual int getSendFileFd();
+
+private:
+    onMigrate _on_migrate;
 };
 
 //通过该模板可以让TCP服务器快速支持TLS
@@ -81,6 +107,9 @@ public:
         _ssl_box.setOnDecData([&](const Buffer::Ptr &buf) {
             public_onRecv(buf);
         });
+        _ssl_box.setOnKtls([&]() {
+            return public_ktlsFd();
+        });
     }
 
     ~TcpSessionWithSSL() override{
@@ -100,8 +129,23 @@ public:
         TcpSessionType::send(std::move(const_cast<Buffer::Ptr &>(buf)));
     }
 
+    //握手数据全部写入内核后才能开启kTLS，否则残留的握手数据会被内核再次加密
+    inline int public_ktlsFd() {
+        auto &sock = TcpSessionType::getSock();
+        return sock && !sock->isSocketBusy() ? sock->rawFD() : -1;
+    }
+
+    //开启kTLS后由内核加密，才能直接写入明文
+    //TcpSessionType为TcpClient时没有该虚函数，故不加override，未被调用时模板不会实例化
+    int getSendFileFd() {
+        return _ssl_box.isKtls() ? TcpSessionType::getSendFileFd() : -1;
+    }
+
 protected:
     int send(Buffer::Ptr buf) override {
+        if (_ssl_box.isKtls()) {
+            return TcpSessionType::send(std::move(buf));
+        }
         auto size = buf->size();
         _ssl_box.onSend(buf);
         return size;
@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include "sockutil.h"
 #include "Util/util.h"
@@ -22,6 +23,9 @@
 #if defined (__APPLE__)
 #include <ifaddrs.h>
 #endif
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
 using namespace std;
 
 namespace toolkit {
@@ -78,6 +82,68 @@ int SockUtil::setReuseable(int sockFd, bool on) {
     }
     return ret;
 }
+int SockUtil::setReusePort(int sockFd, bool on) {
+#if defined(SO_REUSEPORT)
+    int opt = on ? 1 : 0;
+    int ret = setsockopt(sockFd, SOL_SOCKET, SO_REUSEPORT, (char *)&opt, static_cast<socklen_t>(sizeof(opt)));
+    if (ret == -1) {
+        WarnL << "设置 SO_REUSEPORT 失败:" << get_uv_errmsg(true);
+    }
+    return ret;
+#else
+    WarnL << "该平台不支持 SO_REUSEPORT";
+    return -1;
+#endif
+}
+
+int SockUtil::setReusePortSteering(int sockFd, int type, uint32_t groupSize) {
+#if defined(SO_ATTACH_REUSEPORT_CBPF)
+    if (groupSize == 0) {
+        return -1;
+    }
+    if (type == 2 && thread::hardware_concurrency() < groupSize) {
+        //cpu个数少于socket个数时，按cpu分流会使部分socket永远分不到连接，且集中到少数socket后accept队列易溢出
+        WarnL << "cpu个数(" << thread::hardware_concurrency() << ")少于socket个数(" << groupSize << ")，改为按rxhash分流";
+        type = 1;
+    }
+    vector<sock_filter> code;
+    switch (type) {
+        case 1:
+            //A = skb->hash; A为0时返回无效序号，由内核回退默认分配; 否则返回 A % groupSize
+            code = {
+                    {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t) (SKF_AD_OFF + SKF_AD_RXHASH)},
+                    {BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0},
+                    {BPF_RET | BPF_K, 0, 0, 0xFFFFFFFF},
+                    {BPF_ALU | BPF_MOD | BPF_K, 0, 0, groupSize},
+                    {BPF_RET | BPF_A, 0, 0, 0},
+            };
+            break;
+        case 2:
+            //A = 收包cpu; 返回 A % groupSize
+            code = {
+                    {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t) (SKF_AD_OFF + SKF_AD_CPU)},
+                    {BPF_ALU | BPF_MOD | BPF_K, 0, 0, groupSize},
+                    {BPF_RET | BPF_A, 0, 0, 0},
+            };
+            break;
+        default:
+            WarnL << "未知的分流程序类型:" << type;
+            return -1;
+    }
+    sock_fprog prog;
+    prog.len = (unsigned short) code.size();
+    prog.filter = code.data();
+    int ret = setsockopt(sockFd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, (char *)&prog, static_cast<socklen_t>(sizeof(prog)));
+    if (ret == -1) {
+        WarnL << "设置 SO_ATTACH_REUSEPORT_CBPF 失败:" << get_uv_errmsg(true);
+    }
+    return ret;
+#else
+    WarnL << "该平台不支持 SO_ATTACH_REUSEPORT_CBPF";
+    return -1;
+#endif
+}
+
 int SockUtil::setBroadcast(int sockFd, bool on) {
     int opt = on ? 1 : 0;
     int ret = setsockopt(sockFd, SOL_SOCKET, SO_BROADCAST, (char *)&opt,static_cast<socklen_t>(sizeof(opt)));
@@ -283,7 +349,7 @@ int SockUtil::connect(const char *host, uint16_t port,bool bAsync,const char *lo
     return -1;
 }
 
-int SockUtil::listen(const uint16_t port, const char* localIp, int backLog) {
+int SockUtil::listen(const uint16_t port, const char* localIp, int backLog, bool reusePort) {
     int sockfd = -1;
     if ((sockfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1) {
         WarnL << "创建套接字失败:" << get_uv_errmsg(true);
@@ -291,6 +357,10 @@ int SockUtil::listen(const uint16_t port, const char* localIp, int backLog) {
     }
 
     setReuseable(sockfd);
+    if (reusePort && setReusePort(sockfd) == -1) {
+        close(sockfd);
+        return -1;
+    }
     setNoBlocked(sockfd);
     setCloExec(sockfd);
 
@@ -541,7 +611,7 @@ int SockUtil::bindSock(int sockFd,const char *ifr_ip,uint16_t port){
     return 0;
 }
 
-int SockUtil::bindUdpSock(const uint16_t port, const char* localIp) {
+int SockUtil::bindUdpSock(const uint16_t port, const char* localIp, bool reusePort) {
     int sockfd = -1;
     if ((sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
         WarnL << "创建套接字失败:" << get_uv_errmsg(true);
@@ -549,6 +619,10 @@ int SockUtil::bindUdpSock(const uint16_t port, const char* localIp) {
     }
 
     setReuseable(sockfd);
+    if (reusePort && setReusePort(sockfd) == -1) {
+        close(sockfd);
+        return -1;
+    }
     setNoSigpipe(sockfd);
     setNoBlocked(sockfd);
     setSendBuf(sockfd);
@@ -66,17 +66,19 @@ public:
      * @param port 监听的本地端口
      * @param localIp 绑定的本地网卡ip
      * @param backLog accept列队长度
+     * @param reusePort 是否开启SO_REUSEPORT，以便多个socket监听同一端口
      * @return -1代表失败，其他为socket fd号
      */
-    static int listen(const uint16_t port, const char *localIp = "0.0.0.0", int backLog = 1024);
+    static int listen(const uint16_t port, const char *localIp = "0.0.0.0", int backLog = 1024, bool reusePort = false);
 
     /**
      * 创建udp套接字
      * @param port 监听的本地端口
      * @param localIp 绑定的本地网卡ip
+     * @param reusePort 是否开启SO_REUSEPORT，以便多个socket绑定同一端口
      * @return -1代表失败，其他为socket fd号
      */
-    static int bindUdpSock(const uint16_t port, const char *localIp = "0.0.0.0");
+    static int bindUdpSock(const uint16_t port, const char *localIp = "0.0.0.0", bool reusePort = false);
 
     /**
      * 绑定socket fd至某个网卡和端口
@@ -136,6 +138,25 @@ public:
      */
     static int setReuseable(int sock, bool on = true);
 
+    /**
+     * 允许多个socket(可以属于不同进程)绑定同一端口，由内核在这些socket间分配连接或数据包
+     * 必须在bind之前设置，目前仅linux下有负载均衡效果
+     * @param sock socket fd号
+     * @param on 是否开启该特性
+     * @return 0代表成功，-1为失败
+     */
+    static int setReusePort(int sock, bool on = true);
+
+    /**
+     * 为SO_REUSEPORT socket组挂载cBPF分流程序，对绑定同一端口的所有socket生效
+     * 程序返回的序号为socket加入组的顺序，序号无效时内核回退到默认的4元组哈希分配
+     * @param sock 组内任意socket fd号
+     * @param type 1:按网卡计算的4元组哈希(rxhash)固定分配，哈希为0时回退默认分配; 2:按收包cpu分配
+     * @param groupSize 组内socket个数
+     * @return 0代表成功，-1为失败
+     */
+    static int setReusePortSteering(int sock, int type, uint32_t groupSize);
+
     /**
      * 运行发送或接收udp广播信息
      * @param sock socket fd号
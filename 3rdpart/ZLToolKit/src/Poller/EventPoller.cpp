@@ -18,6 +18,7 @@
 #include "Util/uv_errno.h"
 #include "Util/TimeTicker.h"
 #include "Util/onceToken.h"
+#include "Util/Metrics.h"
 #include "Thread/ThreadPool.h"
 #include "Network/sockutil.h"
 
@@ -205,6 +206,7 @@ Task::Ptr EventPoller::async_l(TaskIn task,bool may_sync, bool first) {
             _list_task.emplace_back(ret);
         }
     }
+    ToolkitMetrics::Instance().poller_task_queue.add();
     //写数据到管道,唤醒主线程
     _pipe.write("", 1);
     return ret;
@@ -230,6 +232,7 @@ inline void EventPoller::onPipeEvent() {
         lock_guard<mutex> lck(_mtx_task);
         _list_swap.swap(_list_task);
     }
+    ToolkitMetrics::Instance().poller_task_queue.sub(_list_swap.size());
 
     _list_swap.for_each([&](const Task::Ptr &task) {
         try {
@@ -283,11 +286,17 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
         uint64_t minDelay;
 #if defined(HAS_EPOLL)
         struct epoll_event events[EPOLL_SIZE];
+        uint64_t wakeup_us = 0;
         while (!_exit_flag) {
             minDelay = getMinDelay();
+            if (wakeup_us) {
+                //统计上次唤醒后处理事件、定时器的耗时
+                ToolkitMetrics::Instance().poller_loop_latency.observe(MetricTimer::now() - wakeup_us);
+            }
             startSleep();//用于统计当前线程负载情况
             int ret = epoll_wait(_epoll_fd, events, EPOLL_SIZE, minDelay ? minDelay : -1);
             sleepWakeUp();//用于统计当前线程负载情况
+            wakeup_us = MetricTimer::now();
             if (ret <= 0) {
                 //超时或被打断
                 continue;
@@ -313,9 +322,14 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
         FdSet set_read, set_write, set_err;
         List<Poll_Record::Ptr> callback_list;
         struct timeval tv;
+        uint64_t wakeup_us = 0;
         while (!_exit_flag) {
             //定时器事件中可能操作_event_map
             minDelay = getMinDelay();
+            if (wakeup_us) {
+                //统计上次唤醒后处理事件、定时器的耗时
+                ToolkitMetrics::Instance().poller_loop_latency.observe(MetricTimer::now() - wakeup_us);
+            }
             tv.tv_sec = minDelay / 1000;
             tv.tv_usec = 1000 * (minDelay % 1000);
 
@@ -341,6 +355,7 @@ void EventPoller::runLoop(bool blocked,bool regist_self) {
             startSleep();//用于统计当前线程负载情况
             ret = zl_select(max_fd + 1, &set_read, &set_write, &set_err, minDelay ? &tv : NULL);
             sleepWakeUp();//用于统计当前线程负载情况
+            wakeup_us = MetricTimer::now();
 
             if (ret <= 0) {
                 //超时或被打断
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xiongziliang/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdio.h>
+#include <new>
+#include <algorithm>
+#include <type_traits>
+#include "Metrics.h"
+
+using namespace std;
+
+namespace toolkit {
+
+static string formatValue(uint64_t val, uint64_t scale) {
+    if (scale <= 1) {
+        return to_string(val);
+    }
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.6g", (double) val / scale);
+    return buf;
+}
+
+/////////////////////////////////////Metric/////////////////////////////////////
+
+Metric::Metric(const string &name, const string &help, const string &labels, Type type) {
+    _name = name;
+    _help = help;
+    _labels = labels;
+    _type = type;
+    MetricsRegistry::Instance().addMetric(this);
+}
+
+Metric::~Metric() {
+    MetricsRegistry::Instance().delMetric(this);
+}
+
+void Metric::dumpLine(string &out, const char *suffix, const string &extra_label, const string &value) const {
+    out += _name;
+    out += suffix;
+    if (!_labels.empty() || !extra_label.empty()) {
+        out += "{";
+        out += _labels;
+        if (!_labels.empty() && !extra_label.empty()) {
+            out += ",";
+        }
+        out += extra_label;
+        out += "}";
+    }
+    out += " ";
+    out += value;
+    out += "\n";
+}
+
+/////////////////////////////////////MetricCounter/////////////////////////////////////
+
+MetricCounter::MetricCounter(const string &name, const string &help, const string &labels)
+        : Metric(name, help, labels, counter) {}
+
+int MetricCounter::getShardIndex() {
+    static atomic<int> s_thread_count{0};
+    static thread_local int s_index = s_thread_count++ % kShardCount;
+    return s_index;
+}
+
+uint64_t MetricCounter::value() const {
+    uint64_t ret = 0;
+    for (auto &shard : _shards) {
+        ret += shard.value.load(memory_order_relaxed);
+    }
+    return ret;
+}
+
+void MetricCounter::dump(string &out) const {
+    dumpLine(out, "", "", to_string(value()));
+}
+
+/////////////////////////////////////MetricGauge/////////////////////////////////////
+
+MetricGauge::MetricGauge(const string &name, const string &help, const string &labels)
+        : Metric(name, help, labels, gauge) {}
+
+void MetricGauge::dump(string &out) const {
+    dumpLine(out, "", "", to_string(value()));
+}
+
+/////////////////////////////////////MetricHistogram/////////////////////////////////////
+
+MetricHistogram::MetricHistogram(const string &name, const string &help, const string &labels,
+                                 const vector<uint64_t> &bounds, uint64_t scale)
+        : Metric(name, help, labels, histogram) {
+    _scale = scale;
+    _bounds = bounds;
+    //最后一个桶为+Inf
+    _buckets.reset(new atomic<uint64_t>[_bounds.size() + 1]);
+    for (size_t i = 0; i <= _bounds.size(); ++i) {
+        _buckets[i].store(0, memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(uint64_t val) {
+    auto index = lower_bound(_bounds.begin(), _bounds.end(), val) - _bounds.begin();
+    _buckets[index].fetch_add(1, memory_order_relaxed);
+    _sum.fetch_add(val, memory_order_relaxed);
+}
+
+void MetricHistogram::dump(string &out) const {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < _bounds.size(); ++i) {
+        acc += _buckets[i].load(memory_order_relaxed);
+        dumpLine(out, "_bucket", "le=\"" + formatValue(_bounds[i], _scale) + "\"", to_string(acc));
+    }
+    acc += _buckets[_bounds.size()].load(memory_order_relaxed);
+    dumpLine(out, "_bucket", "le=\"+Inf\"", to_string(acc));
+    dumpLine(out, "_sum", "", formatValue(_sum.load(memory_order_relaxed), _scale));
+    //count取各个桶的累加值，保证与+Inf桶一致
+    dumpLine(out, "_count", "", to_string(acc));
+}
+
+const vector<uint64_t> &MetricHistogram::latencyBounds() {
+    static vector<uint64_t> s_bounds = {100, 250, 500, 1000, 2500, 5000, 10 * 1000, 25 * 1000, 50 * 1000,
+                                        100 * 1000, 250 * 1000, 500 * 1000, 1000 * 1000, 2500 * 1000,
+                                        5000 * 1000, 10000 * 1000};
+    return s_bounds;
+}
+
+/////////////////////////////////////MetricsRegistry/////////////////////////////////////
+
+MetricsRegistry &MetricsRegistry::Instance() {
+    //指标可能在程序退出、静态对象析构时仍被其他线程访问，故不释放
+    static MetricsRegistry *s_instance = new MetricsRegistry;
+    return *s_instance;
+}
+
+void MetricsRegistry::addMetric(Metric *metric) {
+    lock_guard<mutex> lck(_mtx);
+    _metrics[metric->getName()].emplace_back(metric);
+}
+
+void MetricsRegistry::delMetric(Metric *metric) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _metrics.find(metric->getName());
+    if (it == _metrics.end()) {
+        return;
+    }
+    auto &vec = it->second;
+    vec.erase(std::remove(vec.begin(), vec.end(), metric), vec.end());
+    if (vec.empty()) {
+        _metrics.erase(it);
+    }
+}
+
+string MetricsRegistry::dump() {
+    static const char *s_type[] = {"counter", "gauge", "histogram"};
+    string out;
+    lock_guard<mutex> lck(_mtx);
+    for (auto &pr : _metrics) {
+        auto &first = pr.second.front();
+        out += "# HELP " + pr.first + " " + first->getHelp() + "\n";
+        out += "# TYPE " + pr.first + " " + s_type[first->getType()] + "\n";
+        for (auto &metric : pr.second) {
+            metric->dump(out);
+        }
+    }
+    return out;
+}
+
+/////////////////////////////////////ToolkitMetrics/////////////////////////////////////
+
+ToolkitMetrics &ToolkitMetrics::Instance() {
+    //MetricCounter按缓存行对齐，C++11的operator new不保证该对齐，故在对齐的静态存储上构造且不释放
+    static std::aligned_storage<sizeof(ToolkitMetrics), alignof(ToolkitMetrics)>::type s_storage;
+    static ToolkitMetrics *s_instance = new (&s_storage) ToolkitMetrics;
+    return *s_instance;
+}
+
+ToolkitMetrics::ToolkitMetrics() :
+        ring_readers("zltoolkit_ring_readers", "Number of RingBuffer readers"),
+        pool_hit("zltoolkit_resource_pool_obtain_total", "ResourcePool obtain count", "result=\"hit\""),
+        pool_miss("zltoolkit_resource_pool_obtain_total", "ResourcePool obtain count", "result=\"miss\""),
+        send_queue_depth("zltoolkit_socket_send_queue_depth", "Socket send queue depth when sending data", "",
+                         {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 4096}),
+        send_blocked("zltoolkit_socket_send_blocked", "Number of sockets waiting for writable event"),
+        poller_task_queue("zltoolkit_poller_task_queue", "Number of pending async tasks of all EventPollers"),
+        poller_loop_latency("zltoolkit_poller_loop_latency_seconds", "Time spent by EventPoller on each wakeup", "",
+                            MetricHistogram::latencyBounds(), 1000 * 1000) {}
+
+} /* namespace toolkit */
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xiongziliang/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_METRICS_H_
+#define UTIL_METRICS_H_
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+namespace toolkit {
+
+/**
+ * 运行指标基类，构造时自动注册到MetricsRegistry，析构时注销
+ * 指标对象的生命周期一般为全局，热点路径上的更新操作仅为一次relaxed原子操作，
+ * 导出时只遍历已注册的指标，开销与会话、流的个数无关
+ */
+class Metric {
+public:
+    enum Type {
+        counter = 0,
+        gauge,
+        histogram
+    };
+
+    /**
+     * @param name 指标名，同名指标通过labels区分
+     * @param help 指标说明
+     * @param labels 标签，格式为 key1="value1",key2="value2"
+     */
+    Metric(const std::string &name, const std::string &help, const std::string &labels, Type type);
+    virtual ~Metric();
+
+    const std::string &getName() const { return _name; }
+    const std::string &getHelp() const { return _help; }
+    const std::string &getLabels() const { return _labels; }
+    Type getType() const { return _type; }
+
+    /**
+     * 以prometheus文本格式输出指标值(不包括HELP与TYPE行)
+     */
+    virtual void dump(std::string &out) const = 0;
+
+protected:
+    void dumpLine(std::string &out, const char *suffix, const std::string &extra_label, const std::string &value) const;
+
+private:
+    Type _type;
+    std::string _name;
+    std::string _help;
+    std::string _labels;
+};
+
+/**
+ * 单调递增计数器
+ * 按线程分片计数，多线程并发累加时不会争抢同一缓存行
+ */
+class MetricCounter : public Metric {
+public:
+    MetricCounter(const std::string &name, const std::string &help, const std::string &labels = "");
+    ~MetricCounter() override {}
+
+    void add(uint64_t n = 1) {
+        _shards[getShardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const;
+    void dump(std::string &out) const override;
+
+private:
+    static int getShardIndex();
+
+private:
+    static constexpr int kShardCount = 16;
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    Shard _shards[kShardCount];
+};
+
+/**
+ * 瞬时值，例如队列长度、连接数
+ */
+class MetricGauge : public Metric {
+public:
+    MetricGauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    ~MetricGauge() override {}
+
+    void add(int64_t n = 1) {
+        _value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void sub(int64_t n = 1) {
+        _value.fetch_sub(n, std::memory_order_relaxed);
+    }
+
+    void set(int64_t n) {
+        _value.store(n, std::memory_order_relaxed);
+    }
+
+    int64_t value() const {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+    void dump(std::string &out) const override;
+
+private:
+    std::atomic<int64_t> _value{0};
+};
+
+/**
+ * 直方图，桶边界固定
+ */
+class MetricHistogram : public Metric {
+public:
+    /**
+     * @param bounds 各个桶的上边界(包含)，需要升序排列
+     * @param scale 导出时数值除以scale，例如以微秒统计、以秒导出时设置为1000000
+     */
+    MetricHistogram(const std::string &name, const std::string &help, const std::string &labels,
+                    const std::vector<uint64_t> &bounds, uint64_t scale = 1);
+    ~MetricHistogram() override {}
+
+    void observe(uint64_t val);
+    void dump(std::string &out) const override;
+
+    /**
+     * 耗时统计常用的桶边界，单位微秒，100us~10s
+     */
+    static const std::vector<uint64_t> &latencyBounds();
+
+private:
+    uint64_t _scale;
+    std::vector<uint64_t> _bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+    std::atomic<uint64_t> _sum{0};
+};
+
+/**
+ * 耗时统计辅助类，析构时将构造以来的耗时(微秒)记录到直方图
+ */
+class MetricTimer {
+public:
+    MetricTimer(MetricHistogram &histogram) : _histogram(histogram) {
+        _start = now();
+    }
+
+    ~MetricTimer() {
+        _histogram.observe(now() - _start);
+    }
+
+    /**
+     * 单调时钟，单位微秒
+     */
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    uint64_t _start;
+    MetricHistogram &_histogram;
+};
+
+/**
+ * 指标注册表
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry &Instance();
+
+    /**
+     * 以prometheus文本格式导出全部指标
+     */
+    std::string dump();
+
+private:
+    friend class Metric;
+    MetricsRegistry() {}
+    void addMetric(Metric *metric);
+    void delMetric(Metric *metric);
+
+private:
+    std::mutex _mtx;
+    //同名指标需要连续输出，故按照名称分组
+    std::map<std::string, std::vector<Metric *> > _metrics;
+};
+
+/**
+ * ZLToolKit内置的运行指标
+ */
+class ToolkitMetrics {
+public:
+    static ToolkitMetrics &Instance();
+
+    //RingBuffer读取器(播放器)个数
+    MetricGauge ring_readers;
+    //ResourcePool复用对象次数
+    MetricCounter pool_hit;
+    //ResourcePool新建对象次数
+    MetricCounter pool_miss;
+    //socket发送数据时发送队列中的缓存个数
+    MetricHistogram send_queue_depth;
+    //因发送缓冲区满而等待可写事件的socket个数
+    MetricGauge send_blocked;
+    //EventPoller中等待执行的异步任务个数
+    MetricGauge poller_task_queue;
+    //EventPoller每次唤醒后处理事件、任务、定时器的耗时
+    MetricHistogram poller_loop_latency;
+
+private:
+    ToolkitMetrics();
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_METRICS_H_ */
@@ -18,6 +18,7 @@
 #include <functional>
 #include <unordered_set>
 #include "Util/List.h"
+#include "Util/Metrics.h"
 using namespace std;
 
 namespace toolkit {
@@ -92,9 +93,11 @@ public:
         C *ptr;
         if (_objs.size() == 0) {
             ptr = _allotter();
+            ToolkitMetrics::Instance().pool_miss.add();
         } else {
             ptr = _objs.front();
             _objs.pop_front();
+            ToolkitMetrics::Instance().pool_hit.add();
         }
         return ValuePtr(ptr,this->shared_from_this(),std::make_shared<atomic_bool>(false));
     }
@@ -19,6 +19,8 @@
 #include <functional>
 #include <deque>
 #include "Poller/EventPoller.h"
+#include "Util/TraceContext.h"
+#include "Util/Metrics.h"
 using namespace std;
 
 //GOP缓存最大长度下限值
@@ -183,6 +185,7 @@ public:
     friend class RingBuffer<T>;
 
     ~_RingReaderDispatcher() {
+        ToolkitMetrics::Instance().ring_readers.sub(_reader_size);
         decltype(_reader_map) reader_map;
         reader_map.swap(_reader_map);
         for (auto &pr : reader_map) {
@@ -240,6 +243,7 @@ private:
     }
 
     void onSizeChanged(bool add_flag) {
+        ToolkitMetrics::Instance().ring_readers.add(add_flag ? 1 : -1);
         _on_size_changed(_reader_size, add_flag);
     }
 
@@ -278,11 +282,19 @@ public:
             return;
         }
 
+        //跨线程传递耗时追踪上下文
+        auto &trace = TraceContext::current();
         LOCK_GUARD(_mtx_map);
         for (auto &pr : _dispatcher_map) {
             auto &second = pr.second;
             //切换线程后触发onRead事件
-            pr.first->async([second, in, is_key]() {
+            pr.first->async([second, in, is_key, trace]() {
+                if (!trace) {
+                    second->write(std::move(const_cast<T &>(in)), is_key);
+                    return;
+                }
+                TraceScope scope(trace);
+                trace.mark(TraceStageRingDispatch);
                 second->write(std::move(const_cast<T &>(in)), is_key);
             }, false);
         }
@@ -325,6 +337,28 @@ public:
         return _total_count;
     }
 
+    /**
+     * 遍历拥有读取器的poller线程
+     * @param cb 回调，参数为poller线程及该线程中的读取器个数
+     */
+    void for_each_poller(const function<void(const EventPoller::Ptr &poller, int reader_count)> &cb) {
+        LOCK_GUARD(_mtx_map);
+        for (auto &pr : _dispatcher_map) {
+            cb(pr.first, pr.second->_reader_size);
+        }
+    }
+
+    /**
+     * 遍历gop缓存，回调在锁内执行，请勿在回调中操作本对象
+     * @param cb 回调，参数为是否为关键位置及缓存的数据
+     */
+    void for_each_cache(const function<void(bool is_key, const T &in)> &cb) {
+        LOCK_GUARD(_mtx_map);
+        for (auto &pr : _storage->getCache()) {
+            cb(pr.first, pr.second);
+        }
+    }
+
     void clearCache(){
         LOCK_GUARD(_mtx_map);
         _storage->clearCache();
@@ -8,6 +8,7 @@
  * may be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <atomic>
 #include "SSLBox.h"
 #include "util.h"
 #include "onceToken.h"
@@ -55,9 +56,214 @@
 #define SSL_ENABLE_SNI
 #endif
 
+#if defined(ENABLE_OPENSSL) && defined(__linux__) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+//kTLS需要linux内核tls模块，tls1.3密钥需要openssl 1.1.1的keylog回调
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#include <openssl/kdf.h>
+#define SSL_ENABLE_KTLS
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
 namespace toolkit {
 
 static bool s_ignore_invalid_cer = true;
+static bool s_enable_ktls = false;
+
+#ifdef SSL_ENABLE_KTLS
+
+//内核未加载tls模块时不再尝试开启kTLS
+static atomic<bool> s_ulp_unavailable(false);
+
+//保存tls1.3本端发送方向初始流量密钥的SSL ex_data序号
+static int getTrafficSecretIndex() {
+    static int s_index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, [](void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+        delete (string *) ptr;
+    });
+    return s_index;
+}
+
+//tls1.3的流量密钥只能通过keylog回调获取，格式为: label client_random secret
+static void onKeyLog(const SSL *ssl, const char *line) {
+    if (!s_enable_ktls) {
+        return;
+    }
+    const char *label = SSL_is_server(ssl) ? "SERVER_TRAFFIC_SECRET_0 " : "CLIENT_TRAFFIC_SECRET_0 ";
+    if (strncmp(line, label, strlen(label)) != 0) {
+        return;
+    }
+    auto hex = strrchr(line, ' ');
+    long len = 0;
+    auto secret = OPENSSL_hexstr2buf(hex + 1, &len);
+    if (!secret) {
+        return;
+    }
+    auto index = getTrafficSecretIndex();
+    delete (string *) SSL_get_ex_data(ssl, index);
+    SSL_set_ex_data(const_cast<SSL *>(ssl), index, new string((char *) secret, len));
+    OPENSSL_free(secret);
+}
+
+//tls1.3 HKDF-Expand-Label(secret, label, "", len)
+static bool hkdfExpandLabel(const EVP_MD *md, const string &secret, const string &label, size_t len, string &out) {
+    string full_label = "tls13 " + label;
+    string info;
+    info.push_back((char) (len >> 8));
+    info.push_back((char) (len & 0xFF));
+    info.push_back((char) full_label.size());
+    info.append(full_label);
+    info.push_back(0);
+
+    out.resize(len);
+    shared_ptr<EVP_PKEY_CTX> ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr), EVP_PKEY_CTX_free);
+    return ctx && EVP_PKEY_derive_init(ctx.get()) > 0
+           && EVP_PKEY_CTX_hkdf_mode(ctx.get(), EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+           && EVP_PKEY_CTX_set_hkdf_md(ctx.get(), md) > 0
+           && EVP_PKEY_CTX_set1_hkdf_key(ctx.get(), (unsigned char *) secret.data(), secret.size()) > 0
+           && EVP_PKEY_CTX_add1_hkdf_info(ctx.get(), (unsigned char *) info.data(), info.size()) > 0
+           && EVP_PKEY_derive(ctx.get(), (unsigned char *) &out[0], &len) > 0;
+}
+
+//tls1.2 key_block = PRF(master_secret, "key expansion", server_random + client_random)
+static bool tls12KeyBlock(SSL *ssl, const EVP_MD *md, size_t len, string &out) {
+    unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+    unsigned char client_random[SSL3_RANDOM_SIZE];
+    unsigned char server_random[SSL3_RANDOM_SIZE];
+    auto master_len = SSL_SESSION_get_master_key(SSL_get_session(ssl), master, sizeof(master));
+    SSL_get_client_random(ssl, client_random, sizeof(client_random));
+    SSL_get_server_random(ssl, server_random, sizeof(server_random));
+
+    out.resize(len);
+    shared_ptr<EVP_PKEY_CTX> ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr), EVP_PKEY_CTX_free);
+    bool ret = ctx && EVP_PKEY_derive_init(ctx.get()) > 0
+               && EVP_PKEY_CTX_set_tls1_prf_md(ctx.get(), md) > 0
+               && EVP_PKEY_CTX_set1_tls1_prf_secret(ctx.get(), master, master_len) > 0
+               && EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), (unsigned char *) "key expansion", 13) > 0
+               && EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), server_random, sizeof(server_random)) > 0
+               && EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), client_random, sizeof(client_random)) > 0
+               && EVP_PKEY_derive(ctx.get(), (unsigned char *) &out[0], &len) > 0;
+    OPENSSL_cleanse(master, sizeof(master));
+    return ret;
+}
+
+/**
+ * 计算本端发送方向的密钥并开启socket的kTLS发送
+ * 只能在握手刚完成、尚未用openssl加密发送应用数据时调用，此时发送序号是确定的：
+ * tls1.2为1(Finished消息占用了0)，tls1.3为0(已禁用握手后发送的NewSessionTicket)
+ */
+static bool enableKtlsSend(SSL *ssl, int fd) {
+    if (s_ulp_unavailable) {
+        return false;
+    }
+    auto cipher = SSL_get_current_cipher(ssl);
+    auto md = cipher ? SSL_CIPHER_get_handshake_digest(cipher) : nullptr;
+    if (!md) {
+        return false;
+    }
+    auto nid = SSL_CIPHER_get_cipher_nid(cipher);
+    size_t key_len;
+    //tls1.2下由key_block派生的固定iv长度
+    size_t fixed_iv_len;
+    switch (nid) {
+        case NID_aes_128_gcm: key_len = 16; fixed_iv_len = 4; break;
+        case NID_aes_256_gcm: key_len = 32; fixed_iv_len = 4; break;
+        case NID_chacha20_poly1305: key_len = 32; fixed_iv_len = 12; break;
+        default:
+            DebugL << "kTLS不支持该加密套件:" << SSL_CIPHER_get_name(cipher);
+            return false;
+    }
+
+    bool server_mode = SSL_is_server(ssl);
+    string key, iv;
+    uint64_t seq;
+    int version = SSL_version(ssl);
+    if (version == TLS1_3_VERSION) {
+        auto secret = (string *) SSL_get_ex_data(ssl, getTrafficSecretIndex());
+        if (!secret || !hkdfExpandLabel(md, *secret, "key", key_len, key) || !hkdfExpandLabel(md, *secret, "iv", 12, iv)) {
+            return false;
+        }
+        seq = 0;
+    } else if (version == TLS1_2_VERSION) {
+        //aead套件没有mac密钥，key_block依次为: 客户端密钥、服务器密钥、客户端iv、服务器iv
+        string block;
+        if (!tls12KeyBlock(ssl, md, 2 * (key_len + fixed_iv_len), block)) {
+            return false;
+        }
+        key = block.substr(server_mode ? key_len : 0, key_len);
+        iv = block.substr(2 * key_len + (server_mode ? fixed_iv_len : 0), fixed_iv_len);
+        seq = 1;
+    } else {
+        return false;
+    }
+
+    unsigned char rec_seq[8];
+    for (int i = 7; i >= 0; --i, seq >>= 8) {
+        rec_seq[i] = seq & 0xFF;
+    }
+
+    union {
+        tls12_crypto_info_aes_gcm_128 gcm128;
+        tls12_crypto_info_aes_gcm_256 gcm256;
+        tls12_crypto_info_chacha20_poly1305 chacha20;
+    } info;
+    memset(&info, 0, sizeof(info));
+    socklen_t info_len;
+    auto crypto_version = version == TLS1_3_VERSION ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+    //aes-gcm的nonce为4字节salt + 8字节iv，tls1.2的显式iv使用发送序号，保证不重复
+    auto explicit_iv = version == TLS1_3_VERSION ? (unsigned char *) iv.data() + 4 : rec_seq;
+    switch (nid) {
+        case NID_aes_128_gcm:
+            info.gcm128.info.version = crypto_version;
+            info.gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+            memcpy(info.gcm128.key, key.data(), key_len);
+            memcpy(info.gcm128.salt, iv.data(), 4);
+            memcpy(info.gcm128.iv, explicit_iv, 8);
+            memcpy(info.gcm128.rec_seq, rec_seq, 8);
+            info_len = sizeof(info.gcm128);
+            break;
+        case NID_aes_256_gcm:
+            info.gcm256.info.version = crypto_version;
+            info.gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+            memcpy(info.gcm256.key, key.data(), key_len);
+            memcpy(info.gcm256.salt, iv.data(), 4);
+            memcpy(info.gcm256.iv, explicit_iv, 8);
+            memcpy(info.gcm256.rec_seq, rec_seq, 8);
+            info_len = sizeof(info.gcm256);
+            break;
+        default:
+            info.chacha20.info.version = crypto_version;
+            info.chacha20.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            memcpy(info.chacha20.key, key.data(), key_len);
+            memcpy(info.chacha20.iv, iv.data(), 12);
+            memcpy(info.chacha20.rec_seq, rec_seq, 8);
+            info_len = sizeof(info.chacha20);
+            break;
+    }
+    OPENSSL_cleanse(&key[0], key.size());
+
+    bool ret = false;
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == -1) {
+        if (errno == ENOENT && !s_ulp_unavailable.exchange(true)) {
+            WarnL << "内核未加载tls模块(modprobe tls)，kTLS不可用，继续使用openssl加密";
+        } else {
+            DebugL << "设置TCP_ULP失败:" << get_uv_errmsg(true);
+        }
+    } else if (setsockopt(fd, SOL_TLS, TLS_TX, &info, info_len) == -1) {
+        //未配置TLS_TX的tls ulp与普通tcp一样收发
+        DebugL << "设置TLS_TX失败:" << get_uv_errmsg(true);
+    } else {
+        ret = true;
+    }
+    OPENSSL_cleanse(&info, sizeof(info));
+    return ret;
+}
+
+#endif //SSL_ENABLE_KTLS
 
 SSL_Initor &SSL_Initor::Instance() {
     static SSL_Initor obj;
@@ -68,6 +274,16 @@ void SSL_Initor::ignoreInvalidCertificate(bool ignore) {
     s_ignore_invalid_cer = ignore;
 }
 
+void SSL_Initor::enableKtls(bool enable) {
+#ifdef SSL_ENABLE_KTLS
+    s_enable_ktls = enable;
+#else
+    if (enable) {
+        WarnL << "该平台或openssl版本不支持kTLS";
+    }
+#endif
+}
+
 SSL_Initor::SSL_Initor() {
 #if defined(ENABLE_OPENSSL)
     SSL_library_init();
@@ -214,6 +430,9 @@ void SSL_Initor::setupCtx(SSL_CTX *ctx) {
         }
         return s_ignore_invalid_cer ? 1 : ok;
     });
+#ifdef SSL_ENABLE_KTLS
+    SSL_CTX_set_keylog_callback(ctx, onKeyLog);
+#endif
 #endif //defined(ENABLE_OPENSSL)
 }
 
@@ -297,6 +516,13 @@ SSL_Box::SSL_Box(bool server_mode, bool enable, int buff_size) {
         _write_bio = BIO_new(BIO_s_mem());
         SSL_set_bio(_ssl.get(), _read_bio, _write_bio);
         _server_mode ? SSL_set_accept_state(_ssl.get()) : SSL_set_connect_state(_ssl.get());
+#ifdef SSL_ENABLE_KTLS
+        if (s_enable_ktls && _server_mode) {
+            //开启kTLS后openssl不再参与发送，禁止重协商与握手后的NewSessionTicket，以确定发送序号
+            SSL_set_options(_ssl.get(), SSL_OP_NO_RENEGOTIATION);
+            SSL_set_num_tickets(_ssl.get(), 0);
+        }
+#endif
     } else {
         WarnL << "ssl disabled!";
     }
@@ -308,6 +534,10 @@ SSL_Box::SSL_Box(bool server_mode, bool enable, int buff_size) {
 void SSL_Box::shutdown() {
 #if defined(ENABLE_OPENSSL)
     _buffer_send.clear();
+    if (_ktls) {
+        //close_notify需要由内核加密发送，直接断开即可
+        return;
+    }
     int ret = SSL_shutdown(_ssl.get());
     if (ret != 1) {
         ErrorL << "SSL shutdown failed:" << SSLUtil::getLastError();
@@ -356,6 +586,13 @@ void SSL_Box::onSend(const Buffer::Ptr &buffer) {
         return;
     }
 #if defined(ENABLE_OPENSSL)
+    if (_ktls) {
+        //明文直接写入socket，由内核加密
+        if (_on_enc) {
+            _on_enc(buffer);
+        }
+        return;
+    }
     if (!_server_mode && !_send_handshake) {
         _send_handshake = true;
         SSL_do_handshake(_ssl.get());
@@ -375,6 +612,14 @@ void SSL_Box::setOnEncData(const function<void(const Buffer::Ptr &)> &cb){
 
 void SSL_Box::flushWriteBio() {
 #if defined(ENABLE_OPENSSL)
+    if (_ktls) {
+        //开启kTLS后openssl的发送序号已失效，其产生的记录(例如回复KeyUpdate)不能再发送
+        if (BIO_ctrl_pending(_write_bio)) {
+            WarnL << "kTLS模式下丢弃openssl产生的数据:" << BIO_ctrl_pending(_write_bio);
+            (void) BIO_reset(_write_bio);
+        }
+        return;
+    }
     int total = 0;
     int nread = 0;
     auto buffer_bio = _buffer_pool.obtain();
@@ -451,6 +696,23 @@ void SSL_Box::flush() {
     });
 
     flushReadBio();
+    if (SSL_is_init_finished(_ssl.get()) && !_ktls_tried) {
+        //握手刚完成，先发送剩余的握手数据再尝试开启kTLS
+        _ktls_tried = true;
+        flushWriteBio();
+        _ktls = tryKtls();
+    }
+    if (_ktls) {
+        //开启kTLS前缓存的明文
+        flushWriteBio();
+        while (!_buffer_send.empty()) {
+            if (_on_enc) {
+                _on_enc(_buffer_send.front());
+            }
+            _buffer_send.pop_front();
+        }
+        return;
+    }
     if (!SSL_is_init_finished(_ssl.get()) || _buffer_send.empty()) {
         //ssl未握手结束或没有需要发送的数据
         flushWriteBio();
@@ -486,6 +748,33 @@ void SSL_Box::flush() {
 #endif //defined(ENABLE_OPENSSL)
 }
 
+bool SSL_Box::tryKtls() {
+#ifdef SSL_ENABLE_KTLS
+    if (!s_enable_ktls || !_on_ktls) {
+        return false;
+    }
+    auto fd = _on_ktls();
+    if (fd == -1) {
+        return false;
+    }
+    if (!enableKtlsSend(_ssl.get(), fd)) {
+        return false;
+    }
+    DebugL << "kTLS enabled:" << SSL_get_version(_ssl.get()) << " " << SSL_get_cipher_name(_ssl.get());
+    return true;
+#else
+    return false;
+#endif //SSL_ENABLE_KTLS
+}
+
+void SSL_Box::setOnKtls(const function<int()> &cb) {
+    _on_ktls = cb;
+}
+
+bool SSL_Box::isKtls() const {
+    return _ktls;
+}
+
 bool SSL_Box::setHost(const char *host) {
     if(!_ssl) {
         return false;
@@ -53,6 +53,14 @@ public:
      */
     void ignoreInvalidCertificate(bool ignore = true);
 
+    /**
+     * 是否在握手完成后把发送方向的加密卸载到内核(kTLS)
+     * 开启后明文直接写入socket，由内核加密，省去用户态加密与拷贝；
+     * 需要linux内核加载tls模块，不支持的内核、tls版本或加密套件将继续由openssl在用户态加密
+     * @param enable 是否开启
+     */
+    void enableKtls(bool enable = true);
+
     /**
      * 信任某证书,一般用于客户端信任自签名的证书或自签名CA签署的证书使用
      * 比如说我的客户端要信任我自己签发的证书，那么我们可以只信任这个证书
@@ -179,9 +187,22 @@ public:
      */
     bool setHost(const char *host);
 
+    /**
+     * 设置获取socket fd的回调，握手完成时据此尝试开启kTLS发送
+     * 回调返回-1代表不能开启，例如socket发送缓存中还有未发送的握手数据
+     * @param cb 回调对象
+     */
+    void setOnKtls(const function<int()> &cb);
+
+    /**
+     * 是否已开启kTLS发送，开启后onSend的明文直接通过加密后回调输出，由内核加密
+     */
+    bool isKtls() const;
+
 private:
     void flushWriteBio();
     void flushReadBio();
+    bool tryKtls();
 
 private:
     bool _server_mode;
@@ -195,6 +216,9 @@ private:
     ResourcePool<BufferRaw> _buffer_pool;
     int _buff_size;
     bool _is_flush = false;
+    bool _ktls = false;
+    bool _ktls_tried = false;
+    function<int()> _on_ktls;
 };
 
 } /* namespace toolkit */
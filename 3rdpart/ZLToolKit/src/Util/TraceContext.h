@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016 The ZLToolKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLToolKit(https://github.com/xiongziliang/ZLToolKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef UTIL_TRACECONTEXT_H_
+#define UTIL_TRACECONTEXT_H_
+
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+namespace toolkit {
+
+/**
+ * 耗时追踪的接收者，每到达一个阶段会触发一次onTrace
+ * 该接口会在多个线程中被调用，实现者需要保证线程安全
+ */
+class TraceSink {
+public:
+    typedef std::shared_ptr<TraceSink> Ptr;
+    TraceSink() {}
+    virtual ~TraceSink() {}
+
+    /**
+     * 到达某个阶段
+     * @param stage 阶段id
+     * @param elapsed_us 距离追踪起点的耗时，单位微秒
+     */
+    virtual void onTrace(int stage, uint64_t elapsed_us) = 0;
+};
+
+/**
+ * ZLToolKit内置的追踪阶段，上层的阶段id请从TraceStageUser开始
+ */
+enum TraceStage {
+    //RingBuffer数据切换到读取线程后
+    TraceStageRingDispatch = 0,
+    //数据进入Socket发送队列
+    TraceStageSocketSend,
+    //Socket发送队列中的数据全部写入内核
+    TraceStageSocketFlush,
+    TraceStageUser = 8
+};
+
+/**
+ * 耗时追踪上下文，保存追踪起点以及接收者
+ * 当前线程正在处理的数据的追踪上下文保存在线程局部变量中，
+ * 同步调用链中的各个阶段通过TraceContext::current()获取；跨线程时需要拷贝上下文并在目标线程中通过TraceScope恢复
+ */
+class TraceContext {
+public:
+    TraceContext() {}
+
+    /**
+     * @param sink 追踪接收者
+     * @param start_us 追踪起点，取值为TraceContext::now()
+     */
+    TraceContext(const TraceSink::Ptr &sink, uint64_t start_us) {
+        _sink = sink;
+        _start_us = start_us;
+    }
+
+    operator bool() const {
+        return (bool) _sink;
+    }
+
+    /**
+     * 标记到达某个阶段
+     */
+    void mark(int stage) const {
+        if (_sink) {
+            _sink->onTrace(stage, now() - _start_us);
+        }
+    }
+
+    /**
+     * 追踪使用的时钟，单位微秒
+     * getCurrentMicrosecond()由后台线程定时刷新，精度不足以统计单个阶段的耗时，故直接读取单调时钟
+     */
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * 获取当前线程的追踪上下文
+     */
+    static TraceContext &current() {
+        static thread_local TraceContext s_context;
+        return s_context;
+    }
+
+    /**
+     * 当前线程的数据到达某个阶段，未开启追踪时开销为一次线程局部变量访问
+     */
+    static void markCurrent(int stage) {
+        current().mark(stage);
+    }
+
+private:
+    TraceSink::Ptr _sink;
+    uint64_t _start_us = 0;
+};
+
+/**
+ * 在作用域内替换当前线程的追踪上下文，离开作用域时恢复
+ */
+class TraceScope {
+public:
+    TraceScope(const TraceContext &context) {
+        auto &current = TraceContext::current();
+        _old = current;
+        current = context;
+    }
+
+    ~TraceScope() {
+        TraceContext::current() = _old;
+    }
+
+private:
+    TraceContext _old;
+};
+
+} /* namespace toolkit */
+#endif /* UTIL_TRACECONTEXT_H_ */
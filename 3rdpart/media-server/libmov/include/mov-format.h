@@ -36,6 +36,7 @@
 /// MOV flags
 #define MOV_FLAG_FASTSTART	0x00000001
 #define MOV_FLAG_SEGMENT	0x00000002 // fmp4_writer only
+#define MOV_FLAG_ABSOLUTE_TFDT	0x00000004 // fmp4_writer only, tfdt use input dts instead of relative to first sample
 
 /// MOV av stream flag
 #define MOV_AV_FLAG_KEYFREAME 0x0001
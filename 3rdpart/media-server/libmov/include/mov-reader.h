@@ -43,6 +43,14 @@ int mov_reader_read2(mov_reader_t* mov, mov_onalloc onalloc,  mov_reader_onread
 /// @return 0-ok, other-error
 int mov_reader_seek(mov_reader_t* mov, int64_t* timestamp);
 
+/// sample table entry, don't read sample data
+/// @param[in] offset sample data offset in file
+/// @param[in] pts/dts timestamp in ms
+typedef void (*mov_reader_onsample)(void* param, uint32_t track, uint64_t offset, size_t bytes, int64_t pts, int64_t dts, int flags);
+/// enumerate all samples of all tracks, in track order then decode order
+/// @return 0-ok, other-error
+int mov_reader_getsamples(mov_reader_t* mov, mov_reader_onsample onsample, void* param);
+
 #ifdef __cplusplus
 }
 #endif
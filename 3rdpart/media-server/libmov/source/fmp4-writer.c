@@ -452,7 +452,7 @@ int fmp4_writer_write_l(struct fmp4_writer_t* writer, int idx, const void* data,
     }
 
     if (INT64_MIN == track->start_dts)
-        track->start_dts = sample->dts;
+        track->start_dts = (writer->mov.flags & MOV_FLAG_ABSOLUTE_TFDT) ? 0 : sample->dts;
 	writer->mdat_size += bytes; // update media data size
 	track->sample_count += 1;
     track->last_dts = sample->dts;
@@ -520,6 +520,28 @@ int mov_reader_getinfo(struct mov_reader_t* reader, struct mov_reader_trackinfo_
 	return 0;
 }
 
+int mov_reader_getsamples(struct mov_reader_t* reader, mov_reader_onsample onsample, void* param)
+{
+	int i;
+	uint32_t j;
+	struct mov_track_t* track;
+	struct mov_sample_t* sample;
+
+	for (i = 0; i < reader->mov.track_count; i++)
+	{
+		track = &reader->mov.tracks[i];
+		if (0 == track->mdhd.timescale)
+			continue;
+
+		for (j = 0; j < track->sample_count; j++)
+		{
+			sample = &track->samples[j];
+			onsample(param, track->tkhd.track_ID, sample->offset, sample->bytes, sample->pts * 1000 / track->mdhd.timescale, sample->dts * 1000 / track->mdhd.timescale, sample->flags);
+		}
+	}
+	return 0;
+}
+
 uint64_t mov_reader_getduration(struct mov_reader_t* reader)
 {
 	return 0 != reader->mov.mvhd.timescale ? reader->mov.mvhd.duration * 1000 / reader->mov.mvhd.timescale : 0;
@@ -0,0 +1,103 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef MK_FRAME_SUBSCRIBER_H_
+#define MK_FRAME_SUBSCRIBER_H_
+
+#include "mk_common.h"
+#include "mk_events_objects.h"
+#include "mk_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////Frame/////////////////////////////////////////////
+//Frame对象的C映射
+typedef void *mk_frame;
+
+//Frame::getCodecId(), 0:CodecH264/1:CodecH265/2:CodecAAC/3:CodecG711A/4:CodecG711U/5:OPUS
+API_EXPORT int API_CALL mk_frame_get_codec_id(mk_frame frame);
+//Frame::data()
+API_EXPORT const char* API_CALL mk_frame_get_data(mk_frame frame);
+//Frame::size()
+API_EXPORT int API_CALL mk_frame_get_data_size(mk_frame frame);
+//Frame::prefixSize(), h264/h265起始码或aac adts头长度
+API_EXPORT int API_CALL mk_frame_get_data_prefix_size(mk_frame frame);
+//Frame::dts()
+API_EXPORT uint32_t API_CALL mk_frame_get_dts(mk_frame frame);
+//Frame::pts()
+API_EXPORT uint32_t API_CALL mk_frame_get_pts(mk_frame frame);
+//Frame::keyFrame()
+API_EXPORT int API_CALL mk_frame_is_key(mk_frame frame);
+//Frame::configFrame()
+API_EXPORT int API_CALL mk_frame_is_config(mk_frame frame);
+
+/**
+ * 引用帧，帧回调中的mk_frame对象只在回调期间有效，需要异步处理时请先引用之(不拷贝帧数据)
+ * @param frame 帧对象
+ * @return 新的帧对象，用完后请调用mk_frame_unref释放
+ */
+API_EXPORT mk_frame API_CALL mk_frame_ref(mk_frame frame);
+
+/**
+ * 释放mk_frame_ref返回的帧对象
+ */
+API_EXPORT void API_CALL mk_frame_unref(mk_frame frame);
+
+///////////////////////////////////////////FrameSubscriber/////////////////////////////////////////////
+typedef void *mk_frame_subscriber;
+
+/**
+ * 收到帧回调
+ * @param user_data 用户数据指针
+ * @param frame 帧对象，只在回调期间有效
+ */
+typedef void(API_CALL *on_mk_frame_subscriber_frame)(void *user_data, mk_frame frame);
+
+/**
+ * 媒体源注销回调，此后不会再收到帧
+ * @param user_data 用户数据指针
+ */
+typedef void(API_CALL *on_mk_frame_subscriber_detach)(void *user_data);
+
+/**
+ * 进程内订阅媒体源的帧数据，无需通过rtsp/rtmp等协议拉流
+ * @param ctx 媒体源，可以通过mk_media_source_find获取
+ * @param thread 回调所在线程，为NULL时从后台工作线程池中选取
+ * @param use_gop 是否先回放gop缓存，这样可以立即从关键帧开始解码
+ * @param max_lag_ms 允许积压的最大时长(毫秒)，超过后丢弃后续帧直到下一个关键帧，为0时不丢帧
+ * @param on_frame 帧回调
+ * @param on_detach 媒体源注销回调，可以为NULL
+ * @param user_data 回调用户数据指针
+ * @return 订阅者对象，该媒体源不支持订阅时返回NULL
+ */
+API_EXPORT mk_frame_subscriber API_CALL mk_frame_subscriber_create(const mk_media_source ctx, mk_thread thread, int use_gop, uint32_t max_lag_ms,
+                                                                   on_mk_frame_subscriber_frame on_frame,
+                                                                   on_mk_frame_subscriber_detach on_detach,
+                                                                   void *user_data);
+
+/**
+ * 取消订阅并销毁对象，返回后不会再触发回调
+ * @param ctx 订阅者对象
+ */
+API_EXPORT void API_CALL mk_frame_subscriber_release(mk_frame_subscriber ctx);
+
+/**
+ * 获取因积压而丢弃的帧数
+ * @param ctx 订阅者对象
+ */
+API_EXPORT uint64_t API_CALL mk_frame_subscriber_get_dropped(mk_frame_subscriber ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MK_FRAME_SUBSCRIBER_H_ */
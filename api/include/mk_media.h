@@ -106,6 +106,23 @@ API_EXPORT void API_CALL mk_media_input_aac(mk_media ctx, void *data, int len, u
  */
 API_EXPORT void API_CALL mk_media_input_pcm(mk_media ctx, void *data, int len, uint32_t pts);
 
+/**
+ * 输入yuv420p视频帧,启用ENABLE_X264编译时，该函数才有效
+ * @param ctx 对象指针
+ * @param yuv 各平面数据指针
+ * @param linesize 各平面行字节数
+ * @param pts 时间戳，毫秒
+ */
+API_EXPORT void API_CALL mk_media_input_yuv(mk_media ctx, const char *yuv[3], int linesize[3], uint32_t pts);
+
+/**
+ * 设置yuv/pcm编码选项，需要在首次输入yuv/pcm前调用
+ * @param ctx 对象指针
+ * @param async 是否在后台线程池中编码，开启后输入yuv/pcm时只拷贝数据，多路通道并行编码
+ * @param max_queue 异步编码时音频、视频各自最多排队的帧数，超过后丢弃最早的帧
+ */
+API_EXPORT void API_CALL mk_media_set_encode_option(mk_media ctx, int async, int max_queue);
+
 /**
  * 输入单帧OPUS/G711音频帧
  * @param ctx 对象指针
@@ -115,6 +132,50 @@ API_EXPORT void API_CALL mk_media_input_pcm(mk_media ctx, void *data, int len, u
  */
 API_EXPORT void API_CALL mk_media_input_audio(mk_media ctx, void* data, int len, uint32_t dts);
 
+/**
+ * 无拷贝输入帧时，帧内存不再被引用的回调
+ * 该回调可能在其他线程触发
+ * @param user_data 用户数据指针
+ * @param data 帧数据指针
+ */
+typedef void(API_CALL *on_mk_frame_data_release)(void *user_data, void *data);
+
+/**
+ * 无拷贝输入单帧数据，帧内存由调用者持有，ZLMediaKit直接引用该内存(包括gop缓存等场景)，
+ * 在触发释放回调之前，调用者不得修改或释放该内存
+ * @param ctx 对象指针
+ * @param track_id 0:CodecH264/1:CodecH265/2:CodecAAC/3:CodecG711A/4:CodecG711U/5:OPUS
+ * @param data 单帧数据，h264/h265需带00 00 01或00 00 00 01起始码，aac需带adts头
+ * @param len 单帧数据字节数
+ * @param dts 解码时间戳，单位毫秒
+ * @param pts 播放时间戳，单位毫秒
+ * @param cb 释放回调，可以为null
+ * @param user_data 释放回调用户数据指针
+ */
+API_EXPORT void API_CALL mk_media_input_frame(mk_media ctx, int track_id, void *data, int len, uint32_t dts, uint32_t pts,
+                                              on_mk_frame_data_release cb, void *user_data);
+
+/**
+ * 批量输入时的单帧信息，各字段含义同mk_media_input_frame
+ */
+typedef struct {
+    int track_id;
+    void *data;
+    int len;
+    uint32_t dts;
+    uint32_t pts;
+    on_mk_frame_data_release cb;
+    void *user_data;
+} mk_frame_info;
+
+/**
+ * 无拷贝批量输入多帧数据(可以包含多个track)，减少跨语言调用次数
+ * @param ctx 对象指针
+ * @param frames 帧信息数组，按顺序输入
+ * @param count 帧个数
+ */
+API_EXPORT void API_CALL mk_media_input_frames(mk_media ctx, const mk_frame_info *frames, int count);
+
 /**
  * MediaSource.close()回调事件
  * 在选择关闭一个关联的MediaSource时，将会最终触发到该回调
@@ -0,0 +1,154 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "mk_frame_subscriber.h"
+#include "Util/logger.h"
+#include "Common/FrameSubscriber.h"
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+///////////////////////////////////////////Frame/////////////////////////////////////////////
+API_EXPORT int API_CALL mk_frame_get_codec_id(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->getCodecId();
+}
+
+API_EXPORT const char* API_CALL mk_frame_get_data(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->data();
+}
+
+API_EXPORT int API_CALL mk_frame_get_data_size(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->size();
+}
+
+API_EXPORT int API_CALL mk_frame_get_data_prefix_size(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->prefixSize();
+}
+
+API_EXPORT uint32_t API_CALL mk_frame_get_dts(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->dts();
+}
+
+API_EXPORT uint32_t API_CALL mk_frame_get_pts(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->pts();
+}
+
+API_EXPORT int API_CALL mk_frame_is_key(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->keyFrame();
+}
+
+API_EXPORT int API_CALL mk_frame_is_config(mk_frame frame) {
+    assert(frame);
+    return (*(Frame::Ptr *) frame)->configFrame();
+}
+
+API_EXPORT mk_frame API_CALL mk_frame_ref(mk_frame frame) {
+    assert(frame);
+    return new Frame::Ptr(*(Frame::Ptr *) frame);
+}
+
+API_EXPORT void API_CALL mk_frame_unref(mk_frame frame) {
+    assert(frame);
+    delete (Frame::Ptr *) frame;
+}
+
+///////////////////////////////////////////FrameSubscriber/////////////////////////////////////////////
+class FrameSubscriberForC : public std::enable_shared_from_this<FrameSubscriberForC> {
+public:
+    typedef std::shared_ptr<FrameSubscriberForC> Ptr;
+
+    FrameSubscriberForC(const EventPoller::Ptr &poller, bool use_gop, uint32_t max_lag_ms,
+                        on_mk_frame_subscriber_frame on_frame, on_mk_frame_subscriber_detach on_detach, void *user_data) {
+        _subscriber = std::make_shared<FrameSubscriber>(poller, use_gop, max_lag_ms);
+        _on_frame = on_frame;
+        _on_detach = on_detach;
+        _user_data = user_data;
+    }
+
+    ~FrameSubscriberForC() {}
+
+    bool attach(const MediaSource::Ptr &src) {
+        weak_ptr<FrameSubscriberForC> weak_self = shared_from_this();
+        _subscriber->setOnFrame([weak_self](const Frame::Ptr &frame) {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            lock_guard<recursive_mutex> lck(strong_self->_mtx);
+            if (strong_self->_on_frame) {
+                strong_self->_on_frame(strong_self->_user_data, (mk_frame) &frame);
+            }
+        });
+        _subscriber->setOnDetach([weak_self]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            lock_guard<recursive_mutex> lck(strong_self->_mtx);
+            if (strong_self->_on_detach) {
+                strong_self->_on_detach(strong_self->_user_data);
+            }
+        });
+        return _subscriber->attach(src);
+    }
+
+    void unset() {
+        lock_guard<recursive_mutex> lck(_mtx);
+        _on_frame = nullptr;
+        _on_detach = nullptr;
+    }
+
+    FrameSubscriber::Ptr &getSubscriber() {
+        return _subscriber;
+    }
+
+private:
+    recursive_mutex _mtx;
+    on_mk_frame_subscriber_frame _on_frame;
+    on_mk_frame_subscriber_detach _on_detach;
+    void *_user_data;
+    FrameSubscriber::Ptr _subscriber;
+};
+
+API_EXPORT mk_frame_subscriber API_CALL mk_frame_subscriber_create(const mk_media_source ctx, mk_thread thread, int use_gop, uint32_t max_lag_ms,
+                                                                   on_mk_frame_subscriber_frame on_frame,
+                                                                   on_mk_frame_subscriber_detach on_detach,
+                                                                   void *user_data) {
+    assert(ctx && on_frame);
+    MediaSource *src = (MediaSource *) ctx;
+    EventPoller::Ptr poller = thread ? ((EventPoller *) thread)->shared_from_this() : nullptr;
+    FrameSubscriberForC::Ptr *obj = new FrameSubscriberForC::Ptr(
+            std::make_shared<FrameSubscriberForC>(poller, use_gop, max_lag_ms, on_frame, on_detach, user_data));
+    if (!(*obj)->attach(src->shared_from_this())) {
+        delete obj;
+        return nullptr;
+    }
+    return (mk_frame_subscriber) obj;
+}
+
+API_EXPORT void API_CALL mk_frame_subscriber_release(mk_frame_subscriber ctx) {
+    assert(ctx);
+    FrameSubscriberForC::Ptr *obj = (FrameSubscriberForC::Ptr *) ctx;
+    (*obj)->unset();
+    delete obj;
+}
+
+API_EXPORT uint64_t API_CALL mk_frame_subscriber_get_dropped(mk_frame_subscriber ctx) {
+    assert(ctx);
+    FrameSubscriberForC::Ptr *obj = (FrameSubscriberForC::Ptr *) ctx;
+    return (*obj)->getSubscriber()->getDroppedFrames();
+}
@@ -183,12 +183,58 @@ API_EXPORT void API_CALL mk_media_input_pcm(mk_media ctx, void *data , int len,
 	(*obj)->getChannel()->inputPCM((char*)data, len, pts);
 }
 
+API_EXPORT void API_CALL mk_media_input_yuv(mk_media ctx, const char *yuv[3], int linesize[3], uint32_t pts) {
+    assert(ctx && yuv && linesize);
+    MediaHelper::Ptr *obj = (MediaHelper::Ptr *) ctx;
+    (*obj)->getChannel()->inputYUV((char **) yuv, linesize, pts);
+}
+
+API_EXPORT void API_CALL mk_media_set_encode_option(mk_media ctx, int async, int max_queue) {
+    assert(ctx);
+    MediaHelper::Ptr *obj = (MediaHelper::Ptr *) ctx;
+    EncodeOption option;
+    option.async = async;
+    if (max_queue > 0) {
+        option.max_queue = max_queue;
+    }
+    (*obj)->getChannel()->setEncodeOption(option);
+}
+
 API_EXPORT void API_CALL mk_media_input_audio(mk_media ctx, void* data, int len, uint32_t dts){
     assert(ctx && data && len > 0);
     MediaHelper::Ptr* obj = (MediaHelper::Ptr*) ctx;
     (*obj)->getChannel()->inputAudio((char*)data, len, dts);
 }
 
+static void inputFrameNoCopy(DevChannel::Ptr &channel, int track_id, void *data, int len, uint32_t dts, uint32_t pts,
+                             on_mk_frame_data_release cb, void *user_data) {
+    function<void()> on_release;
+    if (cb) {
+        on_release = [cb, user_data, data]() {
+            cb(user_data, data);
+        };
+    }
+    channel->inputFrameNoCopy((CodecId) track_id, (char *) data, len, dts, pts, on_release);
+}
+
+API_EXPORT void API_CALL mk_media_input_frame(mk_media ctx, int track_id, void *data, int len, uint32_t dts, uint32_t pts,
+                                              on_mk_frame_data_release cb, void *user_data) {
+    assert(ctx && data && len > 0);
+    MediaHelper::Ptr *obj = (MediaHelper::Ptr *) ctx;
+    inputFrameNoCopy((*obj)->getChannel(), track_id, data, len, dts, pts, cb, user_data);
+}
+
+API_EXPORT void API_CALL mk_media_input_frames(mk_media ctx, const mk_frame_info *frames, int count) {
+    assert(ctx && frames && count >= 0);
+    MediaHelper::Ptr *obj = (MediaHelper::Ptr *) ctx;
+    auto &channel = (*obj)->getChannel();
+    for (int i = 0; i < count; ++i) {
+        auto &frame = frames[i];
+        assert(frame.data && frame.len > 0);
+        inputFrameNoCopy(channel, frame.track_id, frame.data, frame.len, frame.dts, frame.pts, frame.cb, frame.user_data);
+    }
+}
+
 API_EXPORT void API_CALL mk_media_start_send_rtp(mk_media ctx, const char *dst_url, uint16_t dst_port, const char *ssrc, int is_udp, on_mk_media_send_rtp_result cb, void *user_data){
     assert(ctx && dst_url && ssrc);
     MediaHelper::Ptr* obj = (MediaHelper::Ptr*) ctx;
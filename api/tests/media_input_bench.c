@@ -0,0 +1,214 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mk_mediakit.h"
+#ifdef _WIN32
+#include "windows.h"
+#endif
+
+/**
+ * 对比mk_media_input_h264(拷贝)、mk_media_input_frame(无拷贝)、mk_media_input_frames(无拷贝批量)的帧输入性能
+ * 用法: api_tester_media_input_bench [帧数] [P帧字节数] [批量大小]
+ */
+
+#define GOP_SIZE 50
+#define FRAME_INTERVAL_MS 40
+
+//1280x720 baseline sps/pps
+static const char s_sps[] = "\x00\x00\x00\x01\x67\x42\x00\x28\xda\x01\x40\x16\xe8\x40\x00\x00\xfa\x00\x00\x30\xd4\x21";
+static const char s_pps[] = "\x00\x00\x00\x01\x68\xce\x3c\x80";
+
+typedef struct {
+    char *sps;
+    int sps_len;
+    char *pps;
+    int pps_len;
+    char *idr;
+    int idr_len;
+    char *p;
+    int p_len;
+} bench_frames;
+
+//释放回调在媒体源的工作线程中触发，计数需要原子操作
+#ifdef _WIN32
+static volatile LONG s_release_count = 0;
+#define release_count_add() InterlockedIncrement(&s_release_count)
+#define release_count_get() InterlockedCompareExchange(&s_release_count, 0, 0)
+#define release_count_reset() InterlockedExchange(&s_release_count, 0)
+#else
+static long s_release_count = 0;
+#define release_count_add() __sync_fetch_and_add(&s_release_count, 1)
+#define release_count_get() __sync_fetch_and_add(&s_release_count, 0)
+#define release_count_reset() __sync_lock_test_and_set(&s_release_count, 0)
+#endif
+
+static void API_CALL on_frame_release(void *user_data, void *data) {
+    release_count_add();
+}
+
+static char *make_nalu(const char *prefix, int prefix_len, int len) {
+    int i;
+    char *ret = (char *) malloc(len);
+    memcpy(ret, prefix, prefix_len);
+    for (i = prefix_len; i < len; ++i) {
+        //避免出现起始码
+        ret[i] = (char) (0x80 | (rand() & 0x7F));
+    }
+    return ret;
+}
+
+static mk_media create_media(const char *stream) {
+    mk_media media = mk_media_create("__defaultVhost__", "bench", stream, 0, 0, 0);
+    mk_media_init_video(media, 0, 1280, 720, 25);
+    mk_media_init_complete(media);
+    return media;
+}
+
+//获取第index帧的nalu列表，返回个数
+static int get_frame(const bench_frames *frames, int index, char **data, int *len) {
+    if (index % GOP_SIZE) {
+        data[0] = frames->p;
+        len[0] = frames->p_len;
+        return 1;
+    }
+    data[0] = frames->sps;
+    len[0] = frames->sps_len;
+    data[1] = frames->pps;
+    len[1] = frames->pps_len;
+    data[2] = frames->idr;
+    len[2] = frames->idr_len;
+    return 3;
+}
+
+static void report(const char *mode, int frame_count, long bytes, uint64_t elapsed_ms) {
+    double sec = elapsed_ms ? elapsed_ms / 1000.0 : 0.001;
+    printf("%-8s frames:%d elapsed:%llums fps:%.0f throughput:%.1fMB/s released:%ld\n",
+           mode, frame_count, (unsigned long long) elapsed_ms, frame_count / sec, bytes / sec / 1024 / 1024, (long) release_count_get());
+}
+
+static void bench_copy(const bench_frames *frames, int frame_count) {
+    char *data[3];
+    int len[3];
+    long bytes = 0;
+    int i, j, n;
+    uint64_t start;
+    mk_media media = create_media("copy");
+    start = mk_util_get_current_millisecond();
+    for (i = 0; i < frame_count; ++i) {
+        uint32_t dts = (i + 1) * FRAME_INTERVAL_MS;
+        n = get_frame(frames, i, data, len);
+        for (j = 0; j < n; ++j) {
+            mk_media_input_h264(media, data[j], len[j], dts, dts);
+            bytes += len[j];
+        }
+    }
+    report("copy", frame_count, bytes, mk_util_get_current_millisecond() - start);
+    mk_media_release(media);
+}
+
+static void bench_no_copy(const bench_frames *frames, int frame_count) {
+    char *data[3];
+    int len[3];
+    long bytes = 0;
+    int i, j, n;
+    uint64_t start;
+    mk_media media = create_media("no_copy");
+    release_count_reset();
+    start = mk_util_get_current_millisecond();
+    for (i = 0; i < frame_count; ++i) {
+        uint32_t dts = (i + 1) * FRAME_INTERVAL_MS;
+        n = get_frame(frames, i, data, len);
+        for (j = 0; j < n; ++j) {
+            mk_media_input_frame(media, 0, data[j], len[j], dts, dts, on_frame_release, NULL);
+            bytes += len[j];
+        }
+    }
+    report("no_copy", frame_count, bytes, mk_util_get_current_millisecond() - start);
+    mk_media_release(media);
+}
+
+static void bench_batch(const bench_frames *frames, int frame_count, int batch_size) {
+    char *data[3];
+    int len[3];
+    long bytes = 0;
+    int i, j, n, count = 0;
+    uint64_t start;
+    mk_frame_info *batch = (mk_frame_info *) malloc(sizeof(mk_frame_info) * (batch_size + 3));
+    mk_media media = create_media("batch");
+    release_count_reset();
+    start = mk_util_get_current_millisecond();
+    for (i = 0; i < frame_count; ++i) {
+        uint32_t dts = (i + 1) * FRAME_INTERVAL_MS;
+        n = get_frame(frames, i, data, len);
+        for (j = 0; j < n; ++j) {
+            mk_frame_info *info = &batch[count++];
+            info->track_id = 0;
+            info->data = data[j];
+            info->len = len[j];
+            info->dts = dts;
+            info->pts = dts;
+            info->cb = on_frame_release;
+            info->user_data = NULL;
+            bytes += len[j];
+        }
+        if (count >= batch_size) {
+            mk_media_input_frames(media, batch, count);
+            count = 0;
+        }
+    }
+    mk_media_input_frames(media, batch, count);
+    report("batch", frame_count, bytes, mk_util_get_current_millisecond() - start);
+    mk_media_release(media);
+    free(batch);
+}
+
+int main(int argc, char *argv[]) {
+    int frame_count = argc > 1 ? atoi(argv[1]) : 20000;
+    int p_len = argc > 2 ? atoi(argv[2]) : 32 * 1024;
+    int batch_size = argc > 3 ? atoi(argv[3]) : 16;
+    bench_frames frames;
+
+    mk_config config = {
+            .ini = NULL,
+            .ini_is_path = 0,
+            .log_level = 4,
+            .log_file_path = NULL,
+            .log_file_days = 0,
+            .ssl = NULL,
+            .ssl_is_path = 0,
+            .ssl_pwd = NULL,
+            .thread_num = 0
+    };
+    mk_env_init(&config);
+
+    frames.sps_len = sizeof(s_sps) - 1;
+    frames.sps = make_nalu(s_sps, frames.sps_len, frames.sps_len);
+    frames.pps_len = sizeof(s_pps) - 1;
+    frames.pps = make_nalu(s_pps, frames.pps_len, frames.pps_len);
+    frames.idr_len = p_len * 4;
+    frames.idr = make_nalu("\x00\x00\x00\x01\x65", 5, frames.idr_len);
+    frames.p_len = p_len;
+    frames.p = make_nalu("\x00\x00\x00\x01\x41", 5, frames.p_len);
+
+    printf("frames:%d p_frame_size:%d idr_frame_size:%d batch:%d\n", frame_count, p_len, frames.idr_len, batch_size);
+    bench_copy(&frames, frame_count);
+    bench_no_copy(&frames, frame_count);
+    bench_batch(&frames, frame_count, batch_size);
+
+    free(frames.sps);
+    free(frames.pps);
+    free(frames.idr);
+    free(frames.p);
+    mk_stop_all_server();
+    return 0;
+}
@@ -24,8 +24,13 @@
 #endif //ENABLE_MYSQL
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/SyntheticSource.h"
+#include "Common/LatencyTracer.h"
+#include "Common/MediaMetrics.h"
+#include "Record/RecordCatalog.h"
 #include "Http/HttpRequester.h"
 #include "Http/HttpSession.h"
+#include "Http/ApiJsonWriter.h"
 #include "Network/TcpServer.h"
 #include "Player/PlayerProxy.h"
 #include "Util/MD5.h"
@@ -255,6 +260,10 @@ static recursive_mutex s_proxyMapMtx;
 static unordered_map<string ,FFmpegSource::Ptr> s_ffmpegMap;
 static recursive_mutex s_ffmpegMapMtx;
 
+//合成媒体源列表
+static unordered_map<string ,SyntheticSource::Ptr> s_syntheticMap;
+static recursive_mutex s_syntheticMapMtx;
+
 #if defined(ENABLE_RTPPROXY)
 //rtp服务器列表
 static unordered_map<string, RtpServer::Ptr> s_rtpServerMap;
@@ -265,6 +274,25 @@ static inline string getProxyKey(const string &vhost,const string &app,const str
     return vhost + "/" + app + "/" + stream;
 }
 
+//根据名称获取编码类型，譬如H264、AAC、none
+static CodecId getCodecIdByName(const string &name, CodecId default_codec){
+    if(name.empty()){
+        return default_codec;
+    }
+    for(int codec = CodecH264; codec <= CodecL16; ++codec){
+        if(strcasecmp(getCodecName((CodecId) codec) + strlen("Codec"), name.data()) == 0){
+            return (CodecId) codec;
+        }
+    }
+    return CodecInvalid;
+}
+
+//列表接口的分页与字段筛选参数
+//offset为跳过的条数，count为本页最大条数(0为不限)，fields为逗号分隔的字段名(为空时输出所有字段)
+static ApiListArgs getListArgs(ApiArgsType &allArgs) {
+    return ApiListArgs(allArgs["offset"].as<uint64_t>(), allArgs["count"].as<uint64_t>(), allArgs["fields"]);
+}
+
 /**
  * 安装api接口
  * 所有api都支持GET和POST两种方式
@@ -310,6 +338,18 @@ void installWebApi() {
         });
     });
 
+    //以prometheus文本格式获取运行指标，包括各协议收发流量、RingBuffer读取器个数、socket发送队列、
+    //EventPoller循环耗时与任务队列、ResourcePool命中率、hook耗时、hls切片耗时、mp4录制写入耗时等
+    //测试url http://127.0.0.1/index/api/metrics
+    api_regist2("/index/api/metrics",[](API_ARGS2){
+        CHECK_SECRET();
+        headerOut["Content-Type"] = "text/plain; version=0.0.4";
+        //指标在首次使用时才注册，此处确保未使用过的指标也能导出
+        MediaMetrics::Instance();
+        ToolkitMetrics::Instance();
+        invoker("200 OK", headerOut, MetricsRegistry::Instance().dump());
+    });
+
     //获取服务器配置
     //测试url http://127.0.0.1/index/api/getServerConfig
     api_regist1("/index/api/getServerConfig",[](API_ARGS1){
@@ -389,80 +429,34 @@ void installWebApi() {
 #endif//#if !defined(_WIN32)
 
 
-    static auto makeMediaSourceJson = [](const MediaSource::Ptr &media){
-        Value item;
-        item["schema"] = media->getSchema();
-        item["vhost"] = media->getVhost();
-        item["app"] = media->getApp();
-        item["stream"] = media->getId();
-        item["createStamp"] = (Json::UInt64) media->getCreateStamp();
-        item["aliveSecond"] = (Json::UInt64) media->getAliveSecond();
-        item["bytesSpeed"] = media->getBytesSpeed();
-        item["readerCount"] = media->readerCount();
-        item["totalReaderCount"] = media->totalReaderCount();
-        item["originType"] = (int) media->getOriginType();
-        item["originTypeStr"] = getOriginTypeString(media->getOriginType());
-        item["originUrl"] = media->getOriginUrl();
-        auto originSock = media->getOriginSock();
-        if (originSock) {
-            item["originSock"]["local_ip"] = originSock->get_local_ip();
-            item["originSock"]["local_port"] = originSock->get_local_port();
-            item["originSock"]["peer_ip"] = originSock->get_peer_ip();
-            item["originSock"]["peer_port"] = originSock->get_peer_port();
-            item["originSock"]["identifier"] = originSock->getIdentifier();
-        } else {
-            item["originSock"] = Json::nullValue;
-        }
-
-        for(auto &track : media->getTracks()){
-            Value obj;
-            auto codec_type = track->getTrackType();
-            obj["codec_id"] = track->getCodecId();
-            obj["codec_id_name"] = track->getCodecName();
-            obj["ready"] = track->ready();
-            obj["codec_type"] = codec_type;
-            switch(codec_type){
-                case TrackAudio : {
-                    auto audio_track = dynamic_pointer_cast<AudioTrack>(track);
-                    obj["sample_rate"] = audio_track->getAudioSampleRate();
-                    obj["channels"] = audio_track->getAudioChannel();
-                    obj["sample_bit"] = audio_track->getAudioSampleBit();
-                    break;
-                }
-                case TrackVideo : {
-                    auto video_track = dynamic_pointer_cast<VideoTrack>(track);
-                    obj["width"] = video_track->getVideoWidth();
-                    obj["height"] = video_track->getVideoHeight();
-                    obj["fps"] = round(video_track->getVideoFps());
-                    break;
-                }
-                default:
-                    break;
-            }
-            item["tracks"].append(obj);
-        }
-        return item;
-    };
-
     //获取流列表，可选筛选参数
     //测试url0(获取所有流) http://127.0.0.1/index/api/getMediaList
     //测试url1(获取虚拟主机为"__defaultVost__"的流) http://127.0.0.1/index/api/getMediaList?vhost=__defaultVost__
     //测试url2(获取rtsp类型的流) http://127.0.0.1/index/api/getMediaList?schema=rtsp
-    api_regist1("/index/api/getMediaList",[](API_ARGS1){
+    //测试url3(分页并只获取部分字段) http://127.0.0.1/index/api/getMediaList?offset=0&count=100&fields=app,stream,readerCount
+    api_regist2("/index/api/getMediaList",[](API_ARGS2){
         CHECK_SECRET();
-        //获取所有MediaSource列表
-        MediaSource::for_each_media([&](const MediaSource::Ptr &media){
-            if(!allArgs["schema"].empty() && allArgs["schema"] != media->getSchema()){
-                return;
-            }
-            if(!allArgs["vhost"].empty() && allArgs["vhost"] != media->getVhost()){
-                return;
-            }
-            if(!allArgs["app"].empty() && allArgs["app"] != media->getApp()){
-                return;
-            }
-            val["data"].append(makeMediaSourceJson(media));
-        });
+        auto list_args = getListArgs(allArgs);
+        //加锁期间只收集命中的MediaSource，不拷贝注册表
+        vector<MediaSource::Ptr> media_list;
+        MediaSource::for_each_media([&](const MediaSource::Ptr &media) {
+            media_list.emplace_back(media);
+        }, allArgs["schema"], allArgs["vhost"], allArgs["app"], allArgs["stream"]);
+
+        JsonStreamWriter writer;
+        writer.startObject();
+        writer.member("code", (int) API::Success);
+        writer.member("total", (uint64_t) media_list.size());
+        writer.key("data");
+        writer.startArray();
+        for (uint64_t i = list_args.begin(); i < list_args.end(media_list.size()); ++i) {
+            writer.startObject();
+            writeMediaSourceJson(writer, media_list[i], list_args);
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.endObject();
+        invoker("200 OK", headerOut, writer.takeBody());
     });
 
     //测试url http://127.0.0.1/index/api/isMediaOnline?schema=rtsp&vhost=__defaultVhost__&app=live&stream=obs
@@ -473,17 +467,65 @@ void installWebApi() {
     });
 
     //测试url http://127.0.0.1/index/api/getMediaInfo?schema=rtsp&vhost=__defaultVhost__&app=live&stream=obs
-    api_regist1("/index/api/getMediaInfo",[](API_ARGS1){
+    api_regist2("/index/api/getMediaInfo",[](API_ARGS2){
         CHECK_SECRET();
         CHECK_ARGS("schema","vhost","app","stream");
         auto src = MediaSource::find(allArgs["schema"],allArgs["vhost"],allArgs["app"],allArgs["stream"]);
         if(!src){
             val["online"] = false;
+            invoker("200 OK", headerOut, val.toStyledString());
             return;
         }
-        val = makeMediaSourceJson(src);
-        val["online"] = true;
-        val["code"] = API::Success;
+        JsonStreamWriter writer;
+        writer.startObject();
+        writer.member("code", (int) API::Success);
+        writer.member("online", true);
+        writeMediaSourceJson(writer, src, getListArgs(allArgs));
+        writer.endObject();
+        invoker("200 OK", headerOut, writer.takeBody());
+    });
+
+    //获取数据链路各阶段耗时分布，需要配置general.latencyTraceSample开启采样，可选筛选参数vhost/app/stream
+    //各阶段耗时均为从数据接收时刻起算的累计耗时，单位微秒；reset=1时获取后清空统计
+    //测试url http://127.0.0.1/index/api/getLatencyStats?vhost=__defaultVhost__&app=live&stream=obs
+    api_regist1("/index/api/getLatencyStats",[](API_ARGS1){
+        CHECK_SECRET();
+        bool reset = allArgs["reset"].as<bool>();
+        val["data"] = Json::arrayValue;
+        LatencyTracer::Instance().for_each([&](const StreamLatency::Ptr &stat){
+            if(!allArgs["vhost"].empty() && allArgs["vhost"] != stat->getVhost()){
+                return;
+            }
+            if(!allArgs["app"].empty() && allArgs["app"] != stat->getApp()){
+                return;
+            }
+            if(!allArgs["stream"].empty() && allArgs["stream"] != stat->getStream()){
+                return;
+            }
+            Value item;
+            item["vhost"] = stat->getVhost();
+            item["app"] = stat->getApp();
+            item["stream"] = stat->getStream();
+            for (int stage = 0; stage < LatencyStageMax; ++stage) {
+                auto name = getLatencyStageName(stage);
+                auto &histogram = stat->getHistogram(stage);
+                if (!name || !histogram.count()) {
+                    continue;
+                }
+                Value obj;
+                obj["count"] = (Json::UInt64) histogram.count();
+                obj["avg_us"] = (Json::UInt64) histogram.average();
+                obj["p50_us"] = (Json::UInt64) histogram.percentile(0.5);
+                obj["p90_us"] = (Json::UInt64) histogram.percentile(0.9);
+                obj["p99_us"] = (Json::UInt64) histogram.percentile(0.99);
+                obj["max_us"] = (Json::UInt64) histogram.max();
+                item["stages"][name] = obj;
+            }
+            if (reset) {
+                stat->clear();
+            }
+            val["data"].append(item);
+        });
     });
 
     //主动关断流，包括关断拉流、推流
@@ -517,21 +559,9 @@ void installWebApi() {
         int count_closed = 0;
         list<MediaSource::Ptr> media_list;
         MediaSource::for_each_media([&](const MediaSource::Ptr &media){
-            if(!allArgs["schema"].empty() && allArgs["schema"] != media->getSchema()){
-                return;
-            }
-            if(!allArgs["vhost"].empty() && allArgs["vhost"] != media->getVhost()){
-                return;
-            }
-            if(!allArgs["app"].empty() && allArgs["app"] != media->getApp()){
-                return;
-            }
-            if(!allArgs["stream"].empty() && allArgs["stream"] != media->getId()){
-                return;
-            }
             ++count_hit;
             media_list.emplace_back(media);
-        });
+        }, allArgs["schema"], allArgs["vhost"], allArgs["app"], allArgs["stream"]);
 
         bool force = allArgs["force"].as<bool>();
         for(auto &media : media_list){
@@ -546,12 +576,16 @@ void installWebApi() {
     //获取所有TcpSession列表信息
     //可以根据本地端口和远端ip来筛选
     //测试url(筛选某端口下的tcp会话) http://127.0.0.1/index/api/getAllSession?local_port=1935
-    api_regist1("/index/api/getAllSession",[](API_ARGS1){
+    //测试url(分页并只获取部分字段) http://127.0.0.1/index/api/getAllSession?offset=0&count=1000&fields=id,peer_ip
+    api_regist2("/index/api/getAllSession",[](API_ARGS2){
         CHECK_SECRET();
-        Value jsession;
+        auto list_args = getListArgs(allArgs);
         uint16_t local_port = allArgs["local_port"].as<uint16_t>();
         string &peer_ip = allArgs["peer_ip"];
 
+        //加锁期间只做筛选并收集本页的会话，序列化在释放锁后进行，避免长时间阻塞会话的创建与销毁
+        uint64_t total = 0;
+        vector<TcpSession::Ptr> session_list;
         SessionMap::Instance().for_each_session([&](const string &id,const TcpSession::Ptr &session){
             if(local_port != 0 && local_port != session->get_local_port()){
                 return;
@@ -559,14 +593,26 @@ void installWebApi() {
             if(!peer_ip.empty() && peer_ip != session->get_peer_ip()){
                 return;
             }
-            jsession["peer_ip"] = session->get_peer_ip();
-            jsession["peer_port"] = session->get_peer_port();
-            jsession["local_ip"] = session->get_local_ip();
-            jsession["local_port"] = session->get_local_port();
-            jsession["id"] = id;
-            jsession["typeid"] = typeid(*session).name();
-            val["data"].append(jsession);
+            if (list_args.inPage(total++)) {
+                session_list.emplace_back(session);
+            }
         });
+
+        SessionJsonWriter session_writer(list_args);
+        JsonStreamWriter writer;
+        writer.startObject();
+        writer.member("code", (int) API::Success);
+        writer.member("total", total);
+        writer.key("data");
+        writer.startArray();
+        for (auto &session : session_list) {
+            writer.startObject();
+            session_writer.write(writer, *session, typeid(*session).name());
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.endObject();
+        invoker("200 OK", headerOut, writer.takeBody());
     });
 
     //断开tcp连接，比如说可以断开rtsp、rtmp播放器等
@@ -746,6 +792,66 @@ void installWebApi() {
         api_delFFmpegSource(API_ARGS_VALUE1);
     });
 
+    //添加合成媒体源，用于无外部流时的压测
+    //count大于1时批量添加，流id为stream_0、stream_1...
+    //测试url http://127.0.0.1/index/api/addSyntheticSource?vhost=__defaultVhost__&app=synthetic&stream=0&video_codec=H264&audio_codec=AAC&count=100
+    api_regist1("/index/api/addSyntheticSource",[](API_ARGS1){
+        CHECK_SECRET();
+        CHECK_ARGS("vhost","app","stream");
+        SyntheticVideoInfo video;
+        video.codecId = getCodecIdByName(allArgs["video_codec"], CodecH264);
+        if(!allArgs["width"].empty()){
+            video.iWidth = allArgs["width"];
+        }
+        if(!allArgs["height"].empty()){
+            video.iHeight = allArgs["height"];
+        }
+        if(!allArgs["fps"].empty()){
+            video.iFrameRate = allArgs["fps"];
+        }
+        if(!allArgs["gop"].empty()){
+            video.iGop = allArgs["gop"];
+        }
+        if(!allArgs["video_bitrate"].empty()){
+            video.iBitRate = allArgs["video_bitrate"];
+        }
+
+        SyntheticAudioInfo audio;
+        audio.codecId = getCodecIdByName(allArgs["audio_codec"], CodecAAC);
+        if(!allArgs["channels"].empty()){
+            audio.iChannel = allArgs["channels"];
+        }
+        if(!allArgs["sample_rate"].empty()){
+            audio.iSampleRate = allArgs["sample_rate"];
+        }
+        if(!allArgs["audio_bitrate"].empty()){
+            audio.iBitRate = allArgs["audio_bitrate"];
+        }
+
+        int count = allArgs["count"].empty() ? 1 : allArgs["count"].as<int>();
+        lock_guard<recursive_mutex> lck(s_syntheticMapMtx);
+        for (int i = 0; i < count; ++i) {
+            string stream = count > 1 ? allArgs["stream"] + "_" + to_string(i) : allArgs["stream"];
+            auto key = getProxyKey(allArgs["vhost"], allArgs["app"], stream);
+            if(s_syntheticMap.find(key) == s_syntheticMap.end()){
+                auto source = SyntheticSource::create(allArgs["vhost"], allArgs["app"], stream, video, audio,
+                                                      allArgs["enable_hls"], allArgs["enable_mp4"]);
+                source->start();
+                s_syntheticMap[key] = source;
+            }
+            val["data"]["key"].append(key);
+        }
+    });
+
+    //关闭合成媒体源
+    //测试url http://127.0.0.1/index/api/delSyntheticSource?key=__defaultVhost__/synthetic/0
+    api_regist1("/index/api/delSyntheticSource",[](API_ARGS1){
+        CHECK_SECRET();
+        CHECK_ARGS("key");
+        lock_guard<recursive_mutex> lck(s_syntheticMapMtx);
+        val["data"]["flag"] = s_syntheticMap.erase(allArgs["key"]) == 1;
+    });
+
     //新增http api下载可执行程序文件接口
     //测试url http://127.0.0.1/index/api/downloadBin
     api_regist2("/index/api/downloadBin",[](API_ARGS2){
@@ -916,8 +1022,8 @@ void installWebApi() {
             if (pos != string::npos) {
                 string relative_path = path.substr(pos + 1);
                 if (search_mp4) {
-                    if (!isDir) {
-                        //我们只收集mp4文件，对文件夹不感兴趣
+                    if (!isDir && end_with(relative_path, ".mp4")) {
+                        //我们只收集mp4文件，对文件夹与其他文件不感兴趣
                         paths.append(relative_path);
                     }
                 } else if (isDir && relative_path.find(period) == 0) {
@@ -932,6 +1038,31 @@ void installWebApi() {
         val["data"]["paths"] = paths;
     });
 
+    //查询与时间段[start, end)重叠的录像(mp4文件与ts切片)，时间为unix时间戳，单位秒
+    //type为录制类型(0:hls, 1:mp4)，不传则不限；count为最多返回的条数，不传则不限
+    //http://127.0.0.1/index/api/getRecordSegments?vhost=__defaultVhost__&app=live&stream=ss&start=1600000000&end=1600086400
+    api_regist1("/index/api/getRecordSegments", [](API_ARGS1){
+        CHECK_SECRET();
+        CHECK_ARGS("vhost", "app", "stream", "start", "end");
+        auto type = allArgs["type"].empty() ? -1 : allArgs["type"].as<int>();
+        auto segments = RecordCatalog::Instance().find(allArgs["vhost"], allArgs["app"], allArgs["stream"],
+                                                       allArgs["start"].as<int64_t>(), allArgs["end"].as<int64_t>(),
+                                                       type, allArgs["count"].as<size_t>());
+        Json::Value data(arrayValue);
+        for (auto &segment : segments) {
+            Json::Value item;
+            item["type"] = (int) segment.type;
+            item["start_time"] = (Json::Int64) segment.start_time;
+            item["time_len"] = segment.time_len;
+            item["file_size"] = (Json::UInt64) segment.file_size;
+            item["file_path"] = segment.file_path;
+            item["url"] = segment.url;
+            data.append(item);
+        }
+        val["data"] = data;
+        val["ready"] = RecordCatalog::Instance().isReady();
+    });
+
     static auto responseSnap = [](const string &snap_path,
                                   const HttpSession::KeyValue &headerIn,
                                   const HttpSession::HttpResponseInvoker &invoker) {
@@ -950,6 +1081,49 @@ void installWebApi() {
         invoker.responseFile(headerIn, headerOut, snap_path);
     };
 
+    //获取流的最新视频关键帧(含sps/pps等配置帧)，直接从内存回复，不启动FFmpeg进程
+    //format为annexb(默认，h264/h265裸流)或mp4(只含该帧的fmp4)，可由调用者自行解码生成图片
+    //测试url http://127.0.0.1/index/api/getKeyFrame?vhost=__defaultVhost__&app=live&stream=obs&format=annexb
+    api_regist2("/index/api/getKeyFrame", [](API_ARGS2){
+        CHECK_SECRET();
+        CHECK_ARGS("vhost", "app", "stream");
+        auto src = MediaSource::find(allArgs["vhost"], allArgs["app"], allArgs["stream"]);
+        if (!src) {
+            throw ApiRetException("该媒体流不存在", API::OtherFailed);
+        }
+        auto snap = src->getKeyFrameSnap();
+        if (!snap) {
+            throw ApiRetException("该媒体流尚无视频关键帧", API::OtherFailed);
+        }
+        string format = allArgs["format"].empty() ? "annexb" : allArgs["format"];
+        string body;
+        if (format == "annexb") {
+            body = snap->toAnnexB();
+            headerOut["Content-Type"] = snap->codec == CodecH265 ? "video/h265" : "video/h264";
+        }
+#if defined(ENABLE_MP4)
+        else if (format == "mp4") {
+            for (auto &track : src->getTracks()) {
+                if (track->getTrackType() == TrackVideo) {
+                    body = snap->toMP4(track);
+                    break;
+                }
+            }
+            headerOut["Content-Type"] = HttpFileManager::getContentType(".mp4");
+        }
+#endif
+        else {
+            throw InvalidArgsException(("不支持的format:" + format).data());
+        }
+        if (body.empty()) {
+            throw ApiRetException("生成关键帧数据失败", API::OtherFailed);
+        }
+        //关键帧的时间戳与其生成时的系统时间(毫秒)
+        headerOut["X-Frame-Dts"] = to_string(snap->dts);
+        headerOut["X-Frame-Time"] = to_string(snap->stamp_ms);
+        invoker("200 OK", headerOut, body);
+    });
+
     //获取截图缓存或者实时截图
     //http://127.0.0.1/index/api/getSnap?url=rtmp://127.0.0.1/record/robot.mp4&timeout_sec=10&expire_sec=3
     api_regist2("/index/api/getSnap", [](API_ARGS2){
@@ -1165,6 +1339,11 @@ void unInstallWebApi(){
         s_ffmpegMap.clear();
     }
 
+    {
+        lock_guard<recursive_mutex> lck(s_syntheticMapMtx);
+        s_syntheticMap.clear();
+    }
+
     {
 #if defined(ENABLE_RTPPROXY)
         RtpSelector::Instance().clear();
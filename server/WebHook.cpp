@@ -16,6 +16,7 @@
 #include "Util/NoticeCenter.h"
 #include "Common/config.h"
 #include "Common/MediaSource.h"
+#include "Common/MediaMetrics.h"
 #include "Http/HttpRequester.h"
 #include "Network/TcpSession.h"
 #include "Rtsp/RtspSession.h"
@@ -145,6 +146,8 @@ static void do_http_hook(const string &url,const ArgsType &body,const function<v
             const_cast<HttpRequester::Ptr &>(requester).reset();
         });
         parse_http_response(ex,status,header,strRecvBody,[&](const Value &obj,const string &err){
+            auto &metrics = MediaMetrics::Instance();
+            (err.empty() ? metrics.hook_success : metrics.hook_failed).observe(pTicker->elapsedTime() * 1000);
             if(fun){
                 fun(obj,err);
             }
@@ -25,6 +25,8 @@
 #include "Shell/ShellSession.h"
 #include "Http/WebSocketSession.h"
 #include "Rtp/RtpServer.h"
+#include "Shm/ShmMediaBus.h"
+#include "Record/RecordCatalog.h"
 #include "WebApi.h"
 #include "WebHook.h"
 
@@ -237,6 +239,8 @@ int start_main(int argc,char *argv[]) {
         //加载配置文件，如果配置文件不存在就创建一个
         loadIniConfig(g_ini_file.data());
 
+        //握手完成后是否把tls发送加密卸载到内核
+        SSL_Initor::Instance().enableKtls(mINI::Instance()[General::kEnableKtls]);
         if(!File::is_dir(ssl_file.data())){
             //不是文件夹，加载证书，证书包含公钥和私钥
             SSL_Initor::Instance().loadCertificate(ssl_file.data());
@@ -279,6 +283,13 @@ int start_main(int argc,char *argv[]) {
         TcpServer::Ptr httpSrv(new TcpServer());
         TcpServer::Ptr httpsSrv(new TcpServer());
 
+        //是否每个poller线程独立监听(SO_REUSEPORT)，由内核分配连接
+        bool reusePort = mINI::Instance()[General::kReusePort];
+        int reusePortSteering = mINI::Instance()[General::kReusePortSteering];
+        for (auto &server : {shellSrv, rtspSrv, rtspSSLSrv, rtmpSrv, rtmpsSrv, httpSrv, httpsSrv}) {
+            server->setReusePort(reusePort, reusePortSteering);
+        }
+
 #if defined(ENABLE_RTPPROXY)
         //GB28181 rtp推流端口，支持UDP/TCP
         RtpServer::Ptr rtpServer = std::make_shared<RtpServer>();
@@ -324,6 +335,10 @@ int start_main(int argc,char *argv[]) {
         InfoL << "已启动http api 接口";
         installWebHook();
         InfoL << "已启动http hook 接口";
+        RecordCatalog::Instance().start();
+#if !defined(_WIN32)
+        ShmMediaBus::Instance().start();
+#endif//!defined(_WIN32)
 
 #if !defined(_WIN32) && !defined(ANDROID)
         if (!bDaemon) {
@@ -347,6 +362,11 @@ int start_main(int argc,char *argv[]) {
     }
     unInstallWebApi();
     unInstallWebHook();
+    RecordCatalog::Instance().stop();
+#if !defined(_WIN32)
+    //释放导出的共享内存并移除注册表记录
+    ShmMediaBus::Instance().stop();
+#endif//!defined(_WIN32)
     //休眠1秒再退出，防止资源释放顺序错误
     InfoL << "程序退出中,请等待...";
     sleep(1);
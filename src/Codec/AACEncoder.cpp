@@ -31,6 +31,10 @@ AACEncoder::AACEncoder() {
 }
 
 AACEncoder::~AACEncoder() {
+    release();
+}
+
+void AACEncoder::release() {
     if (_hEncoder != nullptr) {
         faacEncClose(_hEncoder);
         _hEncoder = nullptr;
@@ -62,7 +66,7 @@ bool AACEncoder::init(int iSampleRate, int iChannels, int iSampleBit) {
     // (2.1) Get current encoding configuration
     faacEncConfigurationPtr pConfiguration = faacEncGetCurrentConfiguration(_hEncoder);
     if (pConfiguration == NULL) {
-        faacEncClose(_hEncoder);
+        release();
         return false;
     }
     // pConfiguration->aacObjectType =LOW;
@@ -108,7 +112,7 @@ bool AACEncoder::init(int iSampleRate, int iChannels, int iSampleBit) {
     // (2.2) Set encoding configuration
     if(!faacEncSetConfiguration(_hEncoder, pConfiguration)){
         ErrorL << "faacEncSetConfiguration failed";
-        faacEncClose(_hEncoder);
+        release();
         return false;
     }
     return true;
@@ -23,6 +23,9 @@ public:
     unsigned long _ulMaxOutputBytes = 0;
 
 
+private:
+    void release();
+
 private:
     unsigned char *_pucPcmBuf = nullptr;
     unsigned int _uiPcmLen = 0;
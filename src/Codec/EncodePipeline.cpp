@@ -0,0 +1,262 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "EncodePipeline.h"
+#include "Util/logger.h"
+#include "Thread/WorkThreadPool.h"
+#include "Common/MediaMetrics.h"
+#ifdef ENABLE_FAAC
+#include "AACEncoder.h"
+#endif //ENABLE_FAAC
+
+#ifdef ENABLE_X264
+#include "H264Encoder.h"
+#endif //ENABLE_X264
+
+namespace mediakit {
+
+/////////////////////////////////////EncodePipeline/////////////////////////////////////
+
+EncodePipeline::EncodePipeline(const EncodeOption &option) {
+    _option = option;
+    if (_option.max_queue < 1) {
+        _option.max_queue = 1;
+    }
+    if (_option.async) {
+        //同一通道固定在一个线程编码，保证音视频输出串行
+        _poller = WorkThreadPool::Instance().getPoller();
+    }
+}
+
+EncodePipeline::~EncodePipeline() {
+    MediaMetrics::Instance().encode_queue.sub(_queue.size());
+}
+
+void EncodePipeline::setVideoInfo(int width, int height, float fps) {
+    _width = width;
+    _height = height;
+    _fps = fps;
+}
+
+void EncodePipeline::setAudioInfo(int sample_rate, int channels, int sample_bit) {
+    _sample_rate = sample_rate;
+    _channels = channels;
+    _sample_bit = sample_bit;
+}
+
+void EncodePipeline::setOnH264(const onEncoded &cb) {
+    lock_guard<recursive_mutex> lck(_cb_mtx);
+    _on_h264 = cb;
+}
+
+void EncodePipeline::setOnAAC(const onEncoded &cb) {
+    lock_guard<recursive_mutex> lck(_cb_mtx);
+    _on_aac = cb;
+}
+
+void EncodePipeline::stop() {
+    lock_guard<recursive_mutex> lck(_cb_mtx);
+    _on_h264 = nullptr;
+    _on_aac = nullptr;
+}
+
+void EncodePipeline::inputYUV(char *yuv[3], int linesize[3], uint32_t stamp) {
+    if (!_poller) {
+        auto start = MetricTimer::now();
+        encodeYUV(yuv, linesize, stamp);
+        onEncodeDone(start, start);
+        return;
+    }
+    //yuv420p，色度平面高度为一半
+    size_t size[3] = {(size_t) linesize[0] * _height,
+                      (size_t) linesize[1] * ((_height + 1) / 2),
+                      (size_t) linesize[2] * ((_height + 1) / 2)};
+    auto task = std::make_shared<EncodeTask>();
+    task->type = TrackVideo;
+    task->stamp = stamp;
+    task->enqueue_us = MetricTimer::now();
+    task->data.reserve(size[0] + size[1] + size[2]);
+    for (int i = 0; i < 3; ++i) {
+        task->linesize[i] = linesize[i];
+        task->data.append(yuv[i], size[i]);
+    }
+    enqueue(task);
+}
+
+void EncodePipeline::inputPCM(char *data, int len, uint32_t stamp) {
+    if (!_poller) {
+        auto start = MetricTimer::now();
+        encodePCM(data, len, stamp);
+        onEncodeDone(start, start);
+        return;
+    }
+    auto task = std::make_shared<EncodeTask>();
+    task->type = TrackAudio;
+    task->stamp = stamp;
+    task->enqueue_us = MetricTimer::now();
+    task->data.assign(data, len);
+    enqueue(task);
+}
+
+void EncodePipeline::enqueue(const EncodeTask::Ptr &task) {
+    auto &metrics = MediaMetrics::Instance();
+    auto index = task->type == TrackVideo ? 0 : 1;
+    bool start_drain = false;
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (_queue_count[index] >= _option.max_queue) {
+            //编码跟不上输入，丢弃该类型最早的帧，优先保证实时性
+            for (auto it = _queue.begin(); it != _queue.end(); ++it) {
+                if ((*it)->type == task->type) {
+                    _queue.erase(it);
+                    break;
+                }
+            }
+            --_queue_count[index];
+            ++_dropped;
+            metrics.encode_dropped.add();
+            metrics.encode_queue.sub();
+        }
+        _queue.emplace_back(task);
+        ++_queue_count[index];
+        _queue_depth = _queue.size();
+        metrics.encode_queue.add();
+        if (!_draining) {
+            _draining = true;
+            start_drain = true;
+        }
+    }
+    if (start_drain) {
+        std::weak_ptr<EncodePipeline> weak_self = shared_from_this();
+        _poller->async([weak_self]() {
+            auto strong_self = weak_self.lock();
+            if (strong_self) {
+                strong_self->drain();
+            }
+        }, false);
+    }
+}
+
+void EncodePipeline::drain() {
+    EncodeTask::Ptr task;
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (_queue.empty()) {
+            _draining = false;
+            return;
+        }
+        task = _queue.front();
+        _queue.pop_front();
+        --_queue_count[task->type == TrackVideo ? 0 : 1];
+        _queue_depth = _queue.size();
+        MediaMetrics::Instance().encode_queue.sub();
+    }
+    encode(task);
+
+    //每次只编码一帧，让出线程给共用该线程的其他通道
+    std::weak_ptr<EncodePipeline> weak_self = shared_from_this();
+    _poller->async([weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (strong_self) {
+            strong_self->drain();
+        }
+    }, false);
+}
+
+void EncodePipeline::encode(const EncodeTask::Ptr &task) {
+    auto start = MetricTimer::now();
+    auto data = (char *) task->data.data();
+    if (task->type == TrackVideo) {
+        char *yuv[3];
+        yuv[0] = data;
+        yuv[1] = yuv[0] + task->linesize[0] * _height;
+        yuv[2] = yuv[1] + task->linesize[1] * ((_height + 1) / 2);
+        encodeYUV(yuv, task->linesize, task->stamp);
+    } else {
+        encodePCM(data, task->data.size(), task->stamp);
+    }
+    onEncodeDone(task->enqueue_us, start);
+}
+
+void EncodePipeline::encodeYUV(char *yuv[3], int linesize[3], uint32_t stamp) {
+#ifdef ENABLE_X264
+    if (!_h264_encoder && !_video_failed) {
+        _h264_encoder = std::make_shared<H264Encoder>();
+        if (!_h264_encoder->init(_width, _height, _fps)) {
+            _h264_encoder = nullptr;
+            _video_failed = true;
+            WarnL << "H264Encoder init failed!";
+        }
+    }
+    if (!_h264_encoder) {
+        return;
+    }
+    H264Encoder::H264Frame *out;
+    int frames = _h264_encoder->inputData(yuv, linesize, stamp, &out);
+    for (int i = 0; i < frames; i++) {
+        onOutput(TrackVideo, (char *) out[i].pucData, out[i].iLength, stamp);
+    }
+#endif //ENABLE_X264
+}
+
+void EncodePipeline::encodePCM(char *data, int len, uint32_t stamp) {
+#ifdef ENABLE_FAAC
+    if (!_aac_encoder && !_audio_failed) {
+        _aac_encoder = std::make_shared<AACEncoder>();
+        if (!_aac_encoder->init(_sample_rate, _channels, _sample_bit)) {
+            _aac_encoder = nullptr;
+            _audio_failed = true;
+            WarnL << "AACEncoder init failed!";
+        }
+    }
+    if (!_aac_encoder) {
+        return;
+    }
+    unsigned char *out;
+    int ret = _aac_encoder->inputData(data, len, &out);
+    if (ret > 7) {
+        onOutput(TrackAudio, (char *) out, ret, stamp);
+    }
+#endif //ENABLE_FAAC
+}
+
+void EncodePipeline::onOutput(TrackType type, const char *data, int len, uint32_t stamp) {
+    lock_guard<recursive_mutex> lck(_cb_mtx);
+    auto &cb = type == TrackVideo ? _on_h264 : _on_aac;
+    if (cb) {
+        //拷贝一份，防止回调中修改回调
+        auto cb_copy = cb;
+        cb_copy(data, len, stamp);
+    }
+}
+
+void EncodePipeline::onEncodeDone(uint64_t enqueue_us, uint64_t start_us) {
+    auto now = MetricTimer::now();
+    auto latency = now - enqueue_us;
+    ++_encoded;
+    _last_latency_us = latency;
+    _last_cost_us = now - start_us;
+    _total_latency_us += latency;
+    MediaMetrics::Instance().encode_latency.observe(latency);
+}
+
+map<string, int64_t> EncodePipeline::getStat() const {
+    map<string, int64_t> ret;
+    uint64_t encoded = _encoded;
+    ret["encodeQueue"] = _queue_depth;
+    ret["encodeDropped"] = _dropped;
+    ret["encodeFrames"] = encoded;
+    ret["encodeLatencyMS"] = _last_latency_us / 1000;
+    ret["encodeAvgLatencyMS"] = encoded ? _total_latency_us / encoded / 1000 : 0;
+    ret["encodeCostMS"] = _last_cost_us / 1000;
+    return ret;
+}
+
+} /* namespace mediakit */
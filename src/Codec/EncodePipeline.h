@@ -0,0 +1,143 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef CODEC_ENCODEPIPELINE_H_
+#define CODEC_ENCODEPIPELINE_H_
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <functional>
+#include "Poller/EventPoller.h"
+#include "Extension/Frame.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+class H264Encoder;
+class AACEncoder;
+
+/**
+ * yuv/pcm软件编码选项
+ */
+class EncodeOption {
+public:
+    //是否在后台线程池中编码，否则在调用者线程中同步编码
+    bool async = false;
+    //异步编码时，待编码队列中音频或视频各自最多缓存的帧数，超过后丢弃最早的帧
+    int max_queue = 8;
+};
+
+/**
+ * 单个通道的yuv/pcm编码流水线
+ * 异步编码时，该通道的音视频编码任务在WorkThreadPool的同一个线程中串行执行，
+ * 不同通道分散在线程池各个线程中并行编码，调用者线程只拷贝原始数据
+ */
+class EncodePipeline : public std::enable_shared_from_this<EncodePipeline> {
+public:
+    typedef std::shared_ptr<EncodePipeline> Ptr;
+    //编码后的h264帧(带起始码)或带adts头的aac帧
+    typedef function<void(const char *data, int len, uint32_t stamp)> onEncoded;
+
+    EncodePipeline(const EncodeOption &option);
+    ~EncodePipeline();
+
+    void setVideoInfo(int width, int height, float fps);
+    void setAudioInfo(int sample_rate, int channels, int sample_bit);
+
+    /**
+     * 设置编码输出回调，异步编码时在后台线程触发
+     */
+    void setOnH264(const onEncoded &cb);
+    void setOnAAC(const onEncoded &cb);
+
+    /**
+     * 输入yuv420p视频帧
+     * @param yuv 各平面数据指针
+     * @param linesize 各平面行字节数
+     * @param stamp 时间戳，单位毫秒
+     */
+    void inputYUV(char *yuv[3], int linesize[3], uint32_t stamp);
+
+    /**
+     * 输入pcm音频数据
+     */
+    void inputPCM(char *data, int len, uint32_t stamp);
+
+    /**
+     * 停止输出，返回后不再触发编码输出回调
+     * 回调引用的对象销毁前必须调用
+     */
+    void stop();
+
+    /**
+     * 获取编码统计，包括队列深度、丢帧数、编码耗时等，可跨线程调用
+     */
+    map<string, int64_t> getStat() const;
+
+private:
+    class EncodeTask {
+    public:
+        typedef std::shared_ptr<EncodeTask> Ptr;
+        TrackType type;
+        string data;
+        int linesize[3];
+        uint32_t stamp;
+        //入队时间，单位微秒
+        uint64_t enqueue_us;
+    };
+
+    void enqueue(const EncodeTask::Ptr &task);
+    void drain();
+    void encode(const EncodeTask::Ptr &task);
+    void encodeYUV(char *yuv[3], int linesize[3], uint32_t stamp);
+    void encodePCM(char *data, int len, uint32_t stamp);
+    void onOutput(TrackType type, const char *data, int len, uint32_t stamp);
+    void onEncodeDone(uint64_t enqueue_us, uint64_t start_us);
+
+private:
+    EncodeOption _option;
+    int _width = 0;
+    int _height = 0;
+    float _fps = 0;
+    int _sample_rate = 0;
+    int _channels = 0;
+    int _sample_bit = 0;
+    bool _video_failed = false;
+    bool _audio_failed = false;
+    //防止stop()返回后仍在触发回调
+    recursive_mutex _cb_mtx;
+    onEncoded _on_h264;
+    onEncoded _on_aac;
+    std::shared_ptr<H264Encoder> _h264_encoder;
+    std::shared_ptr<AACEncoder> _aac_encoder;
+    EventPoller::Ptr _poller;
+
+    mutex _mtx;
+    bool _draining = false;
+    deque<EncodeTask::Ptr> _queue;
+    int _queue_count[2] = {0, 0};
+
+    atomic<uint64_t> _queue_depth{0};
+    atomic<uint64_t> _dropped{0};
+    atomic<uint64_t> _encoded{0};
+    //最近一帧从入队到编码完毕的耗时与纯编码耗时，单位微秒
+    atomic<uint64_t> _last_latency_us{0};
+    atomic<uint64_t> _last_cost_us{0};
+    atomic<uint64_t> _total_latency_us{0};
+};
+
+} /* namespace mediakit */
+
+#endif /* CODEC_ENCODEPIPELINE_H_ */
@@ -16,13 +16,6 @@
 #include "Extension/G711.h"
 #include "Extension/H264.h"
 #include "Extension/H265.h"
-#ifdef ENABLE_FAAC
-#include "Codec/AACEncoder.h"
-#endif //ENABLE_FAAC
-
-#ifdef ENABLE_X264
-#include "Codec/H264Encoder.h"
-#endif //ENABLE_X264
 using namespace toolkit;
 
 namespace mediakit {
@@ -31,25 +24,48 @@ DevChannel::DevChannel(const string &vhost, const string &app, const string &str
                        float duration, bool enable_hls, bool enable_mp4) :
         MultiMediaSourceMuxer(vhost, app, stream_id, duration, true, true, enable_hls, enable_mp4) {}
 
-DevChannel::~DevChannel() {}
+DevChannel::~DevChannel() {
+    EncodePipeline::Ptr pipeline;
+    {
+        lock_guard<mutex> lck(_pipeline_mtx);
+        pipeline = _pipeline;
+    }
+    if (pipeline) {
+        //后台线程可能正在编码，等待其回调结束并停止回调
+        pipeline->stop();
+    }
+}
 
-void DevChannel::inputYUV(char* apcYuv[3], int aiYuvLen[3], uint32_t uiStamp) {
-#ifdef ENABLE_X264
-    //TimeTicker1(50);
-    if (!_pH264Enc) {
-        _pH264Enc.reset(new H264Encoder());
-        if (!_pH264Enc->init(_video->iWidth, _video->iHeight, _video->iFrameRate)) {
-            _pH264Enc.reset();
-            WarnL << "H264Encoder init failed!";
-        }
+void DevChannel::setEncodeOption(const EncodeOption &option) {
+    lock_guard<mutex> lck(_pipeline_mtx);
+    _encode_option = option;
+}
+
+EncodePipeline::Ptr DevChannel::getPipeline() {
+    lock_guard<mutex> lck(_pipeline_mtx);
+    if (_pipeline) {
+        return _pipeline;
     }
-    if (_pH264Enc) {
-        H264Encoder::H264Frame *pOut;
-        int iFrames = _pH264Enc->inputData(apcYuv, aiYuvLen, uiStamp, &pOut);
-        for (int i = 0; i < iFrames; i++) {
-            inputH264((char *) pOut[i].pucData, pOut[i].iLength, uiStamp);
-        }
+    _pipeline = std::make_shared<EncodePipeline>(_encode_option);
+    if (_video) {
+        _pipeline->setVideoInfo(_video->iWidth, _video->iHeight, _video->iFrameRate);
+    }
+    if (_audio) {
+        _pipeline->setAudioInfo(_audio->iSampleRate, _audio->iChannel, _audio->iSampleBit);
     }
+    //回调在stop()后不再触发，故可以直接引用this
+    _pipeline->setOnH264([this](const char *data, int len, uint32_t stamp) {
+        inputH264(data, len, stamp);
+    });
+    _pipeline->setOnAAC([this](const char *data, int len, uint32_t stamp) {
+        inputAAC(data + ADTS_HEADER_LEN, len - ADTS_HEADER_LEN, stamp, data);
+    });
+    return _pipeline;
+}
+
+void DevChannel::inputYUV(char* apcYuv[3], int aiYuvLen[3], uint32_t uiStamp) {
+#ifdef ENABLE_X264
+    getPipeline()->inputYUV(apcYuv, aiYuvLen, uiStamp);
 #else
     WarnL << "h264编码未启用,该方法无效,编译时请打开ENABLE_X264选项";
 #endif //ENABLE_X264
@@ -57,20 +73,7 @@ void DevChannel::inputYUV(char* apcYuv[3], int aiYuvLen[3], uint32_t uiStamp) {
 
 void DevChannel::inputPCM(char* pcData, int iDataLen, uint32_t uiStamp) {
 #ifdef ENABLE_FAAC
-    if (!_pAacEnc) {
-        _pAacEnc.reset(new AACEncoder());
-        if (!_pAacEnc->init(_audio->iSampleRate, _audio->iChannel, _audio->iSampleBit)) {
-            _pAacEnc.reset();
-            WarnL << "AACEncoder init failed!";
-        }
-    }
-    if (_pAacEnc) {
-        unsigned char *pucOut;
-        int iRet = _pAacEnc->inputData(pcData, iDataLen, &pucOut);
-        if (iRet > 7) {
-            inputAAC((char *) pucOut + 7, iRet - 7, uiStamp, (char *)pucOut);
-        }
-    }
+    getPipeline()->inputPCM(pcData, iDataLen, uiStamp);
 #else
     WarnL << "aac编码未启用,该方法无效,编译时请打开ENABLE_FAAC选项";
 #endif //ENABLE_FAAC
@@ -157,6 +160,67 @@ void DevChannel::inputAudio(const char *data, int len, uint32_t dts){
     inputFrame(std::make_shared<FrameFromPtr>(_audio->codecId, (char *) data, len, dts, 0));
 }
 
+/**
+ * 引用调用者内存的帧，析构时通知调用者释放内存
+ */
+template <typename Parent>
+class FrameNoCopy : public Parent {
+public:
+    template <typename ... ARGS>
+    FrameNoCopy(const function<void()> &on_release, ARGS && ...args) : Parent(std::forward<ARGS>(args)...) {
+        _on_release = on_release;
+    }
+
+    ~FrameNoCopy() override {
+        if (_on_release) {
+            _on_release();
+        }
+    }
+
+    /**
+     * 内存由调用者保证在释放回调前有效，可以被缓存
+     */
+    bool cacheAble() const override {
+        return true;
+    }
+
+private:
+    function<void()> _on_release;
+};
+
+void DevChannel::inputFrameNoCopy(CodecId codec_id, char *data, int len, uint32_t dts, uint32_t pts, const function<void()> &on_release) {
+    auto index = getTrackType(codec_id) == TrackVideo ? 0 : 1;
+    if (dts == 0) {
+        dts = (uint32_t) _aTicker[index].elapsedTime();
+    }
+    if (pts == 0) {
+        pts = dts;
+    }
+
+    switch (codec_id) {
+        case CodecH264:
+            inputFrame(std::make_shared<FrameNoCopy<H264FrameNoCacheAble> >(on_release, data, len, dts, pts, prefixSize(data, len)));
+            break;
+        case CodecH265:
+            inputFrame(std::make_shared<FrameNoCopy<H265FrameNoCacheAble> >(on_release, data, len, dts, pts, prefixSize(data, len)));
+            break;
+        case CodecAAC:
+            inputFrame(std::make_shared<FrameNoCopy<FrameFromPtr> >(on_release, codec_id, data, len, dts, pts, ADTS_HEADER_LEN));
+            break;
+        case CodecG711A:
+        case CodecG711U:
+        case CodecOpus:
+            inputFrame(std::make_shared<FrameNoCopy<FrameFromPtr> >(on_release, codec_id, data, len, dts, pts));
+            break;
+        default:
+            WarnL << "不支持该编码格式:" << getCodecName(codec_id);
+            if (on_release) {
+                on_release();
+            }
+            break;
+    }
+}
+
 void DevChannel::initVideo(const VideoInfo &info) {
     _video = std::make_shared<VideoInfo>(info);
     switch (info.codecId){
@@ -181,5 +245,13 @@ MediaOriginType DevChannel::getOriginType(MediaSource &sender) const {
     return MediaOriginType::device_chn;
 }
 
+map<string, int64_t> DevChannel::getOriginStat(MediaSource &sender) const {
+    lock_guard<mutex> lck(_pipeline_mtx);
+    if (!_pipeline) {
+        return map<string, int64_t>();
+    }
+    return _pipeline->getStat();
+}
+
 } /* namespace mediakit */
 
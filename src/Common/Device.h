@@ -17,14 +17,12 @@
 #include "Util/util.h"
 #include "Util/TimeTicker.h"
 #include "Common/MultiMediaSourceMuxer.h"
+#include "Codec/EncodePipeline.h"
 using namespace std;
 using namespace toolkit;
 
 namespace mediakit {
 
-class H264Encoder;
-class AACEncoder;
-
 class VideoInfo {
 public:
     CodecId codecId = CodecH264;
@@ -67,6 +65,13 @@ public:
      */
     void initAudio(const AudioInfo &info);
 
+    /**
+     * 设置yuv/pcm编码选项，需要在首次调用inputYUV/inputPCM前设置
+     * 通道较多时建议开启异步编码，各通道在线程池中并行编码
+     * @param option 编码选项
+     */
+    void setEncodeOption(const EncodeOption &option);
+
     /**
      * 输入264帧
      * @param data 264单帧数据指针
@@ -104,9 +109,10 @@ public:
 
     /**
      * 输入yuv420p视频帧，内部会完成编码并调用inputH264方法
-     * @param apcYuv
-     * @param aiYuvLen
-     * @param uiStamp
+     * 异步编码时会拷贝yuv数据，返回后调用者可以复用该内存
+     * @param apcYuv 各平面数据指针
+     * @param aiYuvLen 各平面行字节数(linesize)
+     * @param uiStamp 时间戳，单位毫秒
      */
     void inputYUV(char *apcYuv[3], int aiYuvLen[3], uint32_t uiStamp);
 
@@ -119,12 +125,28 @@ public:
      */
     void inputPCM(char *pcData, int iDataLen, uint32_t uiStamp);
 
+    /**
+     * 无拷贝输入帧，帧内存由调用者持有
+     * 内部直接引用该内存(包括gop缓存、hls/mp4合并帧等场景)，不再引用时触发on_release，
+     * on_release可能在其他线程触发，在此之前调用者不得修改或释放该内存
+     * @param codec_id 编码类型
+     * @param data 帧数据，h264/h265需带00 00 01或00 00 00 01起始码，aac需带adts头
+     * @param len 帧数据长度
+     * @param dts 解码时间戳，单位毫秒；等于0时内部会自动生成时间戳
+     * @param pts 播放时间戳，单位毫秒；等于0时内部会赋值为dts
+     * @param on_release 释放回调，可以为空
+     */
+    void inputFrameNoCopy(CodecId codec_id, char *data, int len, uint32_t dts, uint32_t pts, const function<void()> &on_release);
+
 private:
     MediaOriginType getOriginType(MediaSource &sender) const override;
+    map<string, int64_t> getOriginStat(MediaSource &sender) const override;
+    EncodePipeline::Ptr getPipeline();
 
 private:
-    std::shared_ptr<H264Encoder> _pH264Enc;
-    std::shared_ptr<AACEncoder> _pAacEnc;
+    mutable mutex _pipeline_mtx;
+    EncodeOption _encode_option;
+    EncodePipeline::Ptr _pipeline;
     std::shared_ptr<VideoInfo> _video;
     std::shared_ptr<AudioInfo> _audio;
     SmoothTicker _aTicker[2];
@@ -0,0 +1,62 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "FrameRing.h"
+
+namespace mediakit {
+
+FrameRing::FrameRing(const RingType::onReaderChanged &cb) {
+    _ring = std::make_shared<RingType>(FRAME_GOP_SIZE, cb);
+}
+
+bool FrameRing::isGopStart(const Frame::Ptr &frame) const {
+    if (frame->getTrackType() == TrackVideo) {
+        return frame->keyFrame() || frame->configFrame();
+    }
+    return !_have_video.load(memory_order_relaxed);
+}
+
+void FrameRing::inputFrame(const Frame::Ptr &frame) {
+    if (frame->getTrackType() == TrackVideo) {
+        _have_video.store(true, memory_order_relaxed);
+    }
+    bool key_pos;
+    if (frame->getTrackType() != TrackVideo) {
+        //纯音频时每帧都可以作为起始
+        key_pos = !_have_video.load(memory_order_relaxed);
+    } else if (isGopStart(frame)) {
+        //sps、pps、idr依次写入，只有第一个才重置gop缓存
+        key_pos = !_key_pos;
+        _key_pos = true;
+    } else {
+        key_pos = false;
+        _key_pos = false;
+    }
+    _last_dts.store(frame->dts(), memory_order_relaxed);
+    //订阅者在其他线程异步读取，必须可以缓存
+    _ring->write(Frame::getCacheAbleFrame(frame), key_pos);
+}
+
+vector<Frame::Ptr> FrameRing::getGopCache() const {
+    vector<Frame::Ptr> ret;
+    _ring->for_each_cache([&](bool is_key, const Frame::Ptr &frame) {
+        if (is_key || !ret.empty()) {
+            ret.emplace_back(frame);
+        }
+    });
+    return ret;
+}
+
+void FrameRing::clearCache() {
+    _ring->clearCache();
+    _key_pos = false;
+}
+
+} /* namespace mediakit */
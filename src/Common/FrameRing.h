@@ -0,0 +1,79 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_FRAMERING_H
+#define ZLMEDIAKIT_FRAMERING_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Util/RingBuffer.h"
+#include "Extension/Frame.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+#define FRAME_GOP_SIZE 512
+
+/**
+ * 帧环形缓存，供进程内订阅者(FrameSubscriber)直接读取各个Track的帧，省去协议封装与解析
+ * 由MultiMediaSourceMuxer在首次订阅时创建，之后所有Track就绪后的帧都会写入该缓存；
+ * 开启按需转协议时则一直存在，其gop缓存用于预热按需开启的协议
+ */
+class FrameRing {
+public:
+    typedef std::shared_ptr<FrameRing> Ptr;
+    typedef RingBuffer<Frame::Ptr> RingType;
+
+    FrameRing(const RingType::onReaderChanged &cb = nullptr);
+    ~FrameRing() {}
+
+    /**
+     * 写入帧，sps/pps/idr等时间戳相同的关键帧作为gop起始
+     */
+    void inputFrame(const Frame::Ptr &frame);
+
+    /**
+     * 清空gop缓存，Track重置时调用
+     */
+    void clearCache();
+
+    /**
+     * 获取从gop起始帧开始的缓存帧，gop缓存溢出(不含起始帧)时返回空
+     */
+    vector<Frame::Ptr> getGopCache() const;
+
+    /**
+     * 是否为gop起始帧，无视频时每一帧都可作为起始
+     */
+    bool isGopStart(const Frame::Ptr &frame) const;
+
+    /**
+     * 最近写入帧的dts，用于计算订阅者的积压时长
+     */
+    uint32_t lastDts() const {
+        return _last_dts.load(memory_order_relaxed);
+    }
+
+    RingType::Ptr getRing() const {
+        return _ring;
+    }
+
+private:
+    RingType::Ptr _ring;
+    bool _key_pos = false;
+    atomic<bool> _have_video{false};
+    atomic<uint32_t> _last_dts{0};
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_FRAMERING_H
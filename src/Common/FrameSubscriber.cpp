@@ -0,0 +1,108 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "FrameSubscriber.h"
+#include "Thread/WorkThreadPool.h"
+
+namespace mediakit {
+
+FrameSubscriber::FrameSubscriber(const EventPoller::Ptr &poller, bool use_gop, uint32_t max_lag_ms) {
+    _poller = poller ? poller : WorkThreadPool::Instance().getPoller();
+    _use_gop = use_gop;
+    _max_lag_ms = max_lag_ms;
+}
+
+FrameSubscriber::~FrameSubscriber() {}
+
+void FrameSubscriber::setOnFrame(const onFrame &cb) {
+    _on_frame = cb;
+}
+
+void FrameSubscriber::setOnDetach(const onDetach &cb) {
+    _on_detach = cb;
+}
+
+const EventPoller::Ptr &FrameSubscriber::getPoller() const {
+    return _poller;
+}
+
+const vector<Track::Ptr> &FrameSubscriber::getTracks() const {
+    return _tracks;
+}
+
+uint64_t FrameSubscriber::getDroppedFrames() const {
+    return _dropped.load(memory_order_relaxed);
+}
+
+bool FrameSubscriber::attach(const MediaSource::Ptr &src) {
+    auto frame_ring = src->getFrameRing();
+    if (!frame_ring) {
+        WarnL << "该媒体源不支持帧订阅:" << src->getSchema() << "/" << src->getVhost() << "/" << src->getApp() << "/" << src->getId();
+        return false;
+    }
+    _tracks = src->getTracks(true);
+    _frame_ring = frame_ring;
+
+    weak_ptr<FrameSubscriber> weak_self = shared_from_this();
+    _poller->async([weak_self, frame_ring]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return;
+        }
+        strong_self->_reader = frame_ring->getRing()->attach(strong_self->_poller, strong_self->_use_gop);
+        strong_self->_reader->setDetachCB([weak_self]() {
+            auto strong_self = weak_self.lock();
+            if (strong_self && strong_self->_on_detach) {
+                strong_self->_on_detach();
+            }
+        });
+        //设置读取回调时会同步回放gop缓存，回放期间不做积压判断
+        strong_self->_replaying = true;
+        strong_self->_reader->setReadCB([weak_self](const Frame::Ptr &frame) {
+            auto strong_self = weak_self.lock();
+            if (strong_self) {
+                strong_self->onRead(frame);
+            }
+        });
+        strong_self->_replaying = false;
+    });
+    return true;
+}
+
+void FrameSubscriber::onRead(const Frame::Ptr &frame) {
+    if (_use_gop && !_started) {
+        //gop缓存为空(譬如首个订阅者触发创建帧环形缓存)时，等待gop起始帧，保证可以从关键帧开始解码
+        auto frame_ring = _frame_ring.lock();
+        if (frame_ring && !frame_ring->isGopStart(frame)) {
+            return;
+        }
+        _started = true;
+    }
+    if (_max_lag_ms && !_replaying) {
+        auto frame_ring = _frame_ring.lock();
+        bool lagging = frame_ring && (int64_t) frame_ring->lastDts() - (int64_t) frame->dts() > _max_lag_ms;
+        if (lagging && !_dropping) {
+            WarnL << "帧订阅者积压超过" << _max_lag_ms << "ms，开始丢帧直到下一个关键帧";
+            _dropping = true;
+        }
+        if (_dropping) {
+            if (lagging || (frame_ring && !frame_ring->isGopStart(frame))) {
+                _dropped.fetch_add(1, memory_order_relaxed);
+                return;
+            }
+            _dropping = false;
+        }
+    }
+    if (_on_frame) {
+        _on_frame(frame);
+    }
+}
+
+} /* namespace mediakit */
@@ -0,0 +1,97 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_FRAMESUBSCRIBER_H
+#define ZLMEDIAKIT_FRAMESUBSCRIBER_H
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include "Common/MediaSource.h"
+#include "Common/FrameRing.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 进程内帧订阅者
+ * 直接读取MultiMediaSourceMuxer中各个Track的帧(引用计数共享，无拷贝)，
+ * 适用于同进程内的分析、转码等消费者，省去rtsp/rtmp等协议的封装、收发与解析
+ */
+class FrameSubscriber : public std::enable_shared_from_this<FrameSubscriber> {
+public:
+    typedef std::shared_ptr<FrameSubscriber> Ptr;
+    typedef function<void(const Frame::Ptr &frame)> onFrame;
+    typedef function<void()> onDetach;
+
+    /**
+     * @param poller 回调所在线程，为空时从WorkThreadPool中选取，防止耗时的消费者阻塞网络线程
+     * @param use_gop 是否先回放gop缓存，这样可以立即从关键帧开始解码
+     * @param max_lag_ms 允许积压的最大时长(毫秒)，消费者处理不过来导致积压超过该值时，
+     *                   丢弃后续帧直到下一个gop起始；为0时不丢帧
+     */
+    FrameSubscriber(const EventPoller::Ptr &poller = nullptr, bool use_gop = true, uint32_t max_lag_ms = 0);
+    ~FrameSubscriber();
+
+    /**
+     * 设置帧回调，请在attach之前设置
+     */
+    void setOnFrame(const onFrame &cb);
+
+    /**
+     * 设置媒体源注销回调，请在attach之前设置
+     */
+    void setOnDetach(const onDetach &cb);
+
+    /**
+     * 开始订阅，在poller线程中异步完成
+     * @param src 媒体源，任意协议的MediaSource均可
+     * @return 该媒体源不支持帧订阅时返回false
+     */
+    bool attach(const MediaSource::Ptr &src);
+
+    /**
+     * 获取回调所在线程
+     */
+    const EventPoller::Ptr &getPoller() const;
+
+    /**
+     * 获取订阅时媒体源的Track，可用于获取sps/pps、采样率等信息
+     */
+    const vector<Track::Ptr> &getTracks() const;
+
+    /**
+     * 因积压而丢弃的帧数
+     */
+    uint64_t getDroppedFrames() const;
+
+private:
+    void onRead(const Frame::Ptr &frame);
+
+private:
+    bool _use_gop;
+    bool _started = false;
+    bool _dropping = false;
+    bool _replaying = false;
+    uint32_t _max_lag_ms;
+    atomic<uint64_t> _dropped{0};
+    onFrame _on_frame;
+    onDetach _on_detach;
+    EventPoller::Ptr _poller;
+    vector<Track::Ptr> _tracks;
+    //弱引用，防止延长MultiMediaSourceMuxer中帧环形缓存的生命周期，以便媒体源注销时触发onDetach
+    std::weak_ptr<FrameRing> _frame_ring;
+    FrameRing::RingType::RingReader::Ptr _reader;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_FRAMESUBSCRIBER_H
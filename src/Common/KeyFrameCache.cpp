@@ -0,0 +1,106 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "KeyFrameCache.h"
+#include "Util/util.h"
+#include "Record/MP4Muxer.h"
+
+namespace mediakit {
+
+string KeyFrameSnap::toAnnexB() const {
+    string ret;
+    for (auto &frame : frames) {
+        ret.append("\x00\x00\x00\x01", 4);
+        frame->forEachSlice(frame->prefixSize(), [&](const char *ptr, uint32_t size) {
+            ret.append(ptr, size);
+        });
+    }
+    return ret;
+}
+
+#if defined(ENABLE_MP4)
+
+//收集fmp4切片
+class MP4SnapMuxer : public MP4MuxerMemory {
+public:
+    string data;
+
+protected:
+    void onSegmentData(const string &segment, uint32_t stamp, bool key_frame) override {
+        data.append(segment);
+    }
+};
+
+string KeyFrameSnap::toMP4(const Track::Ptr &track) const {
+    MP4SnapMuxer muxer;
+    //与MP4Vod一样使用track的拷贝，直播中的track可能正在被推流线程修改(例如更新sps/pps)
+    muxer.addTrack(track->clone());
+    auto ret = muxer.getInitSegment();
+    if (ret.empty()) {
+        return "";
+    }
+    for (auto &frame : frames) {
+        muxer.inputFrame(frame);
+    }
+    muxer.flush();
+    return ret + muxer.data;
+}
+
+#endif //defined(ENABLE_MP4)
+
+void KeyFrameCache::inputFrame(const Frame::Ptr &frame) {
+    if (frame->getTrackType() != TrackVideo) {
+        return;
+    }
+    if (frame->configFrame()) {
+        if (_config_done) {
+            //新的sps/pps
+            _config_frames.clear();
+            _config_done = false;
+        }
+        _config_frames.emplace_back(Frame::getCacheAbleFrame(frame));
+        return;
+    }
+    _config_done = true;
+    if (!frame->keyFrame()) {
+        return;
+    }
+    if (!_key_frames.empty() && _key_frames.back()->dts() != frame->dts()) {
+        //新的关键帧，时间戳相同的为同一帧的多个slice
+        _key_frames.clear();
+    }
+    _key_frames.emplace_back(Frame::getCacheAbleFrame(frame));
+    if (_config_frames.empty()) {
+        //尚未收到配置帧，无法解码
+        return;
+    }
+
+    auto snap = std::make_shared<KeyFrameSnap>();
+    snap->codec = frame->getCodecId();
+    snap->dts = frame->dts();
+    snap->stamp_ms = getCurrentMillisecond(true);
+    snap->frames.reserve(_config_frames.size() + _key_frames.size());
+    snap->frames.insert(snap->frames.end(), _config_frames.begin(), _config_frames.end());
+    snap->frames.insert(snap->frames.end(), _key_frames.begin(), _key_frames.end());
+    atomic_store(&_snap, snap);
+}
+
+void KeyFrameCache::clear() {
+    _config_done = false;
+    _config_frames.clear();
+    _key_frames.clear();
+    atomic_store(&_snap, KeyFrameSnap::Ptr());
+}
+
+KeyFrameSnap::Ptr KeyFrameCache::getSnap() const {
+    return atomic_load(&_snap);
+}
+
+} /* namespace mediakit */
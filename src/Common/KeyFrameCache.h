@@ -0,0 +1,90 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_KEYFRAMECACHE_H
+#define ZLMEDIAKIT_KEYFRAMECACHE_H
+
+#include <memory>
+#include <vector>
+#include "Extension/Frame.h"
+#include "Extension/Track.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 视频最新可解码关键帧的快照，生成后不再修改
+ */
+class KeyFrameSnap {
+public:
+    typedef std::shared_ptr<KeyFrameSnap> Ptr;
+
+    KeyFrameSnap() = default;
+    ~KeyFrameSnap() = default;
+
+    /**
+     * 转换为Annex-B格式的裸流，每个nal以00 00 00 01开始，可直接输入解码器
+     */
+    string toAnnexB() const;
+
+#if defined(ENABLE_MP4)
+    /**
+     * 转换为只包含该关键帧的fmp4(init segment + 一个moof/mdat)
+     * @param track 已就绪的视频track，用于生成init segment
+     */
+    string toMP4(const Track::Ptr &track) const;
+#endif
+
+public:
+    CodecId codec = CodecInvalid;
+    //关键帧的dts
+    uint32_t dts = 0;
+    //生成快照时的系统时间，单位毫秒
+    uint64_t stamp_ms = 0;
+    //配置帧(sps/pps/vps)与关键帧(可能有多个slice)，按输入顺序排列
+    vector<Frame::Ptr> frames;
+};
+
+/**
+ * 缓存视频的最新配置帧与关键帧，供截图等场景直接获取可解码的一帧，无需重新拉流
+ * 只在媒体源线程中输入，快照通过原子操作发布，可在任意线程获取
+ */
+class KeyFrameCache {
+public:
+    KeyFrameCache() = default;
+    ~KeyFrameCache() = default;
+
+    /**
+     * 输入帧，非视频帧忽略
+     */
+    void inputFrame(const Frame::Ptr &frame);
+
+    /**
+     * 清空缓存，Track重置时调用
+     */
+    void clear();
+
+    /**
+     * 获取最新关键帧快照，尚无关键帧时返回空
+     */
+    KeyFrameSnap::Ptr getSnap() const;
+
+private:
+    //配置帧之后是否已经输入过其他帧，是则下个配置帧开始新的配置
+    bool _config_done = false;
+    vector<Frame::Ptr> _config_frames;
+    vector<Frame::Ptr> _key_frames;
+    KeyFrameSnap::Ptr _snap;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_KEYFRAMECACHE_H
@@ -0,0 +1,236 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "LatencyTracer.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+
+namespace mediakit {
+
+const char *getLatencyStageName(int stage) {
+    switch (stage) {
+        case LatencyStageRingDispatch : return "ring_dispatch";
+        case LatencyStageSocketSend : return "socket_send";
+        case LatencyStageSocketFlush : return "socket_flush";
+        case LatencyStageMediaSink : return "media_sink";
+        case LatencyStageMuxerRtsp : return "muxer_rtsp";
+        case LatencyStageMuxerRtmp : return "muxer_rtmp";
+        case LatencyStageMuxerTs : return "muxer_ts";
+        case LatencyStageMuxerFmp4 : return "muxer_fmp4";
+        case LatencyStageMuxerHls : return "muxer_hls";
+        case LatencyStageMuxerMp4 : return "muxer_mp4";
+        case LatencyStageCacheFlush : return "cache_flush";
+        default: return nullptr;
+    }
+}
+
+/////////////////////////////////////LatencyHistogram/////////////////////////////////////
+
+//小于8的值单独一个桶，之后每个2的幂次区间分为4个桶
+static int getBucketIndex(uint64_t us) {
+    if (us < 8) {
+        return (int) us;
+    }
+    int msb = 0;
+    uint64_t val = us;
+    while (val >>= 1) {
+        ++msb;
+    }
+    int sub = (int) ((us >> (msb - 2)) & 0x03);
+    return (msb - 1) * 4 + sub;
+}
+
+//桶的上边界
+static uint64_t getBucketValue(int index) {
+    if (index < 8) {
+        return index;
+    }
+    int msb = index / 4 + 1;
+    int sub = index % 4;
+    return ((uint64_t) (4 + sub + 1) << (msb - 2)) - 1;
+}
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LatencyHistogram::add(uint64_t us) {
+    int index = getBucketIndex(us);
+    if (index >= kBucketCount) {
+        index = kBucketCount - 1;
+    }
+    _buckets[index].fetch_add(1, memory_order_relaxed);
+    _count.fetch_add(1, memory_order_relaxed);
+    _sum.fetch_add(us, memory_order_relaxed);
+    auto old = _max.load(memory_order_relaxed);
+    while (us > old && !_max.compare_exchange_weak(old, us, memory_order_relaxed));
+}
+
+void LatencyHistogram::clear() {
+    for (auto &bucket : _buckets) {
+        bucket.store(0, memory_order_relaxed);
+    }
+    _count.store(0, memory_order_relaxed);
+    _sum.store(0, memory_order_relaxed);
+    _max.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return _count.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::average() const {
+    auto cnt = count();
+    return cnt ? _sum.load(memory_order_relaxed) / cnt : 0;
+}
+
+uint64_t LatencyHistogram::max() const {
+    return _max.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentile(float ratio) const {
+    uint64_t total = 0;
+    uint64_t buckets[kBucketCount];
+    for (int i = 0; i < kBucketCount; ++i) {
+        buckets[i] = _buckets[i].load(memory_order_relaxed);
+        total += buckets[i];
+    }
+    if (!total) {
+        return 0;
+    }
+    uint64_t target = (uint64_t) (total * ratio);
+    if (target >= total) {
+        target = total - 1;
+    }
+    uint64_t acc = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        acc += buckets[i];
+        if (acc > target) {
+            //不超过最大值，避免桶边界导致的高估
+            auto val = getBucketValue(i);
+            auto max_val = max();
+            return val < max_val ? val : max_val;
+        }
+    }
+    return max();
+}
+
+/////////////////////////////////////StreamLatency/////////////////////////////////////
+
+StreamLatency::StreamLatency(const string &vhost, const string &app, const string &stream) {
+    _vhost = vhost;
+    _app = app;
+    _stream = stream;
+}
+
+void StreamLatency::onTrace(int stage, uint64_t elapsed_us) {
+    if (stage < 0 || stage >= LatencyStageMax) {
+        return;
+    }
+    _stages[stage].add(elapsed_us);
+}
+
+TraceContext StreamLatency::sample() {
+    GET_CONFIG(uint32_t, sample, General::kLatencyTraceSample);
+    if (!sample || _sample_count.fetch_add(1, memory_order_relaxed) % sample != 0) {
+        return TraceContext();
+    }
+    return TraceContext(std::static_pointer_cast<TraceSink>(shared_from_this()), TraceContext::now());
+}
+
+void StreamLatency::clear() {
+    for (auto &stage : _stages) {
+        stage.clear();
+    }
+}
+
+/////////////////////////////////////LatencyTracer/////////////////////////////////////
+
+LatencyTracer &LatencyTracer::Instance() {
+    static LatencyTracer s_instance;
+    return s_instance;
+}
+
+StreamLatency::Ptr LatencyTracer::get(const string &vhost, const string &app, const string &stream) {
+    auto key = vhost + "/" + app + "/" + stream;
+    lock_guard<mutex> lck(_mtx);
+    auto &weak_stat = _map[key];
+    auto stat = weak_stat.lock();
+    if (!stat) {
+        stat = std::make_shared<StreamLatency>(vhost, app, stream);
+        weak_stat = stat;
+    }
+    return stat;
+}
+
+void LatencyTracer::for_each(const function<void(const StreamLatency::Ptr &stat)> &cb) {
+    decltype(_map) copy;
+    {
+        lock_guard<mutex> lck(_mtx);
+        for (auto it = _map.begin(); it != _map.end();) {
+            if (it->second.expired()) {
+                //清理已经销毁的流
+                it = _map.erase(it);
+                continue;
+            }
+            ++it;
+        }
+        copy = _map;
+    }
+    for (auto &pr : copy) {
+        auto stat = pr.second.lock();
+        if (stat) {
+            cb(stat);
+        }
+    }
+}
+
+/////////////////////////////////////LatencyScope/////////////////////////////////////
+
+//当前线程是否已经处于某个数据入口的作用域中
+static bool &inLatencyScope() {
+    static thread_local bool s_in_scope = false;
+    return s_in_scope;
+}
+
+LatencyScope::LatencyScope(StreamLatency::Ptr &stat, const string &vhost, const string &app, const string &stream) {
+    GET_CONFIG(uint32_t, sample, General::kLatencyTraceSample);
+    if (!sample || inLatencyScope()) {
+        //嵌套的入口(例如rtsp推流解复用后输入MultiMediaSourceMuxer)不重复采样，以最外层入口为起点
+        return;
+    }
+    auto &current = TraceContext::current();
+    if (current) {
+        return;
+    }
+    _owner = true;
+    inLatencyScope() = true;
+    if (!stat) {
+        stat = LatencyTracer::Instance().get(vhost, app, stream);
+    }
+    auto context = stat->sample();
+    if (!context) {
+        return;
+    }
+    _old = current;
+    current = context;
+    _active = true;
+}
+
+LatencyScope::~LatencyScope() {
+    if (_active) {
+        TraceContext::current() = _old;
+    }
+    if (_owner) {
+        inLatencyScope() = false;
+    }
+}
+
+} /* namespace mediakit */
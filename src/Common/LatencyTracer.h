@@ -0,0 +1,161 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_LATENCYTRACER_H
+#define ZLMEDIAKIT_LATENCYTRACER_H
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include "Util/TraceContext.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 数据从接收到发送的各个阶段
+ * 追踪起点为推流(rtsp/rtmp/rtp)、拉流代理或MultiMediaSourceMuxer收到数据的时刻
+ */
+enum LatencyStage {
+    //RingBuffer切换到播放器所在线程
+    LatencyStageRingDispatch = TraceStageRingDispatch,
+    //写入socket发送队列
+    LatencyStageSocketSend = TraceStageSocketSend,
+    //socket发送队列写入内核完毕
+    LatencyStageSocketFlush = TraceStageSocketFlush,
+    //解复用完毕，进入MediaSink
+    LatencyStageMediaSink = TraceStageUser,
+    //各协议复用器处理完毕
+    LatencyStageMuxerRtsp,
+    LatencyStageMuxerRtmp,
+    LatencyStageMuxerTs,
+    LatencyStageMuxerFmp4,
+    LatencyStageMuxerHls,
+    LatencyStageMuxerMp4,
+    //合并写缓存刷新，此阶段从缓存中最老的数据开始计时
+    LatencyStageCacheFlush,
+    LatencyStageMax
+};
+
+/**
+ * 获取阶段名称
+ */
+const char *getLatencyStageName(int stage);
+
+/**
+ * 无锁耗时直方图，单位微秒
+ * 每个2的幂次区间分为4个桶，相对误差小于25%
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void add(uint64_t us);
+    void clear();
+
+    uint64_t count() const;
+    uint64_t average() const;
+    uint64_t max() const;
+
+    /**
+     * 获取百分位数
+     * @param ratio 百分比，取值范围0~1
+     */
+    uint64_t percentile(float ratio) const;
+
+private:
+    static constexpr int kBucketCount = 160;
+    atomic<uint64_t> _buckets[kBucketCount];
+    atomic<uint64_t> _count{0};
+    atomic<uint64_t> _sum{0};
+    atomic<uint64_t> _max{0};
+};
+
+/**
+ * 单个流的耗时统计
+ */
+class StreamLatency : public TraceSink, public std::enable_shared_from_this<StreamLatency> {
+public:
+    typedef std::shared_ptr<StreamLatency> Ptr;
+
+    StreamLatency(const string &vhost, const string &app, const string &stream);
+    ~StreamLatency() override {}
+
+    void onTrace(int stage, uint64_t elapsed_us) override;
+
+    /**
+     * 采样，根据配置每N个数据返回一个有效的追踪上下文
+     */
+    TraceContext sample();
+
+    const string &getVhost() const { return _vhost; }
+    const string &getApp() const { return _app; }
+    const string &getStream() const { return _stream; }
+    const LatencyHistogram &getHistogram(int stage) const { return _stages[stage]; }
+    void clear();
+
+private:
+    string _vhost;
+    string _app;
+    string _stream;
+    atomic<uint64_t> _sample_count{0};
+    LatencyHistogram _stages[LatencyStageMax];
+};
+
+/**
+ * 全局耗时统计表
+ */
+class LatencyTracer {
+public:
+    static LatencyTracer &Instance();
+
+    /**
+     * 获取或创建流的耗时统计对象，统计对象由数据源持有，数据源销毁后统计随之清除
+     */
+    StreamLatency::Ptr get(const string &vhost, const string &app, const string &stream);
+
+    /**
+     * 遍历所有流的耗时统计
+     */
+    void for_each(const function<void(const StreamLatency::Ptr &stat)> &cb);
+
+private:
+    LatencyTracer() {}
+
+private:
+    mutex _mtx;
+    unordered_map<string, weak_ptr<StreamLatency> > _map;
+};
+
+/**
+ * 数据接收入口处的追踪作用域
+ * 仅最外层的入口会参与采样，命中采样时在作用域内开启追踪；未开启追踪功能时只有一次配置读取开销
+ */
+class LatencyScope {
+public:
+    /**
+     * @param stat 统计对象，为空时会被创建并赋值
+     */
+    LatencyScope(StreamLatency::Ptr &stat, const string &vhost, const string &app, const string &stream);
+    ~LatencyScope();
+
+private:
+    bool _owner = false;
+    bool _active = false;
+    TraceContext _old;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_LATENCYTRACER_H
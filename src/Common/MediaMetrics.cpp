@@ -0,0 +1,58 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <new>
+#include <type_traits>
+#include "MediaMetrics.h"
+using namespace std;
+
+namespace mediakit {
+
+static string makeLabel(const char *key, const char *value) {
+    return string(key) + "=\"" + value + "\"";
+}
+
+ProtocolMetrics::ProtocolMetrics(const char *protocol) :
+        bytes_in("zlm_received_bytes_total", "Bytes received", makeLabel("protocol", protocol)),
+        packets_in("zlm_received_packets_total", "Media packets received", makeLabel("protocol", protocol)),
+        bytes_out("zlm_sent_bytes_total", "Bytes sent", makeLabel("protocol", protocol)),
+        packets_out("zlm_sent_packets_total", "Media packets sent", makeLabel("protocol", protocol)) {}
+
+MediaMetrics &MediaMetrics::Instance() {
+    //指标可能在程序退出、静态对象析构时仍被其他线程访问，故不释放；
+    //成员含alignas(64)的MetricCounter，与ToolkitMetrics一样放在静态存储上构造
+    static std::aligned_storage<sizeof(MediaMetrics), alignof(MediaMetrics)>::type s_storage;
+    static MediaMetrics *s_instance = new (&s_storage) MediaMetrics;
+    return *s_instance;
+}
+
+MediaMetrics::MediaMetrics() :
+        rtsp("rtsp"),
+        rtmp("rtmp"),
+        http("http"),
+        rtp("rtp"),
+        hook_success("zlm_hook_latency_seconds", "Http hook request latency", makeLabel("result", "success"),
+                     MetricHistogram::latencyBounds(), 1000 * 1000),
+        hook_failed("zlm_hook_latency_seconds", "Http hook request latency", makeLabel("result", "failed"),
+                    MetricHistogram::latencyBounds(), 1000 * 1000),
+        hls_segment("zlm_hls_segment_latency_seconds", "Time spent on switching hls segment", "",
+                    MetricHistogram::latencyBounds(), 1000 * 1000),
+        record_write("zlm_record_write_latency_seconds", "Time spent on writing a frame to mp4 file", "",
+                     MetricHistogram::latencyBounds(), 1000 * 1000),
+        encode_latency("zlm_encode_latency_seconds", "Time from yuv/pcm input to encoded output", "",
+                       MetricHistogram::latencyBounds(), 1000 * 1000),
+        encode_queue("zlm_encode_queue_depth", "Number of yuv/pcm frames waiting to be encoded"),
+        encode_dropped("zlm_encode_dropped_frames_total", "Number of yuv/pcm frames dropped because encode queue is full"),
+        file_cache_hit("zlm_http_file_cache_hits_total", "Http static file cache hits"),
+        file_cache_miss("zlm_http_file_cache_misses_total", "Http static file cache misses"),
+        file_cache_files("zlm_http_file_cache_files", "Number of files in http static file cache"),
+        file_cache_bytes("zlm_http_file_cache_bytes", "Bytes of files in http static file cache") {}
+
+} /* namespace mediakit */
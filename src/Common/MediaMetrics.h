@@ -0,0 +1,76 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MEDIAMETRICS_H
+#define ZLMEDIAKIT_MEDIAMETRICS_H
+
+#include "Util/Metrics.h"
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 单个协议的收发统计
+ */
+class ProtocolMetrics {
+public:
+    ProtocolMetrics(const char *protocol);
+
+    //接收字节数
+    MetricCounter bytes_in;
+    //接收的媒体包个数(rtp/rtmp包)
+    MetricCounter packets_in;
+    //发送字节数
+    MetricCounter bytes_out;
+    //发送的媒体包个数(rtp/rtmp/flv/ts/fmp4等)
+    MetricCounter packets_out;
+};
+
+/**
+ * ZLMediaKit内置的运行指标，通过/index/api/metrics接口导出
+ */
+class MediaMetrics {
+public:
+    static MediaMetrics &Instance();
+
+    ProtocolMetrics rtsp;
+    ProtocolMetrics rtmp;
+    //包括http-flv/ts/fmp4、websocket、hls、http文件及api
+    ProtocolMetrics http;
+    //GB28181/rtp推流及startSendRtp
+    ProtocolMetrics rtp;
+
+    //hook请求耗时
+    MetricHistogram hook_success;
+    MetricHistogram hook_failed;
+    //hls切片耗时(关闭上个切片、更新m3u8、删除旧切片、创建新切片)
+    MetricHistogram hls_segment;
+    //mp4录制单帧写入耗时(包括创建文件)
+    MetricHistogram record_write;
+    //yuv/pcm从输入到编码完成的耗时(包括排队)
+    MetricHistogram encode_latency;
+    //待编码的yuv/pcm帧个数
+    MetricGauge encode_queue;
+    //编码队列满时丢弃的yuv/pcm帧个数
+    MetricCounter encode_dropped;
+    //http静态文件缓存命中、未命中次数
+    MetricCounter file_cache_hit;
+    MetricCounter file_cache_miss;
+    //http静态文件缓存的文件个数与字节数
+    MetricGauge file_cache_files;
+    MetricGauge file_cache_bytes;
+
+private:
+    MediaMetrics();
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_MEDIAMETRICS_H
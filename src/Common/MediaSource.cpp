@@ -30,6 +30,7 @@ string getOriginTypeString(MediaOriginType type){
         SWITCH_CASE(ffmpeg_pull);
         SWITCH_CASE(mp4_vod);
         SWITCH_CASE(device_chn);
+        SWITCH_CASE(shm_relay);
         default : return "unknown";
     }
 }
@@ -140,6 +141,14 @@ std::shared_ptr<SockInfo> MediaSource::getOriginSock() const {
     return listener->getOriginSock(const_cast<MediaSource &>(*this));
 }
 
+map<string, int64_t> MediaSource::getOriginStat() const {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return map<string, int64_t>();
+    }
+    return listener->getOriginStat(const_cast<MediaSource &>(*this));
+}
+
 bool MediaSource::seekTo(uint32_t stamp) {
     auto listener = _listener.lock();
     if(!listener){
@@ -197,26 +206,71 @@ bool MediaSource::stopSendRtp() {
     return listener->stopSendRtp(*this);
 }
 
-void MediaSource::for_each_media(const function<void(const MediaSource::Ptr &src)> &cb) {
-    decltype(s_media_source_map) copy;
+FrameRing::Ptr MediaSource::getFrameRing() {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return nullptr;
+    }
+    return listener->getFrameRing(*this);
+}
+
+vector<MuxerDemandStat> MediaSource::getMuxerDemandStat() {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return vector<MuxerDemandStat>();
+    }
+    return listener->getMuxerDemandStat(*this);
+}
+
+KeyFrameSnap::Ptr MediaSource::getKeyFrameSnap() {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return nullptr;
+    }
+    return listener->getKeyFrameSnap(*this);
+}
+
+//key为空时遍历map所有成员，否则只查找该key
+template<typename MAP, typename FUNC>
+static void forEachOrFind(MAP &map, const string &key, FUNC &&func) {
+    if (key.empty()) {
+        for (auto &pr : map) {
+            func(pr.second);
+        }
+        return;
+    }
+    auto it = map.find(key);
+    if (it != map.end()) {
+        func(it->second);
+    }
+}
+
+void MediaSource::for_each_media(const function<void(const MediaSource::Ptr &src)> &cb,
+                                 const string &schema,
+                                 const string &vhost,
+                                 const string &app,
+                                 const string &stream) {
+    vector<MediaSource::Ptr> sources;
     {
-        //拷贝s_media_source_map后再遍历，考虑到是高频使用的全局单例锁，并且在上锁时会执行回调代码
-        //很容易导致多个锁交叉死锁的情况，而且该函数使用频率不高，拷贝开销相对来说是可以接受的
+        //加锁期间只收集命中的媒体源，释放锁后再执行回调，考虑到是高频使用的全局单例锁，
+        //在上锁时执行回调代码很容易导致多个锁交叉死锁；筛选条件直接查找map，不遍历也不拷贝整个注册表
         lock_guard<recursive_mutex> lock(s_media_source_mtx);
-        copy = s_media_source_map;
-    }
-
-    for (auto &pr0 : copy) {
-        for (auto &pr1 : pr0.second) {
-            for (auto &pr2 : pr1.second) {
-                for (auto &pr3 : pr2.second) {
-                    auto src = pr3.second.lock();
-                    if(src){
-                        cb(src);
-                    }
-                }
-            }
-        }
+        forEachOrFind(s_media_source_map, schema, [&](VhostAppStreamMap &vhost_map) {
+            forEachOrFind(vhost_map, vhost, [&](AppStreamMap &app_map) {
+                forEachOrFind(app_map, app, [&](StreamMap &stream_map) {
+                    forEachOrFind(stream_map, stream, [&](std::weak_ptr<MediaSource> &weak_src) {
+                        auto src = weak_src.lock();
+                        if (src) {
+                            sources.emplace_back(std::move(src));
+                        }
+                    });
+                });
+            });
+        });
+    }
+
+    for (auto &src : sources) {
+        cb(src);
     }
 }
 
@@ -291,11 +345,44 @@ static MediaSource::Ptr find_l(const string &schema, const string &vhost_in, con
     return ret;
 }
 
+static void placeSession(const MediaSource::Ptr &src, const std::shared_ptr<TcpSession> &session,
+                         const function<void(const MediaSource::Ptr &src)> &cb) {
+    GET_CONFIG(bool, stream_affinity, General::kStreamAffinity);
+    GET_CONFIG(int, load_diff, General::kStreamAffinityLoadDiff);
+    if (!stream_affinity || !src || !session) {
+        cb(src);
+        return;
+    }
+
+    //找到分发该流读取器最多的poller线程
+    EventPoller::Ptr target;
+    int max_count = 0;
+    src->for_each_reader_poller([&](const EventPoller::Ptr &poller, int reader_count) {
+        if (reader_count > max_count) {
+            max_count = reader_count;
+            target = poller;
+        }
+    });
+
+    auto &current = session->getPoller();
+    if (!target || target == current || target->load() > current->load() + load_diff) {
+        //该流无人观看、已经在该线程中分发或者目标线程负载过高，不迁移
+        cb(src);
+        return;
+    }
+
+    weak_ptr<MediaSource> weak_src = src;
+    session->migrateTo(target, [weak_src, cb](bool success) {
+        //迁移完成后在会话所属poller线程中回复播放器
+        cb(weak_src.lock());
+    });
+}
+
 static void findAsync_l(const MediaInfo &info, const std::shared_ptr<TcpSession> &session, bool retry,
                         const function<void(const MediaSource::Ptr &src)> &cb){
     auto src = find_l(info._schema, info._vhost, info._app, info._streamid, true);
     if (src || !retry) {
-        cb(src);
+        placeSession(src, session, cb);
         return;
     }
 
@@ -575,6 +662,14 @@ std::shared_ptr<SockInfo> MediaSourceEventInterceptor::getOriginSock(MediaSource
     return listener->getOriginSock(sender);
 }
 
+map<string, int64_t> MediaSourceEventInterceptor::getOriginStat(MediaSource &sender) const {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return map<string, int64_t>();
+    }
+    return listener->getOriginStat(sender);
+}
+
 bool MediaSourceEventInterceptor::seekTo(MediaSource &sender, uint32_t stamp) {
     auto listener = _listener.lock();
     if (!listener) {
@@ -656,6 +751,30 @@ bool MediaSourceEventInterceptor::stopSendRtp(MediaSource &sender){
     return false;
 }
 
+FrameRing::Ptr MediaSourceEventInterceptor::getFrameRing(MediaSource &sender) {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return nullptr;
+    }
+    return listener->getFrameRing(sender);
+}
+
+vector<MuxerDemandStat> MediaSourceEventInterceptor::getMuxerDemandStat(MediaSource &sender) {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return vector<MuxerDemandStat>();
+    }
+    return listener->getMuxerDemandStat(sender);
+}
+
+KeyFrameSnap::Ptr MediaSourceEventInterceptor::getKeyFrameSnap(MediaSource &sender) {
+    auto listener = _listener.lock();
+    if (!listener) {
+        return nullptr;
+    }
+    return listener->getKeyFrameSnap(sender);
+}
+
 void MediaSourceEventInterceptor::setDelegate(const std::weak_ptr<MediaSourceEvent> &listener) {
     if (listener.lock().get() == this) {
         throw std::invalid_argument("can not set self as a delegate");
@@ -27,6 +27,10 @@
 #include "Rtmp/Rtmp.h"
 #include "Extension/Track.h"
 #include "Record/Recorder.h"
+#include "Common/LatencyTracer.h"
+#include "Common/FrameRing.h"
+#include "Common/KeyFrameCache.h"
+#include "Common/MuxerDemand.h"
 
 using namespace std;
 using namespace toolkit;
@@ -45,7 +49,8 @@ enum class MediaOriginType : uint8_t {
     pull,
     ffmpeg_pull,
     mp4_vod,
-    device_chn
+    device_chn,
+    shm_relay
 };
 
 string getOriginTypeString(MediaOriginType type);
@@ -63,6 +68,8 @@ public:
     virtual string getOriginUrl(MediaSource &sender) const { return ""; }
     // 获取媒体源客户端相关信息
     virtual std::shared_ptr<SockInfo> getOriginSock(MediaSource &sender) const { return nullptr; }
+    // 获取媒体源拉流统计，例如hls拉流的下载速度、落后直播的时长
+    virtual map<string, int64_t> getOriginStat(MediaSource &sender) const { return map<string, int64_t>(); }
 
     // 通知拖动进度条
     virtual bool seekTo(MediaSource &sender, uint32_t stamp) { return false; }
@@ -86,6 +93,12 @@ public:
     virtual void startSendRtp(MediaSource &sender, const string &dst_url, uint16_t dst_port, const string &ssrc, bool is_udp, const function<void(const SockException &ex)> &cb) { cb(SockException(Err_other, "not implemented"));};
     // 停止发送ps-rtp
     virtual bool stopSendRtp(MediaSource &sender) {return false; }
+    // 获取帧环形缓存，用于进程内订阅帧数据
+    virtual FrameRing::Ptr getFrameRing(MediaSource &sender) { return nullptr; }
+    // 获取各协议按需转换的开关统计
+    virtual vector<MuxerDemandStat> getMuxerDemandStat(MediaSource &sender) { return vector<MuxerDemandStat>(); }
+    // 获取视频最新关键帧快照
+    virtual KeyFrameSnap::Ptr getKeyFrameSnap(MediaSource &sender) { return nullptr; }
 
 private:
     Timer::Ptr _async_close_timer;
@@ -103,6 +116,7 @@ public:
     MediaOriginType getOriginType(MediaSource &sender) const override;
     string getOriginUrl(MediaSource &sender) const override;
     std::shared_ptr<SockInfo> getOriginSock(MediaSource &sender) const override;
+    map<string, int64_t> getOriginStat(MediaSource &sender) const override;
 
     bool seekTo(MediaSource &sender, uint32_t stamp) override;
     bool close(MediaSource &sender, bool force) override;
@@ -114,6 +128,9 @@ public:
     vector<Track::Ptr> getTracks(MediaSource &sender, bool trackReady = true) const override;
     void startSendRtp(MediaSource &sender, const string &dst_url, uint16_t dst_port, const string &ssrc, bool is_udp, const function<void(const SockException &ex)> &cb) override;
     bool stopSendRtp(MediaSource &sender) override;
+    FrameRing::Ptr getFrameRing(MediaSource &sender) override;
+    vector<MuxerDemandStat> getMuxerDemandStat(MediaSource &sender) override;
+    KeyFrameSnap::Ptr getKeyFrameSnap(MediaSource &sender) override;
 
 private:
     std::weak_ptr<MediaSourceEvent> _listener;
@@ -237,6 +254,8 @@ public:
     virtual int readerCount() = 0;
     // 观看者个数，包括(hls/rtsp/rtmp)
     virtual int totalReaderCount();
+    // 遍历拥有本协议读取器的poller线程，用于播放器会话的线程亲和调度
+    virtual void for_each_reader_poller(const function<void(const EventPoller::Ptr &poller, int reader_count)> &cb) {};
 
     // 获取媒体源类型
     MediaOriginType getOriginType() const;
@@ -244,6 +263,8 @@ public:
     string getOriginUrl() const;
     // 获取媒体源客户端相关信息
     std::shared_ptr<SockInfo> getOriginSock() const;
+    // 获取媒体源拉流统计
+    map<string, int64_t> getOriginStat() const;
 
     // 拖动进度条
     bool seekTo(uint32_t stamp);
@@ -259,6 +280,12 @@ public:
     void startSendRtp(const string &dst_url, uint16_t dst_port, const string &ssrc, bool is_udp, const function<void(const SockException &ex)> &cb);
     // 停止发送ps-rtp
     bool stopSendRtp();
+    // 获取帧环形缓存，不支持时返回空
+    FrameRing::Ptr getFrameRing();
+    // 获取各协议按需转换的开关统计
+    vector<MuxerDemandStat> getMuxerDemandStat();
+    // 获取视频最新关键帧快照，不支持或尚无关键帧时返回空
+    KeyFrameSnap::Ptr getKeyFrameSnap();
 
     ////////////////static方法，查找或生成MediaSource////////////////
 
@@ -270,8 +297,12 @@ public:
 
     // 异步查找流
     static void findAsync(const MediaInfo &info, const std::shared_ptr<TcpSession> &session, const function<void(const Ptr &src)> &cb);
-    // 遍历所有流
-    static void for_each_media(const function<void(const Ptr &src)> &cb);
+    // 遍历所有流，筛选参数为空时不筛选；回调在释放注册表锁后执行
+    static void for_each_media(const function<void(const Ptr &src)> &cb,
+                               const string &schema = "",
+                               const string &vhost = "",
+                               const string &app = "",
+                               const string &stream = "");
     // 从mp4文件生成MediaSource
     static MediaSource::Ptr createFromMP4(const string &schema, const string &vhost, const string &app, const string &stream, const string &file_path = "", bool check_app = true);
 
@@ -287,6 +318,8 @@ private:
 
 protected:
     BytesSpeed _speed;
+    //数据链路耗时统计，开启采样后才会创建
+    StreamLatency::Ptr _latency;
 
 private:
     time_t _create_stamp;
@@ -333,10 +366,15 @@ public:
         if (key_pos) {
             _key_pos = key_pos;
         }
+        if (!_trace) {
+            //记录缓存中第一个被采样的数据的追踪上下文
+            _trace = TraceContext::current();
+        }
     }
 
     virtual void clearCache() {
         _cache->clear();
+        _trace = TraceContext();
     }
 
     virtual void onFlush(std::shared_ptr<packet_list>, bool key_pos) = 0;
@@ -346,13 +384,22 @@ private:
         if (_cache->empty()) {
             return;
         }
-        onFlush(std::move(_cache), _key_pos);
+        if (_trace || TraceContext::current()) {
+            //当前线程的追踪上下文属于尚未写入缓存的新数据，刷新缓存时需替换为缓存中数据的上下文
+            TraceScope scope(_trace);
+            _trace.mark(LatencyStageCacheFlush);
+            _trace = TraceContext();
+            onFlush(std::move(_cache), _key_pos);
+        } else {
+            onFlush(std::move(_cache), _key_pos);
+        }
         _cache = std::make_shared<packet_list>();
         _key_pos = false;
     }
 
 private:
     bool _key_pos = false;
+    TraceContext _trace;
     policy _policy;
     std::shared_ptr<packet_list> _cache;
 };
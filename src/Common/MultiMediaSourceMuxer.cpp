@@ -19,6 +19,14 @@ MultiMuxerPrivate::~MultiMuxerPrivate() {}
 MultiMuxerPrivate::MultiMuxerPrivate(const string &vhost, const string &app, const string &stream, float dur_sec,
                                      bool enable_rtsp, bool enable_rtmp, bool enable_hls, bool enable_mp4) {
     _stream_url = vhost + " " + app + " " + stream;
+    //帧环形缓存没有对应的MediaSource，观看人数变化时借同名的MediaSource通知，以便触发无人观看等事件；
+    //帧环形缓存可能被订阅者持有而晚于本对象释放，所以不能捕获this
+    _on_frame_ring_reader = [vhost, app, stream](int size) {
+        auto src = MediaSource::find(vhost, app, stream);
+        if (src) {
+            src->onReaderChanged(size);
+        }
+    };
     if (enable_rtmp) {
         _rtmp = std::make_shared<RtmpMediaSourceMuxer>(vhost, app, stream, std::make_shared<TitleMeta>(dur_sec));
     }
@@ -39,6 +47,18 @@ MultiMuxerPrivate::MultiMuxerPrivate(const string &vhost, const string &app, con
 #if defined(ENABLE_MP4)
     _fmp4 = std::make_shared<FMP4MediaSourceMuxer>(vhost, app, stream);
 #endif
+
+    GET_CONFIG(bool, demand_gop_cache, General::kDemandGopCache);
+    GET_CONFIG(bool, hls_demand, General::kHlsDemand);
+    GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
+    GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
+    GET_CONFIG(bool, ts_demand, General::kTSDemand);
+    GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
+    if (demand_gop_cache && (hls_demand || rtsp_demand || rtmp_demand || ts_demand || fmp4_demand)) {
+        //所有按需开启的协议共享同一份帧级别的gop缓存，开启时用其预热，第一个播放者无需等待下一个关键帧
+        _demand_gop_cache = true;
+        _frame_ring = std::make_shared<FrameRing>(_on_frame_ring_reader);
+    }
 }
 
 void MultiMuxerPrivate::resetTracks() {
@@ -67,6 +87,12 @@ void MultiMuxerPrivate::resetTracks() {
     if (mp4) {
         mp4->resetTracks();
     }
+
+    auto frame_ring = atomic_load(&_frame_ring);
+    if (frame_ring) {
+        frame_ring->clearCache();
+    }
+    _key_frame_cache.clear();
 }
 
 void MultiMuxerPrivate::setMediaListener(const std::weak_ptr<MediaSourceEvent> &listener) {
@@ -93,13 +119,15 @@ void MultiMuxerPrivate::setMediaListener(const std::weak_ptr<MediaSourceEvent> &
 
 int MultiMuxerPrivate::totalReaderCount() const {
     auto hls = _hls;
+    auto frame_ring = atomic_load(&_frame_ring);
     return (_rtsp ? _rtsp->readerCount() : 0) +
            (_rtmp ? _rtmp->readerCount() : 0) +
            (_ts ? _ts->readerCount() : 0) +
 #if defined(ENABLE_MP4)
            (_fmp4 ? _fmp4->readerCount() : 0) +
 #endif
-           (hls ? hls->readerCount() : 0);
+           (hls ? hls->readerCount() : 0) +
+           (frame_ring ? frame_ring->getRing()->readerCount() : 0);
 }
 
 static std::shared_ptr<MediaSinkInterface> makeRecorder(const vector<Track::Ptr> &tracks, Recorder::type type, const string &custom_path, MediaSource &sender){
@@ -196,28 +224,91 @@ void MultiMuxerPrivate::onTrackReady(const Track::Ptr &track) {
 
 bool MultiMuxerPrivate::isEnabled(){
     auto hls = _hls;
+    auto frame_ring = atomic_load(&_frame_ring);
     return (_rtmp ? _rtmp->isEnabled() : false) ||
            (_rtsp ? _rtsp->isEnabled() : false) ||
            (_ts ? _ts->isEnabled() : false) ||
 #if defined(ENABLE_MP4)
            (_fmp4 ? _fmp4->isEnabled() : false) ||
 #endif
-           (hls ? hls->isEnabled() : false) || _mp4;
+           (hls ? hls->isEnabled() : false) || _mp4 || _demand_gop_cache ||
+           (frame_ring ? frame_ring->getRing()->readerCount() > 0 : false);
+}
+
+FrameRing::Ptr MultiMuxerPrivate::getFrameRing() {
+    lock_guard<mutex> lck(_frame_ring_mtx);
+    auto frame_ring = atomic_load(&_frame_ring);
+    if (!frame_ring) {
+        frame_ring = std::make_shared<FrameRing>(_on_frame_ring_reader);
+        atomic_store(&_frame_ring, frame_ring);
+    }
+    return frame_ring;
+}
+
+vector<MuxerDemandStat> MultiMuxerPrivate::getMuxerDemandStat() {
+    vector<MuxerDemandStat> ret;
+    if (_rtmp) {
+        ret.emplace_back(_rtmp->getDemandStat());
+    }
+    if (_rtsp) {
+        ret.emplace_back(_rtsp->getDemandStat());
+    }
+    if (_ts) {
+        ret.emplace_back(_ts->getDemandStat());
+    }
+#if defined(ENABLE_MP4)
+    if (_fmp4) {
+        ret.emplace_back(_fmp4->getDemandStat());
+    }
+#endif
+    auto hls = _hls;
+    if (hls) {
+        ret.emplace_back(hls->getDemandStat());
+    }
+    return ret;
+}
+
+KeyFrameSnap::Ptr MultiMuxerPrivate::getKeyFrameSnap() {
+    return _key_frame_cache.getSnap();
+}
+
+//按需开启的协议，先输入gop缓存生成该协议自己的gop
+template<typename Muxer>
+static void warmUpMuxer(const Muxer &muxer, const FrameRing::Ptr &frame_ring) {
+    if (!muxer->popWarmUp() || !frame_ring) {
+        return;
+    }
+    for (auto &frame : frame_ring->getGopCache()) {
+        muxer->inputFrame(frame);
+    }
 }
 
 void MultiMuxerPrivate::onTrackFrame(const Frame::Ptr &frame) {
+    //未开启耗时追踪时trace为空，mark无开销
+    auto &trace = TraceContext::current();
+    trace.mark(LatencyStageMediaSink);
+    //当前帧在各协议处理完毕后才写入gop缓存，所以预热时不会重复输入当前帧
+    auto frame_ring = atomic_load(&_frame_ring);
     if (_rtmp) {
+        warmUpMuxer(_rtmp, frame_ring);
         _rtmp->inputFrame(frame);
+        trace.mark(LatencyStageMuxerRtmp);
     }
     if (_rtsp) {
+        warmUpMuxer(_rtsp, frame_ring);
         _rtsp->inputFrame(frame);
+        trace.mark(LatencyStageMuxerRtsp);
     }
     if (_ts) {
+        warmUpMuxer(_ts, frame_ring);
         _ts->inputFrame(frame);
+        trace.mark(LatencyStageMuxerTs);
     }
 #if defined(ENABLE_MP4)
     if (_fmp4) {
+        warmUpMuxer(_fmp4, frame_ring);
         _fmp4->inputFrame(frame);
+        trace.mark(LatencyStageMuxerFmp4);
     }
 #endif
 
@@ -225,12 +316,19 @@ void MultiMuxerPrivate::onTrackFrame(const Frame::Ptr &frame) {
     //此处使用智能指针拷贝来确保线程安全，比互斥锁性能更优
     auto hls = _hls;
     if (hls) {
+        warmUpMuxer(hls, frame_ring);
         hls->inputFrame(frame);
+        trace.mark(LatencyStageMuxerHls);
     }
     auto mp4 = _mp4;
     if (mp4) {
         mp4->inputFrame(frame);
+        trace.mark(LatencyStageMuxerMp4);
+    }
+    if (frame_ring) {
+        frame_ring->inputFrame(frame);
     }
+    _key_frame_cache.inputFrame(frame);
 }
 
 static string getTrackInfoStr(const TrackSource *track_src){
@@ -288,6 +386,9 @@ MultiMediaSourceMuxer::~MultiMediaSourceMuxer() {}
 
 MultiMediaSourceMuxer::MultiMediaSourceMuxer(const string &vhost, const string &app, const string &stream, float dur_sec,
                                              bool enable_rtsp, bool enable_rtmp, bool enable_hls, bool enable_mp4) {
+    _vhost = vhost;
+    _app = app;
+    _stream_id = stream;
     _muxer.reset(new MultiMuxerPrivate(vhost, app, stream, dur_sec, enable_rtsp, enable_rtmp, enable_hls, enable_mp4));
     _muxer->setTrackListener(this);
 }
@@ -361,6 +462,18 @@ bool MultiMediaSourceMuxer::stopSendRtp(MediaSource &sender){
     return false;
 }
 
+FrameRing::Ptr MultiMediaSourceMuxer::getFrameRing(MediaSource &sender) {
+    return _muxer->getFrameRing();
+}
+
+vector<MuxerDemandStat> MultiMediaSourceMuxer::getMuxerDemandStat(MediaSource &sender) {
+    return _muxer->getMuxerDemandStat();
+}
+
+KeyFrameSnap::Ptr MultiMediaSourceMuxer::getKeyFrameSnap(MediaSource &sender) {
+    return _muxer->getKeyFrameSnap();
+}
+
 void MultiMediaSourceMuxer::addTrack(const Track::Ptr &track) {
     _muxer->addTrack(track);
 }
@@ -424,6 +537,14 @@ public:
         return _frame->size();
     }
 
+    void forEachSlice(uint32_t offset, const function<void(const char *ptr, uint32_t size)> &cb) const override {
+        _frame->forEachSlice(offset, cb);
+    }
+
+    uint8_t byteAt(uint32_t index) const override {
+        return _frame->byteAt(index);
+    }
+
     CodecId getCodecId() const override {
         return _frame->getCodecId();
     }
@@ -434,6 +555,7 @@ private:
 };
 
 void MultiMediaSourceMuxer::inputFrame(const Frame::Ptr &frame_in) {
+    LatencyScope scope(_latency, _vhost, _app, _stream_id);
     GET_CONFIG(bool, modify_stamp, General::kModifyStamp);
     auto frame = frame_in;
     if (modify_stamp) {
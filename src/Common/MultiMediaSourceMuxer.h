@@ -50,6 +50,9 @@ private:
     void onTrackReady(const Track::Ptr & track) override;
     void onTrackFrame(const Frame::Ptr &frame) override;
     void onAllTrackReady() override;
+    FrameRing::Ptr getFrameRing();
+    vector<MuxerDemandStat> getMuxerDemandStat();
+    KeyFrameSnap::Ptr getKeyFrameSnap();
 
 private:
     string _stream_url;
@@ -63,6 +66,14 @@ private:
     FMP4MediaSourceMuxer::Ptr _fmp4;
 #endif
     std::weak_ptr<MediaSourceEvent> _listener;
+    //按需转协议时一直保留帧级别的gop缓存
+    bool _demand_gop_cache = false;
+    //进程内帧订阅，首次订阅时创建；开启_demand_gop_cache时一直存在
+    mutex _frame_ring_mtx;
+    FrameRing::Ptr _frame_ring;
+    FrameRing::RingType::onReaderChanged _on_frame_ring_reader;
+    //最新视频关键帧，用于截图
+    KeyFrameCache _key_frame_cache;
 };
 
 class MultiMediaSourceMuxer : public MediaSourceEventInterceptor, public MediaSinkInterface, public MultiMuxerPrivate::Listener, public std::enable_shared_from_this<MultiMediaSourceMuxer>{
@@ -150,6 +161,21 @@ public:
      */
     bool stopSendRtp(MediaSource &sender) override;
 
+    /**
+     * 获取帧环形缓存，供进程内订阅帧数据
+     */
+    FrameRing::Ptr getFrameRing(MediaSource &sender) override;
+
+    /**
+     * 获取各协议按需转换的开关统计
+     */
+    vector<MuxerDemandStat> getMuxerDemandStat(MediaSource &sender) override;
+
+    /**
+     * 获取视频最新关键帧快照
+     */
+    KeyFrameSnap::Ptr getKeyFrameSnap(MediaSource &sender) override;
+
     /////////////////////////////////MediaSinkInterface override/////////////////////////////////
 
     /**
@@ -184,8 +210,12 @@ public:
 
 private:
     bool _is_enable = false;
+    string _vhost;
+    string _app;
+    string _stream_id;
     Ticker _last_check;
     Stamp _stamp[2];
+    StreamLatency::Ptr _latency;
     MultiMuxerPrivate::Ptr _muxer;
     std::weak_ptr<MultiMuxerPrivate::Listener> _track_listener;
 #if defined(ENABLE_RTPPROXY)
@@ -0,0 +1,50 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "MuxerDemand.h"
+
+namespace mediakit {
+
+MuxerDemand::MuxerDemand(bool enabled) : _enabled(enabled) {}
+
+void MuxerDemand::setEnabled(bool enabled) {
+    lock_guard<mutex> lck(_mtx);
+    if (enabled == _enabled.load(memory_order_relaxed)) {
+        return;
+    }
+    auto elapsed = _ticker.elapsedTime();
+    _ticker.resetTime();
+    if (enabled) {
+        _disabled_ms += elapsed;
+        ++_enable_count;
+        //先开启再标记预热，推流线程取走标记时muxer已经处于开启状态
+        _enabled.store(true, memory_order_release);
+        _warm_up.store(true, memory_order_release);
+    } else {
+        _enabled_ms += elapsed;
+        //关闭后缓存会被清空，未执行的预热也不再需要
+        _warm_up.store(false, memory_order_release);
+        _enabled.store(false, memory_order_release);
+    }
+}
+
+MuxerDemandStat MuxerDemand::getStat(const string &protocol) const {
+    MuxerDemandStat ret;
+    lock_guard<mutex> lck(_mtx);
+    ret.protocol = protocol;
+    ret.enabled = _enabled;
+    ret.enabled_ms = _enabled_ms;
+    ret.disabled_ms = _disabled_ms;
+    ret.enable_count = _enable_count;
+    (ret.enabled ? ret.enabled_ms : ret.disabled_ms) += _ticker.elapsedTime();
+    return ret;
+}
+
+} /* namespace mediakit */
@@ -0,0 +1,122 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MUXERDEMAND_H
+#define ZLMEDIAKIT_MUXERDEMAND_H
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include "Util/TimeTicker.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 按需转协议的开关统计
+ */
+class MuxerDemandStat {
+public:
+    //协议名
+    string protocol;
+    //当前是否开启
+    bool enabled = false;
+    //累计开启时长，单位毫秒
+    uint64_t enabled_ms = 0;
+    //累计关闭时长，单位毫秒
+    uint64_t disabled_ms = 0;
+    //由关闭变为开启的次数
+    uint64_t enable_count = 0;
+};
+
+/**
+ * 按需转协议的开关状态
+ * 播放器个数变化时(播放器所在线程)切换开关，转协议时(推流线程)读取开关，
+ * 由关闭变为开启时标记需要预热，推流线程随后用帧gop缓存生成该协议的gop
+ */
+class MuxerDemand {
+public:
+    MuxerDemand(bool enabled);
+    ~MuxerDemand() = default;
+
+    /**
+     * 设置是否开启
+     */
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const {
+        return _enabled.load(memory_order_acquire);
+    }
+
+    /**
+     * 是否需要预热，调用后清除标记
+     * 开关先于预热标记写入，看到预热标记时必然也看到已开启；尚未开启时不取走标记，以免丢失预热
+     */
+    bool popWarmUp() {
+        if (!_warm_up.load(memory_order_acquire) || !isEnabled()) {
+            return false;
+        }
+        return _warm_up.exchange(false, memory_order_acq_rel);
+    }
+
+    /**
+     * 获取开关统计，时长包括当前状态已经持续的时间
+     */
+    MuxerDemandStat getStat(const string &protocol) const;
+
+private:
+    mutable mutex _mtx;
+    atomic<bool> _enabled;
+    atomic<bool> _warm_up{false};
+    uint64_t _enabled_ms = 0;
+    uint64_t _disabled_ms = 0;
+    uint64_t _enable_count = 0;
+    //当前状态开始的时间
+    Ticker _ticker;
+};
+
+/**
+ * 支持按需转协议的muxer的公共部分，持有开关状态并提供预热与统计接口
+ */
+class MuxerDemandHelper {
+public:
+    /**
+     * @param protocol 协议名，用于统计
+     * @param enabled 初始是否开启
+     */
+    MuxerDemandHelper(const string &protocol, bool enabled) : _protocol(protocol), _demand(enabled) {}
+    virtual ~MuxerDemandHelper() = default;
+
+    /**
+     * 按需转协议时，由关闭变为开启后需要用帧gop缓存预热，调用后清除标记
+     */
+    bool popWarmUp() {
+        return _demand.popWarmUp() && isDemand();
+    }
+
+    MuxerDemandStat getDemandStat() const {
+        return _demand.getStat(_protocol);
+    }
+
+protected:
+    /**
+     * 该协议是否配置为按需生成
+     */
+    virtual bool isDemand() const = 0;
+
+protected:
+    string _protocol;
+    MuxerDemand _demand;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_MUXERDEMAND_H
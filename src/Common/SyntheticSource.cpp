@@ -0,0 +1,505 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "SyntheticSource.h"
+#include "Extension/AAC.h"
+#include "Extension/G711.h"
+#include "Extension/H264.h"
+#include "Extension/H265.h"
+#include "Extension/Opus.h"
+#include "Util/logger.h"
+
+namespace mediakit {
+
+//合成帧的最大长度，超过该长度的帧会被截断
+static constexpr uint32_t kMaxFrameSize = 2 * 1024 * 1024;
+
+/**
+ * 指数哥伦布编码的比特写入器，用于生成sps/pps/vps
+ */
+class BitWriter {
+public:
+    void u(int bits, uint32_t val) {
+        for (int i = bits - 1; i >= 0; --i) {
+            bit((val >> i) & 0x01);
+        }
+    }
+
+    void ue(uint32_t val) {
+        ++val;
+        int len = 0;
+        for (auto tmp = val; tmp > 1; tmp >>= 1) {
+            ++len;
+        }
+        u(len, 0);
+        u(len + 1, val);
+    }
+
+    void se(int32_t val) {
+        ue(val <= 0 ? -2 * val : 2 * val - 1);
+    }
+
+    /**
+     * 写入rbsp_trailing_bits，并生成带0x00000001前缀的nalu(已加入防竞争字节)
+     */
+    string nalu(const string &header) {
+        bit(1);
+        while (_bits) {
+            bit(0);
+        }
+        string ret("\x00\x00\x00\x01", 4);
+        ret.append(header);
+        int zero_count = 0;
+        for (auto ch : _rbsp) {
+            if (zero_count == 2 && (uint8_t) ch <= 3) {
+                ret.push_back(0x03);
+                zero_count = 0;
+            }
+            ret.push_back(ch);
+            zero_count = ch ? 0 : zero_count + 1;
+        }
+        return ret;
+    }
+
+private:
+    void bit(int val) {
+        _cur = (_cur << 1) | val;
+        if (++_bits == 8) {
+            _rbsp.push_back(_cur);
+            _cur = 0;
+            _bits = 0;
+        }
+    }
+
+private:
+    string _rbsp;
+    uint8_t _cur = 0;
+    int _bits = 0;
+};
+
+static void makeH264Config(const SyntheticVideoInfo &info, string &sps, string &pps) {
+    int width_mbs = (info.iWidth + 15) / 16;
+    int height_mbs = (info.iHeight + 15) / 16;
+    BitWriter sps_writer;
+    //baseline profile, level 4.0
+    sps_writer.u(8, 66);
+    sps_writer.u(8, 0);
+    sps_writer.u(8, 40);
+    //seq_parameter_set_id
+    sps_writer.ue(0);
+    //log2_max_frame_num_minus4
+    sps_writer.ue(0);
+    //pic_order_cnt_type
+    sps_writer.ue(2);
+    //max_num_ref_frames
+    sps_writer.ue(1);
+    //gaps_in_frame_num_value_allowed_flag
+    sps_writer.u(1, 0);
+    sps_writer.ue(width_mbs - 1);
+    sps_writer.ue(height_mbs - 1);
+    //frame_mbs_only_flag, direct_8x8_inference_flag
+    sps_writer.u(1, 1);
+    sps_writer.u(1, 1);
+    bool crop = width_mbs * 16 != info.iWidth || height_mbs * 16 != info.iHeight;
+    sps_writer.u(1, crop);
+    if (crop) {
+        //4:2:0的裁剪单位为2像素
+        sps_writer.ue(0);
+        sps_writer.ue((width_mbs * 16 - info.iWidth) / 2);
+        sps_writer.ue(0);
+        sps_writer.ue((height_mbs * 16 - info.iHeight) / 2);
+    }
+    //vui，只携带帧率信息
+    sps_writer.u(1, 1);
+    sps_writer.u(4, 0);
+    sps_writer.u(1, 1);
+    sps_writer.u(32, 1000);
+    sps_writer.u(32, (uint32_t) (info.iFrameRate * 2000));
+    sps_writer.u(1, 1);
+    sps_writer.u(4, 0);
+    sps = sps_writer.nalu("\x67");
+
+    BitWriter pps_writer;
+    //pic_parameter_set_id, seq_parameter_set_id
+    pps_writer.ue(0);
+    pps_writer.ue(0);
+    //entropy_coding_mode_flag, bottom_field_pic_order_in_frame_present_flag
+    pps_writer.u(2, 0);
+    //num_slice_groups_minus1, num_ref_idx_l0/l1_default_active_minus1
+    pps_writer.ue(0);
+    pps_writer.ue(0);
+    pps_writer.ue(0);
+    //weighted_pred_flag, weighted_bipred_idc
+    pps_writer.u(3, 0);
+    //pic_init_qp_minus26, pic_init_qs_minus26, chroma_qp_index_offset
+    pps_writer.se(0);
+    pps_writer.se(0);
+    pps_writer.se(0);
+    //deblocking_filter_control_present_flag, constrained_intra_pred_flag, redundant_pic_cnt_present_flag
+    pps_writer.u(1, 1);
+    pps_writer.u(2, 0);
+    pps = pps_writer.nalu("\x68");
+}
+
+//main profile, level 4.1
+static void writeH265ProfileTierLevel(BitWriter &writer) {
+    //general_profile_space, general_tier_flag, general_profile_idc
+    writer.u(2, 0);
+    writer.u(1, 0);
+    writer.u(5, 1);
+    //general_profile_compatibility_flag
+    writer.u(32, 0x60000000);
+    //progressive_source_flag, interlaced_source_flag, non_packed_constraint_flag, frame_only_constraint_flag
+    writer.u(4, 0x09);
+    //44个保留位
+    writer.u(32, 0);
+    writer.u(12, 0);
+    writer.u(8, 123);
+}
+
+static void makeH265Config(const SyntheticVideoInfo &info, string &vps, string &sps, string &pps) {
+    BitWriter vps_writer;
+    //vps_video_parameter_set_id, vps_base_layer_internal_flag, vps_base_layer_available_flag
+    vps_writer.u(4, 0);
+    vps_writer.u(2, 3);
+    //vps_max_layers_minus1, vps_max_sub_layers_minus1, vps_temporal_id_nesting_flag
+    vps_writer.u(6, 0);
+    vps_writer.u(3, 0);
+    vps_writer.u(1, 1);
+    vps_writer.u(16, 0xFFFF);
+    writeH265ProfileTierLevel(vps_writer);
+    //vps_sub_layer_ordering_info_present_flag
+    vps_writer.u(1, 1);
+    vps_writer.ue(1);
+    vps_writer.ue(0);
+    vps_writer.ue(0);
+    //vps_max_layer_id, vps_num_layer_sets_minus1
+    vps_writer.u(6, 0);
+    vps_writer.ue(0);
+    //vps_timing_info_present_flag, vps_extension_flag
+    vps_writer.u(2, 0);
+    vps = vps_writer.nalu(string("\x40\x01", 2));
+
+    //最小编码块为8x8，宽高需要8对齐
+    int width = (info.iWidth + 7) / 8 * 8;
+    int height = (info.iHeight + 7) / 8 * 8;
+    BitWriter sps_writer;
+    //sps_video_parameter_set_id, sps_max_sub_layers_minus1, sps_temporal_id_nesting_flag
+    sps_writer.u(4, 0);
+    sps_writer.u(3, 0);
+    sps_writer.u(1, 1);
+    writeH265ProfileTierLevel(sps_writer);
+    //sps_seq_parameter_set_id, chroma_format_idc
+    sps_writer.ue(0);
+    sps_writer.ue(1);
+    sps_writer.ue(width);
+    sps_writer.ue(height);
+    bool crop = width != info.iWidth || height != info.iHeight;
+    sps_writer.u(1, crop);
+    if (crop) {
+        sps_writer.ue(0);
+        sps_writer.ue((width - info.iWidth) / 2);
+        sps_writer.ue(0);
+        sps_writer.ue((height - info.iHeight) / 2);
+    }
+    //bit_depth_luma_minus8, bit_depth_chroma_minus8, log2_max_pic_order_cnt_lsb_minus4
+    sps_writer.ue(0);
+    sps_writer.ue(0);
+    sps_writer.ue(4);
+    //sps_sub_layer_ordering_info_present_flag
+    sps_writer.u(1, 1);
+    sps_writer.ue(1);
+    sps_writer.ue(0);
+    sps_writer.ue(0);
+    //编码块8x8~64x64，变换块4x4~32x32
+    sps_writer.ue(0);
+    sps_writer.ue(3);
+    sps_writer.ue(0);
+    sps_writer.ue(3);
+    sps_writer.ue(0);
+    sps_writer.ue(0);
+    //scaling_list_enabled_flag, amp_enabled_flag, sample_adaptive_offset_enabled_flag, pcm_enabled_flag
+    sps_writer.u(4, 0);
+    //num_short_term_ref_pic_sets
+    sps_writer.ue(0);
+    //long_term_ref_pics_present_flag, sps_temporal_mvp_enabled_flag, strong_intra_smoothing_enabled_flag
+    sps_writer.u(3, 0);
+    //vui，只携带帧率信息
+    sps_writer.u(1, 1);
+    //aspect_ratio_info_present_flag ~ default_display_window_flag
+    sps_writer.u(8, 0);
+    sps_writer.u(1, 1);
+    sps_writer.u(32, 1000);
+    sps_writer.u(32, (uint32_t) (info.iFrameRate * 1000));
+    //vui_poc_proportional_to_timing_flag, vui_hrd_parameters_present_flag, bitstream_restriction_flag
+    sps_writer.u(3, 0);
+    //sps_extension_present_flag
+    sps_writer.u(1, 0);
+    sps = sps_writer.nalu(string("\x42\x01", 2));
+
+    BitWriter pps_writer;
+    //pps_pic_parameter_set_id, pps_seq_parameter_set_id
+    pps_writer.ue(0);
+    pps_writer.ue(0);
+    //dependent_slice_segments_enabled_flag, output_flag_present_flag, num_extra_slice_header_bits,
+    //sign_data_hiding_enabled_flag, cabac_init_present_flag
+    pps_writer.u(7, 0);
+    pps_writer.ue(0);
+    pps_writer.ue(0);
+    //init_qp_minus26
+    pps_writer.se(0);
+    //constrained_intra_pred_flag, transform_skip_enabled_flag, cu_qp_delta_enabled_flag
+    pps_writer.u(3, 0);
+    //pps_cb_qp_offset, pps_cr_qp_offset
+    pps_writer.se(0);
+    pps_writer.se(0);
+    //pps_slice_chroma_qp_offsets_present_flag ~ pps_scaling_list_data_present_flag
+    pps_writer.u(9, 0);
+    //lists_modification_present_flag
+    pps_writer.u(1, 0);
+    //log2_parallel_merge_level_minus2
+    pps_writer.ue(0);
+    //slice_segment_header_extension_present_flag, pps_extension_present_flag
+    pps_writer.u(2, 0);
+    pps = pps_writer.nalu(string("\x44\x01", 2));
+}
+
+/**
+ * 生成指定头部的负载池，负载为不含0x00的随机数据，防止出现start code
+ * @param header 包括start code在内的nalu头，负载第一个字节最高位为1(first_mb_in_slice为0或first_slice_segment_in_pic_flag为1)
+ */
+static std::shared_ptr<string> makePayloadPool(const string &header) {
+    auto ret = std::make_shared<string>(header);
+    ret->reserve(kMaxFrameSize);
+    uint32_t seed = 0x12345678;
+    ret->push_back((char) 0x88);
+    while (ret->size() < kMaxFrameSize) {
+        seed = seed * 1103515245 + 12345;
+        ret->push_back((char) ((seed >> 16) % 255 + 1));
+    }
+    return ret;
+}
+
+static const std::shared_ptr<string> &getPayloadPool(CodecId codec, bool key) {
+    static auto h264_idr = makePayloadPool(string("\x00\x00\x00\x01\x65", 5));
+    static auto h264_p = makePayloadPool(string("\x00\x00\x00\x01\x41", 5));
+    static auto h265_idr = makePayloadPool(string("\x00\x00\x00\x01\x26\x01", 6));
+    static auto h265_p = makePayloadPool(string("\x00\x00\x00\x01\x02\x01", 6));
+    static auto audio = makePayloadPool("");
+    switch (codec) {
+        case CodecH264 : return key ? h264_idr : h264_p;
+        case CodecH265 : return key ? h265_idr : h265_p;
+        default: return audio;
+    }
+}
+
+/**
+ * 指向共享负载池的帧，负载池生命周期长于帧，所以可以直接缓存，无需拷贝
+ */
+template <typename Parent>
+class SyntheticFrame : public Parent {
+public:
+    template <typename ... ARGS>
+    SyntheticFrame(const std::shared_ptr<string> &pool, ARGS && ...args) : Parent(std::forward<ARGS>(args)...) {
+        _pool = pool;
+    }
+
+    ~SyntheticFrame() override {}
+
+    bool cacheAble() const override {
+        return true;
+    }
+
+private:
+    std::shared_ptr<string> _pool;
+};
+
+static int getAacSampleRateIndex(int sample_rate) {
+    static const int sample_rates[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+    for (int i = 0; i < (int) (sizeof(sample_rates) / sizeof(sample_rates[0])); ++i) {
+        if (sample_rates[i] == sample_rate) {
+            return i;
+        }
+    }
+    WarnL << "不支持的aac采样率:" << sample_rate << ",已改为44100";
+    return 4;
+}
+
+SyntheticSource::SyntheticSource(const MediaSinkInterface::Ptr &sink, const SyntheticVideoInfo &video, const SyntheticAudioInfo &audio) {
+    _sink = sink;
+    _video = video;
+    _audio = audio;
+
+    switch (_video.codecId) {
+        case CodecH264: {
+            string sps, pps;
+            makeH264Config(_video, sps, pps);
+            _sink->addTrack(std::make_shared<H264Track>(sps, pps));
+            break;
+        }
+        case CodecH265: {
+            string vps, sps, pps;
+            makeH265Config(_video, vps, sps, pps);
+            _sink->addTrack(std::make_shared<H265Track>(vps, sps, pps));
+            break;
+        }
+        case CodecInvalid: break;
+        default: WarnL << "不支持该类型的视频编码类型:" << _video.codecId; _video.codecId = CodecInvalid; break;
+    }
+
+    if (_video.codecId != CodecInvalid) {
+        _video.iFrameRate = MAX(_video.iFrameRate, 1.0f);
+        _video.iGop = MAX(_video.iGop, 1);
+        uint32_t avg_size = MAX((uint32_t) (_video.iBitRate / 8 / _video.iFrameRate), 64u);
+        if (_video.iGop == 1) {
+            _video_key_size = avg_size;
+            _video_size = avg_size;
+        } else {
+            //关键帧为平均帧长的3倍，其他帧平分剩余码率
+            _video_key_size = avg_size * 3;
+            _video_size = MAX((uint32_t) ((avg_size * (uint64_t) _video.iGop - _video_key_size) / (_video.iGop - 1)), 64u);
+        }
+        _video_key_size = MIN(_video_key_size, kMaxFrameSize);
+        _video_size = MIN(_video_size, kMaxFrameSize);
+    }
+
+    switch (_audio.codecId) {
+        case CodecAAC: {
+            auto index = getAacSampleRateIndex(_audio.iSampleRate);
+            _audio.iChannel = MIN(MAX(_audio.iChannel, 1), 7);
+            //AudioSpecificConfig: aac lc
+            string cfg;
+            cfg.push_back((char) ((2 << 3) | (index >> 1)));
+            cfg.push_back((char) (((index & 0x01) << 7) | (_audio.iChannel << 3)));
+            _audio_samples = 1024;
+            auto payload = MAX((uint32_t) ((uint64_t) _audio.iBitRate / 8 * _audio_samples / _audio.iSampleRate), 16u);
+            payload = MIN(payload, (uint32_t) 0x1FFF - ADTS_HEADER_LEN);
+            uint8_t adts[ADTS_HEADER_LEN];
+            dumpAacConfig(cfg, payload, adts, sizeof(adts));
+            _aac_frame = std::make_shared<string>((char *) adts, sizeof(adts));
+            _aac_frame->append(getPayloadPool(CodecAAC, false)->data(), payload);
+            _audio_size = _aac_frame->size();
+            _sink->addTrack(std::make_shared<AACTrack>(cfg));
+            break;
+        }
+        case CodecG711A:
+        case CodecG711U: {
+            //20ms一帧
+            _audio.iSampleRate = 8000;
+            _audio_samples = 160;
+            _audio_size = _audio_samples * _audio.iChannel;
+            _sink->addTrack(std::make_shared<G711Track>(_audio.codecId, _audio.iSampleRate, _audio.iChannel, 16));
+            break;
+        }
+        case CodecOpus: {
+            //20ms一帧
+            _audio.iSampleRate = 48000;
+            _audio_samples = 960;
+            _audio_size = MAX((uint32_t) (_audio.iBitRate / 8 / 50), 16u);
+            _sink->addTrack(std::make_shared<OpusTrack>());
+            break;
+        }
+        case CodecInvalid: break;
+        default: WarnL << "不支持该类型的音频编码类型:" << _audio.codecId; _audio.codecId = CodecInvalid; break;
+    }
+    _sink->addTrackCompleted();
+}
+
+SyntheticSource::~SyntheticSource() {
+    stop();
+}
+
+SyntheticSource::Ptr SyntheticSource::create(const string &vhost, const string &app, const string &stream_id,
+                                             const SyntheticVideoInfo &video, const SyntheticAudioInfo &audio,
+                                             bool enable_hls, bool enable_mp4) {
+    auto channel = std::make_shared<DevChannel>(vhost, app, stream_id, 0, enable_hls, enable_mp4);
+    return std::make_shared<SyntheticSource>(channel, video, audio);
+}
+
+void SyntheticSource::start(const EventPoller::Ptr &poller_in) {
+    stop();
+    auto poller = poller_in ? poller_in : EventPollerPool::Instance().getPoller();
+    auto interval = _video.codecId != CodecInvalid ? (uint64_t) (1000 / _video.iFrameRate) : 20;
+    interval = MAX(interval, (uint64_t) 1);
+    weak_ptr<SyntheticSource> weak_self = shared_from_this();
+    _ticker.resetTime();
+    _timer = poller->doDelayTask(interval, [weak_self, interval]() -> uint64_t {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return 0;
+        }
+        //按照实际流逝时间补齐帧，防止定时器误差导致码率偏低
+        strong_self->inputUntil(strong_self->_ticker.elapsedTime());
+        return interval;
+    });
+}
+
+void SyntheticSource::stop() {
+    if (_timer) {
+        _timer->cancel();
+        _timer = nullptr;
+    }
+}
+
+uint64_t SyntheticSource::generate(uint64_t duration_ms) {
+    uint64_t video_stamp = _video_index * 1000 / _video.iFrameRate;
+    uint64_t audio_stamp = _audio_samples ? _audio_index * _audio_samples * 1000 / _audio.iSampleRate : 0;
+    return inputUntil(MAX(video_stamp, audio_stamp) + duration_ms);
+}
+
+const MediaSinkInterface::Ptr &SyntheticSource::getSink() const {
+    return _sink;
+}
+
+uint64_t SyntheticSource::inputUntil(uint64_t stamp_ms) {
+    uint64_t count = 0;
+    bool has_video = _video.codecId != CodecInvalid;
+    bool has_audio = _audio.codecId != CodecInvalid;
+    while (true) {
+        uint64_t video_stamp = has_video ? (uint64_t) (_video_index * 1000 / _video.iFrameRate) : UINT64_MAX;
+        uint64_t audio_stamp = has_audio ? _audio_index * _audio_samples * 1000 / _audio.iSampleRate : UINT64_MAX;
+        if (MIN(video_stamp, audio_stamp) > stamp_ms) {
+            break;
+        }
+        if (video_stamp <= audio_stamp) {
+            inputVideo();
+        } else {
+            inputAudio();
+        }
+        ++count;
+    }
+    return count;
+}
+
+void SyntheticSource::inputVideo() {
+    uint32_t dts = _video_index * 1000 / _video.iFrameRate;
+    bool key = _video_index % _video.iGop == 0;
+    ++_video_index;
+    auto &pool = getPayloadPool(_video.codecId, key);
+    auto size = key ? _video_key_size : _video_size;
+    if (_video.codecId == CodecH264) {
+        _sink->inputFrame(std::make_shared<SyntheticFrame<H264FrameNoCacheAble> >(pool, (char *) pool->data(), size, dts, dts, 4));
+    } else {
+        _sink->inputFrame(std::make_shared<SyntheticFrame<H265FrameNoCacheAble> >(pool, (char *) pool->data(), size, dts, dts, 4));
+    }
+}
+
+void SyntheticSource::inputAudio() {
+    uint32_t dts = _audio_index * _audio_samples * 1000 / _audio.iSampleRate;
+    ++_audio_index;
+    if (_audio.codecId == CodecAAC) {
+        _sink->inputFrame(std::make_shared<SyntheticFrame<FrameFromPtr> >(_aac_frame, _audio.codecId, (char *) _aac_frame->data(), _audio_size, dts, 0, ADTS_HEADER_LEN));
+        return;
+    }
+    auto &pool = getPayloadPool(_audio.codecId, false);
+    _sink->inputFrame(std::make_shared<SyntheticFrame<FrameFromPtr> >(pool, _audio.codecId, (char *) pool->data(), _audio_size, dts, 0, 0));
+}
+
+} /* namespace mediakit */
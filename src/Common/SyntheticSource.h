@@ -0,0 +1,125 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_SYNTHETICSOURCE_H
+#define ZLMEDIAKIT_SYNTHETICSOURCE_H
+
+#include <memory>
+#include <string>
+#include "Common/Device.h"
+#include "Common/MediaSink.h"
+#include "Poller/EventPoller.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 合成视频参数
+ * codecId为CodecInvalid时不生成视频
+ */
+class SyntheticVideoInfo {
+public:
+    CodecId codecId = CodecH264;
+    int iWidth = 1280;
+    int iHeight = 720;
+    float iFrameRate = 25;
+    //gop长度，单位帧
+    int iGop = 50;
+    //码率，单位bit/s
+    int iBitRate = 2 * 1024 * 1024;
+};
+
+/**
+ * 合成音频参数
+ * codecId为CodecInvalid时不生成音频；g711固定8000采样率，opus固定48000采样率
+ */
+class SyntheticAudioInfo {
+public:
+    CodecId codecId = CodecAAC;
+    int iChannel = 1;
+    int iSampleRate = 44100;
+    //码率，单位bit/s，g711忽略该参数
+    int iBitRate = 64 * 1024;
+};
+
+/**
+ * 进程内合成媒体源，用于在无网络环境下做性能测试
+ * 生成可被各muxer正确识别的h264/h265/aac/g711/opus码流(sps/pps/adts等头信息真实有效，负载为随机数据，不可解码)
+ * 负载数据为进程内共享的静态内存，生成帧时无内存拷贝，可以同时启动大量合成源
+ */
+class SyntheticSource : public std::enable_shared_from_this<SyntheticSource> {
+public:
+    typedef std::shared_ptr<SyntheticSource> Ptr;
+
+    /**
+     * 构造合成源，并向sink添加track
+     * @param sink 帧输出对象，可以是DevChannel或其他MediaSinkInterface
+     * @param video 视频参数
+     * @param audio 音频参数
+     */
+    SyntheticSource(const MediaSinkInterface::Ptr &sink, const SyntheticVideoInfo &video, const SyntheticAudioInfo &audio);
+    ~SyntheticSource();
+
+    /**
+     * 创建一个DevChannel并绑定合成源
+     */
+    static Ptr create(const string &vhost, const string &app, const string &stream_id,
+                      const SyntheticVideoInfo &video, const SyntheticAudioInfo &audio,
+                      bool enable_hls = false, bool enable_mp4 = false);
+
+    /**
+     * 按照实时速率在poller线程中持续生成帧
+     * @param poller 执行线程，为空则从线程池中选取
+     */
+    void start(const EventPoller::Ptr &poller = nullptr);
+
+    /**
+     * 停止实时生成
+     */
+    void stop();
+
+    /**
+     * 在当前线程中以最快速度生成一段时长的帧，用于测量吞吐量
+     * 不可与start同时使用
+     * @param duration_ms 媒体时长，单位毫秒
+     * @return 生成的帧数
+     */
+    uint64_t generate(uint64_t duration_ms);
+
+    /**
+     * 获取帧输出对象
+     */
+    const MediaSinkInterface::Ptr &getSink() const;
+
+private:
+    uint64_t inputUntil(uint64_t stamp_ms);
+    void inputVideo();
+    void inputAudio();
+
+private:
+    SyntheticVideoInfo _video;
+    SyntheticAudioInfo _audio;
+    MediaSinkInterface::Ptr _sink;
+    std::shared_ptr<DelayTask> _timer;
+    Ticker _ticker;
+    uint64_t _video_index = 0;
+    uint64_t _audio_index = 0;
+    uint32_t _video_key_size = 0;
+    uint32_t _video_size = 0;
+    uint32_t _audio_size = 0;
+    uint32_t _audio_samples = 0;
+    //aac帧带adts头，每个合成源码率配置不同，故单独保存
+    std::shared_ptr<string> _aac_frame;
+};
+
+} /* namespace mediakit */
+
+#endif //ZLMEDIAKIT_SYNTHETICSOURCE_H
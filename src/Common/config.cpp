@@ -74,6 +74,13 @@ const string kRtspDemand = GENERAL_FIELD"rtsp_demand";
 const string kRtmpDemand = GENERAL_FIELD"rtmp_demand";
 const string kTSDemand = GENERAL_FIELD"ts_demand";
 const string kFMP4Demand = GENERAL_FIELD"fmp4_demand";
+const string kDemandGopCache = GENERAL_FIELD"demandGopCache";
+const string kStreamAffinity = GENERAL_FIELD"streamAffinity";
+const string kStreamAffinityLoadDiff = GENERAL_FIELD"streamAffinityLoadDiff";
+const string kLatencyTraceSample = GENERAL_FIELD"latencyTraceSample";
+const string kReusePort = GENERAL_FIELD"reusePort";
+const string kReusePortSteering = GENERAL_FIELD"reusePortSteering";
+const string kEnableKtls = GENERAL_FIELD"enableKtls";
 
 onceToken token([](){
     mINI::Instance()[kFlowThreshold] = 1024;
@@ -92,6 +99,13 @@ onceToken token([](){
     mINI::Instance()[kRtmpDemand] = 0;
     mINI::Instance()[kTSDemand] = 0;
     mINI::Instance()[kFMP4Demand] = 0;
+    mINI::Instance()[kDemandGopCache] = 1;
+    mINI::Instance()[kStreamAffinity] = 0;
+    mINI::Instance()[kStreamAffinityLoadDiff] = 20;
+    mINI::Instance()[kLatencyTraceSample] = 0;
+    mINI::Instance()[kReusePort] = 0;
+    mINI::Instance()[kReusePortSteering] = 0;
+    mINI::Instance()[kEnableKtls] = 0;
 
 },nullptr);
 
@@ -114,12 +128,24 @@ const string kRootPath = HTTP_FIELD"rootPath";
 const string kNotFound = HTTP_FIELD"notFound";
 //是否显示文件夹菜单
 const string kDirMenu = HTTP_FIELD"dirMenu";
+//静态文件(包括hls)打开文件与mmap缓存的最大总大小，单位MB，置0关闭缓存
+const string kFileCacheSize = HTTP_FIELD"fileCacheSize";
+//静态文件缓存的最大文件个数
+const string kFileCacheCount = HTTP_FIELD"fileCacheCount";
+//inotify不可用时，缓存文件重新stat校验的间隔，单位毫秒
+const string kFileCacheTTLMS = HTTP_FIELD"fileCacheTTLMS";
+//静态文件是否通过sendfile零拷贝发送(仅linux的http及开启kTLS的https)
+const string kSendFile = HTTP_FIELD"sendFile";
 
 onceToken token([](){
     mINI::Instance()[kSendBufSize] = 64 * 1024;
     mINI::Instance()[kMaxReqSize] = 4*1024;
     mINI::Instance()[kKeepAliveSecond] = 15;
     mINI::Instance()[kDirMenu] = true;
+    mINI::Instance()[kFileCacheSize] = 256;
+    mINI::Instance()[kFileCacheCount] = 1024;
+    mINI::Instance()[kFileCacheTTLMS] = 1000;
+    mINI::Instance()[kSendFile] = true;
 
 #if defined(_WIN32)
     mINI::Instance()[kCharSet] = "gb2312";
@@ -240,6 +266,16 @@ const string kFileBufSize = RECORD_FIELD"fileBufSize";
 const string kFastStart = RECORD_FIELD"fastStart";
 //mp4文件是否重头循环读取
 const string kFileRepeat = RECORD_FIELD"fileRepeat";
+//mp4按需切片为hls点播时，切片内存缓存大小，单位MB
+const string kVodCacheSize = RECORD_FIELD"vodCacheSize";
+//是否保存mp4 sample索引文件
+const string kIndexFile = RECORD_FIELD"indexFile";
+//mp4 sample索引文件保存目录
+const string kIndexPath = RECORD_FIELD"indexPath";
+//mp4 sample索引的内存缓存大小，单位MB
+const string kIndexCacheSize = RECORD_FIELD"indexCacheSize";
+//录像目录日志文件路径
+const string kCatalogFile = RECORD_FIELD"catalogFile";
 
 onceToken token([](){
     mINI::Instance()[kAppName] = "record";
@@ -249,6 +285,11 @@ onceToken token([](){
     mINI::Instance()[kFileBufSize] = 64 * 1024;
     mINI::Instance()[kFastStart] = false;
     mINI::Instance()[kFileRepeat] = false;
+    mINI::Instance()[kVodCacheSize] = 64;
+    mINI::Instance()[kIndexFile] = false;
+    mINI::Instance()[kIndexPath] = "./mp4_index";
+    mINI::Instance()[kIndexCacheSize] = 64;
+    mINI::Instance()[kCatalogFile] = "./record_catalog.log";
 },nullptr);
 } //namespace Record
 
@@ -267,6 +308,12 @@ const string kFileBufSize = HLS_FIELD"fileBufSize";
 const string kFilePath = HLS_FIELD"filePath";
 // 是否广播 ts 切片完成通知
 const string kBroadcastRecordTs = HLS_FIELD"broadcastRecordTs";
+//拉流hls时ts切片最多同时下载的个数
+const string kPullPrefetch = HLS_FIELD"pullPrefetch";
+//是否开启LL-HLS
+const string kLowLatency = HLS_FIELD"lowLatency";
+//LL-HLS部分切片时长,单位秒
+const string kPartDuration = HLS_FIELD"partDur";
 
 onceToken token([](){
     mINI::Instance()[kSegmentDuration] = 2;
@@ -275,6 +322,9 @@ onceToken token([](){
     mINI::Instance()[kFileBufSize] = 64 * 1024;
     mINI::Instance()[kFilePath] = "./www";
     mINI::Instance()[kBroadcastRecordTs] = false;
+    mINI::Instance()[kPullPrefetch] = 3;
+    mINI::Instance()[kLowLatency] = false;
+    mINI::Instance()[kPartDuration] = 0.5;
 },nullptr);
 } //namespace Hls
 
@@ -296,6 +346,24 @@ onceToken token([](){
 },nullptr);
 } //namespace RtpProxy
 
+////////////共享内存媒体总线配置///////////
+namespace Shm {
+#define SHM_FIELD "shm."
+const string kExport = SHM_FIELD"export";
+const string kImport = SHM_FIELD"import";
+const string kRegistry = SHM_FIELD"registry";
+const string kRingSizeKB = SHM_FIELD"ringSizeKB";
+const string kPollMS = SHM_FIELD"pollMS";
+
+onceToken token([](){
+    mINI::Instance()[kExport] = 0;
+    mINI::Instance()[kImport] = 0;
+    mINI::Instance()[kRegistry] = "/dev/shm/zlmediakit_media_bus";
+    mINI::Instance()[kRingSizeKB] = 8 * 1024;
+    mINI::Instance()[kPollMS] = 5;
+},nullptr);
+} //namespace Shm
+
 
 namespace Client {
 const string kNetAdapter = "net_adapter";
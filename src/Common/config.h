@@ -187,6 +187,23 @@ extern const string kRtspDemand;
 extern const string kRtmpDemand;
 extern const string kTSDemand;
 extern const string kFMP4Demand;
+//按需转协议时，是否在无人观看期间保留一份帧级别的gop缓存，
+//协议开启时先用该缓存预热，使第一个播放者也能秒开；仅在开启按需转协议时生效，默认开启
+extern const string kDemandGopCache;
+//播放器会话是否迁移至已经在分发该流的poller线程，这样可以减少热门流跨线程派发数据的次数
+extern const string kStreamAffinity;
+//播放器会话迁移时，目标poller线程负载最多允许比当前poller线程高出的百分比，超过则不迁移
+extern const string kStreamAffinityLoadDiff;
+//数据链路耗时追踪采样间隔，每N个数据采样1个，0为关闭
+extern const string kLatencyTraceSample;
+//tcp服务器、rtp代理udp端口是否每个poller线程独立监听(SO_REUSEPORT)，由内核在各线程间分配连接，
+//避免多线程抢占同一监听socket导致的惊群与分布不均；开启后多个进程也可以监听同一端口
+extern const string kReusePort;
+//开启SO_REUSEPORT时挂载的cBPF分流程序，0:内核默认，1:按4元组哈希固定分配，2:按收包cpu分配
+extern const string kReusePortSteering;
+//https/rtmps/rtsps握手完成后是否把发送加密卸载到内核(kTLS)，需要linux内核加载tls模块，
+//不支持时自动回退为openssl用户态加密
+extern const string kEnableKtls;
 }//namespace General
 
 
@@ -206,6 +223,14 @@ extern const string kRootPath;
 extern const string kNotFound;
 //是否显示文件夹菜单
 extern const string kDirMenu;
+//静态文件(包括hls)打开文件与mmap缓存的最大总大小，单位MB，置0关闭缓存
+extern const string kFileCacheSize;
+//静态文件缓存的最大文件个数
+extern const string kFileCacheCount;
+//inotify不可用时，缓存文件重新stat校验的间隔，单位毫秒
+extern const string kFileCacheTTLMS;
+//静态文件是否通过sendfile零拷贝发送(仅linux的http及开启kTLS的https)
+extern const string kSendFile;
 }//namespace Http
 
 ////////////SHELL配置///////////
@@ -281,6 +306,16 @@ extern const string kFileBufSize;
 extern const string kFastStart;
 //mp4文件是否重头循环读取
 extern const string kFileRepeat;
+//mp4按需切片为hls点播时，切片内存缓存大小，单位MB，置0关闭缓存
+extern const string kVodCacheSize;
+//是否保存.idx sample索引文件，再次打开时直接映射索引文件，不再解析moov，默认关闭
+extern const string kIndexFile;
+//.idx sample索引文件保存目录，按mp4文件的绝对路径存放，相对路径时相对于程序所在目录
+extern const string kIndexPath;
+//mp4 sample索引的内存缓存大小，单位MB
+extern const string kIndexCacheSize;
+//录像目录日志文件路径，相对路径时相对于程序所在目录，置空则不保存，启动时只通过扫描录像目录重建
+extern const string kCatalogFile;
 } //namespace Record
 
 ////////////HLS相关配置///////////
@@ -297,6 +332,12 @@ extern const string kFileBufSize;
 extern const string kFilePath;
 // 是否广播 ts 切片完成通知
 extern const string kBroadcastRecordTs;
+//拉流hls时，直播m3u8中ts切片最多同时下载的个数，每个下载连接都会保持keep-alive并复用
+extern const string kPullPrefetch;
+//是否开启LL-HLS，开启后hls直播生成部分切片，m3u8与部分切片从内存回复并支持阻塞式刷新
+extern const string kLowLatency;
+//LL-HLS部分切片时长,单位秒
+extern const string kPartDuration;
 } //namespace Hls
 
 ////////////Rtp代理相关配置///////////
@@ -309,6 +350,20 @@ extern const string kCheckSource;
 extern const string kTimeoutSec;
 } //namespace RtpProxy
 
+////////////共享内存媒体总线配置///////////
+namespace Shm {
+//是否把本进程的直播流导出至共享内存，供同一主机上的其他进程读取
+extern const string kExport;
+//播放不存在的流时，是否从其他进程导出的共享内存中读取
+extern const string kImport;
+//共享内存流注册表文件路径
+extern const string kRegistry;
+//每个流的共享内存环形缓存大小，单位KB
+extern const string kRingSizeKB;
+//读取共享内存的轮询间隔，单位毫秒
+extern const string kPollMS;
+} //namespace Shm
+
 /**
  * rtsp/rtmp播放器、推流器相关设置名，
  * 这些设置项都不是配置文件用
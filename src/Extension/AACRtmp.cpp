@@ -86,10 +86,11 @@ void AACRtmpEncoder::makeConfigPacket() {
 }
 
 void AACRtmpEncoder::inputFrame(const Frame::Ptr &frame) {
+    auto prefix = frame->prefixSize();
     if (_aac_cfg.empty()) {
-        if (frame->prefixSize()) {
+        if (prefix) {
             //包含adts头,从adts头获取aac配置信息
-            _aac_cfg = makeAacConfig((uint8_t *) (frame->data()), frame->prefixSize());
+            _aac_cfg = makeAacConfig((uint8_t *) (frame->data()), prefix);
         }
         makeConfigPacket();
     }
@@ -104,7 +105,7 @@ void AACRtmpEncoder::inputFrame(const Frame::Ptr &frame) {
         rtmpPkt->buffer.push_back(!is_config);
 
         //aac data
-        rtmpPkt->buffer.append(frame->data() + frame->prefixSize(), frame->size() - frame->prefixSize());
+        rtmpPkt->buffer.append(frame->data() + prefix, frame->size() - prefix);
 
         rtmpPkt->body_size = rtmpPkt->buffer.size();
         rtmpPkt->chunk_id = CHUNK_AUDIO;
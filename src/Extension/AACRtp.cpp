@@ -9,6 +9,7 @@
  */
 
 #include "AACRtp.h"
+#include "CodecTraits.h"
 
 namespace mediakit{
 
@@ -55,7 +56,7 @@ void AACRtpEncoder::inputFrame(const Frame::Ptr &frame) {
 }
 
 void AACRtpEncoder::makeAACRtp(const void *data, unsigned int len, bool mark, uint32_t uiStamp) {
-    RtpCodec::inputRtp(makeRtp(getTrackType(), data, len, mark, uiStamp), false);
+    RtpCodec::inputRtp(makeRtp(CodecTraits<CodecAAC>::kTrackType, data, len, mark, uiStamp), false);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,107 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_CODECTRAITS_H
+#define ZLMEDIAKIT_CODECTRAITS_H
+
+#include "Frame.h"
+#include "H264.h"
+#include "H265.h"
+
+namespace mediakit {
+
+/**
+ * 编码特性，按照编码类型在编译期特化
+ * 各协议的打包类、muxer在添加track时即确定编码类型，帧处理路径上通过该类根据nal头内联判断帧类型，
+ * 不必每帧通过Frame::keyFrame()/configFrame()/getCodecId()等虚函数以及switch重复判断
+ */
+template<CodecId codec>
+class CodecTraits;
+
+template<>
+class CodecTraits<CodecH264> {
+public:
+    static constexpr TrackType kTrackType = TrackVideo;
+
+    static int nalType(uint8_t nal) {
+        return H264_TYPE(nal);
+    }
+
+    static bool keyFrame(uint8_t nal) {
+        return nalType(nal) == H264Frame::NAL_IDR;
+    }
+
+    static bool configFrame(uint8_t nal) {
+        switch (nalType(nal)) {
+            case H264Frame::NAL_SPS:
+            case H264Frame::NAL_PPS: return true;
+            default: return false;
+        }
+    }
+};
+
+template<>
+class CodecTraits<CodecH265> {
+public:
+    static constexpr TrackType kTrackType = TrackVideo;
+
+    static int nalType(uint8_t nal) {
+        return H265_TYPE(nal);
+    }
+
+    static bool keyFrame(uint8_t nal) {
+        return H265Frame::isKeyFrame(nalType(nal));
+    }
+
+    static bool configFrame(uint8_t nal) {
+        switch (nalType(nal)) {
+            case H265Frame::NAL_VPS:
+            case H265Frame::NAL_SPS:
+            case H265Frame::NAL_PPS: return true;
+            default: return false;
+        }
+    }
+};
+
+/**
+ * 音频帧没有关键帧、配置帧之分
+ */
+template<CodecId codec>
+class AudioCodecTraits {
+public:
+    static constexpr TrackType kTrackType = TrackAudio;
+
+    static bool keyFrame(uint8_t) {
+        return false;
+    }
+
+    static bool configFrame(uint8_t) {
+        return false;
+    }
+};
+
+template<>
+class CodecTraits<CodecAAC> : public AudioCodecTraits<CodecAAC> {};
+
+template<>
+class CodecTraits<CodecG711A> : public AudioCodecTraits<CodecG711A> {};
+
+template<>
+class CodecTraits<CodecG711U> : public AudioCodecTraits<CodecG711U> {};
+
+template<>
+class CodecTraits<CodecOpus> : public AudioCodecTraits<CodecOpus> {};
+
+template<>
+class CodecTraits<CodecL16> : public AudioCodecTraits<CodecL16> {};
+
+}//namespace mediakit
+
+#endif //ZLMEDIAKIT_CODECTRAITS_H
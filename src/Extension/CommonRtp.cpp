@@ -72,14 +72,16 @@ CommonRtpEncoder::CommonRtpEncoder(CodecId codec, uint32_t ssrc, uint32_t mtu_si
 void CommonRtpEncoder::inputFrame(const Frame::Ptr &frame){
     GET_CONFIG(uint32_t, cycleMS, Rtp::kCycleMS);
     auto stamp = frame->dts() % cycleMS;
-    auto ptr = frame->data() + frame->prefixSize();
-    auto len = frame->size() - frame->prefixSize();
+    auto prefix = frame->prefixSize();
+    auto ptr = frame->data() + prefix;
+    auto len = frame->size() - prefix;
     auto remain_size = len;
     const auto max_rtp_size = _ui32MtuSize - 20;
 
+    //g711/opus/l16均为音频
     while (remain_size > 0) {
         auto rtp_size = remain_size > max_rtp_size ? max_rtp_size : remain_size;
-        RtpCodec::inputRtp(makeRtp(getTrackType(), ptr, rtp_size, false, stamp), false);
+        RtpCodec::inputRtp(makeRtp(TrackAudio, ptr, rtp_size, false, stamp), false);
         ptr += rtp_size;
         remain_size -= rtp_size;
     }
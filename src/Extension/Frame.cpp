@@ -71,6 +71,31 @@ Frame::Ptr Frame::getCacheAbleFrame(const Frame::Ptr &frame){
     return std::make_shared<FrameCacheAble>(frame);
 }
 
+FrameReader::FrameReader(const Frame::Ptr &frame, uint32_t offset) {
+    _frame = frame;
+    frame->forEachSlice(offset, [&](const char *ptr, uint32_t size) {
+        _slices.emplace_back(ptr, size);
+        _remain += size;
+    });
+}
+
+void FrameReader::read(void *dst, uint32_t size) {
+    auto out = (char *) dst;
+    while (size && _index < _slices.size()) {
+        auto &slice = _slices[_index];
+        auto len = std::min(size, slice.second - _pos);
+        memcpy(out, slice.first + _pos, len);
+        out += len;
+        size -= len;
+        _remain -= len;
+        _pos += len;
+        if (_pos == slice.second) {
+            ++_index;
+            _pos = 0;
+        }
+    }
+}
+
 #define SWITCH_CASE(codec_id) case codec_id : return #codec_id
 const char *getCodecName(CodecId codecId) {
     switch (codecId) {
@@ -85,24 +110,7 @@ const char *getCodecName(CodecId codecId) {
     }
 }
 
-TrackType getTrackType(CodecId codecId){
-    switch (codecId){
-        case CodecH264:
-        case CodecH265: return TrackVideo;
-        case CodecAAC:
-        case CodecG711A:
-        case CodecG711U:
-        case CodecL16:
-        case CodecOpus: return TrackAudio;
-        default: return TrackInvalid;
-    }
-}
-
 const char *CodecInfo::getCodecName() {
     return mediakit::getCodecName(getCodecId());
 }
-
-TrackType CodecInfo::getTrackType() {
-    return mediakit::getTrackType(getCodecId());
-}
 }//namespace mediakit
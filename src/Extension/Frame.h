@@ -48,8 +48,20 @@ const char *getCodecName(CodecId codecId);
 
 /**
  * 获取音视频类型
+ * 每帧都会调用，故内联
  */
-TrackType getTrackType(CodecId codecId);
+inline TrackType getTrackType(CodecId codecId) {
+    switch (codecId) {
+        case CodecH264:
+        case CodecH265: return TrackVideo;
+        case CodecAAC:
+        case CodecG711A:
+        case CodecG711U:
+        case CodecL16:
+        case CodecOpus: return TrackAudio;
+        default: return TrackInvalid;
+    }
+}
 
 /**
  * 编码信息的抽象接口
@@ -74,7 +86,9 @@ public:
     /**
      * 获取音视频类型
      */
-    TrackType getTrackType();
+    TrackType getTrackType() {
+        return mediakit::getTrackType(getCodecId());
+    }
 };
 
 /**
@@ -118,12 +132,59 @@ public:
      */
     virtual bool cacheAble() const { return true; }
 
+    /**
+     * 依次回调帧数据的各个分片(跳过前offset个字节)，连续内存的帧只有一个分片
+     * 分片帧通过该接口读取数据时不会合并分片，可以省去一次内存拷贝
+     */
+    virtual void forEachSlice(uint32_t offset, const function<void(const char *ptr, uint32_t size)> &cb) const {
+        if (size() > offset) {
+            cb(data() + offset, size() - offset);
+        }
+    }
+
+    /**
+     * 获取帧数据中的某个字节，譬如264的nal头，分片帧不会因此合并分片
+     */
+    virtual uint8_t byteAt(uint32_t index) const {
+        return (uint8_t) data()[index];
+    }
+
     /**
      * 返回可缓存的frame
      */
     static Ptr getCacheAbleFrame(const Ptr &frame);
 };
 
+/**
+ * 顺序读取帧数据的辅助类，用于rtp分包等场景
+ * 从各个分片直接拷贝到目标内存，不会触发分片帧的合并
+ */
+class FrameReader {
+public:
+    FrameReader(const Frame::Ptr &frame, uint32_t offset = 0);
+    ~FrameReader() {}
+
+    /**
+     * 剩余未读取的字节数
+     */
+    uint32_t remain() const {
+        return _remain;
+    }
+
+    /**
+     * 读取数据到dst，并移动读取位置
+     * @param size 读取长度，不得大于remain()
+     */
+    void read(void *dst, uint32_t size);
+
+private:
+    Frame::Ptr _frame;
+    uint32_t _remain = 0;
+    uint32_t _index = 0;
+    uint32_t _pos = 0;
+    vector<std::pair<const char *, uint32_t> > _slices;
+};
+
 class FrameImp : public Frame {
 public:
     typedef std::shared_ptr<FrameImp> Ptr;
@@ -189,6 +250,112 @@ private:
     Frame::Ptr _parent_frame;
 };
 
+/**
+ * 分片帧
+ * 帧头(譬如264的0x00 00 00 01前缀与nal头)保存在_buffer中，负载由若干分片组成，
+ * 分片直接引用接收缓存(譬如rtp包)中的数据，组帧时无需内存拷贝；
+ * rtp/rtmp打包、ts合并帧等支持分片的场景通过forEachSlice直接读取各个分片，
+ * 其他场景调用data()时才会把帧头与分片合并到独立的缓存中(只合并一次)；
+ * 分片只能在帧写入环形缓存前追加，之后帧头与分片都不再修改，多线程读取无需加锁
+ */
+template<typename Parent>
+class FrameSliced : public Parent {
+public:
+    typedef std::shared_ptr<FrameSliced> Ptr;
+
+    FrameSliced() {}
+    ~FrameSliced() override {}
+
+    /**
+     * 追加负载分片，不拷贝数据
+     * @param holder 分片数据的持有者，譬如rtp包
+     * @param ptr 分片数据指针
+     * @param size 分片数据长度
+     */
+    void appendSlice(const Buffer::Ptr &holder, const char *ptr, uint32_t size) {
+        if (!size) {
+            return;
+        }
+        _slices.emplace_back(Slice{holder, ptr, size});
+        _slice_bytes += size;
+    }
+
+    /**
+     * 清空所有负载分片，并释放对分片持有者的引用
+     */
+    void clearSlices() {
+        _slices.clear();
+        _slice_bytes = 0;
+    }
+
+    char *data() const override {
+        if (_slices.empty()) {
+            return Parent::data();
+        }
+        //多个线程可能同时读取该帧，只由第一个调用者合并
+        call_once(_merge_flag, [this]() { mergeSlices(); });
+        return (char *) _merged.data();
+    }
+
+    uint32_t size() const override {
+        return Parent::size() + _slice_bytes;
+    }
+
+    void forEachSlice(uint32_t offset, const function<void(const char *ptr, uint32_t size)> &cb) const override {
+        uint32_t head_size = Parent::size();
+        if (offset < head_size) {
+            cb(Parent::data() + offset, head_size - offset);
+            offset = 0;
+        } else {
+            offset -= head_size;
+        }
+        for (auto &slice : _slices) {
+            if (offset >= slice.size) {
+                offset -= slice.size;
+                continue;
+            }
+            cb(slice.ptr + offset, slice.size - offset);
+            offset = 0;
+        }
+    }
+
+    uint8_t byteAt(uint32_t index) const override {
+        uint32_t head_size = Parent::size();
+        if (index < head_size) {
+            return (uint8_t) Parent::data()[index];
+        }
+        index -= head_size;
+        for (auto &slice : _slices) {
+            if (index < slice.size) {
+                return (uint8_t) slice.ptr[index];
+            }
+            index -= slice.size;
+        }
+        return 0;
+    }
+
+private:
+    void mergeSlices() const {
+        //帧头与分片保持不变，其他线程仍可通过forEachSlice、byteAt并发读取
+        _merged.reserve(size());
+        _merged.append(Parent::data(), Parent::size());
+        for (auto &slice : _slices) {
+            _merged.append(slice.ptr, slice.size);
+        }
+    }
+
+private:
+    struct Slice {
+        Buffer::Ptr holder;
+        const char *ptr;
+        uint32_t size;
+    };
+    vector<Slice> _slices;
+    uint32_t _slice_bytes = 0;
+    mutable once_flag _merge_flag;
+    mutable string _merged;
+};
+
 /**
  * 循环池辅助类
  */
@@ -55,6 +55,11 @@ public:
     }
 };
 
+/**
+ * 负载由多个分片组成的H264类，rtp解复用时使用，分片直接引用rtp包，防止内存拷贝
+ */
+typedef FrameSliced<H264Frame> H264FrameSliced;
+
 /**
  * 防止内存拷贝的H264类
  * 用户可以通过该类型快速把一个指针无拷贝的包装成Frame类
@@ -180,7 +185,7 @@ public:
     * @param frame 数据帧
     */
     void inputFrame(const Frame::Ptr &frame) override{
-        int type = H264_TYPE(*((uint8_t *)frame->data() + frame->prefixSize()));
+        int type = H264_TYPE(frame->byteAt(frame->prefixSize()));
         if(type != H264Frame::NAL_B_P && type != H264Frame::NAL_IDR){
             //非I/B/P帧情况下，split一下，防止多个帧粘合在一起
             splitH264(frame->data(), frame->size(), frame->prefixSize(), [&](const char *ptr, int len, int prefix) {
@@ -207,7 +212,7 @@ private:
      * @param frame 数据帧
      */
     void inputFrame_l(const Frame::Ptr &frame){
-        int type = H264_TYPE(*((uint8_t *)frame->data() + frame->prefixSize()));
+        int type = H264_TYPE(frame->byteAt(frame->prefixSize()));
         switch (type){
             case H264Frame::NAL_SPS:{
                 //sps
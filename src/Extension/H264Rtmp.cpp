@@ -9,6 +9,7 @@
  */
 
 #include "H264Rtmp.h"
+#include "CodecTraits.h"
 namespace mediakit{
 
 H264RtmpDecoder::H264RtmpDecoder() {
@@ -158,9 +159,11 @@ void H264RtmpEncoder::makeConfigPacket(){
 }
 
 void H264RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
-    auto pcData = frame->data() + frame->prefixSize();
-    auto iLen = frame->size() - frame->prefixSize();
-    auto type = H264_TYPE(((uint8_t*)pcData)[0]);
+    typedef CodecTraits<CodecH264> Traits;
+    auto prefix = frame->prefixSize();
+    auto iLen = frame->size() - prefix;
+    auto nal = frame->byteAt(prefix);
+    auto type = Traits::nalType(nal);
     if(type == H264Frame::NAL_SEI){
         return;
     }
@@ -170,13 +173,13 @@ void H264RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
         switch (type) {
             case H264Frame::NAL_SPS: {
                 //sps
-                _sps = string(pcData, iLen);
+                _sps = string(frame->data() + prefix, iLen);
                 makeConfigPacket();
                 break;
             }
             case H264Frame::NAL_PPS: {
                 //pps
-                _pps = string(pcData, iLen);
+                _pps = string(frame->data() + prefix, iLen);
                 makeConfigPacket();
                 break;
             }
@@ -185,7 +188,8 @@ void H264RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
         }
     }
 
-    if(_lastPacket && _lastPacket->time_stamp != frame->dts()) {
+    auto dts = frame->dts();
+    if(_lastPacket && _lastPacket->time_stamp != dts) {
         RtmpCodec::inputRtmp(_lastPacket);
         _lastPacket = nullptr;
     }
@@ -194,13 +198,13 @@ void H264RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
         //I or P or B frame
         int8_t flags = FLV_CODEC_H264;
         bool is_config = false;
-        flags |= (((frame->configFrame() || frame->keyFrame()) ? FLV_KEY_FRAME : FLV_INTER_FRAME) << 4);
+        flags |= (((Traits::configFrame(nal) || Traits::keyFrame(nal)) ? FLV_KEY_FRAME : FLV_INTER_FRAME) << 4);
 
         _lastPacket = ResourcePoolHelper<RtmpPacket>::obtainObj();
         _lastPacket->buffer.clear();
         _lastPacket->buffer.push_back(flags);
         _lastPacket->buffer.push_back(!is_config);
-        int32_t cts = frame->pts() - frame->dts();
+        int32_t cts = frame->pts() - dts;
         if (cts < 0) {
             cts = 0;
         }
@@ -209,13 +213,17 @@ void H264RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
 
         _lastPacket->chunk_id = CHUNK_VIDEO;
         _lastPacket->stream_index = STREAM_MEDIA;
-        _lastPacket->time_stamp = frame->dts();
+        _lastPacket->time_stamp = dts;
         _lastPacket->type_id = MSG_VIDEO;
 
     }
     auto size = htonl(iLen);
+    _lastPacket->buffer.reserve(_lastPacket->buffer.size() + 4 + iLen);
     _lastPacket->buffer.append((char *) &size, 4);
-    _lastPacket->buffer.append(pcData, iLen);
+    //分片帧直接追加各个分片，不合并分片
+    frame->forEachSlice(prefix, [&](const char *ptr, uint32_t size) {
+        _lastPacket->buffer.append(ptr, size);
+    });
     _lastPacket->body_size = _lastPacket->buffer.size();
 }
 
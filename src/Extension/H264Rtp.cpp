@@ -9,6 +9,7 @@
  */
 
 #include "H264Rtp.h"
+#include "CodecTraits.h"
 
 namespace mediakit{
 
@@ -34,10 +35,10 @@ H264RtpDecoder::H264RtpDecoder() {
     _h264frame = obtainFrame();
 }
 
-H264Frame::Ptr  H264RtpDecoder::obtainFrame() {
-    //从缓存池重新申请对象，防止覆盖已经写入环形缓存的对象
-    auto frame = ResourcePoolHelper<H264Frame>::obtainObj();
-    frame->_buffer.clear();
+H264FrameSliced::Ptr H264RtpDecoder::obtainFrame() {
+    //每帧新建对象，防止覆盖已经写入环形缓存的对象；
+    //帧负载直接引用rtp包，帧对象释放时即释放对rtp包的引用，所以不放入循环池
+    auto frame = std::make_shared<H264FrameSliced>();
     frame->_prefix_size = 4;
     return frame;
 }
@@ -78,8 +79,10 @@ bool H264RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
 
     if (nal_type >= 0 && nal_type < 24) {
         //a full frame
+        _h264frame->clearSlices();
         _h264frame->_buffer.assign("\x0\x0\x0\x1", 4);
-        _h264frame->_buffer.append((char *) frame, length);
+        _h264frame->_buffer.push_back(frame[0]);
+        _h264frame->appendSlice(rtppack, (char *) frame + 1, length - 1);
         _h264frame->_pts = rtppack->timeStamp;
         auto key = _h264frame->keyFrame();
         onGetH264(_h264frame);
@@ -105,8 +108,10 @@ bool H264RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
                 }
                 if (len > 0) {
                     //有有效数据
+                    _h264frame->clearSlices();
                     _h264frame->_buffer.assign("\x0\x0\x0\x1", 4);
-                    _h264frame->_buffer.append((char *) ptr, len);
+                    _h264frame->_buffer.push_back(ptr[0]);
+                    _h264frame->appendSlice(rtppack, (char *) ptr + 1, len - 1);
                     _h264frame->_pts = rtppack->timeStamp;
                     if ((ptr[0] & 0x1F) == H264Frame::NAL_IDR) {
                         haveIDR = true;
@@ -124,9 +129,11 @@ bool H264RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
             MakeFU(frame[1], fu);
             if (fu.S) {
                 //该帧的第一个rtp包  FU-A start
+                //上一个FU-A的末尾包可能丢失，需清除其残留的分片
+                _h264frame->clearSlices();
                 _h264frame->_buffer.assign("\x0\x0\x0\x1", 4);
                 _h264frame->_buffer.push_back(nal_suffix | fu.type);
-                _h264frame->_buffer.append((char *) frame + 2, length - 2);
+                _h264frame->appendSlice(rtppack, (char *) frame + 2, length - 2);
                 _h264frame->_pts = rtppack->timeStamp;
                 //该函数return时，保存下当前sequence,以便下次对比seq是否连续
                 _lastSeq = rtppack->sequence;
@@ -135,21 +142,21 @@ bool H264RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
 
             if (rtppack->sequence != _lastSeq + 1 && rtppack->sequence != 0) {
                 //中间的或末尾的rtp包，其seq必须连续(如果回环了则判定为连续)，否则说明rtp丢包，那么该帧不完整，必须得丢弃
-                _h264frame->_buffer.clear();
+                _h264frame = obtainFrame();
                 WarnL << "rtp丢包: " << rtppack->sequence << " != " << _lastSeq << " + 1,该帧被废弃";
                 return false;
             }
 
             if (!fu.E) {
                 //该帧的中间rtp包  FU-A mid
-                _h264frame->_buffer.append((char *) frame + 2, length - 2);
+                _h264frame->appendSlice(rtppack, (char *) frame + 2, length - 2);
                 //该函数return时，保存下当前sequence,以便下次对比seq是否连续
                 _lastSeq = rtppack->sequence;
                 return false;
             }
 
             //该帧最后一个rtp包  FU-A end
-            _h264frame->_buffer.append((char *) frame + 2, length - 2);
+            _h264frame->appendSlice(rtppack, (char *) frame + 2, length - 2);
             _h264frame->_pts = rtppack->timeStamp;
             onGetH264(_h264frame);
             return false;
@@ -169,7 +176,7 @@ bool H264RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
     }
 }
 
-void H264RtpDecoder::onGetH264(const H264Frame::Ptr &frame) {
+void H264RtpDecoder::onGetH264(const H264FrameSliced::Ptr &frame) {
     //rtsp没有dts，那么根据pts排序算法生成dts
     _dts_generator.getDts(frame->_pts,frame->_dts);
     //写入环形缓存
@@ -194,10 +201,13 @@ H264RtpEncoder::H264RtpEncoder(uint32_t ui32Ssrc,
 
 void H264RtpEncoder::inputFrame(const Frame::Ptr &frame) {
     GET_CONFIG(uint32_t,cycleMS,Rtp::kCycleMS);
-    auto ptr = frame->data() + frame->prefixSize();
-    auto len = frame->size() - frame->prefixSize();
+    //分片帧直接从各个分片拷贝到rtp包，不合并分片
+    auto prefix = frame->prefixSize();
+    FrameReader reader(frame, prefix);
+    auto nal = frame->byteAt(prefix);
+    auto len = reader.remain();
     auto pts = frame->pts() % cycleMS;
-    auto nal_type = H264_TYPE(ptr[0]);
+    auto nal_type = H264_TYPE(nal);
     auto payload_size = _ui32MtuSize - 2;
 
     //超过MTU则按照FU-A模式打包
@@ -205,16 +215,17 @@ void H264RtpEncoder::inputFrame(const Frame::Ptr &frame) {
         //最高位bit为forbidden_zero_bit,
         //后面2bit为nal_ref_idc(帧重要程度),00:可以丢,11:不能丢
         //末尾5bit为nalu type，固定为28(FU-A)
-        unsigned char nal_fu_a = (*((unsigned char *) ptr) & (~0x1F)) | 28;
+        unsigned char nal_fu_a = (nal & (~0x1F)) | 28;
         unsigned char s_e_r_flags;
         bool fu_a_start = true;
         bool mark_bit = false;
-        int offset = 1;
+        //跳过nal头
+        reader.read(&nal, 1);
         while (!mark_bit) {
-            if (len <= offset + payload_size) {
+            if (reader.remain() <= payload_size) {
                 //FU-A end
                 mark_bit = true;
-                payload_size = len - offset;
+                payload_size = reader.remain();
                 s_e_r_flags = (1 << 6) | nal_type;
             } else if (fu_a_start) {
                 //FU-A start
@@ -226,7 +237,7 @@ void H264RtpEncoder::inputFrame(const Frame::Ptr &frame) {
 
             {
                 //传入nullptr先不做payload的内存拷贝
-                auto rtp = makeRtp(getTrackType(), nullptr, payload_size + 2, mark_bit, pts);
+                auto rtp = makeRtp(CodecTraits<CodecH264>::kTrackType, nullptr, payload_size + 2, mark_bit, pts);
                 //rtp payload 负载部分
                 uint8_t *payload = (uint8_t*)rtp->data() + rtp->offset;
                 //FU-A 第1个字节
@@ -234,21 +245,18 @@ void H264RtpEncoder::inputFrame(const Frame::Ptr &frame) {
                 //FU-A 第2个字节
                 payload[1] = s_e_r_flags;
                 //H264 数据
-                memcpy(payload + 2, (unsigned char *) ptr + offset, payload_size);
+                reader.read(payload + 2, payload_size);
                 //输入到rtp环形缓存
-                RtpCodec::inputRtp(rtp, fu_a_start && nal_type == H264Frame::NAL_IDR);
+                RtpCodec::inputRtp(rtp, fu_a_start && CodecTraits<CodecH264>::keyFrame(nal));
             }
-            offset += payload_size;
             fu_a_start = false;
         }
     } else {
         //如果帧长度不超过mtu, 则按照Single NAL unit packet per H.264 方式打包
-        makeH264Rtp(ptr, len, false, false, pts);
+        auto rtp = makeRtp(CodecTraits<CodecH264>::kTrackType, nullptr, len, false, pts);
+        reader.read(rtp->data() + rtp->offset, len);
+        RtpCodec::inputRtp(rtp, false);
     }
 }
 
-void H264RtpEncoder::makeH264Rtp(const void* data, unsigned int len, bool mark, bool gop_pos, uint32_t uiStamp) {
-    RtpCodec::inputRtp(makeRtp(getTrackType(), data, len, mark, uiStamp), gop_pos);
-}
-
 }//namespace mediakit
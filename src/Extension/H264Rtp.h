@@ -24,7 +24,7 @@ namespace mediakit{
  * 将 h264 over rtsp-rtp 解复用出 h264-Frame
  * rfc3984
  */
-class H264RtpDecoder : public RtpCodec , public ResourcePoolHelper<H264Frame> {
+class H264RtpDecoder : public RtpCodec {
 public:
     typedef std::shared_ptr<H264RtpDecoder> Ptr;
 
@@ -43,10 +43,10 @@ public:
     }
 private:
     bool decodeRtp(const RtpPacket::Ptr &rtp);
-    void onGetH264(const H264Frame::Ptr &frame);
-    H264Frame::Ptr obtainFrame();
+    void onGetH264(const H264FrameSliced::Ptr &frame);
+    H264FrameSliced::Ptr obtainFrame();
 private:
-    H264Frame::Ptr _h264frame;
+    H264FrameSliced::Ptr _h264frame;
     DtsGenerator _dts_generator;
     int _lastSeq = 0;
 };
@@ -77,8 +77,6 @@ public:
      * @param frame 帧数据，必须
      */
     void inputFrame(const Frame::Ptr &frame) override;
-private:
-    void makeH264Rtp(const void *pData, unsigned int uiLen, bool bMark,  bool gop_pos, uint32_t uiStamp);
 };
 
 }//namespace mediakit{
@@ -82,6 +82,11 @@ public:
     }
 };
 
+/**
+ * 负载由多个分片组成的H265类，rtp解复用时使用，分片直接引用rtp包，防止内存拷贝
+ */
+typedef FrameSliced<H265Frame> H265FrameSliced;
+
 class H265FrameNoCacheAble : public FrameFromPtr {
 public:
     typedef std::shared_ptr<H265FrameNoCacheAble> Ptr;
@@ -195,7 +200,7 @@ public:
      * @param frame 数据帧
      */
     void inputFrame(const Frame::Ptr &frame) override{
-        int type = H265_TYPE(*((uint8_t *)frame->data() + frame->prefixSize()));
+        int type = H265_TYPE(frame->byteAt(frame->prefixSize()));
         if(frame->configFrame() || type == H265Frame::NAL_SEI_PREFIX){
             splitH264(frame->data(), frame->size(), frame->prefixSize(), [&](const char *ptr, int len, int prefix){
                 H265FrameInternal::Ptr sub_frame = std::make_shared<H265FrameInternal>(frame, (char*)ptr, len, prefix);
@@ -212,7 +217,7 @@ private:
      * @param frame 数据帧
      */
     void inputFrame_l(const Frame::Ptr &frame) {
-        int type = H265_TYPE(((uint8_t *) frame->data() + frame->prefixSize())[0]);
+        int type = H265_TYPE(frame->byteAt(frame->prefixSize()));
         if (H265Frame::isKeyFrame(type)) {
             insertConfigFrame(frame);
             VideoTrack::inputFrame(frame);
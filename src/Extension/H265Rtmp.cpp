@@ -9,6 +9,7 @@
  */
 
 #include "H265Rtmp.h"
+#include "CodecTraits.h"
 #ifdef ENABLE_MP4
 #include "mpeg4-hevc.h"
 #endif//ENABLE_MP4
@@ -137,28 +138,30 @@ void H265RtmpEncoder::makeConfigPacket(){
 }
 
 void H265RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
-    auto pcData = frame->data() + frame->prefixSize();
-    auto iLen = frame->size() - frame->prefixSize();
-    auto type = H265_TYPE(((uint8_t*)pcData)[0]);
+    typedef CodecTraits<CodecH265> Traits;
+    auto prefix = frame->prefixSize();
+    auto iLen = frame->size() - prefix;
+    auto nal = frame->byteAt(prefix);
+    auto type = Traits::nalType(nal);
 
     if (!_gotSpsPps) {
         //尝试从frame中获取sps pps
         switch (type) {
             case H265Frame::NAL_SPS: {
                 //sps
-                _sps = string(pcData, iLen);
+                _sps = string(frame->data() + prefix, iLen);
                 makeConfigPacket();
                 break;
             }
             case H265Frame::NAL_PPS: {
                 //pps
-                _pps = string(pcData, iLen);
+                _pps = string(frame->data() + prefix, iLen);
                 makeConfigPacket();
                 break;
             }
             case H265Frame::NAL_VPS: {
                 //vps
-                _vps = string(pcData, iLen);
+                _vps = string(frame->data() + prefix, iLen);
                 makeConfigPacket();
                 break;
             }
@@ -171,7 +174,8 @@ void H265RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
         return;
     }
 
-    if(_lastPacket && _lastPacket->time_stamp != frame->dts()) {
+    auto dts = frame->dts();
+    if(_lastPacket && _lastPacket->time_stamp != dts) {
         RtmpCodec::inputRtmp(_lastPacket);
         _lastPacket = nullptr;
     }
@@ -180,25 +184,29 @@ void H265RtmpEncoder::inputFrame(const Frame::Ptr &frame) {
         //I or P or B frame
         int8_t flags = FLV_CODEC_H265;
         bool is_config = false;
-        flags |= (((frame->configFrame() || frame->keyFrame()) ? FLV_KEY_FRAME : FLV_INTER_FRAME) << 4);
+        flags |= (((Traits::configFrame(nal) || Traits::keyFrame(nal)) ? FLV_KEY_FRAME : FLV_INTER_FRAME) << 4);
 
         _lastPacket = ResourcePoolHelper<RtmpPacket>::obtainObj();
         _lastPacket->buffer.clear();
         _lastPacket->buffer.push_back(flags);
         _lastPacket->buffer.push_back(!is_config);
-        auto cts = frame->pts() - frame->dts();
+        auto cts = frame->pts() - dts;
         cts = htonl(cts);
         _lastPacket->buffer.append((char *)&cts + 1, 3);
 
         _lastPacket->chunk_id = CHUNK_VIDEO;
         _lastPacket->stream_index = STREAM_MEDIA;
-        _lastPacket->time_stamp = frame->dts();
+        _lastPacket->time_stamp = dts;
         _lastPacket->type_id = MSG_VIDEO;
 
     }
     auto size = htonl(iLen);
+    _lastPacket->buffer.reserve(_lastPacket->buffer.size() + 4 + iLen);
     _lastPacket->buffer.append((char *) &size, 4);
-    _lastPacket->buffer.append(pcData, iLen);
+    //分片帧直接追加各个分片，不合并分片
+    frame->forEachSlice(prefix, [&](const char *ptr, uint32_t size) {
+        _lastPacket->buffer.append(ptr, size);
+    });
     _lastPacket->body_size = _lastPacket->buffer.size();
 }
 
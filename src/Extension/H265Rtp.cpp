@@ -9,6 +9,7 @@
  */
 
 #include "H265Rtp.h"
+#include "CodecTraits.h"
 
 namespace mediakit{
 
@@ -50,10 +51,10 @@ H265RtpDecoder::H265RtpDecoder() {
     _h265frame = obtainFrame();
 }
 
-H265Frame::Ptr  H265RtpDecoder::obtainFrame() {
-    //从缓存池重新申请对象，防止覆盖已经写入环形缓存的对象
-    auto frame = ResourcePoolHelper<H265Frame>::obtainObj();
-    frame->_buffer.clear();
+H265FrameSliced::Ptr H265RtpDecoder::obtainFrame() {
+    //每帧新建对象，防止覆盖已经写入环形缓存的对象；
+    //帧负载直接引用rtp包，帧对象释放时即释放对rtp包的引用，所以不放入循环池
+    auto frame = std::make_shared<H265FrameSliced>();
     frame->_prefix_size = 4;
     return frame;
 }
@@ -82,10 +83,12 @@ bool H265RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
             MakeFU(frame[2], fu);
             if (fu.S) {
                 //该帧的第一个rtp包
+                //上一个FU的末尾包可能丢失，需清除其残留的分片
+                _h265frame->clearSlices();
                 _h265frame->_buffer.assign("\x0\x0\x0\x1", 4);
                 _h265frame->_buffer.push_back(fu.type << 1);
                 _h265frame->_buffer.push_back(0x01);
-                _h265frame->_buffer.append((char *) frame + 3, length - 3);
+                _h265frame->appendSlice(rtppack, (char *) frame + 3, length - 3);
                 _h265frame->_pts = rtppack->timeStamp;
                 //该函数return时，保存下当前sequence,以便下次对比seq是否连续
                 _lastSeq = rtppack->sequence;
@@ -94,30 +97,36 @@ bool H265RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
 
             if (rtppack->sequence != _lastSeq + 1 && rtppack->sequence != 0) {
                 //中间的或末尾的rtp包，其seq必须连续(如果回环了则判定为连续)，否则说明rtp丢包，那么该帧不完整，必须得丢弃
-                _h265frame->_buffer.clear();
+                _h265frame = obtainFrame();
                 WarnL << "rtp丢包: " << rtppack->sequence << " != " << _lastSeq << " + 1,该帧被废弃";
                 return false;
             }
 
             if (!fu.E) {
                 //该帧的中间rtp包
-                _h265frame->_buffer.append((char *) frame + 3, length - 3);
+                _h265frame->appendSlice(rtppack, (char *) frame + 3, length - 3);
                 //该函数return时，保存下当前sequence,以便下次对比seq是否连续
                 _lastSeq = rtppack->sequence;
                 return false;
             }
 
             //该帧最后一个rtp包
-            _h265frame->_buffer.append((char *) frame + 3, length - 3);
+            _h265frame->appendSlice(rtppack, (char *) frame + 3, length - 3);
             _h265frame->_pts = rtppack->timeStamp;
             onGetH265(_h265frame);
             return false;
         }
 
         default: // 4.4.1. Single NAL Unit Packets (p24)
+            if (length <= 2) {
+                WarnL << "265 RTP包长度不足:" << length;
+                return false;
+            }
             //a full frame
+            _h265frame->clearSlices();
             _h265frame->_buffer.assign("\x0\x0\x0\x1", 4);
-            _h265frame->_buffer.append((char *)frame, length);
+            _h265frame->_buffer.append((char *) frame, 2);
+            _h265frame->appendSlice(rtppack, (char *) frame + 2, length - 2);
             _h265frame->_pts = rtppack->timeStamp;
             auto key = _h265frame->keyFrame();
             onGetH265(_h265frame);
@@ -125,7 +134,7 @@ bool H265RtpDecoder::decodeRtp(const RtpPacket::Ptr &rtppack) {
     }
 }
 
-void H265RtpDecoder::onGetH265(const H265Frame::Ptr &frame) {
+void H265RtpDecoder::onGetH265(const H265FrameSliced::Ptr &frame) {
     //rtsp没有dts，那么根据pts排序算法生成dts
     _dts_generator.getDts(frame->_pts,frame->_dts);
     //写入环形缓存
@@ -150,24 +159,28 @@ H265RtpEncoder::H265RtpEncoder(uint32_t ui32Ssrc,
 
 void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
     GET_CONFIG(uint32_t, cycleMS, Rtp::kCycleMS);
-    auto ptr = (uint8_t *) frame->data() + frame->prefixSize();
-    auto len = frame->size() - frame->prefixSize();
+    //分片帧直接从各个分片拷贝到rtp包，不合并分片
+    auto prefix = frame->prefixSize();
+    FrameReader reader(frame, prefix);
+    auto nal = frame->byteAt(prefix);
+    auto len = reader.remain();
     auto pts = frame->pts() % cycleMS;
-    auto nal_type = H265_TYPE(ptr[0]); //获取NALU的5bit 帧类型
+    auto nal_type = H265_TYPE(nal); //获取NALU的6bit 帧类型
     auto payload_size = _ui32MtuSize - 3;
 
     //超过MTU,按照FU方式打包
     if (len > payload_size + 2) {
-        //获取帧头数据，1byte
         unsigned char s_e_flags;
         bool fu_start = true;
         bool mark_bit = false;
-        int offset = 2;
+        //跳过2个字节的nal头
+        uint8_t nal_header[2];
+        reader.read(nal_header, 2);
         while (!mark_bit) {
-            if (len <= offset + payload_size) {
+            if (reader.remain() <= payload_size) {
                 //FU end
                 mark_bit = true;
-                payload_size = len - offset;
+                payload_size = reader.remain();
                 s_e_flags = (1 << 6) | nal_type;
             } else if (fu_start) {
                 //FU start
@@ -179,7 +192,7 @@ void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
 
             {
                 //传入nullptr先不做payload的内存拷贝
-                auto rtp = makeRtp(getTrackType(), nullptr, payload_size + 3, mark_bit, pts);
+                auto rtp = makeRtp(CodecTraits<CodecH265>::kTrackType, nullptr, payload_size + 3, mark_bit, pts);
                 //rtp payload 负载部分
                 uint8_t *payload = (uint8_t *) rtp->data() + rtp->offset;
                 //FU 第1个字节，表明为FU
@@ -189,21 +202,17 @@ void H265RtpEncoder::inputFrame(const Frame::Ptr &frame) {
                 //FU 第3个字节
                 payload[2] = s_e_flags;
                 //H265 数据
-                memcpy(payload + 3, ptr + offset, payload_size);
+                reader.read(payload + 3, payload_size);
                 //输入到rtp环形缓存
-                RtpCodec::inputRtp(rtp, fu_start && H265Frame::isKeyFrame(nal_type));
+                RtpCodec::inputRtp(rtp, fu_start && CodecTraits<CodecH265>::keyFrame(nal));
             }
-
-            offset += payload_size;
             fu_start = false;
         }
     } else {
-        makeH265Rtp(nal_type, ptr, len, false, true, pts);
+        auto rtp = makeRtp(CodecTraits<CodecH265>::kTrackType, nullptr, len, false, pts);
+        reader.read(rtp->data() + rtp->offset, len);
+        RtpCodec::inputRtp(rtp, H265Frame::isKeyFrame(nal_type));
     }
 }
 
-void H265RtpEncoder::makeH265Rtp(int nal_type,const void* data, unsigned int len, bool mark, bool first_packet, uint32_t uiStamp) {
-    RtpCodec::inputRtp(makeRtp(getTrackType(),data,len,mark,uiStamp),first_packet && H265Frame::isKeyFrame(nal_type));
-}
-
 }//namespace mediakit
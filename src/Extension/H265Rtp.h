@@ -25,7 +25,7 @@ namespace mediakit{
  * 将 h265 over rtsp-rtp 解复用出 h265-Frame
  * 《草案（H265-over-RTP）draft-ietf-payload-rtp-h265-07.pdf》
  */
-class H265RtpDecoder : public RtpCodec , public ResourcePoolHelper<H265Frame> {
+class H265RtpDecoder : public RtpCodec {
 public:
     typedef std::shared_ptr<H265RtpDecoder> Ptr;
 
@@ -44,10 +44,10 @@ public:
     }
 private:
     bool decodeRtp(const RtpPacket::Ptr &rtp);
-    void onGetH265(const H265Frame::Ptr &frame);
-    H265Frame::Ptr obtainFrame();
+    void onGetH265(const H265FrameSliced::Ptr &frame);
+    H265FrameSliced::Ptr obtainFrame();
 private:
-    H265Frame::Ptr _h265frame;
+    H265FrameSliced::Ptr _h265frame;
     DtsGenerator _dts_generator;
     int _lastSeq = 0;
 };
@@ -78,8 +78,6 @@ public:
      * @param frame 帧数据，必须
      */
     void inputFrame(const Frame::Ptr &frame) override;
-private:
-    void makeH265Rtp(int nal_type,const void *pData, unsigned int uiLen, bool bMark, bool first_packet,uint32_t uiStamp);
 };
 
 }//namespace mediakit{
@@ -11,7 +11,10 @@
 #ifndef ZLMEDIAKIT_FMP4MEDIASOURCE_H
 #define ZLMEDIAKIT_FMP4MEDIASOURCE_H
 
+#include <mutex>
 #include "Common/MediaSource.h"
+#include "Poller/Timer.h"
+#include "FMP4Packager.h"
 using namespace toolkit;
 #define FMP4_GOP_SIZE 512
 
@@ -51,6 +54,48 @@ public:
         return _ring;
     }
 
+    /**
+     * 获取CMAF打包器，并在之后30秒内保持打包
+     * 打包期间视为有一个观看者，防止无人观看时流被关闭
+     */
+    const FMP4Packager::Ptr &getPackager() {
+        lock_guard<recursive_mutex> lck(_packager_mtx);
+        _packager_ticker.resetTime();
+        if (_packager_timer) {
+            return _packager;
+        }
+        _packager->setActive(true);
+        auto poller = EventPollerPool::Instance().getPoller();
+        weak_ptr<FMP4MediaSource> weak_self = dynamic_pointer_cast<FMP4MediaSource>(shared_from_this());
+        _packager_timer = std::make_shared<Timer>(5.0f, [weak_self]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return false;
+            }
+            lock_guard<recursive_mutex> lck(strong_self->_packager_mtx);
+            if (strong_self->_packager_ticker.elapsedTime() < 30 * 1000) {
+                return true;
+            }
+            //无人访问，停止打包
+            strong_self->_packager->setActive(false);
+            strong_self->_packager_reader = nullptr;
+            strong_self->_packager_timer = nullptr;
+            return false;
+        }, poller);
+        //环形缓冲的读取器只能在poller线程中创建
+        poller->async([weak_self, poller]() {
+            auto strong_self = weak_self.lock();
+            if (!strong_self) {
+                return;
+            }
+            lock_guard<recursive_mutex> lck(strong_self->_packager_mtx);
+            if (strong_self->_packager_timer && strong_self->_ring) {
+                strong_self->_packager_reader = strong_self->_ring->attach(poller, false);
+            }
+        });
+        return _packager;
+    }
+
     /**
      * 获取fmp4 init segment
      */
@@ -64,6 +109,7 @@ public:
      */
     void setInitSegment(string str) {
         _init_segment = std::move(str);
+        _packager->setInitSegment(_init_segment);
         if (_ring) {
             regist();
         }
@@ -76,6 +122,15 @@ public:
         return _ring ? _ring->readerCount() : 0;
     }
 
+    /**
+     * 遍历拥有播放器的poller线程
+     */
+    void for_each_reader_poller(const function<void(const EventPoller::Ptr &poller, int reader_count)> &cb) override {
+        if (_ring) {
+            _ring->for_each_poller(cb);
+        }
+    }
+
     /**
      * 输入FMP4包
      * @param packet FMP4包
@@ -89,6 +144,7 @@ public:
             _have_video = true;
         }
         _speed += packet->size();
+        _packager->inputPacket(packet);
         auto stamp = packet->time_stamp;
         PacketCache<FMP4Packet>::inputPacket(stamp, true, std::move(packet), key);
     }
@@ -99,6 +155,7 @@ public:
     void clearCache() override {
         PacketCache<FMP4Packet>::clearCache();
         _ring->clearCache();
+        _packager->clear();
     }
 
 private:
@@ -132,6 +189,12 @@ private:
     int _ring_size;
     string _init_segment;
     RingType::Ptr _ring;
+
+    recursive_mutex _packager_mtx;
+    Ticker _packager_ticker;
+    Timer::Ptr _packager_timer;
+    RingType::RingReader::Ptr _packager_reader;
+    FMP4Packager::Ptr _packager = std::make_shared<FMP4Packager>();
 };
 
 
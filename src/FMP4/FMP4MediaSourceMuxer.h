@@ -18,14 +18,14 @@
 
 namespace mediakit {
 
-class FMP4MediaSourceMuxer : public MP4MuxerMemory, public MediaSourceEventInterceptor,
+class FMP4MediaSourceMuxer : public MP4MuxerMemory, public MediaSourceEventInterceptor, public MuxerDemandHelper,
                              public std::enable_shared_from_this<FMP4MediaSourceMuxer> {
 public:
     using Ptr = std::shared_ptr<FMP4MediaSourceMuxer>;
 
     FMP4MediaSourceMuxer(const string &vhost,
                          const string &app,
-                         const string &stream_id) {
+                         const string &stream_id) : MuxerDemandHelper("fmp4", true) {
         _media_src = std::make_shared<FMP4MediaSource>(vhost, app, stream_id);
     }
 
@@ -42,7 +42,7 @@ public:
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
-        _enabled = fmp4_demand ? size : true;
+        _demand.setEnabled(fmp4_demand ? size : true);
         if (!size && fmp4_demand) {
             _clear_cache = true;
         }
@@ -55,7 +55,7 @@ public:
             _clear_cache = false;
             _media_src->clearCache();
         }
-        if (_enabled || !fmp4_demand) {
+        if (_demand.isEnabled() || !fmp4_demand) {
             MP4MuxerMemory::inputFrame(frame);
         }
     }
@@ -63,7 +63,7 @@ public:
     bool isEnabled() {
         GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return fmp4_demand ? (_clear_cache ? true : _enabled) : true;
+        return fmp4_demand ? (_clear_cache ? true : _demand.isEnabled()) : true;
     }
 
     void onAllTrackReady() {
@@ -71,6 +71,11 @@ public:
     }
 
 protected:
+    bool isDemand() const override {
+        GET_CONFIG(bool, fmp4_demand, General::kFMP4Demand);
+        return fmp4_demand;
+    }
+
     void onSegmentData(const string &string, uint32_t stamp, bool key_frame) override {
         if (string.empty()) {
             return;
@@ -81,7 +86,6 @@ protected:
     }
 
 private:
-    bool _enabled = true;
     bool _clear_cache = false;
     FMP4MediaSource::Ptr _media_src;
 };
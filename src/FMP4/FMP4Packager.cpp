@@ -0,0 +1,554 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <ctime>
+#include <cmath>
+#include <sys/time.h>
+#include "FMP4Packager.h"
+#include "Common/config.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+
+namespace mediakit {
+
+static const string kHlsFile = "cmaf.m3u8";
+static const string kMpdFile = "cmaf.mpd";
+static const string kInitFile = "cmaf_init.mp4";
+
+static uint16_t loadBE16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t loadBE32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t loadBE64(const uint8_t *p) {
+    return ((uint64_t) loadBE32(p) << 32) | loadBE32(p + 4);
+}
+
+/**
+ * 遍历[data, data + size)中的box
+ * @param cb 参数为box类型与box内容(不含box头)，返回false时停止遍历
+ */
+static void forEachBox(const uint8_t *data, size_t size, const function<bool(const string &type, const uint8_t *body, size_t body_size)> &cb) {
+    size_t offset = 0;
+    while (offset + 8 <= size) {
+        uint64_t box_size = loadBE32(data + offset);
+        size_t header = 8;
+        if (box_size == 1) {
+            if (offset + 16 > size) {
+                return;
+            }
+            box_size = loadBE64(data + offset + 8);
+            header = 16;
+        } else if (box_size == 0) {
+            box_size = size - offset;
+        }
+        if (box_size < header || box_size > size - offset) {
+            return;
+        }
+        if (!cb(string((char *) data + offset + 4, 4), data + offset + header, box_size - header)) {
+            return;
+        }
+        offset += box_size;
+    }
+}
+
+static bool findBox(const uint8_t *data, size_t size, const char *type, const uint8_t *&body, size_t &body_size) {
+    bool found = false;
+    forEachBox(data, size, [&](const string &box_type, const uint8_t *box_body, size_t box_body_size) {
+        if (box_type != type) {
+            return true;
+        }
+        body = box_body;
+        body_size = box_body_size;
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+//按box路径查找，例如"mdia/minf/stbl/stsd"
+static bool findBoxPath(const uint8_t *data, size_t size, const string &path, const uint8_t *&body, size_t &body_size) {
+    body = data;
+    body_size = size;
+    for (auto &type : split(path, "/")) {
+        if (!findBox(body, body_size, type.data(), body, body_size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static string hexString(uint32_t value, bool upper = false) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), upper ? "%X" : "%x", value);
+    return buf;
+}
+
+//由stsd中的sample entry生成RFC 6381 codecs字符串
+static string getCodecString(const string &fourcc, const uint8_t *entry, size_t entry_size, bool video) {
+    //VisualSampleEntry与AudioSampleEntry的固定字段长度
+    size_t fixed = video ? 78 : 28;
+    if (entry_size < fixed) {
+        return fourcc;
+    }
+    const uint8_t *body;
+    size_t body_size;
+    if ((fourcc == "avc1" || fourcc == "avc3") && findBox(entry + fixed, entry_size - fixed, "avcC", body, body_size) && body_size >= 4) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%s.%02x%02x%02x", fourcc.data(), body[1], body[2], body[3]);
+        return buf;
+    }
+    if ((fourcc == "hvc1" || fourcc == "hev1") && findBox(entry + fixed, entry_size - fixed, "hvcC", body, body_size) && body_size >= 13) {
+        //profile_space、tier、profile_idc、兼容标志(位反序)、level与约束标志(省略末尾的0)
+        static const char *space[] = {"", "A", "B", "C"};
+        uint32_t compat = loadBE32(body + 2);
+        uint32_t reversed = 0;
+        for (int i = 0; i < 32; ++i) {
+            reversed |= ((compat >> i) & 1) << (31 - i);
+        }
+        string ret = fourcc + "." + space[body[1] >> 6] + to_string(body[1] & 0x1F) + "." + hexString(reversed, true) + "." +
+                     ((body[1] & 0x20) ? "H" : "L") + to_string(body[12]);
+        int last = 11;
+        while (last >= 6 && body[last] == 0) {
+            --last;
+        }
+        for (int i = 6; i <= last; ++i) {
+            ret += "." + hexString(body[i], true);
+        }
+        return ret;
+    }
+    if (fourcc == "mp4a" && findBox(entry + fixed, entry_size - fixed, "esds", body, body_size) && body_size > 4) {
+        //解析ES_Descriptor/DecoderConfigDescriptor/DecoderSpecificInfo
+        const uint8_t *ptr = body + 4, *end = body + body_size;
+        uint8_t object_type = 0;
+        auto read_descriptor = [&](uint8_t &tag, size_t &len) {
+            if (ptr >= end) {
+                return false;
+            }
+            tag = *ptr++;
+            len = 0;
+            for (int i = 0; i < 4 && ptr < end; ++i) {
+                uint8_t byte = *ptr++;
+                len = (len << 7) | (byte & 0x7F);
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            return ptr <= end;
+        };
+        uint8_t tag;
+        size_t len;
+        while (read_descriptor(tag, len)) {
+            if (tag == 0x03) {
+                //ES_ID与标志
+                if (end - ptr < 3) {
+                    break;
+                }
+                uint8_t flags = ptr[2];
+                ptr += 3;
+                if (flags & 0x80) {
+                    ptr += 2;
+                }
+                if ((flags & 0x40) && ptr < end) {
+                    ptr += 1 + *ptr;
+                }
+                if (flags & 0x20) {
+                    ptr += 2;
+                }
+            } else if (tag == 0x04) {
+                if (end - ptr < 13) {
+                    break;
+                }
+                object_type = ptr[0];
+                ptr += 13;
+            } else if (tag == 0x05) {
+                if (object_type == 0x40 && ptr < end) {
+                    return "mp4a.40." + to_string(ptr[0] >> 3);
+                }
+                break;
+            } else {
+                ptr += len;
+            }
+        }
+        return object_type ? "mp4a." + hexString(object_type, true) : fourcc;
+    }
+    if (fourcc == "Opus") {
+        return "opus";
+    }
+    return fourcc;
+}
+
+static string getIsoTime(int64_t ms) {
+    time_t sec = ms / 1000;
+    struct tm tm;
+    gmtime_r(&sec, &tm);
+    char buf[64];
+    auto len = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + len, sizeof(buf) - len, ".%03dZ", (int) (ms % 1000));
+    return buf;
+}
+
+static int64_t getWallTimeMS() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+bool FMP4Packager::isPackagerFile(const string &file_name) {
+    if (file_name == kHlsFile || file_name == kMpdFile || file_name == kInitFile) {
+        return true;
+    }
+    unsigned long long index;
+    char tail[8] = {0};
+    return sscanf(file_name.data(), "cmaf_%llu.%7s", &index, tail) == 2 && string(tail) == "m4s";
+}
+
+void FMP4Packager::setInitSegment(const string &init_segment) {
+    lock_guard<mutex> lck(_mtx);
+    _segments.clear();
+    _cur_data.clear();
+    _start_wall_ms = 0;
+    _init_segment = std::make_shared<BufferString>(init_segment);
+    _have_video = false;
+    _track_id = 0;
+    _timescale = 1000;
+    _width = _height = 0;
+    _trex_flags = 0;
+
+    const uint8_t *moov;
+    size_t moov_size;
+    if (!findBox((uint8_t *) init_segment.data(), init_segment.size(), "moov", moov, moov_size)) {
+        return;
+    }
+    vector<string> codecs;
+    forEachBox(moov, moov_size, [&](const string &type, const uint8_t *trak, size_t trak_size) {
+        if (type != "trak") {
+            return true;
+        }
+        const uint8_t *body;
+        size_t size;
+        if (!findBox(trak, trak_size, "tkhd", body, size) || size < 24) {
+            return true;
+        }
+        uint32_t track_id = loadBE32(body + (body[0] == 1 ? 20 : 12));
+        if (!findBoxPath(trak, trak_size, "mdia/mdhd", body, size) || size < 24) {
+            return true;
+        }
+        uint32_t timescale = loadBE32(body + (body[0] == 1 ? 20 : 12));
+        if (!findBoxPath(trak, trak_size, "mdia/hdlr", body, size) || size < 12) {
+            return true;
+        }
+        bool video = string((char *) body + 8, 4) == "vide";
+        if (!findBoxPath(trak, trak_size, "mdia/minf/stbl/stsd", body, size) || size < 8) {
+            return true;
+        }
+        forEachBox(body + 8, size - 8, [&](const string &fourcc, const uint8_t *entry, size_t entry_size) {
+            codecs.emplace_back(getCodecString(fourcc, entry, entry_size, video));
+            if (video && entry_size >= 28 && !_width) {
+                _width = loadBE16(entry + 24);
+                _height = loadBE16(entry + 26);
+            }
+            return false;
+        });
+        //以视频track(无视频时为第一个track)计算切片时间
+        if ((video && !_have_video) || !_track_id) {
+            _have_video = _have_video || video;
+            _track_id = track_id;
+            _timescale = timescale ? timescale : 1000;
+        }
+        return true;
+    });
+    //分片中未指定sample_flags时的默认值
+    forEachBox(moov, moov_size, [&](const string &type, const uint8_t *mvex, size_t mvex_size) {
+        if (type != "mvex") {
+            return true;
+        }
+        forEachBox(mvex, mvex_size, [&](const string &type, const uint8_t *trex, size_t trex_size) {
+            if (type == "trex" && trex_size >= 24 && loadBE32(trex + 4) == _track_id) {
+                _trex_flags = loadBE32(trex + 20);
+                return false;
+            }
+            return true;
+        });
+        return false;
+    });
+    _codecs.clear();
+    for (auto &codec : codecs) {
+        _codecs += (_codecs.empty() ? "" : ",") + codec;
+    }
+}
+
+void FMP4Packager::setActive(bool active) {
+    list<Waiter> waiters;
+    {
+        lock_guard<mutex> lck(_mtx);
+        _active = active;
+        if (!active) {
+            clear_l(waiters);
+        }
+    }
+    for (auto &waiter : waiters) {
+        waiter.cb(nullptr);
+    }
+}
+
+void FMP4Packager::clear() {
+    list<Waiter> waiters;
+    {
+        lock_guard<mutex> lck(_mtx);
+        clear_l(waiters);
+    }
+    for (auto &waiter : waiters) {
+        waiter.cb(nullptr);
+    }
+}
+
+void FMP4Packager::clear_l(list<Waiter> &waiters) {
+    _segments.clear();
+    _cur_data.clear();
+    _start_wall_ms = 0;
+    //等待中的请求在锁外回复
+    waiters.swap(_waiters);
+}
+
+//sample_flags中的sample_is_non_sync_sample标志
+static constexpr uint32_t kNonSyncSample = 0x10000;
+
+/**
+ * 判断traf的第一个sample是否为同步帧(关键帧)
+ * 依次取trun的first_sample_flags、第一个sample的flags、tfhd的default_sample_flags、trex的default_sample_flags
+ */
+static bool isFirstSampleSync(const uint8_t *tfhd, size_t tfhd_size, const uint8_t *traf, size_t traf_size, uint32_t trex_flags) {
+    const uint8_t *trun;
+    size_t trun_size;
+    if (findBox(traf, traf_size, "trun", trun, trun_size) && trun_size >= 8) {
+        uint32_t flags = loadBE32(trun) & 0xFFFFFF;
+        size_t offset = 8 + ((flags & 0x01) ? 4 : 0);
+        if (flags & 0x04) {
+            return offset + 4 <= trun_size && !(loadBE32(trun + offset) & kNonSyncSample);
+        }
+        if (flags & 0x400) {
+            offset += ((flags & 0x100) ? 4 : 0) + ((flags & 0x200) ? 4 : 0);
+            return offset + 4 <= trun_size && !(loadBE32(trun + offset) & kNonSyncSample);
+        }
+    }
+    uint32_t flags = loadBE32(tfhd) & 0xFFFFFF;
+    if (flags & 0x20) {
+        size_t offset = 8 + ((flags & 0x01) ? 8 : 0) + ((flags & 0x02) ? 4 : 0) + ((flags & 0x08) ? 4 : 0) + ((flags & 0x10) ? 4 : 0);
+        return offset + 4 <= tfhd_size && !(loadBE32(tfhd + offset) & kNonSyncSample);
+    }
+    return !(trex_flags & kNonSyncSample);
+}
+
+bool FMP4Packager::parseFragment(const Buffer::Ptr &packet, int64_t &start_ms, bool &key) const {
+    //一个数据包可能包含多个moof，取第一个包含该track的traf
+    bool found = false;
+    forEachBox((uint8_t *) packet->data(), packet->size(), [&](const string &type, const uint8_t *moof, size_t moof_size) {
+        if (type != "moof") {
+            return true;
+        }
+        forEachBox(moof, moof_size, [&](const string &type, const uint8_t *traf, size_t traf_size) {
+            const uint8_t *body;
+            size_t size;
+            if (type != "traf" || !findBox(traf, traf_size, "tfhd", body, size) || size < 8 || loadBE32(body + 4) != _track_id) {
+                return true;
+            }
+            //无视频时每个分片都可以作为切片开始
+            key = !_have_video || isFirstSampleSync(body, size, traf, traf_size, _trex_flags);
+            if (findBox(traf, traf_size, "tfdt", body, size) && size >= 8) {
+                uint64_t decode_time = body[0] == 1 ? (size >= 12 ? loadBE64(body + 4) : 0) : loadBE32(body + 4);
+                start_ms = decode_time * 1000 / _timescale;
+                found = true;
+            }
+            return false;
+        });
+        return !found;
+    });
+    return found;
+}
+
+void FMP4Packager::inputPacket(const Buffer::Ptr &packet) {
+    GET_CONFIG(float, segDur, Hls::kSegmentDuration);
+    GET_CONFIG(uint32_t, segNum, Hls::kSegmentNum);
+    GET_CONFIG(uint32_t, segRetain, Hls::kSegmentRetain);
+
+    list<pair<onData, Buffer::Ptr> > ready;
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (!_active || !_init_segment) {
+            return;
+        }
+        int64_t start;
+        bool key = false;
+        //切片只在关键帧处切分
+        if (parseFragment(packet, start, key) && key) {
+            if (!_cur_data.empty() && start < _cur_start) {
+                //时间戳回退，丢弃未完成的切片
+                _cur_data.clear();
+            }
+            if (!_cur_data.empty() && start - _cur_start >= segDur * 1000) {
+                Segment segment{_next_index++, _cur_start, (uint32_t) (start - _cur_start), std::make_shared<BufferString>(std::move(_cur_data))};
+                _cur_data.clear();
+                _segments.emplace_back(std::move(segment));
+                while (_segments.size() > MAX(segNum, 1) + segRetain) {
+                    _segments.pop_front();
+                }
+                //已生成切片，回复等待中的索引请求
+                for (auto &waiter : _waiters) {
+                    ready.emplace_back(std::move(waiter.cb), getFile_l(waiter.file_name));
+                }
+                _waiters.clear();
+            }
+            if (_cur_data.empty()) {
+                _cur_start = start;
+                if (!_start_wall_ms) {
+                    _start_wall_ms = getWallTimeMS() - start;
+                }
+            }
+        } else if (_cur_data.empty()) {
+            //等待关键帧
+            return;
+        }
+        _cur_data.append(packet->data(), packet->size());
+    }
+    for (auto &pr : ready) {
+        pr.first(pr.second);
+    }
+}
+
+uint64_t FMP4Packager::getFile(const string &file_name, const onData &cb) {
+    Buffer::Ptr data;
+    {
+        lock_guard<mutex> lck(_mtx);
+        if ((file_name == kHlsFile || file_name == kMpdFile) && _segments.empty()) {
+            //尚未生成切片
+            _waiters.emplace_back(Waiter{++_waiter_id, file_name, cb});
+            return _waiter_id;
+        }
+        data = getFile_l(file_name);
+    }
+    cb(data);
+    return 0;
+}
+
+void FMP4Packager::delWaiter(uint64_t id) {
+    //回调持有http会话的回复函数，在锁外释放
+    onData cb;
+    lock_guard<mutex> lck(_mtx);
+    for (auto it = _waiters.begin(); it != _waiters.end(); ++it) {
+        if (it->id == id) {
+            cb = std::move(it->cb);
+            _waiters.erase(it);
+            break;
+        }
+    }
+}
+
+Buffer::Ptr FMP4Packager::getFile_l(const string &file_name) const {
+    if (file_name == kHlsFile) {
+        return std::make_shared<BufferString>(makeHls_l());
+    }
+    if (file_name == kMpdFile) {
+        return std::make_shared<BufferString>(makeMpd_l());
+    }
+    if (file_name == kInitFile) {
+        return _init_segment;
+    }
+    auto index = strtoull(file_name.data() + sizeof("cmaf_") - 1, nullptr, 10);
+    if (_segments.empty() || index < _segments.front().index || index > _segments.back().index) {
+        return nullptr;
+    }
+    return _segments[index - _segments.front().index].data;
+}
+
+string FMP4Packager::makeHls_l() const {
+    GET_CONFIG(uint32_t, segNum, Hls::kSegmentNum);
+    auto count = MIN(_segments.size(), (size_t) MAX(segNum, 1));
+    auto first = _segments.size() - count;
+    uint32_t max_duration = 0;
+    for (auto i = first; i < _segments.size(); ++i) {
+        max_duration = MAX(max_duration, _segments[i].duration);
+    }
+
+    char line[256];
+    string m3u8;
+    snprintf(line, sizeof(line),
+             "#EXTM3U\n"
+             "#EXT-X-VERSION:7\n"
+             "#EXT-X-TARGETDURATION:%u\n"
+             "#EXT-X-MEDIA-SEQUENCE:%llu\n"
+             "%s"
+             "#EXT-X-MAP:URI=\"%s\"\n",
+             (max_duration + 999) / 1000,
+             (unsigned long long) (count ? _segments[first].index : 0),
+             _have_video ? "#EXT-X-INDEPENDENT-SEGMENTS\n" : "",
+             kInitFile.data());
+    m3u8.append(line);
+    for (auto i = first; i < _segments.size(); ++i) {
+        snprintf(line, sizeof(line), "#EXTINF:%.3f,\ncmaf_%llu.m4s\n", _segments[i].duration / 1000.0, (unsigned long long) _segments[i].index);
+        m3u8.append(line);
+    }
+    return m3u8;
+}
+
+string FMP4Packager::makeMpd_l() const {
+    GET_CONFIG(float, segDur, Hls::kSegmentDuration);
+    GET_CONFIG(uint32_t, segNum, Hls::kSegmentNum);
+    auto count = MIN(_segments.size(), (size_t) MAX(segNum, 1));
+    auto first = _segments.size() - count;
+    uint64_t bytes = 0, duration = 0;
+    for (auto i = first; i < _segments.size(); ++i) {
+        bytes += _segments[i].data->size();
+        duration += _segments[i].duration;
+    }
+    auto bandwidth = duration ? bytes * 8 * 1000 / duration : 0;
+
+    char buf[1024];
+    string mpd;
+    snprintf(buf, sizeof(buf),
+             "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+             "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" profiles=\"urn:mpeg:dash:profile:isoff-live:2011\" type=\"dynamic\"\n"
+             "     availabilityStartTime=\"%s\" publishTime=\"%s\" minimumUpdatePeriod=\"PT%.3fS\"\n"
+             "     minBufferTime=\"PT%.3fS\" timeShiftBufferDepth=\"PT%.3fS\" suggestedPresentationDelay=\"PT%.3fS\">\n"
+             "  <Period id=\"0\" start=\"PT0S\">\n"
+             "    <AdaptationSet id=\"0\" mimeType=\"%s\" segmentAlignment=\"true\" startWithSAP=\"1\">\n"
+             "      <Representation id=\"0\" codecs=\"%s\" bandwidth=\"%llu\"",
+             getIsoTime(_start_wall_ms).data(), getIsoTime(getWallTimeMS()).data(), segDur,
+             segDur, duration / 1000.0, segDur * 3,
+             _have_video ? "video/mp4" : "audio/mp4",
+             _codecs.data(), (unsigned long long) bandwidth);
+    mpd.append(buf);
+    if (_width && _height) {
+        snprintf(buf, sizeof(buf), " width=\"%d\" height=\"%d\"", _width, _height);
+        mpd.append(buf);
+    }
+    snprintf(buf, sizeof(buf),
+             ">\n"
+             "        <SegmentTemplate timescale=\"1000\" initialization=\"%s\" media=\"cmaf_$Number$.m4s\" startNumber=\"%llu\">\n"
+             "          <SegmentTimeline>\n",
+             kInitFile.data(), (unsigned long long) (count ? _segments[first].index : 0));
+    mpd.append(buf);
+    for (auto i = first; i < _segments.size(); ++i) {
+        snprintf(buf, sizeof(buf), "            <S t=\"%lld\" d=\"%u\"/>\n", (long long) _segments[i].start, _segments[i].duration);
+        mpd.append(buf);
+    }
+    mpd.append("          </SegmentTimeline>\n"
+               "        </SegmentTemplate>\n"
+               "      </Representation>\n"
+               "    </AdaptationSet>\n"
+               "  </Period>\n"
+               "</MPD>\n");
+    return mpd;
+}
+
+}//namespace mediakit
@@ -0,0 +1,124 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_FMP4PACKAGER_H
+#define ZLMEDIAKIT_FMP4PACKAGER_H
+
+#include <list>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <functional>
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * CMAF打包器，把fmp4直播的分片(moof+mdat)按关键帧与hls.segDur合并为切片，
+ * 在内存中生成CMAF hls(cmaf.m3u8，EXT-X-MAP指向cmaf_init.mp4)与dash(cmaf.mpd)的索引与切片，
+ * 一路fmp4复用同时提供http/ws-fmp4、CMAF hls与dash三种分发方式
+ * 音视频复用在同一个切片中，mpd中为单个Representation
+ */
+class FMP4Packager {
+public:
+    using Ptr = std::shared_ptr<FMP4Packager>;
+    using onData = function<void(const Buffer::Ptr &data)>;
+
+    FMP4Packager() = default;
+    ~FMP4Packager() = default;
+
+    /**
+     * 是否为打包器生成的文件名
+     */
+    static bool isPackagerFile(const string &file_name);
+
+    /**
+     * 设置init segment，从中解析track的时间刻度与编码信息
+     */
+    void setInitSegment(const string &init_segment);
+
+    /**
+     * 开启或关闭打包，关闭时清空切片并以nullptr回复等待中的请求；无人访问时关闭以节省内存
+     */
+    void setActive(bool active);
+
+    /**
+     * 输入fmp4分片，从分片的sample_flags判断是否以关键帧开始
+     */
+    void inputPacket(const Buffer::Ptr &packet);
+
+    /**
+     * 清空切片并以nullptr回复等待中的请求，fmp4时间戳不再连续时调用
+     */
+    void clear();
+
+    /**
+     * 获取文件
+     * cmaf.m3u8与cmaf.mpd在生成第一个切片前阻塞
+     * @param cb 回调，可能在fmp4打包线程中触发；文件不存在时回调nullptr
+     * @return 阻塞时返回等待者id，超时后需通过delWaiter移除；已回调时返回0
+     */
+    uint64_t getFile(const string &file_name, const onData &cb);
+
+    /**
+     * 移除超时的等待者，其回调不再触发
+     * @param id getFile返回的等待者id
+     */
+    void delWaiter(uint64_t id);
+
+private:
+    struct Waiter {
+        uint64_t id;
+        string file_name;
+        onData cb;
+    };
+
+    struct Segment {
+        uint64_t index;
+        //单位毫秒，与fmp4中视频track(无视频时为第一个track)的tfdt一致
+        int64_t start;
+        uint32_t duration;
+        Buffer::Ptr data;
+    };
+
+    Buffer::Ptr getFile_l(const string &file_name) const;
+    void clear_l(list<Waiter> &waiters);
+    string makeHls_l() const;
+    string makeMpd_l() const;
+    bool parseFragment(const Buffer::Ptr &packet, int64_t &start_ms, bool &key) const;
+
+private:
+    mutable mutex _mtx;
+    bool _active = false;
+    bool _have_video = false;
+    //计算切片时间的track
+    uint32_t _track_id = 0;
+    uint32_t _timescale = 1000;
+    uint32_t _trex_flags = 0;
+    string _codecs;
+    int _width = 0;
+    int _height = 0;
+    Buffer::Ptr _init_segment;
+
+    uint64_t _next_index = 0;
+    int64_t _cur_start = 0;
+    string _cur_data;
+    //第一个切片开始时的系统时间减去其时间戳，为dash的availabilityStartTime
+    int64_t _start_wall_ms = 0;
+    deque<Segment> _segments;
+    uint64_t _waiter_id = 0;
+    list<Waiter> _waiters;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_FMP4PACKAGER_H
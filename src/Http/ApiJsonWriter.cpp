@@ -0,0 +1,206 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include "ApiJsonWriter.h"
+#include "Util/util.h"
+#include "Extension/Track.h"
+
+namespace mediakit {
+
+ApiListArgs::ApiListArgs(uint64_t offset, uint64_t count, const string &fields) {
+    _offset = offset;
+    _count = count;
+    for (auto &field : split(fields, ",")) {
+        trim(field);
+        if (!field.empty()) {
+            _fields.emplace_back(std::move(field));
+        }
+    }
+}
+
+uint64_t ApiListArgs::begin() const {
+    return _offset;
+}
+
+uint64_t ApiListArgs::end(uint64_t size) const {
+    if (!_count || _count >= size || _offset >= size - _count) {
+        return size;
+    }
+    return _offset + _count;
+}
+
+bool ApiListArgs::inPage(uint64_t index) const {
+    return index >= _offset && (!_count || index - _offset < _count);
+}
+
+bool ApiListArgs::hasField(const char *name) const {
+    if (_fields.empty()) {
+        return true;
+    }
+    for (auto &field : _fields) {
+        if (field == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void writeMediaSourceJson(JsonStreamWriter &writer, const MediaSource::Ptr &media, const ApiListArgs &list_args) {
+    if (list_args.hasField("schema")) {
+        writer.member("schema", media->getSchema());
+    }
+    if (list_args.hasField("vhost")) {
+        writer.member("vhost", media->getVhost());
+    }
+    if (list_args.hasField("app")) {
+        writer.member("app", media->getApp());
+    }
+    if (list_args.hasField("stream")) {
+        writer.member("stream", media->getId());
+    }
+    if (list_args.hasField("createStamp")) {
+        writer.member("createStamp", (uint64_t) media->getCreateStamp());
+    }
+    if (list_args.hasField("aliveSecond")) {
+        writer.member("aliveSecond", (uint64_t) media->getAliveSecond());
+    }
+    if (list_args.hasField("bytesSpeed")) {
+        writer.member("bytesSpeed", media->getBytesSpeed());
+    }
+    if (list_args.hasField("readerCount")) {
+        writer.member("readerCount", media->readerCount());
+    }
+    if (list_args.hasField("totalReaderCount")) {
+        writer.member("totalReaderCount", media->totalReaderCount());
+    }
+    if (list_args.hasField("originType") || list_args.hasField("originTypeStr")) {
+        auto origin_type = media->getOriginType();
+        if (list_args.hasField("originType")) {
+            writer.member("originType", (int) origin_type);
+        }
+        if (list_args.hasField("originTypeStr")) {
+            writer.member("originTypeStr", getOriginTypeString(origin_type));
+        }
+    }
+    if (list_args.hasField("originUrl")) {
+        writer.member("originUrl", media->getOriginUrl());
+    }
+    if (list_args.hasField("originSock")) {
+        writer.key("originSock");
+        auto originSock = media->getOriginSock();
+        if (originSock) {
+            writer.startObject();
+            writer.member("local_ip", originSock->get_local_ip());
+            writer.member("local_port", originSock->get_local_port());
+            writer.member("peer_ip", originSock->get_peer_ip());
+            writer.member("peer_port", originSock->get_peer_port());
+            writer.member("identifier", originSock->getIdentifier());
+            writer.endObject();
+        } else {
+            writer.valueNull();
+        }
+    }
+
+    if (list_args.hasField("originStat")) {
+        //拉流代理的拉流统计，例如hls拉流的下载速度(bytesSpeed)、未下载切片时长(pendingMS)等
+        auto origin_stat = media->getOriginStat();
+        if (!origin_stat.empty()) {
+            writer.key("originStat");
+            writer.startObject();
+            for (auto &pr : origin_stat) {
+                writer.key(pr.first);
+                writer.value((int64_t) pr.second);
+            }
+            writer.endObject();
+        }
+    }
+
+    if (list_args.hasField("muxers")) {
+        //各协议按需转换的开关状态及累计开启、关闭时长(毫秒)
+        writer.key("muxers");
+        writer.startArray();
+        for (auto &stat : media->getMuxerDemandStat()) {
+            writer.startObject();
+            writer.member("protocol", stat.protocol);
+            writer.member("enabled", stat.enabled);
+            writer.member("enabledMS", (uint64_t) stat.enabled_ms);
+            writer.member("disabledMS", (uint64_t) stat.disabled_ms);
+            writer.member("enableCount", (uint64_t) stat.enable_count);
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+
+    if (list_args.hasField("tracks")) {
+        writer.key("tracks");
+        writer.startArray();
+        for (auto &track : media->getTracks()) {
+            writer.startObject();
+            auto codec_type = track->getTrackType();
+            writer.member("codec_id", (int) track->getCodecId());
+            writer.member("codec_id_name", track->getCodecName());
+            writer.member("ready", track->ready());
+            writer.member("codec_type", (int) codec_type);
+            switch (codec_type) {
+                case TrackAudio : {
+                    auto audio_track = dynamic_pointer_cast<AudioTrack>(track);
+                    writer.member("sample_rate", audio_track->getAudioSampleRate());
+                    writer.member("channels", audio_track->getAudioChannel());
+                    writer.member("sample_bit", audio_track->getAudioSampleBit());
+                    break;
+                }
+                case TrackVideo : {
+                    auto video_track = dynamic_pointer_cast<VideoTrack>(track);
+                    writer.member("width", video_track->getVideoWidth());
+                    writer.member("height", video_track->getVideoHeight());
+                    writer.member("fps", round(video_track->getVideoFps()));
+                    break;
+                }
+                default:
+                    break;
+            }
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+}
+
+SessionJsonWriter::SessionJsonWriter(const ApiListArgs &list_args) {
+    _peer_ip = list_args.hasField("peer_ip");
+    _peer_port = list_args.hasField("peer_port");
+    _local_ip = list_args.hasField("local_ip");
+    _local_port = list_args.hasField("local_port");
+    _id = list_args.hasField("id");
+    _typeid = list_args.hasField("typeid");
+}
+
+void SessionJsonWriter::write(JsonStreamWriter &writer, SockInfo &session, const char *type_id) const {
+    if (_peer_ip) {
+        writer.member("peer_ip", session.get_peer_ip());
+    }
+    if (_peer_port) {
+        writer.member("peer_port", session.get_peer_port());
+    }
+    if (_local_ip) {
+        writer.member("local_ip", session.get_local_ip());
+    }
+    if (_local_port) {
+        writer.member("local_port", session.get_local_port());
+    }
+    if (_id) {
+        writer.member("id", session.getIdentifier());
+    }
+    if (_typeid) {
+        writer.member("typeid", type_id);
+    }
+}
+
+}//namespace mediakit
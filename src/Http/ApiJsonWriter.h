@@ -0,0 +1,91 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_APIJSONWRITER_H
+#define ZLMEDIAKIT_APIJSONWRITER_H
+
+#include <string>
+#include <vector>
+#include "JsonStreamWriter.h"
+#include "Network/Socket.h"
+#include "Common/MediaSource.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 列表接口的分页与字段筛选参数
+ */
+class ApiListArgs {
+public:
+    /**
+     * @param offset 跳过的条数
+     * @param count 本页最大条数，0为不限
+     * @param fields 逗号分隔的字段名，为空时输出所有字段
+     */
+    ApiListArgs(uint64_t offset, uint64_t count, const string &fields);
+    ~ApiListArgs() = default;
+
+    uint64_t begin() const;
+
+    /**
+     * 本页结束位置
+     * @param size 列表总条数
+     */
+    uint64_t end(uint64_t size) const;
+
+    /**
+     * 第index条是否在本页内
+     */
+    bool inPage(uint64_t index) const;
+
+    /**
+     * 是否需要输出该字段
+     */
+    bool hasField(const char *name) const;
+
+private:
+    uint64_t _offset;
+    uint64_t _count;
+    vector<string> _fields;
+};
+
+/**
+ * 直接序列化MediaSource的各字段至writer，不构造Json::Value，用于getMediaList与getMediaInfo
+ * 调用者负责startObject/endObject
+ */
+void writeMediaSourceJson(JsonStreamWriter &writer, const MediaSource::Ptr &media, const ApiListArgs &list_args);
+
+/**
+ * getAllSession的会话序列化，构造时确定需要输出的字段，序列化时不再逐条查找
+ */
+class SessionJsonWriter {
+public:
+    SessionJsonWriter(const ApiListArgs &list_args);
+    ~SessionJsonWriter() = default;
+
+    /**
+     * 序列化会话的各字段，调用者负责startObject/endObject
+     * @param type_id 会话的类型名
+     */
+    void write(JsonStreamWriter &writer, SockInfo &session, const char *type_id) const;
+
+private:
+    bool _peer_ip;
+    bool _peer_port;
+    bool _local_ip;
+    bool _local_port;
+    bool _id;
+    bool _typeid;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_APIJSONWRITER_H
@@ -33,13 +33,15 @@ void HlsPlayer::play_l(){
     if(!(*this)[kNetAdapter].empty()) {
         setNetAdapter((*this)[kNetAdapter]);
     }
+    _m3u8_ticker.resetTime();
     sendRequest(_m3u8_list.back(), playTimeOutSec);
 }
 
 void HlsPlayer::teardown_l(const SockException &ex){
     _timer.reset();
     _timer_ts.reset();
-    _http_ts_player.reset();
+    _segment_tasks.clear();
+    _idle_fetchers.clear();
     shutdown(ex);
 }
 
@@ -47,69 +49,176 @@ void HlsPlayer::teardown() {
     teardown_l(SockException(Err_shutdown,"teardown"));
 }
 
-void HlsPlayer::playNextTs(bool force){
-    if (_ts_list.empty()) {
-        //播放列表为空，那么立即重新下载m3u8文件
-        _timer.reset();
-        play_l();
-        return;
-    }
-    if (!force && _http_ts_player && _http_ts_player->alive()) {
-        //播放器目前还存活，正在下载中
-        return;
+HttpTSPlayer::Ptr HlsPlayer::obtainFetcher() {
+    if (!_idle_fetchers.empty()) {
+        //复用keep-alive连接，省去tcp与tls握手
+        auto fetcher = _idle_fetchers.front();
+        _idle_fetchers.pop_front();
+        return fetcher;
     }
-    auto ts_duration = _ts_list.front().duration * 1000;
-    weak_ptr<HlsPlayer> weakSelf = dynamic_pointer_cast<HlsPlayer>(shared_from_this());
-    std::shared_ptr<Ticker> ticker(new Ticker);
-
-    _http_ts_player = std::make_shared<HttpTSPlayer>(getPoller(), false);
 
-    _http_ts_player->setOnCreateSocket([weakSelf](const EventPoller::Ptr &poller) {
+    weak_ptr<HlsPlayer> weakSelf = dynamic_pointer_cast<HlsPlayer>(shared_from_this());
+    auto fetcher = std::make_shared<HttpTSPlayer>(getPoller(), false);
+    fetcher->setOnCreateSocket([weakSelf](const EventPoller::Ptr &poller) {
         auto strongSelf = weakSelf.lock();
         if (strongSelf) {
             return strongSelf->createSocket();
         }
         return Socket::createSocket(poller, true);
     });
+    fetcher->setMethod("GET");
+    if (!(*this)[kNetAdapter].empty()) {
+        fetcher->setNetAdapter((*this)[Client::kNetAdapter]);
+    }
+    return fetcher;
+}
 
-    _http_ts_player->setOnDisconnect([weakSelf, ticker, ts_duration](const SockException &err) {
+void HlsPlayer::playNextTs(){
+    GET_CONFIG(uint32_t, pull_prefetch, Hls::kPullPrefetch);
+    //直播时并行预取多个切片；点播时同时只下载一个切片，并按切片时长控制下载速度
+    size_t max_tasks = isLive() ? MAX(pull_prefetch, 1u) : 1;
+    weak_ptr<HlsPlayer> weakSelf = dynamic_pointer_cast<HlsPlayer>(shared_from_this());
+    while (!_ts_list.empty() && _segment_tasks.size() < max_tasks) {
+        SegmentTask::Ptr task = std::make_shared<SegmentTask>();
+        task->ts = _ts_list.front();
+        task->fetcher = obtainFetcher();
+        _ts_list.pop_front();
+        _segment_tasks.emplace_back(task);
+
+        weak_ptr<SegmentTask> weakTask = task;
+        task->fetcher->setOnPacket([weakSelf, weakTask](const char *data, uint64_t len) {
+            auto strongSelf = weakSelf.lock();
+            auto strongTask = weakTask.lock();
+            if (strongSelf && strongTask) {
+                strongSelf->onSegmentPacket(strongTask, data, len);
+            }
+        });
+        task->fetcher->setOnComplete([weakSelf, weakTask]() {
+            auto strongSelf = weakSelf.lock();
+            auto strongTask = weakTask.lock();
+            if (strongSelf && strongTask) {
+                strongSelf->onSegmentCompleted(strongTask, true);
+            }
+        });
+        task->fetcher->setOnDisconnect([weakSelf, weakTask](const SockException &ex) {
+            auto strongSelf = weakSelf.lock();
+            auto strongTask = weakTask.lock();
+            if (strongSelf && strongTask) {
+                strongSelf->onSegmentCompleted(strongTask, false);
+            }
+        });
+        task->fetcher->sendRequest(task->ts.url, 2 * task->ts.duration);
+    }
+    updatePendingMS();
+}
+
+void HlsPlayer::playNextTsDelay(int64_t delay_ms) {
+    weak_ptr<HlsPlayer> weakSelf = dynamic_pointer_cast<HlsPlayer>(shared_from_this());
+    if (delay_ms <= 0) {
+        //本函数可能在HttpClient的回调中触发，下载下一个切片可能复用该连接，所以切换到下一次事件循环执行
+        _timer_ts.reset();
+        getPoller()->async([weakSelf]() {
+            auto strongSelf = weakSelf.lock();
+            if (strongSelf) {
+                strongSelf->playNextTs();
+            }
+        }, false);
+        return;
+    }
+    _timer_ts.reset(new Timer(delay_ms / 1000.0, [weakSelf]() {
         auto strongSelf = weakSelf.lock();
-        if (!strongSelf) {
-            return;
-        }
-        auto delay = ts_duration - 500 - ticker->elapsedTime();
-        if (delay <= 0) {
-            //播放这个ts切片花费了太长时间，我们立即下一个切片的播放
-            strongSelf->playNextTs(true);
-        } else {
-            //下一个切片慢点播放
-            strongSelf->_timer_ts.reset(new Timer(delay / 1000.0, [weakSelf, delay]() {
-                auto strongSelf = weakSelf.lock();
-                if (!strongSelf) {
-                    return false;
-                }
-                strongSelf->playNextTs(true);
-                return false;
-            }, strongSelf->getPoller()));
+        if (strongSelf) {
+            strongSelf->playNextTs();
         }
-    });
+        return false;
+    }, getPoller()));
+}
 
-    _http_ts_player->setOnPacket([weakSelf](const char *data, uint64_t len) {
-        auto strongSelf = weakSelf.lock();
-        if (!strongSelf) {
-            return;
+void HlsPlayer::onSegmentPacket(const SegmentTask::Ptr &task, const char *data, uint64_t len) {
+    _total_bytes += len;
+    _speed += len;
+    _bytes_speed = _speed.getSpeed();
+    if (!_segment_tasks.empty() && _segment_tasks.front() == task) {
+        //按顺序轮到该切片，边下载边解析
+        onPacket_l(data, len);
+    } else {
+        //前面的切片还未下载完毕
+        task->cache.append(data, len);
+    }
+}
+
+void HlsPlayer::onSegmentCompleted(const SegmentTask::Ptr &task, bool success) {
+    if (task->completed) {
+        return;
+    }
+    task->completed = true;
+    _last_fetch_ms = task->ticker.elapsedTime();
+    ++_total_segments;
+    auto fetcher = task->fetcher;
+    task->fetcher = nullptr;
+    fetcher->setOnPacket(nullptr);
+    fetcher->setOnComplete(nullptr);
+    if (success) {
+        weak_ptr<HlsPlayer> weakSelf = dynamic_pointer_cast<HlsPlayer>(shared_from_this());
+        weak_ptr<HttpTSPlayer> weakFetcher = fetcher;
+        //空闲时被服务器断开或超时，则不再复用
+        fetcher->setOnDisconnect([weakSelf, weakFetcher](const SockException &ex) {
+            auto strongSelf = weakSelf.lock();
+            auto strongFetcher = weakFetcher.lock();
+            if (strongSelf && strongFetcher) {
+                strongSelf->_idle_fetchers.remove(strongFetcher);
+            }
+        });
+        _idle_fetchers.emplace_back(std::move(fetcher));
+    } else {
+        //下载失败，跳过该切片；HttpClient回调中不能直接释放对象，所以切换线程释放
+        ++_failed_segments;
+        WarnL << "下载ts切片失败:" << task->ts.url;
+        getPoller()->async([fetcher]() {}, false);
+    }
+
+    //按顺序解析已经下载完毕的切片
+    while (!_segment_tasks.empty() && _segment_tasks.front()->completed) {
+        _segment_tasks.pop_front();
+        if (!_segment_tasks.empty()) {
+            auto &head = _segment_tasks.front();
+            if (!head->cache.empty()) {
+                onPacket_l(head->cache.data(), head->cache.size());
+                head->cache.clear();
+                head->cache.shrink_to_fit();
+            }
         }
-        //收到ts包
-        strongSelf->onPacket_l(data, len);
-    });
+    }
 
-    _http_ts_player->setMethod("GET");
-    if (!(*this)[kNetAdapter].empty()) {
-        _http_ts_player->setNetAdapter((*this)[Client::kNetAdapter]);
+    int64_t delay_ms = 0;
+    if (!isLive()) {
+        //点播时下一个切片慢点下载
+        delay_ms = task->ts.duration * 1000 - 500 - task->ticker.elapsedTime();
     }
+    playNextTsDelay(delay_ms);
+}
 
-    _http_ts_player->sendRequest(_ts_list.front().url, 2 * _ts_list.front().duration);
-    _ts_list.pop_front();
+void HlsPlayer::updatePendingMS() {
+    float pending = 0;
+    for (auto &ts : _ts_list) {
+        pending += ts.duration;
+    }
+    for (auto &task : _segment_tasks) {
+        pending += task->ts.duration;
+    }
+    _pending_ms = pending * 1000;
+}
+
+map<string, int64_t> HlsPlayer::getPullStat() const {
+    map<string, int64_t> ret;
+    ret["pendingMS"] = _pending_ms;
+    ret["bytesSpeed"] = _bytes_speed;
+    ret["totalBytes"] = _total_bytes;
+    ret["totalSegments"] = _total_segments;
+    ret["failedSegments"] = _failed_segments;
+    ret["lastSegmentMS"] = _last_fetch_ms;
+    ret["lastM3u8MS"] = _last_m3u8_ms;
+    return ret;
 }
 
 void HlsPlayer::onParsed(bool is_m3u8_inner,int64_t sequence,const map<int,ts_segment> &ts_map){
@@ -119,6 +228,7 @@ void HlsPlayer::onParsed(bool is_m3u8_inner,int64_t sequence,const map<int,ts_se
             return;
         }
         _last_sequence = sequence;
+        _m3u8_changed = true;
         for (auto &pr : ts_map) {
             auto &ts = pr.second;
             if (_ts_url_cache.emplace(ts.url).second) {
@@ -173,8 +283,10 @@ void HlsPlayer::onResponseBody(const char *buf, int64_t size, int64_t recvedSize
 }
 
 void HlsPlayer::onResponseCompleted() {
+    _last_m3u8_ms = _m3u8_ticker.elapsedTime();
+    _m3u8_changed = false;
     if (HlsParser::parse(getUrl(), _m3u8)) {
-        playDelay();
+        playDelay(_m3u8_changed);
         if (_first) {
             _first = false;
             onPlayResult(SockException(Err_success, "play success"));
@@ -221,9 +333,13 @@ bool HlsPlayer::onRedirectUrl(const string &url,bool temporary) {
     return true;
 }
 
-void HlsPlayer::playDelay(){
+void HlsPlayer::playDelay(bool changed){
+    //m3u8未更新时，按照rfc8216，以切片时长的一半重试
+    auto delay_ms = (int64_t) (delaySecond() * (changed ? 1000 : 500));
+    //刷新间隔从上次请求开始时算起，避免高延时链路下刷新周期被拉长
+    delay_ms -= _m3u8_ticker.elapsedTime();
     weak_ptr<HlsPlayer> weakSelf = dynamic_pointer_cast<HlsPlayer>(shared_from_this());
-    _timer.reset(new Timer(delaySecond(), [weakSelf]() {
+    _timer.reset(new Timer(MAX(delay_ms, 50) / 1000.0, [weakSelf]() {
         auto strongSelf = weakSelf.lock();
         if (strongSelf) {
             strongSelf->play_l();
@@ -314,15 +430,23 @@ void HlsPlayerImp::inputFrame(const Frame::Ptr &frame) {
     }
 }
 
+map<string, int64_t> HlsPlayerImp::getPullStat() const {
+    auto ret = PlayerImp<HlsPlayer, PlayerBase>::getPullStat();
+    ret["bufferMS"] = _buffer_ms;
+    return ret;
+}
+
 int64_t HlsPlayerImp::getPlayPosition(){
     return _ticker.elapsedTime() + _ticker_offset;
 }
 
 int64_t HlsPlayerImp::getBufferMS(){
     if(_frame_cache.empty()){
+        _buffer_ms = 0;
         return 0;
     }
-    return _frame_cache.rbegin()->first - _frame_cache.begin()->first;
+    _buffer_ms = _frame_cache.rbegin()->first - _frame_cache.begin()->first;
+    return _buffer_ms;
 }
 
 void HlsPlayerImp::setPlayPosition(int64_t pos){
@@ -11,6 +11,8 @@
 #ifndef HTTP_HLSPLAYER_H
 #define HTTP_HLSPLAYER_H
 
+#include <deque>
+#include <atomic>
 #include <unordered_set>
 #include "Util/util.h"
 #include "Poller/Timer.h"
@@ -40,6 +42,11 @@ public:
      */
     void teardown() override;
 
+    /**
+     * 获取拉流统计，包括未下载的切片时长、下载速度等
+     */
+    map<string, int64_t> getPullStat() const override;
+
 protected:
     /**
      * 收到ts包
@@ -93,12 +100,29 @@ private:
     bool onRedirectUrl(const string &url,bool temporary) override;
 
 private:
-    void playDelay();
+    //正在下载的ts切片
+    class SegmentTask {
+    public:
+        typedef std::shared_ptr<SegmentTask> Ptr;
+        ts_segment ts;
+        bool completed = false;
+        //未轮到解析时先缓存收到的数据
+        string cache;
+        Ticker ticker;
+        HttpTSPlayer::Ptr fetcher;
+    };
+
+    void playDelay(bool changed = true);
     float delaySecond();
-    void playNextTs(bool force = false);
+    void playNextTs();
+    void playNextTsDelay(int64_t delay_ms);
     void teardown_l(const SockException &ex);
     void play_l();
     void onPacket_l(const char *data, uint64_t len);
+    HttpTSPlayer::Ptr obtainFetcher();
+    void onSegmentPacket(const SegmentTask::Ptr &task, const char *data, uint64_t len);
+    void onSegmentCompleted(const SegmentTask::Ptr &task, bool success);
+    void updatePendingMS();
 
 private:
     struct UrlComp {
@@ -111,16 +135,32 @@ private:
 private:
     bool _is_m3u8 = false;
     bool _first = true;
+    bool _m3u8_changed = false;
     int64_t _last_sequence = -1;
     string _m3u8;
+    //m3u8请求开始后计时，刷新间隔从请求开始算起，不累加下载耗时
+    Ticker _m3u8_ticker;
     Timer::Ptr _timer;
     Timer::Ptr _timer_ts;
     list<ts_segment> _ts_list;
     list<string> _ts_url_sort;
     list<string> _m3u8_list;
     set<string, UrlComp> _ts_url_cache;
-    HttpTSPlayer::Ptr _http_ts_player;
+    //按m3u8中的顺序排列，只有第一个切片的数据直接解析
+    deque<SegmentTask::Ptr> _segment_tasks;
+    //空闲的keep-alive下载连接
+    list<HttpTSPlayer::Ptr> _idle_fetchers;
     TSSegment _segment;
+
+    //以下统计可能被其他线程读取
+    BytesSpeed _speed;
+    atomic<int64_t> _bytes_speed{0};
+    atomic<uint64_t> _total_bytes{0};
+    atomic<uint64_t> _total_segments{0};
+    atomic<uint64_t> _failed_segments{0};
+    atomic<int64_t> _pending_ms{0};
+    atomic<int64_t> _last_fetch_ms{0};
+    atomic<int64_t> _last_m3u8_ms{0};
 };
 
 class HlsPlayerImp : public PlayerImp<HlsPlayer, PlayerBase> , public MediaSink{
@@ -142,6 +182,7 @@ private:
     int64_t getPlayPosition();
     void setPlayPosition(int64_t pos);
     int64_t getBufferMS();
+    map<string, int64_t> getPullStat() const override;
 
 private:
     int64_t _ticker_offset = 0;
@@ -151,6 +192,8 @@ private:
     DecoderImp::Ptr _decoder;
     TSSegment::onSegment _on_ts;
     multimap<int64_t, Frame::Ptr> _frame_cache;
+    //缓存时长，可能被其他线程读取
+    atomic<int64_t> _buffer_ms{0};
 };
 
 }//namespace mediakit 
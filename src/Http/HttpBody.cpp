@@ -14,6 +14,9 @@
 #include "Util/logger.h"
 #include "HttpClient.h"
 #ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
 #endif
 
@@ -21,6 +24,11 @@
 #define ENABLE_MMAP
 #endif
 
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#define ENABLE_SENDFILE
+#endif
+
 namespace mediakit {
 
 HttpStringBody::HttpStringBody(const string &str){
@@ -41,6 +49,76 @@ Buffer::Ptr HttpStringBody::readData(uint32_t size) {
     return ret;
 }
 
+//////////////////////////////////////////////////////////////////
+//引用原Buffer的一部分，不拷贝数据
+class HttpBufferSlice : public Buffer {
+public:
+    HttpBufferSlice(const Buffer::Ptr &buffer, uint64_t offset, uint32_t size){
+        _buffer = buffer;
+        _data = buffer->data() + offset;
+        _size = size;
+    }
+    ~HttpBufferSlice() override{}
+    char *data() const override {
+        return _data;
+    }
+    uint32_t size() const override{
+        return _size;
+    }
+private:
+    char *_data;
+    uint32_t _size;
+    Buffer::Ptr _buffer;
+};
+
+HttpBufferBody::HttpBufferBody(const Buffer::Ptr &buffer){
+    _buffer = buffer;
+}
+
+uint64_t HttpBufferBody::remainSize() {
+    return _buffer ? _buffer->size() - _offset : 0;
+}
+
+Buffer::Ptr HttpBufferBody::readData(uint32_t size) {
+    size = MIN(remainSize(),size);
+    if(!size){
+        //没有剩余字节了
+        return nullptr;
+    }
+    auto ret = std::make_shared<HttpBufferSlice>(_buffer, _offset, size);
+    _offset += size;
+    return ret;
+}
+
+//////////////////////////////////////////////////////////////////
+HttpBufferListBody::HttpBufferListBody(List<Buffer::Ptr> buffers) : _buffers(std::move(buffers)){
+    _buffers.for_each([&](const Buffer::Ptr &buffer){
+        _remain += buffer->size();
+    });
+}
+
+uint64_t HttpBufferListBody::remainSize() {
+    return _remain;
+}
+
+Buffer::Ptr HttpBufferListBody::readData(uint32_t size) {
+    while (!_buffers.empty() && _offset >= _buffers.front()->size()) {
+        //当前Buffer已读完
+        _buffers.pop_front();
+        _offset = 0;
+    }
+    if (_buffers.empty() || !size) {
+        //没有剩余字节了
+        return nullptr;
+    }
+    auto &buffer = _buffers.front();
+    size = MIN(buffer->size() - _offset, size);
+    auto ret = std::make_shared<HttpBufferSlice>(buffer, _offset, size);
+    _offset += size;
+    _remain -= size;
+    return ret;
+}
+
 //////////////////////////////////////////////////////////////////
 HttpFileBody::HttpFileBody(const string &filePath){
     std::shared_ptr<FILE> fp(fopen(filePath.data(), "rb"), [](FILE *fp) {
@@ -59,9 +137,20 @@ HttpFileBody::HttpFileBody(const std::shared_ptr<FILE> &fp, uint64_t offset, uin
     init(fp,offset,max_size);
 }
 
+HttpFileBody::HttpFileBody(const HttpCachedFile::Ptr &file, uint64_t offset, uint64_t max_size) {
+    _file = file;
+    _max_size = max_size;
+    _start = offset;
+    _prefetch_end = offset;
+    //与文件缓存共享内存，指向偏移量处
+    _map_addr = std::shared_ptr<char>(file->getData(), file->getData().get() + offset);
+}
+
 void HttpFileBody::init(const std::shared_ptr<FILE> &fp,uint64_t offset,uint64_t max_size){
     _fp = fp;
     _max_size = max_size;
+    _start = offset;
+    _prefetch_end = offset;
 #ifdef ENABLE_MMAP
     do {
         if(!_fp){
@@ -149,6 +238,126 @@ Buffer::Ptr HttpFileBody::readData(uint32_t size) {
     return ret;
 }
 
+//sendfile模式每次预读的字节数，已预读的数据不足一半时开始下一次预读
+static constexpr uint64_t kReadAheadSize = 1024 * 1024;
+
+int HttpFileBody::getFileFd() const {
+    if (_file) {
+        //小文件已拷贝至内存，fd为-1
+        return _file->getFd();
+    }
+    return _fp ? fileno(_fp.get()) : -1;
+}
+
+bool HttpFileBody::sendFileAble() {
+#if defined(ENABLE_SENDFILE)
+    return getFileFd() != -1;
+#else
+    return false;
+#endif
+}
+
+bool HttpFileBody::isResident(uint64_t offset, uint64_t size) const {
+#if defined(ENABLE_SENDFILE)
+    if (!_file) {
+        return false;
+    }
+    //文件缓存映射了整个文件，通过mincore判断是否在page cache中
+    static auto page_size = sysconf(_SC_PAGESIZE);
+    auto start = offset & ~(page_size - 1);
+    auto len = offset + size - start;
+    vector<unsigned char> vec((len + page_size - 1) / page_size);
+    if (mincore(_file->getData().get() + start, len, vec.data()) != 0) {
+        return false;
+    }
+    for (auto flag : vec) {
+        if (!(flag & 0x01)) {
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HttpFileBody::prefetch(uint64_t offset, uint64_t size, const function<void()> &on_ready) {
+#if defined(ENABLE_SENDFILE)
+    auto self = static_pointer_cast<HttpFileBody>(shared_from_this());
+    WorkThreadPool::Instance().getPoller()->async([self, offset, size, on_ready]() {
+        int fd = self->getFileFd();
+        //先提示内核异步读取整个区间，再逐页访问等待读取完毕
+        posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+        static auto page_size = sysconf(_SC_PAGESIZE);
+        auto start = offset & ~(page_size - 1);
+        auto len = offset + size - start;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (uint64_t) st.st_size >= offset + size) {
+            //文件未被截断才访问，否则访问映射会触发SIGBUS
+            auto ptr = (char *) mmap(NULL, len, PROT_READ, MAP_SHARED, fd, start);
+            if (ptr != MAP_FAILED) {
+                volatile char sum = 0;
+                for (uint64_t i = 0; i < len; i += page_size) {
+                    sum += ptr[i];
+                }
+                munmap(ptr, len);
+            }
+        }
+        self->_prefetch_end = offset + size;
+        self->_prefetching = false;
+        if (self->_waiting.exchange(false)) {
+            on_ready();
+        }
+    }, false);
+#endif
+}
+
+int HttpFileBody::sendFile(int fd, const function<void()> &on_ready) {
+#if defined(ENABLE_SENDFILE)
+    auto end = _start + _max_size;
+    while (true) {
+        auto pos = _start + _offset;
+        uint64_t ready_end = _prefetch_end;
+        if (ready_end - pos < kReadAheadSize / 2 && ready_end < end && !_prefetching.exchange(true)) {
+            auto size = MIN(kReadAheadSize, end - ready_end);
+            if (isResident(ready_end, size)) {
+                //已经在page cache中，不需要预读
+                _prefetch_end = ready_end + size;
+                _prefetching = false;
+                continue;
+            }
+            prefetch(ready_end, size, on_ready);
+        }
+
+        if (ready_end > pos) {
+            off_t off = pos;
+            ssize_t ret;
+            do {
+                ret = ::sendfile(fd, getFileFd(), &off, ready_end - pos);
+            } while (-1 == ret && UV_EINTR == get_uv_error(true));
+            if (ret == 0) {
+                //文件被截断，真实长度小于声明长度
+                WarnL << "sendfile reached end of file unexpectedly";
+                errno = EIO;
+                return -1;
+            }
+            if (ret > 0) {
+                _offset += ret;
+            }
+            return ret;
+        }
+
+        //没有已预读的数据，等待后台线程预读完成
+        _waiting = true;
+        if (_prefetch_end == ready_end || !_waiting.exchange(false)) {
+            return 0;
+        }
+    }
+#else
+    return -1;
+#endif
+}
+
 //////////////////////////////////////////////////////////////////
 HttpMultiFormBody::HttpMultiFormBody(const HttpArgs &args,const string &filePath,const string &boundary){
     std::shared_ptr<FILE> fp(fopen(filePath.data(), "rb"), [](FILE *fp) {
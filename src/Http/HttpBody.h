@@ -13,10 +13,12 @@
 
 #include <stdlib.h>
 #include <memory>
+#include <atomic>
 #include "Network/Buffer.h"
 #include "Util/ResourcePool.h"
 #include "Util/logger.h"
 #include "Thread/WorkThreadPool.h"
+#include "HttpFileCache.h"
 
 using namespace std;
 using namespace toolkit;
@@ -77,6 +79,19 @@ public:
         cb(readData(size));
 #endif
     }
+
+    /**
+     * 是否支持通过sendFile直接把文件写入socket
+     */
+    virtual bool sendFileAble() { return false; }
+
+    /**
+     * 通过sendfile把文件直接写入socket，只发送已在page cache中的部分，不会阻塞在磁盘io上
+     * @param fd socket fd
+     * @param on_ready 没有可发送的数据时，在后台线程预读文件，预读完成后在后台线程触发该回调
+     * @return 发送的字节数，0代表等待预读完成，-1代表发送失败(包括EAGAIN)
+     */
+    virtual int sendFile(int fd, const function<void()> &on_ready) { return -1; }
 private:
 //    EventPoller::Ptr _async_read_thread;
 };
@@ -96,6 +111,37 @@ private:
     uint64_t _offset = 0;
 };
 
+/**
+ * Buffer类型的content，多个请求可共享同一个Buffer
+ */
+class HttpBufferBody : public HttpBody{
+public:
+    typedef std::shared_ptr<HttpBufferBody> Ptr;
+    HttpBufferBody(const Buffer::Ptr &buffer);
+    ~HttpBufferBody() override {}
+    uint64_t remainSize() override ;
+    Buffer::Ptr readData(uint32_t size) override ;
+private:
+    Buffer::Ptr _buffer;
+    uint64_t _offset = 0;
+};
+
+/**
+ * 多个Buffer依次拼接而成的content，用于边生成边分块缓存的大body，避免合并为一整块内存
+ */
+class HttpBufferListBody : public HttpBody{
+public:
+    typedef std::shared_ptr<HttpBufferListBody> Ptr;
+    HttpBufferListBody(List<Buffer::Ptr> buffers);
+    ~HttpBufferListBody() override {}
+    uint64_t remainSize() override ;
+    Buffer::Ptr readData(uint32_t size) override ;
+private:
+    List<Buffer::Ptr> _buffers;
+    uint64_t _remain = 0;
+    uint64_t _offset = 0;
+};
+
 /**
  * 文件类型的content
  */
@@ -111,17 +157,37 @@ public:
      */
     HttpFileBody(const std::shared_ptr<FILE> &fp,uint64_t offset,uint64_t max_size);
     HttpFileBody(const string &file_path);
+
+    /**
+     * 通过缓存的文件构造，共享文件缓存的内存或mmap映射
+     * @param file 缓存的文件
+     * @param offset 相对文件头的偏移量
+     * @param max_size 最大读取字节数，不能超过文件大小减去偏移量
+     */
+    HttpFileBody(const HttpCachedFile::Ptr &file, uint64_t offset, uint64_t max_size);
     ~HttpFileBody(){};
 
     uint64_t remainSize() override ;
     Buffer::Ptr readData(uint32_t size) override;
+    bool sendFileAble() override;
+    int sendFile(int fd, const function<void()> &on_ready) override;
 private:
     void init(const std::shared_ptr<FILE> &fp,uint64_t offset,uint64_t max_size);
+    int getFileFd() const;
+    bool isResident(uint64_t offset, uint64_t size) const;
+    void prefetch(uint64_t offset, uint64_t size, const function<void()> &on_ready);
 private:
     std::shared_ptr<FILE> _fp;
     uint64_t _max_size;
     uint64_t _offset = 0;
+    //相对文件头的起始偏移量
+    uint64_t _start = 0;
     std::shared_ptr<char> _map_addr;
+    HttpCachedFile::Ptr _file;
+    //sendfile模式下已预读至page cache的文件偏移量
+    atomic<uint64_t> _prefetch_end{0};
+    atomic<bool> _prefetching{false};
+    atomic<bool> _waiting{false};
     ResourcePool<BufferRaw> _pool;
 };
 
@@ -73,9 +73,21 @@ string HttpServerCookie::cookieExpireTime() const{
 //////////////////////////////CookieManager////////////////////////////////////
 INSTANCE_IMP(HttpCookieManager);
 
+//分片个数
+static constexpr size_t kShardCount = 64;
+//时间轮槽位间隔，单位秒，同时为清理过期cookie的定时器间隔
+static constexpr uint64_t kWheelTickSecond = 10;
+//时间轮槽位个数，剩余时间超过一圈的cookie到期前会被重新检查并放回时间轮
+static constexpr uint32_t kWheelSlots = 64;
+
 HttpCookieManager::HttpCookieManager() {
+    for (size_t i = 0; i < kShardCount; ++i) {
+        _cookie_shards.emplace_back(new CookieShard);
+        _cookie_shards.back()->wheel.resize(kWheelSlots);
+        _uid_shards.emplace_back(new UidShard);
+    }
     //定时删除过期的cookie，防止内存膨胀
-    _timer = std::make_shared<Timer>(10,[this](){
+    _timer = std::make_shared<Timer>(kWheelTickSecond,[this](){
         onManager();
         return true;
     }, nullptr);
@@ -85,51 +97,116 @@ HttpCookieManager::~HttpCookieManager() {
     _timer.reset();
 }
 
+HttpCookieManager::CookieShard &HttpCookieManager::getCookieShard(const string &cookie) {
+    return *_cookie_shards[std::hash<string>()(cookie) % kShardCount];
+}
+
+HttpCookieManager::UidShard &HttpCookieManager::getUidShard(const string &uid) {
+    return *_uid_shards[std::hash<string>()(uid) % kShardCount];
+}
+
+void HttpCookieManager::addToWheel_l(CookieShard &shard, const HttpServerCookie::Ptr &cookie) {
+    auto elapsed = cookie->_ticker.elapsedTime();
+    auto life = cookie->_max_elapsed * 1000;
+    auto remain = life > elapsed ? life - elapsed : 0;
+    //至少在下一个槽位检查，最多一圈
+    auto steps = MIN(MAX((remain + kWheelTickSecond * 1000 - 1) / (kWheelTickSecond * 1000), 1), kWheelSlots - 1);
+    shard.wheel[(shard.wheel_pos + steps) % kWheelSlots].emplace_back(cookie);
+}
+
+void HttpCookieManager::onManager_l(CookieShard &shard, vector<HttpServerCookie::Ptr> &expired) {
+    shard.wheel_pos = (shard.wheel_pos + 1) % kWheelSlots;
+    vector<std::weak_ptr<HttpServerCookie> > slot;
+    slot.swap(shard.wheel[shard.wheel_pos]);
+    for (auto &weak_cookie : slot) {
+        auto cookie = weak_cookie.lock();
+        if (!cookie) {
+            //cookie已经释放
+            continue;
+        }
+        auto it_name = shard.map_cookie.find(cookie->getCookieName());
+        if (it_name == shard.map_cookie.end()) {
+            continue;
+        }
+        auto it_cookie = it_name->second.find(cookie->getCookie());
+        if (it_cookie == it_name->second.end() || it_cookie->second != cookie) {
+            //cookie已经被删除
+            continue;
+        }
+        if (!cookie->isExpired()) {
+            //期间刷新过过期时间或剩余时间超过一圈，重新放回时间轮
+            addToWheel_l(shard, cookie);
+            continue;
+        }
+        //cookie过期,移除记录
+        expired.emplace_back(std::move(it_cookie->second));
+        it_name->second.erase(it_cookie);
+        if (it_name->second.empty()) {
+            //该类型下没有任何cooki记录,移除之
+            shard.map_cookie.erase(it_name);
+        }
+    }
+}
+
 void HttpCookieManager::onManager() {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    //先遍历所有类型
-    for(auto it_name = _map_cookie.begin() ; it_name != _map_cookie.end() ;){
-        //再遍历该类型下的所有cookie
-        for (auto it_cookie = it_name->second.begin() ; it_cookie != it_name->second.end() ; ){
-            if(it_cookie->second->isExpired()){
-                //cookie过期,移除记录
-                DebugL << it_cookie->second->getUid() << " cookie过期:" << it_cookie->second->getCookie();
-                it_cookie = it_name->second.erase(it_cookie);
-                continue;
-            }
-            ++it_cookie;
+    size_t count = 0;
+    for (auto &shard : _cookie_shards) {
+        vector<HttpServerCookie::Ptr> expired;
+        {
+            lock_guard<recursive_mutex> lck(shard->mtx);
+            onManager_l(*shard, expired);
         }
+        count += expired.size();
+        //在分片锁外析构cookie
+    }
+    if (count) {
+        DebugL << "移除过期cookie个数:" << count;
+    }
+}
 
-        if(it_name->second.empty()){
-            //该类型下没有任何cooki记录,移除之
-            DebugL << "该path下没有任何cooki记录:" << it_name->first;
-            it_name = _map_cookie.erase(it_name);
-            continue;
+string HttpCookieManager::obtainCookie() {
+    //获取唯一的防膨胀的随机字符串
+    while (true) {
+        auto str = _geneator.obtain();
+        auto &shard = getCookieShard(str);
+        lock_guard<recursive_mutex> lck(shard.mtx);
+        if (shard.obtained.emplace(str).second) {
+            //没有重复
+            return str;
         }
-        ++it_name;
     }
 }
 
 HttpServerCookie::Ptr HttpCookieManager::addCookie(const string &cookie_name,const string &uidIn,uint64_t max_elapsed,int max_client) {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto cookie = _geneator.obtain();
+    auto cookie = obtainCookie();
     auto uid = uidIn.empty() ? cookie : uidIn;
-    auto oldCookie = getOldestCookie(cookie_name , uid, max_client);
-    if(!oldCookie.empty()){
-        //假如该账号已经登录了，那么删除老的cookie。
-        //目的是实现单账号多地登录时挤占登录
-        delCookie(cookie_name,oldCookie);
+    HttpServerCookie::Ptr data;
+    {
+        //锁定uid分片，保证同一账号下的挤占登录判断与新cookie登记是原子的
+        auto &uid_shard = getUidShard(uid);
+        lock_guard<recursive_mutex> lck(uid_shard.mtx);
+        auto oldCookie = getOldestCookie(cookie_name , uid, max_client);
+        if(!oldCookie.empty()){
+            //假如该账号已经登录了，那么删除老的cookie。
+            //目的是实现单账号多地登录时挤占登录
+            delCookie(cookie_name,oldCookie);
+        }
+        data.reset(new HttpServerCookie(shared_from_this(),cookie_name,uid,cookie,max_elapsed));
     }
-    HttpServerCookie::Ptr data(new HttpServerCookie(shared_from_this(),cookie_name,uid,cookie,max_elapsed));
     //保存该账号下的新cookie
-    _map_cookie[cookie_name][cookie] = data;
+    auto &shard = getCookieShard(cookie);
+    lock_guard<recursive_mutex> lck(shard.mtx);
+    shard.map_cookie[cookie_name][cookie] = data;
+    addToWheel_l(shard, data);
     return data;
 }
 
 HttpServerCookie::Ptr HttpCookieManager::getCookie(const string &cookie_name,const string &cookie) {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto it_name = _map_cookie.find(cookie_name);
-    if(it_name == _map_cookie.end()){
+    HttpServerCookie::Ptr expired;
+    auto &shard = getCookieShard(cookie);
+    lock_guard<recursive_mutex> lck(shard.mtx);
+    auto it_name = shard.map_cookie.find(cookie_name);
+    if(it_name == shard.map_cookie.end()){
         //不存在该类型的cookie
         return nullptr;
     }
@@ -139,14 +216,14 @@ HttpServerCookie::Ptr HttpCookieManager::getCookie(const string &cookie_name,con
         return nullptr;
     }
     if(it_cookie->second->isExpired()){
-        //cookie过期
+        //cookie过期，在分片锁释放后析构(expired在lck之前声明)
         DebugL << "cookie过期:" << it_cookie->second->getCookie();
+        expired = std::move(it_cookie->second);
         it_name->second.erase(it_cookie);
         return nullptr;
     }
     return it_cookie->second;
 }
-
 HttpServerCookie::Ptr HttpCookieManager::getCookie(const string &cookie_name,const StrCaseMap &http_header) {
     auto it = http_header.find("Cookie");
     if (it == http_header.end()) {
@@ -181,27 +258,43 @@ bool HttpCookieManager::delCookie(const HttpServerCookie::Ptr &cookie) {
 }
 
 bool HttpCookieManager::delCookie(const string &cookie_name,const string &cookie) {
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto it_name = _map_cookie.find(cookie_name);
-    if(it_name == _map_cookie.end()){
+    HttpServerCookie::Ptr removed;
+    auto &shard = getCookieShard(cookie);
+    lock_guard<recursive_mutex> lck(shard.mtx);
+    auto it_name = shard.map_cookie.find(cookie_name);
+    if(it_name == shard.map_cookie.end()){
         return false;
     }
-    return it_name->second.erase(cookie);
+    auto it_cookie = it_name->second.find(cookie);
+    if(it_cookie == it_name->second.end()){
+        return false;
+    }
+    //在分片锁释放后析构
+    removed = std::move(it_cookie->second);
+    it_name->second.erase(it_cookie);
+    return true;
 }
 
 void HttpCookieManager::onAddCookie(const string &cookie_name,const string &uid,const string &cookie){
     //添加新的cookie，我们记录下这个uid下有哪些cookie，目的是实现单账号多地登录时挤占登录
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
+    auto &shard = getUidShard(uid);
+    lock_guard<recursive_mutex> lck(shard.mtx);
     //相同用户下可以存在多个cookie(意味多地登录)，这些cookie根据登录时间的早晚依次排序
-    _map_uid_to_cookie[cookie_name][uid][getCurrentMillisecond()] = cookie;
+    shard.map_uid_to_cookie[cookie_name][uid][getCurrentMillisecond()] = cookie;
 }
+
 void HttpCookieManager::onDelCookie(const string &cookie_name,const string &uid,const string &cookie){
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    //回收随机字符串
-    _geneator.release(cookie);
+    {
+        //回收随机字符串
+        auto &shard = getCookieShard(cookie);
+        lock_guard<recursive_mutex> lck(shard.mtx);
+        shard.obtained.erase(cookie);
+    }
 
-    auto it_name = _map_uid_to_cookie.find(cookie_name);
-    if(it_name == _map_uid_to_cookie.end()){
+    auto &shard = getUidShard(uid);
+    lock_guard<recursive_mutex> lck(shard.mtx);
+    auto it_name = shard.map_uid_to_cookie.find(cookie_name);
+    if(it_name == shard.map_uid_to_cookie.end()){
         //该类型下未有任意用户登录
         return;
     }
@@ -231,16 +324,17 @@ void HttpCookieManager::onDelCookie(const string &cookie_name,const string &uid,
             break;
         }
         //该类型下未有任何用户在线，移除之
-        _map_uid_to_cookie.erase(it_name);
+        shard.map_uid_to_cookie.erase(it_name);
         break;
     }
 
 }
 
 string HttpCookieManager::getOldestCookie(const string &cookie_name,const string &uid, int max_client){
-    lock_guard<recursive_mutex> lck(_mtx_cookie);
-    auto it_name = _map_uid_to_cookie.find(cookie_name);
-    if(it_name == _map_uid_to_cookie.end()){
+    auto &shard = getUidShard(uid);
+    lock_guard<recursive_mutex> lck(shard.mtx);
+    auto it_name = shard.map_uid_to_cookie.find(cookie_name);
+    if(it_name == shard.map_uid_to_cookie.end()){
         //不存在该类型的cookie
         return "";
     }
@@ -259,26 +353,10 @@ string HttpCookieManager::getOldestCookie(const string &cookie_name,const string
 
 /////////////////////////////////RandStrGeneator////////////////////////////////////
 string RandStrGeneator::obtain(){
-    //获取唯一的防膨胀的随机字符串
-    while (true){
-        auto str = obtain_l();
-        if(_obtained.find(str) == _obtained.end()){
-            //没有重复
-            _obtained.emplace(str);
-            return str;
-        }
-    }
-}
-void RandStrGeneator::release(const string &str){
-    //从防膨胀库中移除
-    _obtained.erase(str);
-}
-
-string RandStrGeneator::obtain_l(){
     //12个伪随机字节 + 4个递增的整形字节，然后md5即为随机字符串
     auto str = makeRandStr(12,false);
-    str.append((char *)&_index, sizeof(_index));
-    ++_index;
+    auto index = _index++;
+    str.append((char *)&index, sizeof(index));
     return MD5(str).hexdigest();
 }
 
@@ -11,8 +11,13 @@
 #ifndef SRC_HTTP_COOKIEMANAGER_H
 #define SRC_HTTP_COOKIEMANAGER_H
 
+#include <mutex>
+#include <atomic>
 #include <memory>
+#include <map>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include "Util/mini.h"
 #include "Util/util.h"
 #include "Util/TimeTicker.h"
@@ -94,6 +99,7 @@ public:
      */
     std::shared_ptr<lock_guard<recursive_mutex> > getLock();
 private:
+    friend class HttpCookieManager;
     string cookieExpireTime() const ;
 private:
     string _uid;
@@ -106,7 +112,7 @@ private:
 };
 
 /**
- * cookie随机字符串生成器
+ * cookie随机字符串生成器，线程安全
  */
 class RandStrGeneator{
 public:
@@ -114,28 +120,20 @@ public:
     ~RandStrGeneator() = default;
 
     /**
-     * 获取不碰撞的随机字符串
+     * 获取随机字符串，是否与在用的字符串碰撞由调用者判断
      * @return 随机字符串
      */
     string obtain();
-
-    /**
-     * 释放随机字符串
-     * @param str 随机字符串
-     */
-    void release(const string &str);
-private:
-    string obtain_l();
 private:
-    //碰撞库
-    unordered_set<string> _obtained;
     //增长index，防止碰撞用
-    int _index = 0;
+    atomic<uint32_t> _index{0};
 };
 
 /**
  * cookie管理器，用于管理cookie的生成以及过期管理，同时实现了同账号异地挤占登录功能
  * 该对象实现了同账号最多登录若干个设备
+ * cookie按随机字符串的hash分片存储，uid索引按uid的hash分片存储，查找与增删只锁定所在分片；
+ * 每个分片各有一个时间轮，清理过期cookie时逐个分片处理到期的槽位，无全局锁
  */
 class HttpCookieManager : public std::enable_shared_from_this<HttpCookieManager> {
 public:
@@ -223,10 +221,46 @@ private:
      * @return 成功true
      */
     bool delCookie(const string &cookie_name,const string &cookie);
+
+    /**
+     * 获取不碰撞的随机字符串
+     */
+    string obtainCookie();
+
+private:
+    struct CookieShard {
+        //cookie析构时会锁定uid分片，所以不能在持有本锁时释放cookie对象
+        recursive_mutex mtx;
+        unordered_map<string/*cookie_name*/,unordered_map<string/*cookie*/,HttpServerCookie::Ptr/*cookie_data*/> > map_cookie;
+        //碰撞库，cookie对象析构时移除
+        unordered_set<string> obtained;
+        //时间轮，每个槽位为到期时需要检查的cookie
+        uint32_t wheel_pos = 0;
+        vector<vector<std::weak_ptr<HttpServerCookie> > > wheel;
+    };
+
+    struct UidShard {
+        recursive_mutex mtx;
+        unordered_map<string/*cookie_name*/,unordered_map<string/*uid*/,map<uint64_t/*cookie time stamp*/,string/*cookie*/> > > map_uid_to_cookie;
+    };
+
+    CookieShard &getCookieShard(const string &cookie);
+    UidShard &getUidShard(const string &uid);
+
+    /**
+     * 把cookie加入时间轮，请在持有分片锁时调用
+     */
+    void addToWheel_l(CookieShard &shard, const HttpServerCookie::Ptr &cookie);
+
+    /**
+     * 处理一个分片时间轮的当前槽位
+     * @param expired 移除的cookie，在释放分片锁后析构
+     */
+    void onManager_l(CookieShard &shard, vector<HttpServerCookie::Ptr> &expired);
+
 private:
-    unordered_map<string/*cookie_name*/,unordered_map<string/*cookie*/,HttpServerCookie::Ptr/*cookie_data*/> >_map_cookie;
-    unordered_map<string/*cookie_name*/,unordered_map<string/*uid*/,map<uint64_t/*cookie time stamp*/,string/*cookie*/> > >_map_uid_to_cookie;
-    recursive_mutex _mtx_cookie;
+    vector<std::unique_ptr<CookieShard> > _cookie_shards;
+    vector<std::unique_ptr<UidShard> > _uid_shards;
     Timer::Ptr _timer;
     RandStrGeneator _geneator;
 };
@@ -0,0 +1,409 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "HttpFileCache.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+#include "Common/config.h"
+#include "Common/MediaMetrics.h"
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define ENABLE_INOTIFY
+#endif
+
+namespace mediakit {
+
+//不超过该大小的文件(例如m3u8)拷贝至内存，不占用fd，也不按页占用映射内存
+static constexpr uint64_t kSnapshotSize = 64 * 1024;
+
+#if defined(ENABLE_INOTIFY)
+//写入的文件关闭后才移除缓存；不监听IN_MODIFY，否则hls目录内正在写入的ts每次写入都会产生事件
+static constexpr uint32_t kWatchMask = IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                       IN_DELETE_SELF | IN_MOVE_SELF;
+#endif
+
+static int64_t getMtimeNS(const struct stat &st) {
+#if defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return st.st_mtime * 1000000000LL;
+#else
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+HttpCachedFile::~HttpCachedFile() {
+#ifndef _WIN32
+    if (_fd != -1) {
+        close(_fd);
+    }
+#endif
+}
+
+const string &HttpCachedFile::getPath() const {
+    return _path;
+}
+
+uint64_t HttpCachedFile::size() const {
+    return _size;
+}
+
+const std::shared_ptr<char> &HttpCachedFile::getData() const {
+    return _data;
+}
+
+int HttpCachedFile::getFd() const {
+    return _fd;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+HttpFileCache &HttpFileCache::Instance() {
+    //inotify事件回调引用了本对象，故不释放
+    static HttpFileCache *s_instance = new HttpFileCache;
+    return *s_instance;
+}
+
+HttpCachedFile::Ptr HttpFileCache::get(const string &path) {
+#if defined(_WIN32)
+    return nullptr;
+#else
+    GET_CONFIG(uint32_t, max_mb, Http::kFileCacheSize);
+    GET_CONFIG(uint32_t, max_count, Http::kFileCacheCount);
+    GET_CONFIG(uint32_t, ttl_ms, Http::kFileCacheTTLMS);
+
+    if (!max_mb || !max_count) {
+        //缓存已关闭(可能是热加载配置)
+        lock_guard<mutex> lck(_mtx);
+        clear_l();
+        return nullptr;
+    }
+    if (end_with(path, ".m3u8")) {
+        //直播m3u8每个切片都会重写，缓存只会返回过期的列表
+        return nullptr;
+    }
+    auto pos = path.rfind('/');
+    if (pos == string::npos) {
+        return nullptr;
+    }
+
+    auto &metrics = MediaMetrics::Instance();
+    uint64_t max_bytes = max_mb * 1024ULL * 1024ULL;
+    //目录保留末尾的'/'，inotify事件中的文件名直接拼接在后面
+    string dir = path.substr(0, pos + 1);
+    uint64_t seq = 0;
+    bool watched;
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto file = find_l(path, ttl_ms);
+        if (file) {
+            metrics.file_cache_hit.add();
+            return file;
+        }
+        //先监听目录再读取文件，防止读取后、监听前的修改被遗漏
+        watched = watch_l(dir, seq);
+    }
+
+    metrics.file_cache_miss.add();
+    auto file = loadFile(path, max_bytes / 4);
+
+    lock_guard<mutex> lck(_mtx);
+    if (!file) {
+        if (watched) {
+            unwatch_l(dir);
+        }
+        return nullptr;
+    }
+    file->_dir = dir;
+    file->_check_ms = getCurrentMillisecond();
+
+    if (watched) {
+        auto it = _dirs.find(dir);
+        if (it == _dirs.end() || it->second.seq != seq) {
+            //读取期间目录内有文件变化，本次读取的内容可能已过期，不加入缓存
+            unwatch_l(dir);
+            return file;
+        }
+        file->_watched = true;
+    }
+
+    auto it = _files.find(path);
+    if (it != _files.end()) {
+        //其他线程已经加载了该文件
+        if (watched) {
+            file->_watched = false;
+            unwatch_l(dir);
+        }
+        return it->second;
+    }
+    add_l(file, max_bytes, max_count);
+    return file;
+#endif
+}
+
+HttpCachedFile::Ptr HttpFileCache::peek(const string &path) {
+#if defined(_WIN32)
+    return nullptr;
+#else
+    GET_CONFIG(uint32_t, ttl_ms, Http::kFileCacheTTLMS);
+    lock_guard<mutex> lck(_mtx);
+    return find_l(path, ttl_ms);
+#endif
+}
+
+void HttpFileCache::clear() {
+    lock_guard<mutex> lck(_mtx);
+    clear_l();
+}
+
+HttpCachedFile::Ptr HttpFileCache::loadFile(const string &path, uint64_t max_file_size) {
+#if defined(_WIN32)
+    return nullptr;
+#else
+    int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t) st.st_size > max_file_size) {
+        close(fd);
+        return nullptr;
+    }
+
+    HttpCachedFile::Ptr file(new HttpCachedFile);
+    file->_path = path;
+    file->_size = st.st_size;
+    file->_dev = st.st_dev;
+    file->_ino = st.st_ino;
+    file->_mtime_ns = getMtimeNS(st);
+
+    if (file->_size <= kSnapshotSize) {
+        std::shared_ptr<char> data(new char[file->_size + 1], [](char *ptr) { delete[] ptr; });
+        uint64_t offset = 0;
+        while (offset < file->_size) {
+            auto ret = pread(fd, data.get() + offset, file->_size - offset, offset);
+            if (ret == -1 && get_uv_error(false) == UV_EINTR) {
+                continue;
+            }
+            if (ret <= 0) {
+                //文件被并发截断
+                break;
+            }
+            offset += ret;
+        }
+        close(fd);
+        file->_size = offset;
+        file->_data = std::move(data);
+        return file;
+    }
+
+    auto size = file->_size;
+    auto ptr = (char *) mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        WarnL << "mmap " << path << " failed:" << get_uv_errmsg(false);
+        close(fd);
+        return nullptr;
+    }
+    file->_data.reset(ptr, [size](char *ptr) {
+        munmap(ptr, size);
+    });
+    file->_fd = fd;
+    return file;
+#endif
+}
+
+HttpCachedFile::Ptr HttpFileCache::find_l(const string &path, uint64_t ttl_ms) {
+    auto it = _files.find(path);
+    if (it == _files.end()) {
+        return nullptr;
+    }
+    auto file = it->second;
+    if (!file->_watched) {
+        //未被inotify监听，超过ttl后重新校验(文件可能被修改或替换)
+        auto now = getCurrentMillisecond();
+        if (now - file->_check_ms >= ttl_ms) {
+            struct stat st;
+            if (stat(path.data(), &st) != 0 || (uint64_t) st.st_dev != file->_dev ||
+                (uint64_t) st.st_ino != file->_ino || (uint64_t) st.st_size != file->_size ||
+                getMtimeNS(st) != file->_mtime_ns) {
+                remove_l(file);
+                return nullptr;
+            }
+            file->_check_ms = now;
+        }
+    }
+    _lru.splice(_lru.begin(), _lru, file->_lru_it);
+    return file;
+}
+
+void HttpFileCache::add_l(const HttpCachedFile::Ptr &file, uint64_t max_bytes, uint64_t max_count) {
+    _lru.emplace_front(file);
+    file->_lru_it = _lru.begin();
+    _files.emplace(file->_path, file);
+    _bytes += file->_size;
+
+    auto &metrics = MediaMetrics::Instance();
+    metrics.file_cache_files.add();
+    metrics.file_cache_bytes.add(file->_size);
+
+    while (_bytes > max_bytes || _files.size() > max_count) {
+        //淘汰最近最少使用的文件
+        remove_l(_lru.back());
+    }
+}
+
+void HttpFileCache::remove_l(HttpCachedFile::Ptr file) {
+    _files.erase(file->_path);
+    _lru.erase(file->_lru_it);
+    _bytes -= file->_size;
+
+    auto &metrics = MediaMetrics::Instance();
+    metrics.file_cache_files.sub();
+    metrics.file_cache_bytes.sub(file->_size);
+
+    if (file->_watched) {
+        unwatch_l(file->_dir);
+    }
+}
+
+void HttpFileCache::clear_l() {
+    while (!_lru.empty()) {
+        remove_l(_lru.back());
+    }
+}
+
+bool HttpFileCache::watch_l(const string &dir, uint64_t &seq) {
+#if defined(ENABLE_INOTIFY)
+    if (!_inotify_inited) {
+        _inotify_inited = true;
+        _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify_fd == -1) {
+            WarnL << "inotify_init1 failed, http file cache will check files by stat:" << get_uv_errmsg(false);
+            return false;
+        }
+        _poller = EventPollerPool::Instance().getPoller();
+        if (_poller->addEvent(_inotify_fd, Event_Read, [this](int event) { onInotify(); }) == -1) {
+            WarnL << "listen inotify fd failed, http file cache will check files by stat";
+            close(_inotify_fd);
+            _inotify_fd = -1;
+            return false;
+        }
+    }
+    if (_inotify_fd == -1) {
+        return false;
+    }
+
+    auto it = _dirs.find(dir);
+    if (it != _dirs.end()) {
+        ++it->second.ref;
+        seq = it->second.seq;
+        return true;
+    }
+    int wd = inotify_add_watch(_inotify_fd, dir.data(), kWatchMask);
+    if (wd == -1) {
+        //可能超过了fs.inotify.max_user_watches限制
+        DebugL << "inotify_add_watch " << dir << " failed:" << get_uv_errmsg(false);
+        return false;
+    }
+    if (_wds.find(wd) != _wds.end()) {
+        //同一个目录通过不同路径(例如软链接)访问，inotify返回同一个wd，此路径改用stat校验
+        return false;
+    }
+    _dirs.emplace(dir, WatchDir{wd, 1, 0});
+    _wds.emplace(wd, dir);
+    seq = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HttpFileCache::unwatch_l(const string &dir) {
+#if defined(ENABLE_INOTIFY)
+    auto it = _dirs.find(dir);
+    if (it == _dirs.end() || --it->second.ref > 0) {
+        return;
+    }
+    inotify_rm_watch(_inotify_fd, it->second.wd);
+    _wds.erase(it->second.wd);
+    _dirs.erase(it);
+#endif
+}
+
+void HttpFileCache::removeDir_l(const string &dir) {
+#if defined(ENABLE_INOTIFY)
+    auto it = _dirs.find(dir);
+    if (it != _dirs.end()) {
+        //目录已失效，加载中的文件因找不到目录也不会加入缓存
+        inotify_rm_watch(_inotify_fd, it->second.wd);
+        _wds.erase(it->second.wd);
+        _dirs.erase(it);
+    }
+    for (auto file_it = _lru.begin(); file_it != _lru.end();) {
+        auto file = *(file_it++);
+        if (file->_dir == dir) {
+            remove_l(file);
+        }
+    }
+#endif
+}
+
+void HttpFileCache::onInotify() {
+#if defined(ENABLE_INOTIFY)
+    alignas(struct inotify_event) char buf[4096];
+    while (true) {
+        auto size = read(_inotify_fd, buf, sizeof(buf));
+        if (size <= 0) {
+            break;
+        }
+        lock_guard<mutex> lck(_mtx);
+        for (char *ptr = buf; ptr < buf + size;) {
+            auto event = (struct inotify_event *) ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                //事件丢失，无法确定哪些文件被修改
+                WarnL << "inotify queue overflow, clear http file cache";
+                for (auto &pr : _dirs) {
+                    ++pr.second.seq;
+                }
+                clear_l();
+                continue;
+            }
+            auto it = _wds.find(event->wd);
+            if (it == _wds.end()) {
+                continue;
+            }
+            auto dir = it->second;
+            ++_dirs[dir].seq;
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                removeDir_l(dir);
+                continue;
+            }
+            if (event->len) {
+                auto file_it = _files.find(dir + event->name);
+                if (file_it != _files.end()) {
+                    remove_l(file_it->second);
+                }
+            }
+        }
+    }
+#endif
+}
+
+}//namespace mediakit
@@ -0,0 +1,130 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_HTTPFILECACHE_H
+#define ZLMEDIAKIT_HTTPFILECACHE_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Poller/EventPoller.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 缓存的静态文件，内容不可变
+ * 小文件为内存拷贝，大文件为整个文件的mmap映射，切片时共享同一映射
+ */
+class HttpCachedFile {
+public:
+    typedef std::shared_ptr<HttpCachedFile> Ptr;
+    ~HttpCachedFile();
+
+    const string &getPath() const;
+
+    /**
+     * 加载时的文件大小
+     */
+    uint64_t size() const;
+
+    /**
+     * 文件内容，文件从缓存中移除后，已取得的内容仍然有效
+     */
+    const std::shared_ptr<char> &getData() const;
+
+    /**
+     * 只读打开的文件fd，小文件已拷贝至内存，返回-1
+     */
+    int getFd() const;
+
+private:
+    friend class HttpFileCache;
+    HttpCachedFile() = default;
+
+private:
+    int _fd = -1;
+    bool _watched = false;
+    uint64_t _size = 0;
+    uint64_t _dev = 0;
+    uint64_t _ino = 0;
+    int64_t _mtime_ns = 0;
+    uint64_t _check_ms = 0;
+    string _path;
+    string _dir;
+    std::shared_ptr<char> _data;
+    list<HttpCachedFile::Ptr>::iterator _lru_it;
+};
+
+/**
+ * http静态文件(包括hls的ts)的打开文件与mmap缓存，进程内共享；m3u8会被不断重写，不缓存
+ * linux下通过inotify监听缓存文件所在目录，文件被修改(关闭写)、删除、改名时移除缓存，
+ * 命中缓存时不产生任何系统调用；inotify不可用时，缓存超过http.fileCacheTTLMS后通过stat校验
+ * 缓存按最近最少使用淘汰，总字节数与文件个数受http.fileCacheSize与http.fileCacheCount限制
+ */
+class HttpFileCache {
+public:
+    static HttpFileCache &Instance();
+
+    /**
+     * 获取文件，未命中时打开文件并加入缓存
+     * @param path 文件绝对路径
+     * @return 文件不存在、不是普通文件、是m3u8、超过缓存大小的1/4或缓存关闭时返回空
+     */
+    HttpCachedFile::Ptr get(const string &path);
+
+    /**
+     * 只查找缓存，未命中时不打开文件，用于鉴权前判断文件是否存在
+     * @param path 文件绝对路径
+     * @return 未命中缓存时返回空
+     */
+    HttpCachedFile::Ptr peek(const string &path);
+
+    /**
+     * 清空缓存
+     */
+    void clear();
+
+private:
+    HttpFileCache() = default;
+    HttpCachedFile::Ptr loadFile(const string &path, uint64_t max_file_size);
+    HttpCachedFile::Ptr find_l(const string &path, uint64_t ttl_ms);
+    void add_l(const HttpCachedFile::Ptr &file, uint64_t max_bytes, uint64_t max_count);
+    void remove_l(HttpCachedFile::Ptr file);
+    void clear_l();
+    bool watch_l(const string &dir, uint64_t &seq);
+    void unwatch_l(const string &dir);
+    void removeDir_l(const string &dir);
+    void onInotify();
+
+private:
+    struct WatchDir {
+        int wd;
+        int ref;
+        //目录内有文件变化的次数，防止加载文件期间文件被修改而缓存了旧内容
+        uint64_t seq;
+    };
+
+    mutex _mtx;
+    uint64_t _bytes = 0;
+    int _inotify_fd = -1;
+    bool _inotify_inited = false;
+    EventPoller::Ptr _poller;
+    list<HttpCachedFile::Ptr> _lru;
+    unordered_map<string, HttpCachedFile::Ptr> _files;
+    unordered_map<string, WatchDir> _dirs;
+    unordered_map<int, string> _wds;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_HTTPFILECACHE_H
@@ -17,6 +17,8 @@
 #include "Util/File.h"
 #include "HttpSession.h"
 #include "Record/HlsMediaSource.h"
+#include "HttpFileCache.h"
+#include "Record/MP4Vod.h"
 
 namespace mediakit {
 
@@ -89,6 +91,7 @@ static const char *s_mime_src[][2] = {
         {"ai", "application/postscript"},
         {"rtf", "application/rtf"},
         {"m3u8", "application/vnd.apple.mpegurl"},
+        {"mpd", "application/dash+xml"},
         {"xls", "application/vnd.ms-excel"},
         {"eot", "application/vnd.ms-fontobject"},
         {"ppt", "application/vnd.ms-powerpoint"},
@@ -141,6 +144,7 @@ static const char *s_mime_src[][2] = {
         {"3gpp", "video/3gpp"},
         {"3gp", "video/3gpp"},
         {"ts", "video/mp2t"},
+        {"m4s", "video/iso.segment"},
         {"mp4", "video/mp4"},
         {"mpeg", "video/mpeg"},
         {"mpg", "video/mpeg"},
@@ -397,7 +401,8 @@ static void canAccessPath(TcpSession &sender, const Parser &parser, const MediaI
         HttpCookieManager::Instance().delCookie(cookie);
     }
 
-    bool is_hls = mediaInfo._schema == HLS_SCHEMA;
+    //hls与CMAF(fmp4)按播放鉴权，并统计观看时长与流量
+    bool is_hls = mediaInfo._schema == HLS_SCHEMA || mediaInfo._schema == FMP4_SCHEMA;
 
     SockInfoImp::Ptr info = std::make_shared<SockInfoImp>();
     info->_identifier = sender.getIdentifier();
@@ -473,6 +478,194 @@ static string pathCat(const string &a, const string &b){
     return a + '/' + b;
 }
 
+/**
+ * 解析LL-HLS部分切片的文件名part_<msn>_<part>.ts
+ */
+static bool parsePartPath(const string &path, uint64_t &msn, uint32_t &part) {
+    auto pos = path.rfind('/');
+    if (pos == string::npos || !end_with(path, ".ts")) {
+        return false;
+    }
+    unsigned long long part_msn;
+    char tail;
+    if (sscanf(path.data() + pos + 1, "part_%llu_%u.t%c", &part_msn, &part, &tail) != 3 || tail != 's') {
+        return false;
+    }
+    msn = part_msn;
+    return true;
+}
+
+/**
+ * 生成回复内存数据的回调，只回复一次，可在任意线程触发，在http客户端线程中回复
+ * @param hls_data 不为空时统计hls流量
+ * @param cache_control 回复成功时的Cache-Control头
+ * @return 回调的参数为回复数据与数据为空时的错误码
+ */
+static function<void(const Buffer::Ptr &data, const char *err_code)> makeBufferResponder(const TcpSession::Ptr &session, const HttpServerCookie::Ptr &cookie,
+                                                                                     const HlsCookieData::Ptr &hls_data, const string &content_type,
+                                                                                     const string &cache_control, const HttpFileManager::invoker &cb) {
+    auto done = std::make_shared<atomic<bool> >(false);
+    weak_ptr<TcpSession> weak_session = session;
+    return [weak_session, done, cookie, hls_data, content_type, cache_control, cb](const Buffer::Ptr &data, const char *err_code) {
+        if (done->exchange(true)) {
+            return;
+        }
+        auto strong_session = weak_session.lock();
+        if (!strong_session) {
+            return;
+        }
+        strong_session->async([cookie, hls_data, content_type, cache_control, cb, data, err_code]() {
+            StrCaseMap headerOut;
+            if (cookie) {
+                auto lck = cookie->getLock();
+                headerOut["Set-Cookie"] = cookie->getCookie((*cookie)[kCookieName].get<HttpCookieAttachment>()._path);
+                if (hls_data && data) {
+                    hls_data->addByteUsage(data->size());
+                }
+            }
+            if (!data) {
+                GET_CONFIG(string, notFound, Http::kNotFound);
+                cb(err_code, "text/html", headerOut, std::make_shared<HttpStringBody>(notFound));
+                return;
+            }
+            headerOut["Cache-Control"] = cache_control;
+            cb("200 OK", content_type, headerOut, std::make_shared<HttpBufferBody>(data));
+        }, false);
+    };
+}
+
+/**
+ * LL-HLS的m3u8与部分切片从HlsMediaSource内存中回复
+ * m3u8请求带_HLS_msn参数时，以及部分切片尚未生成时(预加载提示)，挂起请求直至生成或超时
+ * @return 流未注册时返回false
+ */
+static bool responseLowLatencyHls(const TcpSession::Ptr &session, const Parser &parser, const MediaInfo &mediaInfo, const string &strFile,
+                                  bool is_part, uint64_t part_msn, uint32_t part_index,
+                                  const HttpServerCookie::Ptr &cookie, const HttpFileManager::invoker &cb) {
+    auto stream_id = mediaInfo._streamid;
+    if (is_part) {
+        //部分切片的url为流目录下的文件
+        stream_id = stream_id.substr(0, stream_id.rfind('/'));
+    }
+    auto src = dynamic_pointer_cast<HlsMediaSource>(MediaSource::find(HLS_SCHEMA, mediaInfo._vhost, mediaInfo._app, stream_id));
+    if (!src) {
+        return false;
+    }
+    HlsCookieData::Ptr hls_data;
+    if (cookie) {
+        auto lck = cookie->getLock();
+        auto &attachment = (*cookie)[kCookieName].get<HttpCookieAttachment>();
+        if (attachment._is_hls) {
+            hls_data = attachment._hls_data;
+            //添加观看人数，触发按需生成
+            hls_data->addByteUsage(0);
+        }
+    }
+
+    GET_CONFIG(uint32_t, segDur, Hls::kSegmentDuration);
+    //阻塞最长3个切片时长，同时作为阻塞请求回复的缓存时长
+    uint32_t hold_sec = MAX(segDur, 1) * 3;
+    int64_t msn = -1, part = -1;
+    if (!is_part && !parser.getUrlArgs()["_HLS_msn"].empty()) {
+        msn = atoll(parser.getUrlArgs()["_HLS_msn"].data());
+        if (!parser.getUrlArgs()["_HLS_part"].empty()) {
+            part = atoll(parser.getUrlArgs()["_HLS_part"].data());
+        }
+    }
+    //阻塞请求的url唯一且内容不变，可以被cdn缓存
+    bool blocking = is_part || msn >= 0;
+    auto reply = makeBufferResponder(session, cookie, hls_data, HttpFileManager::getContentType(strFile.data()),
+                                     blocking ? string("max-age=") + to_string(hold_sec) : string("no-cache"), cb);
+
+    //超时后移除等待者，m3u8回复当前内容，部分切片回复404
+    std::weak_ptr<HlsMediaSource> weak_src = src;
+    auto waiter_id = std::make_shared<atomic<uint64_t> >(0);
+    auto timeout = session->getPoller()->doDelayTask(hold_sec * 1000, [reply, weak_src, is_part, waiter_id]() {
+        auto src = weak_src.lock();
+        if (!src) {
+            reply(nullptr, "404 Not Found");
+            return 0;
+        }
+        src->delWaiter(*waiter_id);
+        reply(is_part ? nullptr : src->getPlaylist(), "404 Not Found");
+        return 0;
+    });
+
+    //回复后取消超时任务，释放其持有的回复函数(cookie与invoker)
+    if (is_part) {
+        *waiter_id = src->getPart(part_msn, part_index, [reply, timeout](const Buffer::Ptr &data) {
+            reply(data, "404 Not Found");
+            timeout->cancel();
+        });
+    } else {
+        *waiter_id = src->getPlaylist(msn, part, [reply, timeout](const Buffer::Ptr &data) {
+            //请求的切片超前过多
+            reply(data, "400 Bad Request");
+            timeout->cancel();
+        });
+    }
+    return true;
+}
+
+/**
+ * CMAF hls与dash的索引与切片从FMP4MediaSource的打包器内存中回复
+ * url为fmp4流目录下的文件，例如/live/test/cmaf.m3u8、/live/test/cmaf.mpd
+ * 生成第一个切片前挂起索引请求，直至生成或超时
+ * @param mediaInfo 已转换为fmp4流的url信息
+ */
+static void responseCmaf(const TcpSession::Ptr &session, const MediaInfo &mediaInfo, const string &strFile,
+                         const HttpServerCookie::Ptr &cookie, const HttpFileManager::invoker &cb) {
+    auto file_name = strFile.substr(strFile.rfind('/') + 1);
+    HlsCookieData::Ptr hls_data;
+    if (cookie) {
+        auto lck = cookie->getLock();
+        auto &attachment = (*cookie)[kCookieName].get<HttpCookieAttachment>();
+        if (attachment._is_hls) {
+            hls_data = attachment._hls_data;
+        }
+    }
+
+    weak_ptr<TcpSession> weak_session = session;
+    MediaSource::findAsync(mediaInfo, session, [weak_session, file_name, cookie, hls_data, cb](const MediaSource::Ptr &src) {
+        auto strong_session = weak_session.lock();
+        if (!strong_session) {
+            return;
+        }
+        auto fmp4 = dynamic_pointer_cast<FMP4MediaSource>(src);
+        if (!fmp4) {
+            //流不存在
+            sendNotFound(cb);
+            return;
+        }
+        GET_CONFIG(uint32_t, segDur, Hls::kSegmentDuration);
+        uint32_t hold_sec = MAX(segDur, 1) * 3;
+        //索引每次请求都可能变化，切片与init segment内容不变
+        bool is_index = end_with(file_name, ".m3u8") || end_with(file_name, ".mpd");
+        if (hls_data) {
+            //流已注册，开始统计流量
+            hls_data->addByteUsage(0);
+        }
+        auto reply = makeBufferResponder(strong_session, cookie, hls_data, HttpFileManager::getContentType(file_name.data()),
+                                         is_index ? string("no-cache") : string("max-age=") + to_string(hold_sec * 10), cb);
+        //超时后移除等待者并回复404，回复后取消超时任务，释放其持有的回复函数
+        auto packager = fmp4->getPackager();
+        std::weak_ptr<FMP4Packager> weak_packager = packager;
+        auto waiter_id = std::make_shared<atomic<uint64_t> >(0);
+        auto timeout = strong_session->getPoller()->doDelayTask(hold_sec * 1000, [reply, weak_packager, waiter_id]() {
+            auto packager = weak_packager.lock();
+            if (packager) {
+                packager->delWaiter(*waiter_id);
+            }
+            reply(nullptr, "404 Not Found");
+            return 0;
+        });
+        *waiter_id = packager->getFile(file_name, [reply, timeout](const Buffer::Ptr &data) {
+            reply(data, "404 Not Found");
+            timeout->cancel();
+        });
+    });
+}
+
 /**
  * 访问文件
  * @param sender 事件触发者
@@ -483,8 +676,23 @@ static string pathCat(const string &a, const string &b){
  */
 static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo &mediaInfo, const string &strFile, const HttpFileManager::invoker &cb) {
     bool is_hls = end_with(strFile, kHlsSuffix);
-    bool file_exist = File::is_file(strFile.data());
-    if (!is_hls && !file_exist) {
+    //命中文件缓存时不再stat文件，鉴权通过前不加载文件至缓存
+    bool file_exist = HttpFileCache::Instance().peek(strFile) || File::is_file(strFile.data());
+    bool is_vod = false;
+    string vod_file, vod_name;
+#ifdef ENABLE_MP4
+    //mp4文件下的虚拟路径，按需切片为hls点播
+    is_vod = !is_hls && !file_exist && MP4Vod::parsePath(strFile, vod_file, vod_name);
+#endif
+    //LL-HLS的部分切片只存在于内存中
+    GET_CONFIG(bool, lowLatency, Hls::kLowLatency);
+    uint64_t part_msn = 0;
+    uint32_t part_index = 0;
+    bool is_part = lowLatency && !is_hls && !file_exist && !is_vod && parsePartPath(strFile, part_msn, part_index);
+    //CMAF hls与dash只存在于内存中，url为fmp4流目录下的文件
+    bool is_cmaf = !is_hls && !file_exist && !is_vod && !is_part && mediaInfo._streamid.find('/') != string::npos &&
+                   FMP4Packager::isPackagerFile(strFile.substr(strFile.rfind('/') + 1));
+    if (!is_hls && !file_exist && !is_vod && !is_part && !is_cmaf) {
         //文件不存在且不是hls,那么直接返回404
         sendNotFound(cb);
         return;
@@ -496,9 +704,17 @@ static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo
         replace(const_cast<string &>(mediaInfo._streamid), kHlsSuffix, "");
     }
 
+    if (is_cmaf) {
+        //CMAF，移除文件名获取真实的stream_id并且修改协议为fmp4，按fmp4播放鉴权
+        auto &stream_id = const_cast<string &>(mediaInfo._streamid);
+        const_cast<string &>(mediaInfo._schema) = FMP4_SCHEMA;
+        stream_id = stream_id.substr(0, stream_id.rfind('/'));
+    }
+
     weak_ptr<TcpSession> weakSession = sender.shared_from_this();
     //判断是否有权限访问该文件
-    canAccessPath(sender, parser, mediaInfo, false, [cb, strFile, parser, is_hls, mediaInfo, weakSession , file_exist](const string &errMsg, const HttpServerCookie::Ptr &cookie) {
+    canAccessPath(sender, parser, mediaInfo, false, [cb, strFile, parser, is_hls, mediaInfo, weakSession , file_exist, is_vod, vod_file, vod_name,
+                                                     is_part, part_msn, part_index, is_cmaf](const string &errMsg, const HttpServerCookie::Ptr &cookie) {
         auto strongSession = weakSession.lock();
         if (!strongSession) {
             //http客户端已经断开，不需要回复
@@ -515,6 +731,48 @@ static void accessFile(TcpSession &sender, const Parser &parser, const MediaInfo
             return;
         }
 
+        GET_CONFIG(bool, lowLatency, Hls::kLowLatency);
+        if (lowLatency && (is_hls || is_part)) {
+            //LL-HLS直播，流未注册时m3u8按普通hls处理(等待流注册)
+            if (responseLowLatencyHls(strongSession, parser, mediaInfo, strFile, is_part, part_msn, part_index, cookie, cb)) {
+                return;
+            }
+            if (is_part) {
+                sendNotFound(cb);
+                return;
+            }
+        }
+
+        if (is_cmaf) {
+            responseCmaf(strongSession, mediaInfo, strFile, cookie, cb);
+            return;
+        }
+
+#ifdef ENABLE_MP4
+        if (is_vod) {
+            //在后台线程切片，完成后切回http客户端线程回复
+            MP4Vod::Instance().getFileAsync(vod_file, vod_name, [weakSession, cookie, cb, strFile](const Buffer::Ptr &data) {
+                auto strongSession = weakSession.lock();
+                if (!strongSession) {
+                    return;
+                }
+                strongSession->async([cookie, cb, strFile, data]() {
+                    if (!data) {
+                        sendNotFound(cb);
+                        return;
+                    }
+                    StrCaseMap headerOut;
+                    if (cookie) {
+                        auto lck = cookie->getLock();
+                        headerOut["Set-Cookie"] = cookie->getCookie((*cookie)[kCookieName].get<HttpCookieAttachment>()._path);
+                    }
+                    cb("200 OK", HttpFileManager::getContentType(strFile.data()), headerOut, std::make_shared<HttpBufferBody>(data));
+                });
+            });
+            return;
+        }
+#endif
+
         auto response_file = [file_exist](const HttpServerCookie::Ptr &cookie, const HttpFileManager::invoker &cb, const string &strFile, const Parser &parser) {
             StrCaseMap httpHeader;
             if (cookie) {
@@ -599,8 +857,8 @@ void HttpFileManager::onAccessPath(TcpSession &sender, Parser &parser, const Htt
     auto fullUrl = string(HTTP_SCHEMA) + "://" + parser["Host"] + parser.FullUrl();
     MediaInfo mediaInfo(fullUrl);
     auto strFile = getFilePath(parser, mediaInfo, sender);
-    //访问的是文件夹
-    if (File::is_dir(strFile.data())) {
+    //访问的是文件夹(命中文件缓存的必然是文件)
+    if (!HttpFileCache::Instance().peek(strFile) && File::is_dir(strFile.data())) {
         auto indexFile = searchIndexFile(strFile);
         if (!indexFile.empty()) {
             //发现该文件夹下有index文件
@@ -669,13 +927,18 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
                                           const StrCaseMap &responseHeader,
                                           const string &filePath) const {
     StrCaseMap &httpHeader = const_cast<StrCaseMap &>(responseHeader);
-    std::shared_ptr<FILE> fp(fopen(filePath.data(), "rb"), [](FILE *fp) {
-        if (fp) {
-            fclose(fp);
-        }
-    });
+    //优先使用文件缓存，文件过大或缓存关闭时才打开文件
+    auto cached_file = HttpFileCache::Instance().get(filePath);
+    std::shared_ptr<FILE> fp;
+    if (!cached_file) {
+        fp.reset(fopen(filePath.data(), "rb"), [](FILE *fp) {
+            if (fp) {
+                fclose(fp);
+            }
+        });
+    }
 
-    if (!fp) {
+    if (!cached_file && !fp) {
         //打开文件失败
         GET_CONFIG(string, notFound, Http::kNotFound);
         GET_CONFIG(string, charSet, Http::kCharSet);
@@ -689,7 +952,7 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
     auto &strRange = const_cast<StrCaseMap &>(requestHeader)["Range"];
     int64_t iRangeStart = 0;
     int64_t iRangeEnd = 0;
-    int64_t fileSize = HttpMultiFormBody::fileSize(fp.get());
+    int64_t fileSize = cached_file ? cached_file->size() : HttpMultiFormBody::fileSize(fp.get());
 
     const char *pcHttpResult = NULL;
     if (strRange.size() == 0) {
@@ -709,7 +972,15 @@ void HttpResponseInvokerImp::responseFile(const StrCaseMap &requestHeader,
     }
 
     //回复文件
-    HttpBody::Ptr fileBody = std::make_shared<HttpFileBody>(fp, iRangeStart, iRangeEnd - iRangeStart + 1);
+    HttpBody::Ptr fileBody;
+    if (cached_file) {
+        //缓存的内容不能越界读取
+        iRangeEnd = MIN(iRangeEnd, fileSize - 1);
+        iRangeStart = MIN(iRangeStart, iRangeEnd + 1);
+        fileBody = std::make_shared<HttpFileBody>(cached_file, iRangeStart, iRangeEnd - iRangeStart + 1);
+    } else {
+        fileBody = std::make_shared<HttpFileBody>(fp, iRangeStart, iRangeEnd - iRangeStart + 1);
+    }
     (*this)(pcHttpResult, httpHeader, fileBody);
 }
 
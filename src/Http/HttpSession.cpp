@@ -12,6 +12,7 @@
 #include <sys/stat.h>
 #include <algorithm>
 #include "Common/config.h"
+#include "Common/MediaMetrics.h"
 #include "strCoding.h"
 #include "HttpSession.h"
 #include "Util/base64.h"
@@ -84,9 +85,15 @@ void HttpSession::onRecvContent(const char *data,uint64_t len) {
 
 void HttpSession::onRecv(const Buffer::Ptr &pBuf) {
     _ticker.resetTime();
+    MediaMetrics::Instance().http.bytes_in.add(pBuf->size());
     input(pBuf->data(),pBuf->size());
 }
 
+int HttpSession::send(Buffer::Ptr pkt) {
+    MediaMetrics::Instance().http.bytes_out.add(pkt->size());
+    return TcpSession::send(std::move(pkt));
+}
+
 void HttpSession::onError(const SockException& err) {
     if(_is_live_stream){
         uint64_t duration = _ticker.createdTime()/1000;
@@ -402,10 +409,11 @@ class AsyncSenderData {
 public:
     friend class AsyncSender;
     typedef std::shared_ptr<AsyncSenderData> Ptr;
-    AsyncSenderData(const TcpSession::Ptr &session, const HttpBody::Ptr &body, bool close_when_complete) {
+    AsyncSenderData(const TcpSession::Ptr &session, const HttpBody::Ptr &body, bool close_when_complete, int send_file_fd = -1) {
         _session = dynamic_pointer_cast<HttpSession>(session);
         _body = body;
         _close_when_complete = close_when_complete;
+        _send_file_fd = send_file_fd;
     }
     ~AsyncSenderData() = default;
 private:
@@ -413,6 +421,8 @@ private:
     HttpBody::Ptr _body;
     bool _close_when_complete;
     bool _read_complete = false;
+    //sendfile模式的socket fd
+    int _send_file_fd;
 };
 
 class AsyncSender {
@@ -427,6 +437,14 @@ public:
             return false;
         }
 
+        if (data->_send_file_fd != -1) {
+            auto session = data->_session.lock();
+            if (session) {
+                onSendFile(data, session);
+            }
+            return true;
+        }
+
         GET_CONFIG(uint32_t, sendBufSize, Http::kSendBufSize);
         data->_body->readDataAsync(sendBufSize, [data](const Buffer::Ptr &sendBuf) {
             auto session = data->_session.lock();
@@ -464,6 +482,50 @@ private:
         }
     }
 
+    static void onSendFile(const AsyncSenderData::Ptr &data, const std::shared_ptr<HttpSession> &session) {
+        session->_ticker.resetTime();
+        auto &sock = session->getSock();
+        while (data->_body->remainSize()) {
+            if (sock->getSendBufferCount()) {
+                //http头等数据未发送完毕，等待onFlush回调
+                return;
+            }
+            auto sent = data->_body->sendFile(data->_send_file_fd, [data]() {
+                //后台线程预读完成，切换到poller线程继续发送
+                auto session = data->_session.lock();
+                if (!session) {
+                    return;
+                }
+                session->async([data]() {
+                    auto session = data->_session.lock();
+                    if (session) {
+                        onSendFile(data, session);
+                    }
+                }, false);
+            });
+            if (sent > 0) {
+                MediaMetrics::Instance().http.bytes_out.add(sent);
+                continue;
+            }
+            if (sent == 0) {
+                //等待预读
+                return;
+            }
+            if (get_uv_error(true) == UV_EAGAIN) {
+                //socket写缓存满了，等待可写
+                sock->waitWriteAble();
+                return;
+            }
+            session->shutdown(SockException(Err_other, StrPrinter << "sendfile failed:" << get_uv_errmsg(true)));
+            return;
+        }
+        //文件写完了
+        data->_read_complete = true;
+        if (data->_close_when_complete) {
+            shutdown(session);
+        }
+    }
+
     static void shutdown(const std::shared_ptr<HttpSession> &session) {
         if(session){
             session->shutdown(SockException(Err_shutdown, StrPrinter << "close connection after send http body completed."));
@@ -570,7 +632,10 @@ void HttpSession::sendResponse(const char *pcStatus,
     }
 
     //发送http body
-    AsyncSenderData::Ptr data = std::make_shared<AsyncSenderData>(shared_from_this(),body,bClose);
+    GET_CONFIG(bool, sendFile, Http::kSendFile);
+    //文件零拷贝发送，不经过发送缓存
+    int send_file_fd = sendFile && body->sendFileAble() ? getSendFileFd() : -1;
+    AsyncSenderData::Ptr data = std::make_shared<AsyncSenderData>(shared_from_this(), body, bClose, send_file_fd);
     getSock()->setOnFlush([data](){
         return AsyncSender::onSocketFlushed(data);
     });
@@ -710,6 +775,7 @@ void HttpSession::onWrite(const Buffer::Ptr &buffer, bool flush) {
     }
 
     _ticker.resetTime();
+    MediaMetrics::Instance().http.packets_out.add();
     if (!_live_over_websocket) {
         _total_bytes_usage += buffer->size();
         send(buffer);
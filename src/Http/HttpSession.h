@@ -48,6 +48,7 @@ public:
     void onRecv(const Buffer::Ptr &) override;
     void onError(const SockException &err) override;
     void onManager() override;
+    int send(Buffer::Ptr pkt) override;
     static string urlDecode(const string &str);
 
 protected:
@@ -53,14 +53,22 @@ void HttpTSPlayer::onResponseBody(const char *buf, int64_t size, int64_t recvedS
 }
 
 void HttpTSPlayer::onResponseCompleted() {
+    if (_on_complete) {
+        //接收完毕，保持连接以便复用；回调中可能重新设置或清空该回调，所以先移出再执行
+        auto on_complete = std::move(_on_complete);
+        _on_complete = nullptr;
+        on_complete();
+        return;
+    }
     //接收完毕
     shutdown(SockException(Err_success, "play completed"));
 }
 
 void HttpTSPlayer::onDisconnect(const SockException &ex) {
     if (_on_disconnect) {
-        _on_disconnect(ex);
+        auto on_disconnect = std::move(_on_disconnect);
         _on_disconnect = nullptr;
+        on_disconnect(ex);
     }
 }
 
@@ -78,4 +86,8 @@ void HttpTSPlayer::setOnPacket(const TSSegment::onSegment &cb) {
     _on_segment = cb;
 }
 
+void HttpTSPlayer::setOnComplete(const function<void()> &cb) {
+    _on_complete = cb;
+}
+
 }//namespace mediakit
\ No newline at end of file
@@ -30,6 +30,9 @@ public:
     void setOnDisconnect(const onShutdown &cb);
     //设置接收ts包回调
     void setOnPacket(const TSSegment::onSegment &cb);
+    //设置接收完毕回调，设置后接收完毕时不再断开连接，可以复用该连接继续请求；
+    //该回调只触发一次，复用连接请求下一个文件时需要重新设置
+    void setOnComplete(const function<void()> &cb);
 
 protected:
     ///HttpClient override///
@@ -50,6 +53,7 @@ private:
     bool _split_ts;
     TSSegment _segment;
     onShutdown _on_disconnect;
+    function<void()> _on_complete;
     TSSegment::onSegment _on_segment;
 };
 
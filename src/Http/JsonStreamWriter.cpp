@@ -0,0 +1,228 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+#include "JsonStreamWriter.h"
+
+namespace mediakit {
+
+JsonStreamWriter::JsonStreamWriter(size_t chunk_size) {
+    _chunk_size = chunk_size ? chunk_size : 64 * 1024;
+    _chunk.reserve(_chunk_size);
+}
+
+void JsonStreamWriter::startObject() {
+    comma();
+    append('{');
+    _need_comma = false;
+}
+
+void JsonStreamWriter::endObject() {
+    append('}');
+    _need_comma = true;
+}
+
+void JsonStreamWriter::startArray() {
+    comma();
+    append('[');
+    _need_comma = false;
+}
+
+void JsonStreamWriter::endArray() {
+    append(']');
+    _need_comma = true;
+}
+
+void JsonStreamWriter::key(const char *name) {
+    comma();
+    appendQuoted(name, strlen(name));
+    append(':');
+    _need_comma = false;
+}
+
+void JsonStreamWriter::key(const string &name) {
+    comma();
+    appendQuoted(name.data(), name.size());
+    append(':');
+    _need_comma = false;
+}
+
+void JsonStreamWriter::value(const char *str) {
+    comma();
+    appendQuoted(str, strlen(str));
+    _need_comma = true;
+}
+
+void JsonStreamWriter::value(const string &str) {
+    comma();
+    appendQuoted(str.data(), str.size());
+    _need_comma = true;
+}
+
+void JsonStreamWriter::value(bool val) {
+    comma();
+    if (val) {
+        append("true", 4);
+    } else {
+        append("false", 5);
+    }
+    _need_comma = true;
+}
+
+void JsonStreamWriter::value(int val) {
+    value((int64_t) val);
+}
+
+void JsonStreamWriter::value(unsigned int val) {
+    value((uint64_t) val);
+}
+
+void JsonStreamWriter::value(int64_t val) {
+    comma();
+    //先转为无符号数再取反，防止INT64_MIN溢出
+    appendInteger(val < 0 ? 0 - (uint64_t) val : (uint64_t) val, val < 0);
+    _need_comma = true;
+}
+
+void JsonStreamWriter::value(uint64_t val) {
+    comma();
+    appendInteger(val, false);
+    _need_comma = true;
+}
+
+void JsonStreamWriter::value(double val) {
+    if (!std::isfinite(val)) {
+        //json不支持nan与inf
+        valueNull();
+        return;
+    }
+    comma();
+    char buf[32];
+    //优先使用较短的15位有效数字，无法精确还原时再使用17位
+    int size = snprintf(buf, sizeof(buf), "%.15g", val);
+    if (strtod(buf, nullptr) != val) {
+        size = snprintf(buf, sizeof(buf), "%.17g", val);
+    }
+    append(buf, size);
+    _need_comma = true;
+}
+
+void JsonStreamWriter::valueNull() {
+    comma();
+    append("null", 4);
+    _need_comma = true;
+}
+
+uint64_t JsonStreamWriter::size() const {
+    return _chunks_bytes + _chunk.size();
+}
+
+HttpBody::Ptr JsonStreamWriter::takeBody() {
+    flushChunk();
+    auto ret = std::make_shared<HttpBufferListBody>(std::move(_chunks));
+    _chunks_bytes = 0;
+    _need_comma = false;
+    return ret;
+}
+
+string JsonStreamWriter::takeString() {
+    string ret;
+    ret.reserve(size());
+    _chunks.for_each([&](const Buffer::Ptr &chunk) {
+        ret.append(chunk->data(), chunk->size());
+    });
+    ret.append(_chunk);
+    _chunks.clear();
+    _chunks_bytes = 0;
+    _chunk.clear();
+    _need_comma = false;
+    return ret;
+}
+
+void JsonStreamWriter::comma() {
+    if (_need_comma) {
+        append(',');
+    }
+}
+
+void JsonStreamWriter::append(char ch) {
+    if (_chunk.size() + 1 > _chunk_size) {
+        flushChunk();
+    }
+    _chunk.push_back(ch);
+}
+
+void JsonStreamWriter::append(const char *data, size_t size) {
+    //写满后再换块，防止string扩容导致内存翻倍
+    if (_chunk.size() + size > _chunk_size) {
+        flushChunk();
+    }
+    _chunk.append(data, size);
+}
+
+void JsonStreamWriter::appendQuoted(const char *str, size_t size) {
+    static const char s_hex[] = "0123456789abcdef";
+    append('"');
+    auto start = str;
+    auto end = str + size;
+    for (auto ptr = str; ptr < end; ++ptr) {
+        unsigned char ch = *ptr;
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            //utf-8等其他字符原样输出
+            continue;
+        }
+        append(start, ptr - start);
+        start = ptr + 1;
+        switch (ch) {
+            case '"': append("\\\"", 2); break;
+            case '\\': append("\\\\", 2); break;
+            case '\b': append("\\b", 2); break;
+            case '\f': append("\\f", 2); break;
+            case '\n': append("\\n", 2); break;
+            case '\r': append("\\r", 2); break;
+            case '\t': append("\\t", 2); break;
+            default: {
+                char buf[6] = {'\\', 'u', '0', '0', s_hex[ch >> 4], s_hex[ch & 0x0F]};
+                append(buf, sizeof(buf));
+                break;
+            }
+        }
+    }
+    append(start, end - start);
+    append('"');
+}
+
+void JsonStreamWriter::appendInteger(uint64_t val, bool negative) {
+    char buf[24];
+    char *ptr = buf + sizeof(buf);
+    do {
+        *--ptr = '0' + val % 10;
+        val /= 10;
+    } while (val);
+    if (negative) {
+        *--ptr = '-';
+    }
+    append(ptr, buf + sizeof(buf) - ptr);
+}
+
+void JsonStreamWriter::flushChunk() {
+    if (_chunk.empty()) {
+        return;
+    }
+    _chunks_bytes += _chunk.size();
+    _chunks.emplace_back(std::make_shared<BufferString>(std::move(_chunk)));
+    _chunk = string();
+    _chunk.reserve(_chunk_size);
+}
+
+}//namespace mediakit
@@ -0,0 +1,95 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_JSONSTREAMWRITER_H
+#define ZLMEDIAKIT_JSONSTREAMWRITER_H
+
+#include <string>
+#include <cstdint>
+#include "HttpBody.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 流式json序列化，不构造Json::Value树，直接输出紧凑格式的json文本
+ * 输出按块缓存，每块写满后不再移动，最后整体作为http body发送，
+ * 适用于getMediaList等数据量随流、会话个数增长的接口
+ * 调用者需保证startObject/endObject等调用成对且顺序合法，本类不做校验
+ */
+class JsonStreamWriter {
+public:
+    /**
+     * @param chunk_size 每块缓存的大小
+     */
+    JsonStreamWriter(size_t chunk_size = 64 * 1024);
+    ~JsonStreamWriter() = default;
+
+    void startObject();
+    void endObject();
+    void startArray();
+    void endArray();
+
+    /**
+     * 对象的成员名，后面必须紧跟一个值或一个对象、数组
+     */
+    void key(const char *name);
+    void key(const string &name);
+
+    void value(const char *str);
+    void value(const string &str);
+    void value(bool val);
+    void value(int val);
+    void value(unsigned int val);
+    void value(int64_t val);
+    void value(uint64_t val);
+    void value(double val);
+    void valueNull();
+
+    template<typename T>
+    void member(const char *name, T &&val) {
+        key(name);
+        value(std::forward<T>(val));
+    }
+
+    /**
+     * 已输出的字节数
+     */
+    uint64_t size() const;
+
+    /**
+     * 取出已输出的内容作为http body，之后本对象恢复为初始状态
+     */
+    HttpBody::Ptr takeBody();
+
+    /**
+     * 取出已输出的内容并合并为一个字符串，主要用于测试
+     */
+    string takeString();
+
+private:
+    void comma();
+    void append(char ch);
+    void append(const char *data, size_t size);
+    void appendQuoted(const char *str, size_t size);
+    void appendInteger(uint64_t val, bool negative);
+    void flushChunk();
+
+private:
+    bool _need_comma = false;
+    size_t _chunk_size;
+    uint64_t _chunks_bytes = 0;
+    string _chunk;
+    List<Buffer::Ptr> _chunks;
+};
+
+}//namespace mediakit
+#endif //ZLMEDIAKIT_JSONSTREAMWRITER_H
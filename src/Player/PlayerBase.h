@@ -112,6 +112,12 @@ public:
      */
     virtual float getPacketLossRate(TrackType trackType) const {return 0; }
 
+    /**
+     * 获取拉流统计，例如hls拉流的下载速度、落后直播的时长等
+     * @return 统计项名及其值，可能跨线程调用
+     */
+    virtual map<string, int64_t> getPullStat() const { return map<string, int64_t>(); }
+
     /**
      * 获取所有track
      */
@@ -195,6 +201,13 @@ public:
         return Parent::getTracks(trackReady);
     }
 
+    map<string, int64_t> getPullStat() const override {
+        if (_delegate) {
+            return _delegate->getPullStat();
+        }
+        return Parent::getPullStat();
+    }
+
     std::shared_ptr<SockInfo> getSockInfo() const{
         return dynamic_pointer_cast<SockInfo>(_delegate);
     }
@@ -197,6 +197,10 @@ std::shared_ptr<SockInfo> PlayerProxy::getOriginSock(MediaSource &sender) const{
     return getSockInfo();
 }
 
+map<string, int64_t> PlayerProxy::getOriginStat(MediaSource &sender) const{
+    return getPullStat();
+}
+
 class MuteAudioMaker : public FrameDispatcher{
 public:
     typedef std::shared_ptr<MuteAudioMaker> Ptr;
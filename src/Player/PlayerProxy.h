@@ -62,6 +62,7 @@ private:
     MediaOriginType getOriginType(MediaSource &sender) const override;
     string getOriginUrl(MediaSource &sender) const override;
     std::shared_ptr<SockInfo> getOriginSock(MediaSource &sender) const override;
+    map<string, int64_t> getOriginStat(MediaSource &sender) const override;
 
     void rePlay(const string &strUrl,int iFailedCnt);
     void onPlaySuccess();
@@ -9,12 +9,18 @@
  */
 
 #include "HlsMaker.h"
+#include "Common/MediaMetrics.h"
 namespace mediakit {
 
-HlsMaker::HlsMaker(float seg_duration, uint32_t seg_number) {
+//LL-HLS时m3u8中列出部分切片的已完成切片个数
+static constexpr size_t kPartSegments = 2;
+
+HlsMaker::HlsMaker(float seg_duration, uint32_t seg_number, float part_duration) {
     //最小允许设置为0，0个切片代表点播
     _seg_number = seg_number;
     _seg_duration = seg_duration;
+    //部分切片只用于直播
+    _part_duration = seg_number ? part_duration : 0;
 }
 
 HlsMaker::~HlsMaker() {
@@ -32,23 +38,73 @@ void HlsMaker::makeIndexFile(bool eof) {
         }
     }
 
-    auto sequence = _seg_number ? (_file_index > _seg_number ? _file_index - _seg_number : 0LL) : 0LL;
+    //未完成的切片不在列表中
+    auto sequence = _file_index - (_last_file_name.empty() ? 0 : 1) - _seg_dur_list.size();
 
     string m3u8;
-    snprintf(file_content, sizeof(file_content),
-             "#EXTM3U\n"
-             "#EXT-X-VERSION:3\n"
-             "#EXT-X-ALLOW-CACHE:NO\n"
-             "#EXT-X-TARGETDURATION:%u\n"
-             "#EXT-X-MEDIA-SEQUENCE:%llu\n",
-             (maxSegmentDuration + 999) / 1000,
-             sequence);
-
-    m3u8.assign(file_content);
-
-    for (auto &tp : _seg_dur_list) {
-        snprintf(file_content, sizeof(file_content), "#EXTINF:%.3f,\n%s\n", std::get<0>(tp) / 1000.0, std::get<1>(tp).data());
-        m3u8.append(file_content);
+    if (!isLowLatency()) {
+        snprintf(file_content, sizeof(file_content),
+                 "#EXTM3U\n"
+                 "#EXT-X-VERSION:3\n"
+                 "#EXT-X-ALLOW-CACHE:NO\n"
+                 "#EXT-X-TARGETDURATION:%u\n"
+                 "#EXT-X-MEDIA-SEQUENCE:%llu\n",
+                 (maxSegmentDuration + 999) / 1000,
+                 (unsigned long long) sequence);
+        m3u8.assign(file_content);
+        for (auto &tp : _seg_dur_list) {
+            snprintf(file_content, sizeof(file_content), "#EXTINF:%.3f,\n%s\n", std::get<0>(tp) / 1000.0, std::get<1>(tp).data());
+            m3u8.append(file_content);
+        }
+    } else {
+        //部分切片的时长在遇到下一帧时才能确定，可能略超配置值，PART-TARGET取实际最大值
+        uint32_t part_target = _part_duration * 1000;
+        for (auto &parts : _seg_parts) {
+            for (auto &part : parts) {
+                part_target = MAX(part_target, part.duration);
+            }
+        }
+        for (auto &part : _cur_parts) {
+            part_target = MAX(part_target, part.duration);
+        }
+        snprintf(file_content, sizeof(file_content),
+                 "#EXTM3U\n"
+                 "#EXT-X-VERSION:6\n"
+                 "#EXT-X-TARGETDURATION:%u\n"
+                 "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n"
+                 "#EXT-X-PART-INF:PART-TARGET=%.3f\n"
+                 "#EXT-X-MEDIA-SEQUENCE:%llu\n",
+                 (maxSegmentDuration + 999) / 1000,
+                 part_target * 3 / 1000.0,
+                 part_target / 1000.0,
+                 (unsigned long long) sequence);
+        m3u8.assign(file_content);
+
+        auto append_parts = [&](const vector<PartInfo> &parts, uint64_t msn) {
+            for (uint32_t i = 0; i < parts.size(); ++i) {
+                snprintf(file_content, sizeof(file_content), "#EXT-X-PART:DURATION=%.3f,URI=\"%s\"%s\n",
+                         parts[i].duration / 1000.0, onPartName(msn, i).data(), parts[i].independent ? ",INDEPENDENT=YES" : "");
+                m3u8.append(file_content);
+            }
+        };
+        auto part_start = _seg_dur_list.size() - MIN(_seg_parts.size(), _seg_dur_list.size());
+        for (size_t i = 0; i < _seg_dur_list.size(); ++i) {
+            if (i >= part_start) {
+                append_parts(_seg_parts[_seg_parts.size() - (_seg_dur_list.size() - i)], sequence + i);
+            }
+            auto &tp = _seg_dur_list[i];
+            snprintf(file_content, sizeof(file_content), "#EXTINF:%.3f,\n%s\n", std::get<0>(tp) / 1000.0, std::get<1>(tp).data());
+            m3u8.append(file_content);
+        }
+        if (!eof) {
+            //未完成切片已生成的部分切片，以及下一个部分切片的预加载提示
+            uint64_t msn;
+            uint32_t part;
+            getPartPosition(msn, part);
+            append_parts(_cur_parts, msn);
+            snprintf(file_content, sizeof(file_content), "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n", onPartName(msn, part).data());
+            m3u8.append(file_content);
+        }
     }
 
     if (eof) {
@@ -66,6 +122,18 @@ void HlsMaker::inputData(void *data, uint32_t len, uint32_t timestamp, bool is_i
             addNewSegment(timestamp);
         }
         if (!_last_file_name.empty()) {
+            if (isLowLatency()) {
+                //在帧边界切分部分切片(同一帧的ts包时间戳相同)，音视频时间戳可能交错，按有符号比较
+                if (_part_bytes && (int32_t) (timestamp - _last_part_timestamp) >= _part_duration * 1000) {
+                    flushPart(timestamp);
+                    makeIndexFile(false);
+                }
+                if (!_part_bytes) {
+                    _last_part_timestamp = timestamp;
+                    _part_independent = is_idr_fast_packet;
+                }
+                _part_bytes += len;
+            }
             //存在切片才写入ts数据
             onWriteSegment((char *) data, len);
             _last_timestamp = timestamp;
@@ -98,6 +166,7 @@ void HlsMaker::addNewSegment(uint32_t stamp) {
         //存在上个切片，并且未到分片时间
         return;
     }
+    MetricTimer timer(MediaMetrics::Instance().hls_segment);
 
     //关闭并保存上一个切片，如果_seg_number==0,那么是点播。
     flushLastSegment(_seg_number == 0);
@@ -117,6 +186,17 @@ void HlsMaker::flushLastSegment(bool eof){
     if (seg_dur <= 0) {
         seg_dur = 100;
     }
+    if (isLowLatency()) {
+        //切片的最后一个部分切片
+        if (_part_bytes) {
+            flushPart(_last_timestamp);
+        }
+        _seg_parts.emplace_back(std::move(_cur_parts));
+        _cur_parts.clear();
+        if (_seg_parts.size() > kPartSegments) {
+            _seg_parts.pop_front();
+        }
+    }
     _seg_dur_list.push_back(std::make_tuple(seg_dur, std::move(_last_file_name)));
     _last_file_name.clear();
     delOldSegment();
@@ -124,15 +204,46 @@ void HlsMaker::flushLastSegment(bool eof){
     onFlushLastSegment(seg_dur);
 }
 
+void HlsMaker::flushPart(uint32_t end_timestamp) {
+    int32_t part_dur = end_timestamp - _last_part_timestamp;
+    if (part_dur <= 0) {
+        part_dur = 1;
+    }
+    _cur_parts.push_back(PartInfo{(uint32_t) part_dur, _part_independent});
+    _part_bytes = 0;
+    onFlushPart(_file_index - 1, _cur_parts.size() - 1);
+}
+
+string HlsMaker::onPartName(uint64_t msn, uint32_t part) {
+    return StrPrinter << "part_" << msn << "_" << part << ".ts";
+}
+
+void HlsMaker::getPartPosition(uint64_t &msn, uint32_t &part) const {
+    if (_last_file_name.empty()) {
+        msn = _file_index;
+        part = 0;
+        return;
+    }
+    msn = _file_index - 1;
+    part = _cur_parts.size();
+}
+
 bool HlsMaker::isLive() {
     return _seg_number != 0;
 }
 
+bool HlsMaker::isLowLatency() const {
+    return _part_duration > 0;
+}
+
 void HlsMaker::clear() {
     _file_index = 0;
     _last_seg_timestamp = 0;
     _seg_dur_list.clear();
     _last_file_name.clear();
+    _part_bytes = 0;
+    _cur_parts.clear();
+    _seg_parts.clear();
 }
 
 }//namespace mediakit
\ No newline at end of file
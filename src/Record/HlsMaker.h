@@ -13,6 +13,7 @@
 
 #include <deque>
 #include <tuple>
+#include <vector>
 #include "Common/config.h"
 #include "Util/TimeTicker.h"
 #include "Util/File.h"
@@ -27,8 +28,9 @@ public:
     /**
      * @param seg_duration 切片文件长度
      * @param seg_number 切片个数
+     * @param part_duration LL-HLS部分切片长度，为0时不生成部分切片
      */
-    HlsMaker(float seg_duration = 5, uint32_t seg_number = 3);
+    HlsMaker(float seg_duration = 5, uint32_t seg_number = 3, float part_duration = 0);
     virtual ~HlsMaker();
 
     /**
@@ -45,6 +47,11 @@ public:
      */
     bool isLive();
 
+    /**
+     * 是否生成LL-HLS部分切片
+     */
+    bool isLowLatency() const;
+
     /**
      * 清空记录
      */
@@ -84,6 +91,23 @@ protected:
      */
     virtual void onFlushLastSegment(uint32_t duration_ms) {};
 
+    /**
+     * LL-HLS部分切片生成完毕回调，部分切片的数据为上次回调以来onWriteSegment写入的数据
+     * @param msn 所属切片的序号
+     * @param part 在所属切片中的序号
+     */
+    virtual void onFlushPart(uint64_t msn, uint32_t part) {};
+
+    /**
+     * 获取LL-HLS部分切片在m3u8中的uri
+     */
+    virtual string onPartName(uint64_t msn, uint32_t part);
+
+    /**
+     * 获取未完成切片的序号以及其已生成的部分切片个数
+     */
+    void getPartPosition(uint64_t &msn, uint32_t &part) const;
+
     /**
      * 关闭上个ts切片并且写入m3u8索引
      * @param eof HLS直播是否已结束
@@ -108,7 +132,19 @@ private:
      */
     void addNewSegment(uint32_t timestamp);
 
+    /**
+     * 生成部分切片
+     * @param end_timestamp 部分切片的结束时间戳
+     */
+    void flushPart(uint32_t end_timestamp);
+
 private:
+    struct PartInfo {
+        uint32_t duration;
+        //是否以关键帧开始
+        bool independent;
+    };
+
     float _seg_duration = 0;
     uint32_t _seg_number = 0;
     uint32_t _last_timestamp = 0;
@@ -116,6 +152,15 @@ private:
     uint64_t _file_index = 0;
     string _last_file_name;
     std::deque<tuple<int,string> > _seg_dur_list;
+
+    float _part_duration = 0;
+    uint32_t _part_bytes = 0;
+    uint32_t _last_part_timestamp = 0;
+    bool _part_independent = false;
+    //未完成切片的部分切片
+    std::vector<PartInfo> _cur_parts;
+    //最近完成的切片的部分切片，与_seg_dur_list的尾部对应
+    std::deque<std::vector<PartInfo> > _seg_parts;
 };
 
 }//namespace mediakit
@@ -22,7 +22,8 @@ HlsMakerImp::HlsMakerImp(const string &m3u8_file,
                          const string &params,
                          uint32_t bufSize,
                          float seg_duration,
-                         uint32_t seg_number) : HlsMaker(seg_duration, seg_number) {
+                         uint32_t seg_number,
+                         float part_duration) : HlsMaker(seg_duration, seg_number, part_duration) {
     _path_prefix = m3u8_file.substr(0, m3u8_file.rfind('/'));
     _path_hls = m3u8_file;
     _params = params;
@@ -45,7 +46,11 @@ void HlsMakerImp::clearCache() {
         //hls直播才删除文件
         clear();
         _file = nullptr;
+        _part_buf.clear();
         _segment_file_paths.clear();
+        if (_media_src) {
+            _media_src->clearPlaylist();
+        }
         File::delete_file(_path_prefix.data());
     }
 }
@@ -92,12 +97,22 @@ void HlsMakerImp::onWriteSegment(const char *data, int len) {
     if (_file) {
         fwrite(data, len, 1, _file.get());
     }
+    if (isLowLatency()) {
+        _part_buf.append(data, len);
+    }
     if (_media_src) {
         _media_src->onSegmentSize(len);
     }
 }
 
 void HlsMakerImp::onWriteHls(const char *data, int len) {
+    if (isLowLatency() && _media_src) {
+        //LL-HLS的m3u8从内存回复，文件仍然写入
+        uint64_t msn;
+        uint32_t part;
+        getPartPosition(msn, part);
+        _media_src->setPlaylist(string(data, len), msn, part);
+    }
     auto hls = makeFile(_path_hls);
     if (hls) {
         fwrite(data, len, 1, hls.get());
@@ -120,10 +135,26 @@ void HlsMakerImp::onFlushLastSegment(uint32_t duration_ms) {
         struct stat fileData;
         stat(_info.file_path.data(), &fileData);
         _info.file_size = fileData.st_size;
+        _info.live = isLive();
         NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastRecordTs, _info);
     }
 }
 
+void HlsMakerImp::onFlushPart(uint64_t msn, uint32_t part) {
+    if (_media_src) {
+        _media_src->addPart(msn, part, std::make_shared<BufferString>(std::move(_part_buf)));
+    }
+    _part_buf.clear();
+}
+
+string HlsMakerImp::onPartName(uint64_t msn, uint32_t part) {
+    auto name = HlsMaker::onPartName(msn, part);
+    if (_params.empty()) {
+        return name;
+    }
+    return name + "?" + _params;
+}
+
 std::shared_ptr<FILE> HlsMakerImp::makeFile(const string &file, bool setbuf) {
     auto file_buf = _file_buf;
     auto ret = shared_ptr<FILE>(File::create_file(file.data(), "wb"), [file_buf](FILE *fp) {
@@ -27,7 +27,8 @@ public:
                 const string &params,
                 uint32_t bufSize  = 64 * 1024,
                 float seg_duration = 5,
-                uint32_t seg_number = 3);
+                uint32_t seg_number = 3,
+                float part_duration = 0);
 
     ~HlsMakerImp() override;
 
@@ -56,6 +57,8 @@ protected:
     void onWriteSegment(const char *data, int len) override;
     void onWriteHls(const char *data, int len) override;
     void onFlushLastSegment(uint32_t duration_ms) override;
+    void onFlushPart(uint64_t msn, uint32_t part) override;
+    string onPartName(uint64_t msn, uint32_t part) override;
 
 private:
     std::shared_ptr<FILE> makeFile(const string &file,bool setbuf = false);
@@ -66,6 +69,8 @@ private:
     string _path_hls;
     string _path_prefix;
     RecordInfo _info;
+    //LL-HLS未完成的部分切片数据
+    string _part_buf;
     std::shared_ptr<FILE> _file;
     std::shared_ptr<char> _file_buf;
     HlsMediaSource::Ptr _media_src;
@@ -12,6 +12,129 @@
 
 namespace mediakit{
 
+//内存中保留部分切片的切片个数，比m3u8中列出的多一个，防止播放器请求时已被淘汰
+static constexpr uint64_t kPartSegments = 4;
+//阻塞请求的切片序号最多超前的切片个数
+static constexpr int64_t kMaxMsnAhead = 2;
+
+void HlsMediaSource::addPart(uint64_t msn, uint32_t part, const Buffer::Ptr &data) {
+    lock_guard<mutex> lck(_mtx_part);
+    auto &parts = _parts[msn];
+    if (parts.size() <= part) {
+        parts.resize(part + 1);
+    }
+    parts[part] = data;
+    while (_parts.size() > kPartSegments) {
+        _parts.erase(_parts.begin());
+    }
+}
+
+void HlsMediaSource::setPlaylist(const string &m3u8, uint64_t msn, uint32_t part) {
+    List<pair<onData, Buffer::Ptr> > ready;
+    {
+        lock_guard<mutex> lck(_mtx_part);
+        _playlist = std::make_shared<BufferString>(m3u8);
+        _next_msn = msn;
+        _next_part = part;
+        for (auto it = _part_waiters.begin(); it != _part_waiters.end();) {
+            Buffer::Ptr data;
+            if (!checkWaiter_l(*it, data)) {
+                ++it;
+                continue;
+            }
+            ready.emplace_back(std::move(it->cb), std::move(data));
+            it = _part_waiters.erase(it);
+        }
+    }
+    ready.for_each([](const pair<onData, Buffer::Ptr> &pr) {
+        pr.first(pr.second);
+    });
+}
+
+void HlsMediaSource::clearPlaylist() {
+    //等待者的回调持有http会话的回复函数，在锁外释放
+    std::list<PartWaiter> waiters;
+    lock_guard<mutex> lck(_mtx_part);
+    _next_msn = 0;
+    _next_part = 0;
+    _playlist = nullptr;
+    _parts.clear();
+    waiters.swap(_part_waiters);
+}
+
+Buffer::Ptr HlsMediaSource::getPlaylist() const {
+    lock_guard<mutex> lck(_mtx_part);
+    return _playlist;
+}
+
+uint64_t HlsMediaSource::getPlaylist(int64_t msn, int64_t part, const onData &cb) {
+    return addWaiter(PartWaiter{0, false, msn, part, cb});
+}
+
+uint64_t HlsMediaSource::getPart(uint64_t msn, uint32_t part, const onData &cb) {
+    return addWaiter(PartWaiter{0, true, (int64_t) msn, part, cb});
+}
+
+uint64_t HlsMediaSource::addWaiter(PartWaiter waiter) {
+    Buffer::Ptr data;
+    {
+        lock_guard<mutex> lck(_mtx_part);
+        if (!checkWaiter_l(waiter, data)) {
+            waiter.id = ++_waiter_id;
+            _part_waiters.emplace_back(std::move(waiter));
+            return _part_waiters.back().id;
+        }
+    }
+    waiter.cb(data);
+    return 0;
+}
+
+void HlsMediaSource::delWaiter(uint64_t id) {
+    onData cb;
+    lock_guard<mutex> lck(_mtx_part);
+    for (auto it = _part_waiters.begin(); it != _part_waiters.end(); ++it) {
+        if (it->id == id) {
+            cb = std::move(it->cb);
+            _part_waiters.erase(it);
+            break;
+        }
+    }
+}
+
+bool HlsMediaSource::hasSegment_l(int64_t msn, int64_t part) const {
+    if (part < 0) {
+        return msn < (int64_t) _next_msn;
+    }
+    return msn < (int64_t) _next_msn || (msn == (int64_t) _next_msn && part < _next_part);
+}
+
+bool HlsMediaSource::checkWaiter_l(const PartWaiter &waiter, Buffer::Ptr &data) const {
+    if (!_playlist) {
+        //尚未生成m3u8
+        return false;
+    }
+    if (waiter.msn > (int64_t) _next_msn + kMaxMsnAhead) {
+        //超前过多，或者切片已重新开始
+        return true;
+    }
+    if (!waiter.is_part) {
+        if (waiter.msn < 0 || hasSegment_l(waiter.msn, waiter.part)) {
+            data = _playlist;
+            return true;
+        }
+        return false;
+    }
+    if (!hasSegment_l(waiter.msn, waiter.part)) {
+        return false;
+    }
+    auto it = _parts.find(waiter.msn);
+    if (it != _parts.end() && waiter.part < (int64_t) it->second.size()) {
+        data = it->second[waiter.part];
+    }
+    //已淘汰或所属切片完成时部分切片个数不足，data为空
+    return true;
+}
+
 HlsCookieData::HlsCookieData(const MediaInfo &info, const std::shared_ptr<SockInfo> &sock_info) {
     _info = info;
     _sock_info = sock_info;
@@ -21,7 +144,13 @@ HlsCookieData::HlsCookieData(const MediaInfo &info, const std::shared_ptr<SockIn
 
 void HlsCookieData::addReaderCount(){
     if(!*_added){
-        auto src = dynamic_pointer_cast<HlsMediaSource>(MediaSource::find(HLS_SCHEMA,_info._vhost,_info._app,_info._streamid));
+        auto media_src = MediaSource::find(_info._schema,_info._vhost,_info._app,_info._streamid);
+        auto src = dynamic_pointer_cast<HlsMediaSource>(media_src);
+        if(!src && media_src){
+            //CMAF(fmp4)由打包器维持观看，只统计观看时长与流量
+            *_added = true;
+            return;
+        }
         if(src){
             *_added = true;
             _ring_reader = src->getRing()->attach(EventPollerPool::Instance().getPoller());
@@ -11,8 +11,11 @@
 #ifndef ZLMEDIAKIT_HLSMEDIASOURCE_H
 #define ZLMEDIAKIT_HLSMEDIASOURCE_H
 
+#include <map>
+#include <list>
 #include <atomic>
 #include "Util/TimeTicker.h"
+#include "Network/Buffer.h"
 #include "Common/MediaSource.h"
 namespace mediakit{
 
@@ -83,11 +86,84 @@ public:
         _speed += bytes;
     }
 
+    ////////////LL-HLS，m3u8与部分切片(part)保存在内存中////////////
+
+    typedef function<void(const Buffer::Ptr &data)> onData;
+
+    /**
+     * 添加部分切片
+     * @param msn 所属切片的序号
+     * @param part 在所属切片中的序号
+     */
+    void addPart(uint64_t msn, uint32_t part, const Buffer::Ptr &data);
+
+    /**
+     * 更新m3u8，并回复已满足条件的阻塞请求
+     * @param msn 未完成切片的序号
+     * @param part 未完成切片已生成的部分切片个数
+     */
+    void setPlaylist(const string &m3u8, uint64_t msn, uint32_t part);
+
+    /**
+     * 清空内存中的m3u8与部分切片，并丢弃等待中的请求，这些请求在超时后回复
+     */
+    void clearPlaylist();
+
+    /**
+     * 获取当前的m3u8，不阻塞
+     * @return 尚未生成m3u8时返回nullptr
+     */
+    Buffer::Ptr getPlaylist() const;
+
+    /**
+     * 获取m3u8，m3u8包含指定切片(或部分切片)前阻塞
+     * @param msn 切片序号，小于0时不阻塞
+     * @param part 部分切片序号，小于0时等待整个切片完成
+     * @param cb 回调，可能在切片线程中触发；请求的切片超前过多时回调nullptr
+     * @return 阻塞时返回等待者id，超时后需通过delWaiter移除；已回调时返回0
+     */
+    uint64_t getPlaylist(int64_t msn, int64_t part, const onData &cb);
+
+    /**
+     * 获取部分切片，尚未生成时(例如EXT-X-PRELOAD-HINT)阻塞至生成
+     * @param cb 回调，可能在切片线程中触发；部分切片已淘汰或不会生成时回调nullptr
+     * @return 阻塞时返回等待者id，超时后需通过delWaiter移除；已回调时返回0
+     */
+    uint64_t getPart(uint64_t msn, uint32_t part, const onData &cb);
+
+    /**
+     * 移除超时的等待者，其回调不再触发
+     * @param id getPlaylist或getPart返回的等待者id
+     */
+    void delWaiter(uint64_t id);
+
+private:
+    struct PartWaiter {
+        uint64_t id;
+        bool is_part;
+        int64_t msn;
+        int64_t part;
+        onData cb;
+    };
+
+    bool hasSegment_l(int64_t msn, int64_t part) const;
+    //返回false表示需要继续等待
+    bool checkWaiter_l(const PartWaiter &waiter, Buffer::Ptr &data) const;
+    uint64_t addWaiter(PartWaiter waiter);
+
 private:
     bool _is_regist = false;
     RingType::Ptr _ring;
     mutex _mtx_cb;
     List<function<void()> > _list_cb;
+
+    mutable mutex _mtx_part;
+    uint64_t _next_msn = 0;
+    uint32_t _next_part = 0;
+    Buffer::Ptr _playlist;
+    map<uint64_t, vector<Buffer::Ptr> > _parts;
+    uint64_t _waiter_id = 0;
+    std::list<PartWaiter> _part_waiters;
 };
 
 class HlsCookieData{
@@ -15,14 +15,17 @@
 #include "TsMuxer.h"
 namespace mediakit {
 
-class HlsRecorder : public MediaSourceEventInterceptor, public TsMuxer, public std::enable_shared_from_this<HlsRecorder> {
+class HlsRecorder : public MediaSourceEventInterceptor, public TsMuxer, public MuxerDemandHelper, public std::enable_shared_from_this<HlsRecorder> {
 public:
     typedef std::shared_ptr<HlsRecorder> Ptr;
-    HlsRecorder(const string &m3u8_file, const string &params){
+    //默认不生成hls文件，有播放器时再生成
+    HlsRecorder(const string &m3u8_file, const string &params) : MuxerDemandHelper("hls", false) {
         GET_CONFIG(uint32_t, hlsNum, Hls::kSegmentNum);
         GET_CONFIG(uint32_t, hlsBufSize, Hls::kFileBufSize);
         GET_CONFIG(uint32_t, hlsDuration, Hls::kSegmentDuration);
-        _hls = std::make_shared<HlsMakerImp>(m3u8_file, params, hlsBufSize, hlsDuration, hlsNum);
+        GET_CONFIG(bool, lowLatency, Hls::kLowLatency);
+        GET_CONFIG(float, partDuration, Hls::kPartDuration);
+        _hls = std::make_shared<HlsMakerImp>(m3u8_file, params, hlsBufSize, hlsDuration, hlsNum, lowLatency ? partDuration : 0);
         //清空上次的残余文件
         _hls->clearCache();
     }
@@ -47,7 +50,7 @@ public:
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, hls_demand, General::kHlsDemand);
         //hls保留切片个数为0时代表为hls录制(不删除切片)，那么不管有无观看者都一直生成hls
-        _enabled = hls_demand ? (_hls->isLive() ? size : true) : true;
+        _demand.setEnabled(hls_demand ? (_hls->isLive() ? size : true) : true);
         if (!size && _hls->isLive() && hls_demand) {
             //hls直播时，如果无人观看就删除视频缓存，目的是为了防止视频跳跃
             _clear_cache = true;
@@ -58,7 +61,7 @@ public:
     bool isEnabled() {
         GET_CONFIG(bool, hls_demand, General::kHlsDemand);
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return hls_demand ? (_clear_cache ? true : _enabled) : true;
+        return hls_demand ? (_clear_cache ? true : _demand.isEnabled()) : true;
     }
 
     void inputFrame(const Frame::Ptr &frame) override {
@@ -67,19 +70,23 @@ public:
             _clear_cache = false;
             _hls->clearCache();
         }
-        if (_enabled || !hls_demand) {
+        if (_demand.isEnabled() || !hls_demand) {
             TsMuxer::inputFrame(frame);
         }
     }
 
+protected:
+    bool isDemand() const override {
+        GET_CONFIG(bool, hls_demand, General::kHlsDemand);
+        return hls_demand;
+    }
+
 private:
     void onTs(const void *packet, int bytes, uint32_t timestamp, bool is_idr_fast_packet) override {
         _hls->inputData((char *) packet, bytes, timestamp, is_idr_fast_packet);
     }
 
 private:
-    //默认不生成hls文件，有播放器时再生成
-    bool _enabled = false;
     bool _clear_cache = false;
     std::shared_ptr<HlsMakerImp> _hls;
 };
@@ -22,34 +22,26 @@ namespace mediakit {
 MP4Demuxer::MP4Demuxer() {}
 
 MP4Demuxer::~MP4Demuxer() {
-    _mov_reader = nullptr;
     closeFile();
 }
 
 void MP4Demuxer::openMP4(const string &file){
     openFile(file.data(),"rb+");
-    _mov_reader = createReader();
-    getAllTracks();
-    _duration_ms = mov_reader_getduration(_mov_reader.get());
-}
-
-int MP4Demuxer::getAllTracks() {
-    static mov_reader_trackinfo_t s_on_track = {
-            [](void *param, uint32_t track, uint8_t object, int width, int height, const void *extra, size_t bytes) {
-                //onvideo
-                MP4Demuxer *thiz = (MP4Demuxer *)param;
-                thiz->onVideoTrack(track,object,width,height,extra,bytes);
-            },
-            [](void *param, uint32_t track, uint8_t object, int channel_count, int bit_per_sample, int sample_rate, const void *extra, size_t bytes) {
-                //onaudio
-                MP4Demuxer *thiz = (MP4Demuxer *)param;
-                thiz->onAudioTrack(track,object,channel_count,bit_per_sample,sample_rate,extra,bytes);
-            },
-            [](void *param, uint32_t track, uint8_t object, const void *extra, size_t bytes) {
-                //onsubtitle, do nothing
-            }
-    };
-    return mov_reader_getinfo(_mov_reader.get(),&s_on_track,this);
+    //索引生成后不再需要mov reader，同一文件的多个解复用器共享索引
+    _index = MP4Index::get(file, *this);
+    if (!_index) {
+        throw std::runtime_error("读取mp4文件失败:" + file);
+    }
+    for (auto &track : _index->getTracks()) {
+        if (track.video) {
+            onVideoTrack(track.track_id, track.object, track.width, track.height, track.extra.data(), track.extra.size());
+        } else {
+            onAudioTrack(track.track_id, track.object, track.channel_count, track.bit_per_sample, track.sample_rate, track.extra.data(), track.extra.size());
+        }
+    }
+    _duration_ms = _index->getDurationMS();
+    _read_pos = 0;
+    _file_pos = UINT64_MAX;
 }
 
 #define SWITCH_CASE(obj_id) case obj_id : return #obj_id
@@ -145,61 +137,44 @@ void MP4Demuxer::onAudioTrack(uint32_t track_id, uint8_t object, int channel_cou
 }
 
 int64_t MP4Demuxer::seekTo(int64_t stamp_ms) {
-    if(0 != mov_reader_seek(_mov_reader.get(),&stamp_ms)){
+    if (!_index->getSampleCount()) {
         return -1;
     }
+    _read_pos = _index->seek(stamp_ms);
     return stamp_ms;
 }
 
-struct Context{
-    MP4Demuxer *thiz;
-    int flags;
-    int64_t pts;
-    int64_t dts;
-    uint32_t track_id;
-    BufferRaw::Ptr buffer;
-};
-
 #define DATA_OFFSET ADTS_HEADER_LEN
 
 Frame::Ptr MP4Demuxer::readFrame(bool &keyFrame, bool &eof) {
     keyFrame = false;
     eof = false;
-    static mov_reader_onread mov_reader_onread = [](void *param, uint32_t track_id, const void *buffer, size_t bytes, int64_t pts, int64_t dts, int flags) {
-        Context *ctx = (Context *) param;
-        ctx->pts = pts;
-        ctx->dts = dts;
-        ctx->flags = flags;
-        ctx->track_id = track_id;
-    };
-
-    static mov_onalloc mov_onalloc = [](void *param, int bytes) -> void * {
-        Context *ctx = (Context *) param;
-        ctx->buffer = ctx->thiz->_buffer_pool.obtain();
-        ctx->buffer->setCapacity(bytes + DATA_OFFSET + 1);
-        ctx->buffer->setSize(bytes + DATA_OFFSET);
-        return ctx->buffer->data() + DATA_OFFSET;
-    };
-
-    Context ctx = {this, 0};
-    auto ret = mov_reader_read2(_mov_reader.get(), mov_onalloc, mov_reader_onread, &ctx);
-    switch (ret) {
-        case 0 : {
-            eof = true;
-            return nullptr;
-        }
-
-        case 1 : {
-            keyFrame = ctx.flags & MOV_AV_FLAG_KEYFREAME;
-            return makeFrame(ctx.track_id, ctx.buffer, ctx.pts, ctx.dts);
-        }
+    if (_read_pos >= _index->getSampleCount()) {
+        eof = true;
+        return nullptr;
+    }
+    auto &sample = _index->getSamples()[_read_pos++];
+    auto buffer = readData(sample);
+    if (!buffer) {
+        eof = true;
+        return nullptr;
+    }
+    keyFrame = sample.key;
+    return makeFrame(sample.track_id, buffer, sample.dts + sample.cts, sample.dts);
+}
 
-        default : {
-            eof = true;
-            WarnL << "读取mp4文件数据失败:" << ret;
-            return nullptr;
-        }
+BufferRaw::Ptr MP4Demuxer::readData(const MP4Sample &sample) {
+    auto buffer = _buffer_pool.obtain();
+    buffer->setCapacity(sample.bytes + DATA_OFFSET + 1);
+    buffer->setSize(sample.bytes + DATA_OFFSET);
+    //顺序读取时不seek，保留文件io缓存
+    if ((_file_pos != sample.offset && 0 != onSeek(sample.offset)) || 0 != onRead(buffer->data() + DATA_OFFSET, sample.bytes)) {
+        WarnL << "读取mp4 sample失败, offset:" << sample.offset << ", size:" << sample.bytes;
+        _file_pos = UINT64_MAX;
+        return nullptr;
     }
+    _file_pos = sample.offset + sample.bytes;
+    return buffer;
 }
 
 Frame::Ptr MP4Demuxer::makeFrame(uint32_t track_id, const Buffer::Ptr &buf, int64_t pts, int64_t dts) {
@@ -263,5 +238,17 @@ uint64_t MP4Demuxer::getDurationMS() const {
     return _duration_ms;
 }
 
+const MP4Index::Ptr &MP4Demuxer::getIndex() const {
+    return _index;
+}
+
+Frame::Ptr MP4Demuxer::readSample(const MP4Sample &sample) {
+    auto buffer = readData(sample);
+    if (!buffer) {
+        return nullptr;
+    }
+    return makeFrame(sample.track_id, buffer, sample.dts + sample.cts, sample.dts);
+}
+
 }//namespace mediakit
 #endif// ENABLE_MP4
\ No newline at end of file
@@ -12,6 +12,7 @@
 #define ZLMEDIAKIT_MP4DEMUXER_H
 #ifdef ENABLE_MP4
 #include "MP4.h"
+#include "MP4Index.h"
 #include "Extension/Track.h"
 #include "Util/ResourcePool.h"
 namespace mediakit {
@@ -60,14 +61,30 @@ public:
      */
     uint64_t getDurationMS() const;
 
+    /**
+     * 获取sample索引，所有track的sample按dts排序
+     */
+    const MP4Index::Ptr &getIndex() const;
+
+    /**
+     * 读取一个sample的数据并生成帧，不影响readFrame的读取位置
+     * @param sample sample索引
+     * @return 帧数据，读取失败或track不支持时返回空
+     */
+    Frame::Ptr readSample(const MP4Sample &sample);
+
 private:
-    int getAllTracks();
+    BufferRaw::Ptr readData(const MP4Sample &sample);
     void onVideoTrack(uint32_t track_id, uint8_t object, int width, int height, const void *extra, size_t bytes);
     void onAudioTrack(uint32_t track_id, uint8_t object, int channel_count, int bit_per_sample, int sample_rate, const void *extra, size_t bytes);
     Frame::Ptr makeFrame(uint32_t track_id, const Buffer::Ptr &buf, int64_t pts, int64_t dts);
 
 private:
-    Reader _mov_reader;
+    MP4Index::Ptr _index;
+    //下一个读取的sample序号
+    size_t _read_pos = 0;
+    //文件当前读取位置，顺序读取时无需seek
+    uint64_t _file_pos = UINT64_MAX;
     uint64_t _duration_ms = 0;
     map<int, Track::Ptr> _track_to_codec;
     ResourcePool<BufferRaw> _buffer_pool;
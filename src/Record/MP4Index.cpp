@@ -0,0 +1,487 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifdef ENABLE_MP4
+#include <fcntl.h>
+#include <thread>
+#include <algorithm>
+#include <sys/stat.h>
+#include "MP4Index.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/onceToken.h"
+#include "Thread/WorkThreadPool.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+#include "Common/config.h"
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+using namespace toolkit;
+
+namespace mediakit {
+
+static_assert(sizeof(MP4Sample) == 32, "MP4Sample layout changed");
+
+//索引文件格式: IndexHeader + track信息(IndexTrack与extra数据，按8字节对齐) + MP4Sample数组 + 关键帧序号数组
+//采用本机字节序，仅作为本机缓存使用，与mp4文件大小、修改时间不符时重新生成
+static const char kIndexMagic[8] = {'Z', 'L', 'M', 'P', '4', 'I', 'D', 'X'};
+static constexpr uint32_t kIndexVersion = 1;
+static const string kIndexSuffix = ".idx";
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t track_count;
+    uint64_t file_size;
+    int64_t mtime_ns;
+    uint64_t duration_ms;
+    uint64_t sample_count;
+    uint64_t key_count;
+    //track信息总字节数
+    uint64_t track_bytes;
+};
+
+struct IndexTrack {
+    uint32_t track_id;
+    uint8_t video;
+    uint8_t object;
+    uint16_t reserved;
+    int32_t width;
+    int32_t height;
+    int32_t channel_count;
+    int32_t bit_per_sample;
+    int32_t sample_rate;
+    uint32_t extra_size;
+};
+
+static uint64_t align8(uint64_t size) {
+    return (size + 7) & ~7ULL;
+}
+
+static int64_t getMtimeNS(const struct stat &st) {
+#if defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return st.st_mtime * 1000000000LL;
+#else
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * 解析mp4文件的moov，生成索引文件格式的数据
+ */
+static string buildIndex(MP4FileIO &io, const struct stat &st) {
+    static mov_reader_trackinfo_t s_on_track = {
+            [](void *param, uint32_t track, uint8_t object, int width, int height, const void *extra, size_t bytes) {
+                //onvideo
+                auto tracks = (vector<MP4Index::Track> *) param;
+                tracks->emplace_back(MP4Index::Track{track, true, object, width, height, 0, 0, 0, bytes ? string((char *) extra, bytes) : ""});
+            },
+            [](void *param, uint32_t track, uint8_t object, int channel_count, int bit_per_sample, int sample_rate, const void *extra, size_t bytes) {
+                //onaudio
+                auto tracks = (vector<MP4Index::Track> *) param;
+                tracks->emplace_back(MP4Index::Track{track, false, object, 0, 0, channel_count, bit_per_sample, sample_rate, bytes ? string((char *) extra, bytes) : ""});
+            },
+            [](void *param, uint32_t track, uint8_t object, const void *extra, size_t bytes) {
+                //onsubtitle, do nothing
+            }
+    };
+    static mov_reader_onsample s_on_sample = [](void *param, uint32_t track, uint64_t offset, size_t bytes, int64_t pts, int64_t dts, int flags) {
+        auto samples = (vector<MP4Sample> *) param;
+        samples->emplace_back(MP4Sample{offset, dts, (uint32_t) bytes, track, (int32_t) (pts - dts), (uint8_t) ((flags & MOV_AV_FLAG_KEYFREAME) != 0), 0, 0});
+    };
+
+    vector<MP4Index::Track> tracks;
+    vector<MP4Sample> samples;
+    auto reader = io.createReader();
+    mov_reader_getinfo(reader.get(), &s_on_track, &tracks);
+    mov_reader_getsamples(reader.get(), s_on_sample, &samples);
+
+    IndexHeader header;
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.track_count = tracks.size();
+    header.file_size = st.st_size;
+    header.mtime_ns = getMtimeNS(st);
+    header.duration_ms = mov_reader_getduration(reader.get());
+    header.sample_count = samples.size();
+    header.track_bytes = 0;
+    reader = nullptr;
+
+    for (auto &sample : samples) {
+        for (auto &track : tracks) {
+            if (track.track_id == sample.track_id) {
+                sample.video = track.video;
+                break;
+            }
+        }
+    }
+    //多个track的sample按时间交织
+    std::stable_sort(samples.begin(), samples.end(), [](const MP4Sample &a, const MP4Sample &b) {
+        return a.dts < b.dts;
+    });
+
+    vector<uint32_t> keys;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (samples[i].video && samples[i].key) {
+            keys.emplace_back(i);
+        }
+    }
+    header.key_count = keys.size();
+
+    for (auto &track : tracks) {
+        header.track_bytes += align8(sizeof(IndexTrack) + track.extra.size());
+    }
+
+    string ret;
+    ret.reserve(sizeof(header) + header.track_bytes + samples.size() * sizeof(MP4Sample) + keys.size() * sizeof(uint32_t));
+    ret.append((char *) &header, sizeof(header));
+    for (auto &track : tracks) {
+        IndexTrack info = {track.track_id, track.video, track.object, 0, track.width, track.height,
+                           track.channel_count, track.bit_per_sample, track.sample_rate, (uint32_t) track.extra.size()};
+        ret.append((char *) &info, sizeof(info));
+        ret.append(track.extra);
+        ret.resize(align8(ret.size()));
+    }
+    ret.append((char *) samples.data(), samples.size() * sizeof(MP4Sample));
+    ret.append((char *) keys.data(), keys.size() * sizeof(uint32_t));
+    return ret;
+}
+
+/**
+ * 只读映射索引文件
+ */
+static std::shared_ptr<char> mapIndexFile(const string &path, uint64_t &bytes) {
+#if !defined(_WIN32)
+    int fd = open(path.data(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t) st.st_size < sizeof(IndexHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    bytes = st.st_size;
+    auto ptr = (char *) mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+    auto size = bytes;
+    return std::shared_ptr<char>(ptr, [size](char *ptr) {
+        munmap(ptr, size);
+    });
+#else
+    std::shared_ptr<FILE> fp(File::create_file(path.data(), "rb"), [](FILE *fp) {
+        if (fp) {
+            fclose(fp);
+        }
+    });
+    if (!fp) {
+        return nullptr;
+    }
+    fseek(fp.get(), 0, SEEK_END);
+    bytes = ftell(fp.get());
+    fseek(fp.get(), 0, SEEK_SET);
+    if (bytes < sizeof(IndexHeader)) {
+        return nullptr;
+    }
+    std::shared_ptr<char> ret(new char[bytes], [](char *ptr) { delete[] ptr; });
+    if (bytes != fread(ret.get(), 1, bytes, fp.get())) {
+        return nullptr;
+    }
+    return ret;
+#endif
+}
+
+/**
+ * mp4文件对应的索引文件路径，索引文件按mp4文件的绝对路径存放于record.indexPath目录下，
+ * 不与mp4文件混放，不会被当作录像列出，也不能通过http根目录访问
+ */
+static string getIndexFilePath(const string &path) {
+    GET_CONFIG(string, indexPath, Record::kIndexPath);
+    auto dir = File::absolutePath("", indexPath);
+    if (dir.empty() || dir.back() != '/') {
+        dir.push_back('/');
+    }
+    string relative = path;
+    //windows下盘符中的':'不能作为目录名
+    replace(relative, ":", "");
+    auto pos = relative.find_first_not_of('/');
+    return dir + (pos == string::npos ? relative : relative.substr(pos)) + kIndexSuffix;
+}
+
+/**
+ * 删除mp4文件已不存在的索引文件，mp4文件可能在程序未运行时或通过其他途径被删除
+ */
+static void removeOrphanIndexFiles() {
+#if !defined(_WIN32)
+    GET_CONFIG(string, indexPath, Record::kIndexPath);
+    auto dir = File::absolutePath("", indexPath);
+    if (!dir.empty() && dir.back() == '/') {
+        dir.pop_back();
+    }
+    File::scanDir(dir, [&](const string &path, bool is_dir) {
+        if (is_dir || path.size() <= dir.size()) {
+            return true;
+        }
+        if (end_with(path, ".tmp")) {
+            //保存索引文件时异常退出遗留的临时文件
+            File::delete_file(path.data());
+        } else if (end_with(path, kIndexSuffix)) {
+            auto mp4_path = path.substr(dir.size(), path.size() - dir.size() - kIndexSuffix.size());
+            if (!File::is_file(mp4_path.data())) {
+                File::delete_file(path.data());
+            }
+        }
+        return true;
+    }, true);
+#endif
+}
+
+/**
+ * 先写临时文件再改名，其他进程或线程不会读到写了一半的索引文件
+ */
+static void saveIndexFile(const string &path, const string &data) {
+    auto tmp = path + "." + to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    auto fp = File::create_file(tmp.data(), "wb");
+    if (!fp) {
+        DebugL << "创建mp4索引文件失败:" << tmp << " " << get_uv_errmsg();
+        return;
+    }
+    bool ok = data.size() == fwrite(data.data(), 1, data.size(), fp);
+    ok = (0 == fclose(fp)) && ok;
+#if defined(_WIN32)
+    File::delete_file(path.data());
+#endif
+    if (!ok || 0 != rename(tmp.data(), path.data())) {
+        WarnL << "保存mp4索引文件失败:" << path << " " << get_uv_errmsg();
+        File::delete_file(tmp.data());
+    }
+}
+
+/**
+ * 进程内的mp4索引缓存，按最近最少使用淘汰，总大小受record.indexCacheSize限制
+ */
+class MP4IndexCache {
+public:
+    static MP4IndexCache &Instance() {
+        static MP4IndexCache *s_instance = new MP4IndexCache;
+        return *s_instance;
+    }
+
+    MP4Index::Ptr find(const string &path, const struct stat &st) {
+        lock_guard<mutex> lck(_mtx);
+        auto it = _map.find(path);
+        if (it == _map.end()) {
+            return nullptr;
+        }
+        auto index = it->second->second;
+        if (index->_file_size != (uint64_t) st.st_size || index->_mtime_ns != getMtimeNS(st)) {
+            //mp4文件已被修改
+            remove_l(it->second);
+            return nullptr;
+        }
+        _lru.splice(_lru.begin(), _lru, it->second);
+        return index;
+    }
+
+    void add(const string &path, const MP4Index::Ptr &index) {
+        GET_CONFIG(uint32_t, cacheSize, Record::kIndexCacheSize);
+        uint64_t max_bytes = cacheSize * 1024ULL * 1024;
+        lock_guard<mutex> lck(_mtx);
+        auto it = _map.find(path);
+        if (it != _map.end()) {
+            remove_l(it->second);
+        }
+        if (index->_bytes > max_bytes) {
+            return;
+        }
+        _lru.emplace_front(path, index);
+        _map[path] = _lru.begin();
+        _bytes += index->_bytes;
+        while (_bytes > max_bytes) {
+            remove_l(std::prev(_lru.end()));
+        }
+    }
+
+    void clear() {
+        lock_guard<mutex> lck(_mtx);
+        _lru.clear();
+        _map.clear();
+        _bytes = 0;
+    }
+
+private:
+    typedef list<pair<string, MP4Index::Ptr> > IndexList;
+
+    MP4IndexCache() = default;
+
+    void remove_l(IndexList::iterator it) {
+        _bytes -= it->second->_bytes;
+        _map.erase(it->first);
+        _lru.erase(it);
+    }
+
+private:
+    mutex _mtx;
+    uint64_t _bytes = 0;
+    IndexList _lru;
+    unordered_map<string, IndexList::iterator> _map;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+MP4Index::Ptr MP4Index::get(const string &path, MP4FileIO &io) {
+    GET_CONFIG(bool, indexFile, Record::kIndexFile);
+    if (indexFile) {
+        static onceToken s_token([]() {
+            //首次使用索引文件时在后台清理孤立的索引文件
+            WorkThreadPool::Instance().getPoller()->async(removeOrphanIndexFiles, false);
+        });
+    }
+    struct stat st;
+    if (stat(path.data(), &st) != 0) {
+        if (indexFile) {
+            //mp4文件已被删除，一并删除其索引文件
+            File::delete_file(getIndexFilePath(path).data());
+        }
+        return nullptr;
+    }
+    auto ret = MP4IndexCache::Instance().find(path, st);
+    if (ret) {
+        return ret;
+    }
+
+    ret.reset(new MP4Index);
+    if (indexFile) {
+        //尝试加载之前生成的索引文件
+        uint64_t bytes = 0;
+        auto data = mapIndexFile(getIndexFilePath(path), bytes);
+        if (!data || !ret->parse(data, bytes) || ret->_file_size != (uint64_t) st.st_size || ret->_mtime_ns != getMtimeNS(st)) {
+            ret.reset(new MP4Index);
+        }
+    }
+
+    if (!ret->_data) {
+        auto index = buildIndex(io, st);
+        std::shared_ptr<char> data(new char[index.size()], [](char *ptr) { delete[] ptr; });
+        memcpy(data.get(), index.data(), index.size());
+        if (!ret->parse(data, index.size())) {
+            throw std::runtime_error("生成mp4索引失败:" + path);
+        }
+        if (indexFile) {
+            saveIndexFile(getIndexFilePath(path), index);
+        }
+    }
+    MP4IndexCache::Instance().add(path, ret);
+    return ret;
+}
+
+void MP4Index::clear() {
+    MP4IndexCache::Instance().clear();
+}
+
+MP4Index::~MP4Index() {}
+
+bool MP4Index::parse(const std::shared_ptr<char> &data, uint64_t bytes) {
+    if (bytes < sizeof(IndexHeader)) {
+        return false;
+    }
+    auto ptr = data.get();
+    auto header = (IndexHeader *) ptr;
+    if (memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) || header->version != kIndexVersion) {
+        return false;
+    }
+    auto samples_offset = sizeof(IndexHeader) + header->track_bytes;
+    if (header->track_bytes > bytes || header->sample_count > bytes / sizeof(MP4Sample) || header->key_count > bytes / sizeof(uint32_t) ||
+        samples_offset + header->sample_count * sizeof(MP4Sample) + header->key_count * sizeof(uint32_t) != bytes) {
+        return false;
+    }
+
+    vector<Track> tracks;
+    uint64_t offset = sizeof(IndexHeader);
+    for (uint32_t i = 0; i < header->track_count; ++i) {
+        if (offset + sizeof(IndexTrack) > samples_offset) {
+            return false;
+        }
+        auto info = (IndexTrack *) (ptr + offset);
+        if (offset + sizeof(IndexTrack) + info->extra_size > samples_offset) {
+            return false;
+        }
+        tracks.emplace_back(Track{info->track_id, info->video != 0, info->object, info->width, info->height, info->channel_count,
+                                  info->bit_per_sample, info->sample_rate, string(ptr + offset + sizeof(IndexTrack), info->extra_size)});
+        offset += align8(sizeof(IndexTrack) + info->extra_size);
+    }
+
+    auto samples = (MP4Sample *) (ptr + samples_offset);
+    auto keys = (uint32_t *) (ptr + samples_offset + header->sample_count * sizeof(MP4Sample));
+    for (uint64_t i = 0; i < header->key_count; ++i) {
+        if (keys[i] >= header->sample_count) {
+            return false;
+        }
+    }
+
+    _file_size = header->file_size;
+    _mtime_ns = header->mtime_ns;
+    _duration_ms = header->duration_ms;
+    _bytes = bytes;
+    _tracks = std::move(tracks);
+    _data = data;
+    _samples = samples;
+    _sample_count = header->sample_count;
+    _keys = keys;
+    _key_count = header->key_count;
+    return true;
+}
+
+const vector<MP4Index::Track> &MP4Index::getTracks() const {
+    return _tracks;
+}
+
+uint64_t MP4Index::getDurationMS() const {
+    return _duration_ms;
+}
+
+const MP4Sample *MP4Index::getSamples() const {
+    return _samples;
+}
+
+size_t MP4Index::getSampleCount() const {
+    return _sample_count;
+}
+
+size_t MP4Index::seek(int64_t &stamp_ms) const {
+    if (_key_count) {
+        //第一个时间戳大于stamp_ms的关键帧，与其前一个关键帧比较，取最近的
+        auto it = std::upper_bound(_keys, _keys + _key_count, stamp_ms, [this](int64_t stamp, uint32_t index) {
+            return stamp < _samples[index].dts;
+        });
+        if (it == _keys + _key_count || (it != _keys && stamp_ms - _samples[*(it - 1)].dts <= _samples[*it].dts - stamp_ms)) {
+            --it;
+        }
+        stamp_ms = _samples[*it].dts;
+    }
+    //时间戳相同的音频sample排在视频关键帧之前，也一并读取
+    auto sample = std::lower_bound(_samples, _samples + _sample_count, stamp_ms, [](const MP4Sample &sample, int64_t stamp) {
+        return sample.dts < stamp;
+    });
+    if (!_key_count && sample != _samples + _sample_count) {
+        stamp_ms = sample->dts;
+    }
+    return sample - _samples;
+}
+
+}//namespace mediakit
+#endif//ENABLE_MP4
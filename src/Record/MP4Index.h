@@ -0,0 +1,122 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4INDEX_H
+#define ZLMEDIAKIT_MP4INDEX_H
+
+#ifdef ENABLE_MP4
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "MP4.h"
+using namespace std;
+
+namespace mediakit {
+
+//sample索引，不包含sample数据，与索引文件中的布局一致
+struct MP4Sample {
+    //sample数据在文件中的偏移量
+    uint64_t offset;
+    //单位毫秒
+    int64_t dts;
+    uint32_t bytes;
+    uint32_t track_id;
+    int32_t cts;
+    uint8_t key;
+    //是否为视频track的sample
+    uint8_t video;
+    uint16_t reserved;
+};
+
+/**
+ * mp4文件的track信息与按dts排序的sample索引，内容不可变，多个读取者共享
+ * 生成一次后缓存于内存，开启record.indexFile时保存为record.indexPath目录下的.idx索引文件，
+ * 之后打开时直接mmap索引文件，不再解析moov；seek为关键帧上的二分查找
+ */
+class MP4Index {
+public:
+    typedef std::shared_ptr<MP4Index> Ptr;
+
+    struct Track {
+        uint32_t track_id;
+        bool video;
+        uint8_t object;
+        //视频有效
+        int width;
+        int height;
+        //音频有效
+        int channel_count;
+        int bit_per_sample;
+        int sample_rate;
+        string extra;
+    };
+
+    /**
+     * 获取mp4文件的索引，依次查找内存缓存、索引文件，都未命中时通过mov reader解析mp4文件生成
+     * @param path mp4文件路径
+     * @param io 已打开的mp4文件，用于生成索引
+     * @return 文件不存在时返回空，mp4解析失败时抛异常
+     */
+    static Ptr get(const string &path, MP4FileIO &io);
+
+    /**
+     * 清空内存缓存
+     */
+    static void clear();
+
+    ~MP4Index();
+
+    const vector<Track> &getTracks() const;
+
+    /**
+     * 文件长度，单位毫秒
+     */
+    uint64_t getDurationMS() const;
+
+    /**
+     * 所有track的sample，按dts排序
+     */
+    const MP4Sample *getSamples() const;
+    size_t getSampleCount() const;
+
+    /**
+     * 定位至离stamp_ms最近的视频关键帧(无视频时为sample)
+     * @param stamp_ms 预期的时间轴位置，返回实际位置
+     * @return 开始读取的sample序号，等于getSampleCount()时表示已到文件末尾
+     */
+    size_t seek(int64_t &stamp_ms) const;
+
+private:
+    friend class MP4IndexCache;
+    MP4Index() = default;
+    bool parse(const std::shared_ptr<char> &data, uint64_t bytes);
+
+private:
+    uint64_t _file_size = 0;
+    int64_t _mtime_ns = 0;
+    uint64_t _duration_ms = 0;
+    uint64_t _bytes = 0;
+    vector<Track> _tracks;
+    //索引数据，内存或mmap映射
+    std::shared_ptr<char> _data;
+    const MP4Sample *_samples = nullptr;
+    size_t _sample_count = 0;
+    //视频关键帧在_samples中的序号
+    const uint32_t *_keys = nullptr;
+    size_t _key_count = 0;
+};
+
+}//namespace mediakit
+#endif//ENABLE_MP4
+#endif //ZLMEDIAKIT_MP4INDEX_H
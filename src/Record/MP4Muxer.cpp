@@ -87,7 +87,7 @@ void MP4MuxerInterface::inputFrame(const Frame::Ptr &frame) {
 
     switch (frame->getCodecId()) {
         case CodecH264: {
-            int type = H264_TYPE(*((uint8_t *)frame->data() + frame->prefixSize()));
+            int type = H264_TYPE(frame->byteAt(frame->prefixSize()));
             if(type == H264Frame::NAL_SEI){
                 break;
             }
@@ -95,39 +95,7 @@ void MP4MuxerInterface::inputFrame(const Frame::Ptr &frame) {
         case CodecH265: {
             //这里的代码逻辑是让SPS、PPS、IDR这些时间戳相同的帧打包到一起当做一个帧处理，
             if (!_frameCached.empty() && _frameCached.back()->dts() != frame->dts()) {
-                Frame::Ptr back = _frameCached.back();
-                //求相对时间戳
-                track_info.stamp.revise(back->dts(), back->pts(), dts_out, pts_out);
-
-                if (_frameCached.size() != 1) {
-                    //缓存中有多帧，需要按照mp4格式合并一起
-                    BufferLikeString merged;
-                    merged.reserve(back->size() + 1024);
-                    _frameCached.for_each([&](const Frame::Ptr &frame) {
-                        uint32_t nalu_size = frame->size() - frame->prefixSize();
-                        nalu_size = htonl(nalu_size);
-                        merged.append((char *) &nalu_size, 4);
-                        merged.append(frame->data() + frame->prefixSize(), frame->size() - frame->prefixSize());
-                    });
-                    mp4_writer_write(_mov_writter.get(),
-                                       track_info.track_id,
-                                       merged.data(),
-                                       merged.size(),
-                                       pts_out,
-                                       dts_out,
-                                       back->keyFrame() ? MOV_AV_FLAG_KEYFREAME : 0);
-                } else {
-                    //缓存中只有一帧视频
-                    mp4_writer_write_l(_mov_writter.get(),
-                                       track_info.track_id,
-                                       back->data() + back->prefixSize(),
-                                       back->size() - back->prefixSize(),
-                                       pts_out,
-                                       dts_out,
-                                       back->keyFrame() ? MOV_AV_FLAG_KEYFREAME : 0,
-                                       1/*需要生成头4个字节的MP4格式start code*/);
-                }
-                _frameCached.clear();
+                writeCachedVideo(track_info);
             }
             //缓存帧，时间戳相同的帧合并一起写入mp4
             _frameCached.emplace_back(Frame::getCacheAbleFrame(frame));
@@ -147,6 +115,65 @@ void MP4MuxerInterface::inputFrame(const Frame::Ptr &frame) {
     }
 }
 
+void MP4MuxerInterface::writeCachedVideo(track_info &track_info) {
+    Frame::Ptr back = _frameCached.back();
+    //求相对时间戳
+    int64_t dts_out, pts_out;
+    track_info.stamp.revise(back->dts(), back->pts(), dts_out, pts_out);
+
+    if (_frameCached.size() != 1) {
+        //缓存中有多帧，需要按照mp4格式合并一起
+        BufferLikeString merged;
+        merged.reserve(back->size() + 1024);
+        _frameCached.for_each([&](const Frame::Ptr &frame) {
+            uint32_t nalu_size = frame->size() - frame->prefixSize();
+            nalu_size = htonl(nalu_size);
+            merged.append((char *) &nalu_size, 4);
+            //分片帧直接从各个分片拷贝，不合并分片
+            frame->forEachSlice(frame->prefixSize(), [&](const char *ptr, uint32_t size) {
+                merged.append(ptr, size);
+            });
+        });
+        mp4_writer_write(_mov_writter.get(),
+                         track_info.track_id,
+                         merged.data(),
+                         merged.size(),
+                         pts_out,
+                         dts_out,
+                         back->keyFrame() ? MOV_AV_FLAG_KEYFREAME : 0);
+    } else {
+        //缓存中只有一帧视频
+        mp4_writer_write_l(_mov_writter.get(),
+                           track_info.track_id,
+                           back->data() + back->prefixSize(),
+                           back->size() - back->prefixSize(),
+                           pts_out,
+                           dts_out,
+                           back->keyFrame() ? MOV_AV_FLAG_KEYFREAME : 0,
+                           1/*需要生成头4个字节的MP4格式start code*/);
+    }
+    _frameCached.clear();
+}
+
+void MP4MuxerInterface::setPlayBack(bool playback) {
+    _playback = playback;
+}
+
+bool MP4MuxerInterface::isPlayBack() const {
+    return _playback;
+}
+
+void MP4MuxerInterface::flush() {
+    if (_frameCached.empty()) {
+        return;
+    }
+    auto it = _codec_to_trackid.find(_frameCached.back()->getCodecId());
+    if (it != _codec_to_trackid.end()) {
+        writeCachedVideo(it->second);
+    }
+    _frameCached.clear();
+}
+
 static uint8_t getObject(CodecId codecId){
     switch (codecId){
         case CodecG711A : return MOV_OBJECT_G711a;
@@ -313,6 +340,11 @@ void MP4MuxerInterface::addTrack(const Track::Ptr &track) {
         default: WarnL << "MP4录制不支持该编码格式:" << track->getCodecName(); break;
     }
 
+    auto it = _codec_to_trackid.find(track->getCodecId());
+    if (it != _codec_to_trackid.end()) {
+        it->second.stamp.setPlayBack(_playback);
+    }
+
     //尝试音视频同步
     stampSync();
 }
@@ -324,7 +356,8 @@ MP4MuxerMemory::MP4MuxerMemory() {
 }
 
 MP4FileIO::Writer MP4MuxerMemory::createWriter() {
-    return _memory_file->createWriter(MOV_FLAG_SEGMENT, true);
+    //点播时tfdt需与输入时间戳一致，各切片才能独立生成
+    return _memory_file->createWriter(MOV_FLAG_SEGMENT | (isPlayBack() ? MOV_FLAG_ABSOLUTE_TFDT : 0), true);
 }
 
 const string &MP4MuxerMemory::getInitSegment(){
@@ -336,6 +369,19 @@ const string &MP4MuxerMemory::getInitSegment(){
     return _init_segment;
 }
 
+void MP4MuxerMemory::flush() {
+    if (_init_segment.empty()) {
+        return;
+    }
+    MP4MuxerInterface::flush();
+    saveSegment();
+    auto segment = _memory_file->getAndClearMemory();
+    if (!segment.empty()) {
+        onSegmentData(segment, 0, _key_frame);
+    }
+    _key_frame = false;
+}
+
 void MP4MuxerMemory::resetTracks(){
     MP4MuxerInterface::resetTracks();
     _memory_file = std::make_shared<MP4FileMemory>();
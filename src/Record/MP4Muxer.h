@@ -58,8 +58,20 @@ public:
      */
     void initSegment();
 
+    /**
+     * 设置为点播模式，直接使用输入的时间戳，不转换为从0开始的相对时间戳
+     * 请在addTrack之前调用
+     */
+    void setPlayBack(bool playback = true);
+
+    /**
+     * 写入缓存中的最后一帧视频，用于点播切片结束时
+     */
+    virtual void flush();
+
 protected:
     virtual MP4FileIO::Writer createWriter() = 0;
+    bool isPlayBack() const;
 
 private:
     void stampSync();
@@ -67,11 +79,16 @@ private:
 private:
     bool _started = false;
     bool _have_video = false;
+    bool _playback = false;
     MP4FileIO::Writer _mov_writter;
     struct track_info {
         int track_id = -1;
         Stamp stamp;
     };
+    //合并时间戳相同的视频帧并写入
+    void writeCachedVideo(track_info &track);
+
+private:
     List<Frame::Ptr> _frameCached;
     unordered_map<int, track_info> _codec_to_trackid;
 };
@@ -127,6 +144,11 @@ public:
      */
     const string &getInitSegment();
 
+    /**
+     * 写入缓存的帧并输出最后一个切片
+     */
+    void flush() override;
+
 protected:
     /**
      * 输出fmp4切片回调函数
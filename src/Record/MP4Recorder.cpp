@@ -12,6 +12,7 @@
 #include <ctime>
 #include <sys/stat.h>
 #include "Common/config.h"
+#include "Common/MediaMetrics.h"
 #include "MP4Recorder.h"
 #include "Thread/WorkThreadPool.h"
 
@@ -96,6 +97,7 @@ void MP4Recorder::closeFile() {
 }
 
 void MP4Recorder::inputFrame(const Frame::Ptr &frame) {
+    MetricTimer timer(MediaMetrics::Instance().record_write);
     GET_CONFIG(uint32_t,recordSec,Record::kFileSecond);
     if(!_muxer || ((_createFileTicker.elapsedTime() > recordSec * 1000) &&
                   (!_haveVideo || (_haveVideo && frame->keyFrame()))) ){
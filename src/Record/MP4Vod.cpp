@@ -0,0 +1,433 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifdef ENABLE_MP4
+#include <sys/stat.h>
+#include "MP4Vod.h"
+#include "TsMuxer.h"
+#include "MP4Muxer.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Thread/WorkThreadPool.h"
+
+namespace mediakit {
+
+//同时保持打开的mp4文件个数，每个文件保留其sample索引
+static constexpr size_t kMaxVodFiles = 16;
+
+static const string kTsM3u8 = "vod.m3u8";
+static const string kFmp4M3u8 = "vod_fmp4.m3u8";
+static const string kFmp4Init = "init.mp4";
+
+static int64_t getMtimeNS(const struct stat &st) {
+#if defined(__APPLE__)
+    return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return st.st_mtime * 1000000000LL;
+#else
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * 解析切片文件名，例如12.ts
+ */
+static bool parseSegmentName(const string &name, const string &suffix, size_t &index) {
+    if (name.size() <= suffix.size() || !end_with(name, suffix)) {
+        return false;
+    }
+    index = 0;
+    for (size_t i = 0; i < name.size() - suffix.size(); ++i) {
+        if (name[i] < '0' || name[i] > '9' || i >= 9) {
+            return false;
+        }
+        index = index * 10 + (name[i] - '0');
+    }
+    return true;
+}
+
+//收集mpegts切片数据
+class VodTsMuxer : public TsMuxer {
+public:
+    VodTsMuxer() = default;
+    ~VodTsMuxer() override = default;
+
+    string &getData() {
+        return _data;
+    }
+
+protected:
+    void onTs(const void *packet, int bytes, uint32_t timestamp, bool is_idr_fast_packet) override {
+        _data.append((char *) packet, bytes);
+    }
+
+private:
+    string _data;
+};
+
+//收集fmp4切片数据，每个切片只生成一个moof
+class VodFmp4Muxer : public MP4MuxerMemory {
+public:
+    VodFmp4Muxer() = default;
+    ~VodFmp4Muxer() override = default;
+
+    void inputFrame(const Frame::Ptr &frame) override {
+        //不按关键帧或时长拆分fragment
+        MP4MuxerInterface::inputFrame(frame);
+    }
+
+    string &getData() {
+        return _data;
+    }
+
+protected:
+    void onSegmentData(const string &string, uint32_t stamp, bool key_frame) override {
+        _data.append(string);
+    }
+
+private:
+    string _data;
+};
+
+class MP4VodFile {
+public:
+    typedef std::shared_ptr<MP4VodFile> Ptr;
+
+    /**
+     * 打开mp4文件并按关键帧生成切片索引，失败时抛异常
+     */
+    MP4VodFile(const string &path, const struct stat &st) {
+        GET_CONFIG(uint32_t, segDur, Hls::kSegmentDuration);
+        _path = path;
+        _size = st.st_size;
+        _mtime_ns = getMtimeNS(st);
+        _version = _path + "?" + to_string(_size) + "_" + to_string(_mtime_ns);
+
+        _demuxer = std::make_shared<MP4Demuxer>();
+        _demuxer->openMP4(path);
+        _index = _demuxer->getIndex();
+        _samples = _index->getSamples();
+        _sample_count = _index->getSampleCount();
+        if (!_sample_count) {
+            throw std::runtime_error("mp4文件不包含任何sample");
+        }
+
+        bool have_video = false;
+        for (auto &track : _index->getTracks()) {
+            if (track.video) {
+                have_video = true;
+                break;
+            }
+        }
+
+        size_t begin = 0;
+        auto seg_ms = MAX(segDur, 1u) * 1000;
+        for (size_t i = 1; i < _sample_count; ++i) {
+            auto &sample = _samples[i];
+            if (have_video && !(sample.video && sample.key)) {
+                //有视频时只在关键帧处切片
+                continue;
+            }
+            if (sample.dts - _samples[begin].dts < seg_ms) {
+                continue;
+            }
+            _segments.emplace_back(Segment{begin, i, _samples[begin].dts, sample.dts - _samples[begin].dts});
+            begin = i;
+        }
+        auto start_dts = _samples[begin].dts;
+        auto duration = MAX(_samples[_sample_count - 1].dts - start_dts, (int64_t) _demuxer->getDurationMS() - start_dts);
+        _segments.emplace_back(Segment{begin, _sample_count, start_dts, MAX(duration, (int64_t) 1)});
+    }
+
+    /**
+     * 文件是否已被修改
+     */
+    bool isChanged(const struct stat &st) const {
+        return (uint64_t) st.st_size != _size || getMtimeNS(st) != _mtime_ns;
+    }
+
+    const string &getPath() const {
+        return _path;
+    }
+
+    /**
+     * 文件版本，文件被修改后版本改变，旧切片缓存不再命中
+     */
+    const string &getVersion() const {
+        return _version;
+    }
+
+    /**
+     * 生成虚拟文件
+     * @return 文件名无效或切片失败时返回空
+     */
+    Buffer::Ptr makeFile(const string &name) {
+        size_t index;
+        string ret;
+        if (name == kTsM3u8) {
+            ret = makeM3u8(false);
+        } else if (name == kFmp4M3u8) {
+            ret = makeM3u8(true);
+        } else if (name == kFmp4Init) {
+            lock_guard<mutex> lck(_mtx);
+            VodFmp4Muxer muxer;
+            addTracks(muxer);
+            ret = muxer.getInitSegment();
+        } else if (parseSegmentName(name, ".ts", index) && index < _segments.size()) {
+            lock_guard<mutex> lck(_mtx);
+            VodTsMuxer muxer;
+            inputSegment(muxer, addTracks(muxer), _segments[index]);
+            ret = std::move(muxer.getData());
+        } else if (parseSegmentName(name, ".m4s", index) && index < _segments.size()) {
+            lock_guard<mutex> lck(_mtx);
+            VodFmp4Muxer muxer;
+            auto tracks = addTracks(muxer);
+            //生成init segment后才能输出切片
+            muxer.getInitSegment();
+            inputSegment(muxer, tracks, _segments[index]);
+            ret = std::move(muxer.getData());
+        }
+        if (ret.empty()) {
+            return nullptr;
+        }
+        return std::make_shared<BufferString>(std::move(ret));
+    }
+
+private:
+    struct Segment {
+        //[begin, end)为切片包含的sample
+        size_t begin;
+        size_t end;
+        int64_t start_dts;
+        int64_t duration;
+    };
+
+    string makeM3u8(bool fmp4) const {
+        char line[256];
+        int64_t max_duration = 0;
+        for (auto &seg : _segments) {
+            max_duration = MAX(max_duration, seg.duration);
+        }
+        string m3u8;
+        m3u8.reserve(128 + _segments.size() * 32);
+        snprintf(line, sizeof(line),
+                 "#EXTM3U\n"
+                 "#EXT-X-VERSION:%d\n"
+                 "#EXT-X-PLAYLIST-TYPE:VOD\n"
+                 "#EXT-X-TARGETDURATION:%u\n"
+                 "#EXT-X-MEDIA-SEQUENCE:0\n",
+                 fmp4 ? 7 : 3,
+                 (uint32_t) ((max_duration + 999) / 1000));
+        m3u8.append(line);
+        if (fmp4) {
+            m3u8.append("#EXT-X-MAP:URI=\"" + kFmp4Init + "\"\n");
+        }
+        for (size_t i = 0; i < _segments.size(); ++i) {
+            snprintf(line, sizeof(line), "#EXTINF:%.3f,\n%zu%s\n", _segments[i].duration / 1000.0, i, fmp4 ? ".m4s" : ".ts");
+            m3u8.append(line);
+        }
+        m3u8.append("#EXT-X-ENDLIST\n");
+        return m3u8;
+    }
+
+    /**
+     * 每个切片使用新的track，使得h264/h265关键帧前插入sps/pps
+     * @return 编码类型与track的对应关系
+     */
+    template<typename Muxer>
+    unordered_map<int, Track::Ptr> addTracks(Muxer &muxer) {
+        unordered_map<int, Track::Ptr> ret;
+        muxer.setPlayBack();
+        for (auto &track : _demuxer->getTracks(true)) {
+            auto clone = track->clone();
+            muxer.addTrack(clone);
+            clone->addDelegate(std::make_shared<FrameWriterInterfaceHelper>([&muxer](const Frame::Ptr &frame) {
+                muxer.inputFrame(frame);
+            }));
+            ret[clone->getCodecId()] = clone;
+        }
+        return ret;
+    }
+
+    template<typename Muxer>
+    void inputSegment(Muxer &muxer, const unordered_map<int, Track::Ptr> &tracks, const Segment &seg) {
+        for (auto i = seg.begin; i < seg.end; ++i) {
+            auto frame = _demuxer->readSample(_samples[i]);
+            if (!frame) {
+                continue;
+            }
+            auto it = tracks.find(frame->getCodecId());
+            if (it != tracks.end()) {
+                it->second->inputFrame(frame);
+            }
+        }
+        muxer.flush();
+    }
+
+private:
+    string _path;
+    string _version;
+    uint64_t _size;
+    int64_t _mtime_ns;
+    //demuxer的读取位置不能被多个线程同时修改
+    mutex _mtx;
+    MP4Demuxer::Ptr _demuxer;
+    //sample索引由多个解复用器共享
+    MP4Index::Ptr _index;
+    const MP4Sample *_samples;
+    size_t _sample_count;
+    vector<Segment> _segments;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+MP4Vod &MP4Vod::Instance() {
+    //后台线程中的切片任务引用了本对象，故不释放
+    static MP4Vod *s_instance = new MP4Vod;
+    return *s_instance;
+}
+
+bool MP4Vod::parsePath(const string &path, string &mp4_path, string &name) {
+    auto pos = path.rfind('/');
+    if (pos == string::npos || pos < 4) {
+        return false;
+    }
+    auto file = path.substr(pos + 1);
+    size_t index;
+    if (file != kTsM3u8 && file != kFmp4M3u8 && file != kFmp4Init &&
+        !parseSegmentName(file, ".ts", index) && !parseSegmentName(file, ".m4s", index)) {
+        return false;
+    }
+    if (strcasecmp(path.substr(pos - 4, 4).data(), ".mp4") != 0) {
+        return false;
+    }
+    auto dir = path.substr(0, pos);
+    if (!File::is_file(dir.data())) {
+        return false;
+    }
+    mp4_path = std::move(dir);
+    name = std::move(file);
+    return true;
+}
+
+std::shared_ptr<MP4VodFile> MP4Vod::getVodFile(const string &mp4_path) {
+    struct stat st;
+    if (stat(mp4_path.data(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return nullptr;
+    }
+    {
+        lock_guard<mutex> lck(_mtx);
+        for (auto it = _files.begin(); it != _files.end(); ++it) {
+            if ((*it)->getPath() != mp4_path) {
+                continue;
+            }
+            if ((*it)->isChanged(st)) {
+                //文件已被修改(例如正在录制)，重新生成索引
+                _files.erase(it);
+                break;
+            }
+            _files.splice(_files.begin(), _files, it);
+            return _files.front();
+        }
+    }
+
+    MP4VodFile::Ptr file;
+    try {
+        file = std::make_shared<MP4VodFile>(mp4_path, st);
+    } catch (std::exception &ex) {
+        WarnL << "mp4点播打开文件失败:" << mp4_path << ", " << ex.what();
+        return nullptr;
+    }
+
+    lock_guard<mutex> lck(_mtx);
+    _files.emplace_front(file);
+    if (_files.size() > kMaxVodFiles) {
+        _files.pop_back();
+    }
+    return file;
+}
+
+void MP4Vod::getFileAsync(const string &mp4_path, const string &name, const onGetFile &cb) {
+    WorkThreadPool::Instance().getPoller()->async([this, mp4_path, name, cb]() {
+        auto file = getVodFile(mp4_path);
+        if (!file) {
+            cb(nullptr);
+            return;
+        }
+        auto key = file->getVersion() + "/" + name;
+        {
+            lock_guard<mutex> lck(_mtx);
+            auto data = findCache_l(key);
+            if (data) {
+                cb(data);
+                return;
+            }
+            auto &waiters = _pending[key];
+            waiters.emplace_back(cb);
+            if (waiters.size() > 1) {
+                //该切片正在被其他线程生成
+                return;
+            }
+        }
+
+        auto data = file->makeFile(name);
+        vector<onGetFile> waiters;
+        {
+            GET_CONFIG(uint32_t, cacheSize, Record::kVodCacheSize);
+            lock_guard<mutex> lck(_mtx);
+            if (data) {
+                addCache_l(key, data, cacheSize * 1024ULL * 1024);
+            }
+            waiters.swap(_pending[key]);
+            _pending.erase(key);
+        }
+        for (auto &waiter : waiters) {
+            waiter(data);
+        }
+    });
+}
+
+Buffer::Ptr MP4Vod::findCache_l(const string &key) {
+    auto it = _cache_map.find(key);
+    if (it == _cache_map.end()) {
+        return nullptr;
+    }
+    _cache.splice(_cache.begin(), _cache, it->second);
+    return it->second->second;
+}
+
+void MP4Vod::addCache_l(const string &key, const Buffer::Ptr &data, uint64_t max_bytes) {
+    if (data->size() > max_bytes / 4 || _cache_map.find(key) != _cache_map.end()) {
+        //缓存关闭、切片太大或已缓存
+        return;
+    }
+    _cache.emplace_front(key, data);
+    _cache_map[key] = _cache.begin();
+    _cache_bytes += data->size();
+    while (_cache_bytes > max_bytes) {
+        auto &back = _cache.back();
+        _cache_bytes -= back.second->size();
+        _cache_map.erase(back.first);
+        _cache.pop_back();
+    }
+}
+
+void MP4Vod::clear() {
+    lock_guard<mutex> lck(_mtx);
+    _cache_bytes = 0;
+    _cache.clear();
+    _cache_map.clear();
+    _files.clear();
+}
+
+}//namespace mediakit
+#endif//ENABLE_MP4
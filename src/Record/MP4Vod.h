@@ -0,0 +1,85 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_MP4VOD_H
+#define ZLMEDIAKIT_MP4VOD_H
+
+#ifdef ENABLE_MP4
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "MP4Demuxer.h"
+#include "Network/Buffer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+class MP4VodFile;
+
+/**
+ * 录制的mp4文件按需切片为hls点播，不预先生成任何文件
+ * 通过mp4文件下的虚拟路径访问:
+ * xxx.mp4/vod.m3u8、xxx.mp4/<序号>.ts 为mpegts切片；
+ * xxx.mp4/vod_fmp4.m3u8、xxx.mp4/init.mp4、xxx.mp4/<序号>.m4s 为fmp4切片
+ * 切片在视频关键帧处切分，时长参考hls.segDur，生成的切片缓存于内存，总大小受record.vodCacheSize限制
+ */
+class MP4Vod {
+public:
+    typedef function<void(const Buffer::Ptr &data)> onGetFile;
+
+    static MP4Vod &Instance();
+
+    /**
+     * 解析mp4点播虚拟路径
+     * @param path 请求的文件绝对路径
+     * @param mp4_path 解析得到的mp4文件路径
+     * @param name 解析得到的虚拟文件名，例如vod.m3u8、0.ts
+     * @return 是否为mp4点播虚拟路径且mp4文件存在
+     */
+    static bool parsePath(const string &path, string &mp4_path, string &name);
+
+    /**
+     * 异步获取虚拟文件内容，在后台线程切片，同一切片的并发请求只切片一次
+     * @param mp4_path mp4文件路径
+     * @param name 虚拟文件名
+     * @param cb 回调，在后台线程触发，文件不存在或切片失败时为空
+     */
+    void getFileAsync(const string &mp4_path, const string &name, const onGetFile &cb);
+
+    /**
+     * 清空打开的mp4文件与切片缓存
+     */
+    void clear();
+
+private:
+    MP4Vod() = default;
+    std::shared_ptr<MP4VodFile> getVodFile(const string &mp4_path);
+    Buffer::Ptr findCache_l(const string &key);
+    void addCache_l(const string &key, const Buffer::Ptr &data, uint64_t max_bytes);
+
+private:
+    typedef list<pair<string, Buffer::Ptr> > CacheList;
+
+    mutex _mtx;
+    uint64_t _cache_bytes = 0;
+    CacheList _cache;
+    unordered_map<string, CacheList::iterator> _cache_map;
+    //正在生成中的切片及其等待者
+    unordered_map<string, vector<onGetFile> > _pending;
+    list<std::shared_ptr<MP4VodFile> > _files;
+};
+
+}//namespace mediakit
+#endif//ENABLE_MP4
+#endif //ZLMEDIAKIT_MP4VOD_H
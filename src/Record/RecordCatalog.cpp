@@ -0,0 +1,590 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include <unordered_set>
+#include <sys/stat.h>
+#include "RecordCatalog.h"
+#include "Common/config.h"
+#include "Util/File.h"
+#include "Util/util.h"
+#include "Util/uv_errno.h"
+#include "Util/logger.h"
+#include "Util/TimeTicker.h"
+#include "Util/NoticeCenter.h"
+#include "Thread/WorkThreadPool.h"
+using namespace toolkit;
+
+#if defined(_WIN32)
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+namespace mediakit {
+
+//每块的记录数，追加记录时只复制被修改的块，超过两倍时分裂
+static constexpr size_t kChunkSize = 256;
+
+typedef vector<RecordSegment> Chunk;
+
+struct RecordCatalog::StreamList {
+    //按开始时间排序，每块都不为空
+    vector<std::shared_ptr<const Chunk> > chunks;
+    //最长的录像时长，查询时据此向前扩展查找范围
+    float max_len = 0;
+};
+
+struct RecordCatalog::Stream {
+    std::shared_ptr<const StreamList> list = std::make_shared<StreamList>();
+};
+
+static string getStreamKey(const string &vhost, const string &app, const string &stream) {
+    GET_CONFIG(bool, enableVhost, General::kEnableVhost);
+    return (enableVhost && !vhost.empty() ? vhost : DEFAULT_VHOST) + "/" + app + "/" + stream;
+}
+
+static bool startBefore(time_t start_time, const RecordSegment &segment) {
+    return start_time < segment.start_time;
+}
+
+static bool chunkStartBefore(time_t start_time, const std::shared_ptr<const Chunk> &chunk) {
+    return start_time < chunk->front().start_time;
+}
+
+static bool segmentBefore(const RecordSegment &lhs, const RecordSegment &rhs) {
+    return lhs.start_time < rhs.start_time;
+}
+
+//从按开始时间排序的记录生成列表
+std::shared_ptr<RecordCatalog::StreamList> RecordCatalog::makeStreamList(const vector<RecordSegment> &segments) {
+    auto ret = std::make_shared<StreamList>();
+    for (size_t i = 0; i < segments.size(); i += kChunkSize) {
+        auto end = MIN(segments.size(), i + kChunkSize);
+        ret->chunks.emplace_back(std::make_shared<Chunk>(segments.begin() + i, segments.begin() + end));
+    }
+    for (auto &segment : segments) {
+        ret->max_len = MAX(ret->max_len, segment.time_len);
+    }
+    return ret;
+}
+
+//插入一条记录，返回新的列表，原列表不变
+std::shared_ptr<const RecordCatalog::StreamList> RecordCatalog::insertSegment(const StreamList &old, const RecordSegment &segment) {
+    auto ret = std::make_shared<StreamList>(old);
+    ret->max_len = MAX(ret->max_len, segment.time_len);
+    auto &chunks = ret->chunks;
+    if (chunks.empty()) {
+        chunks.emplace_back(std::make_shared<Chunk>(1, segment));
+        return ret;
+    }
+    //首条记录不晚于该记录的最后一块，录像一般按时间顺序完成，通常为最后一块
+    auto it = upper_bound(chunks.begin(), chunks.end(), segment.start_time, chunkStartBefore);
+    if (it != chunks.begin()) {
+        --it;
+    }
+    auto chunk = std::make_shared<Chunk>(**it);
+    //同一文件重复添加时替换旧记录
+    chunk->erase(remove_if(chunk->begin(), chunk->end(), [&](const RecordSegment &item) {
+        return item.file_path == segment.file_path && item.type == segment.type;
+    }), chunk->end());
+    chunk->insert(upper_bound(chunk->begin(), chunk->end(), segment.start_time, startBefore), segment);
+    if (chunk->size() < 2 * kChunkSize) {
+        *it = chunk;
+        return ret;
+    }
+    auto tail = std::make_shared<Chunk>(chunk->begin() + kChunkSize, chunk->end());
+    chunk->resize(kChunkSize);
+    *it = chunk;
+    chunks.insert(it + 1, tail);
+    return ret;
+}
+
+RecordCatalog &RecordCatalog::Instance() {
+    static RecordCatalog *instance = new RecordCatalog;
+    return *instance;
+}
+
+void RecordCatalog::start() {
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (_started) {
+            return;
+        }
+        _started = true;
+    }
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastRecordMP4, [this](BroadcastRecordMP4Args) {
+        add(Recorder::type_mp4, info);
+    });
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastRecordTs, [this](BroadcastRecordTsArgs) {
+        add(Recorder::type_hls, info);
+    });
+    //扫描录像目录可能比较耗时，在后台线程执行
+    WorkThreadPool::Instance().getExecutor()->async([this]() {
+        rebuild();
+    });
+}
+
+void RecordCatalog::stop() {
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastRecordMP4);
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastRecordTs);
+    lock_guard<mutex> lck(_mtx);
+    _journal = nullptr;
+}
+
+bool RecordCatalog::isReady() const {
+    lock_guard<mutex> lck(_mtx);
+    return _ready;
+}
+
+void RecordCatalog::add(Recorder::type type, const RecordInfo &info) {
+    if (info.live) {
+        //hls直播切片很快会被删除，不加入录像目录，否则目录与日志无限增长
+        return;
+    }
+    Entry entry;
+    entry.vhost = info.vhost;
+    entry.app = info.app;
+    entry.stream = info.stream;
+    entry.segment.type = type;
+    entry.segment.start_time = info.start_time;
+    entry.segment.time_len = info.time_len;
+    entry.segment.file_size = info.file_size;
+    entry.segment.file_path = info.file_path;
+    entry.segment.url = info.url;
+
+    lock_guard<mutex> lck(_mtx);
+    if (_started && !_ready) {
+        _pending.emplace_back(std::move(entry));
+        return;
+    }
+    add_l(entry);
+    writeJournal_l(entry);
+}
+
+void RecordCatalog::add_l(const Entry &entry) {
+    auto key = getStreamKey(entry.vhost, entry.app, entry.stream);
+    //写入者持有_mtx，_streams只在此处与rebuild中替换
+    auto streams = atomic_load(&_streams);
+    std::shared_ptr<Stream> stream;
+    auto it = streams->find(key);
+    if (it != streams->end()) {
+        stream = it->second;
+    } else {
+        //新增流的频率很低，复制整个表
+        auto copy = std::make_shared<StreamMap>(*streams);
+        stream = std::make_shared<Stream>();
+        (*copy)[key] = stream;
+        atomic_store(&_streams, std::shared_ptr<const StreamMap>(copy));
+    }
+    atomic_store(&stream->list, insertSegment(*atomic_load(&stream->list), entry.segment));
+}
+
+vector<RecordSegment> RecordCatalog::find(const string &vhost, const string &app, const string &stream,
+                                          time_t start, time_t end, int type, size_t max_count) const {
+    vector<RecordSegment> ret;
+    auto streams = atomic_load(&_streams);
+    auto it = streams->find(getStreamKey(vhost, app, stream));
+    if (it == streams->end()) {
+        return ret;
+    }
+    auto list = atomic_load(&it->second->list);
+    auto &chunks = list->chunks;
+    //开始时间早于start的录像也可能与时间段重叠，向前扩展最长录像时长
+    time_t from = start - (time_t) ceil(list->max_len);
+    auto chunk_it = upper_bound(chunks.begin(), chunks.end(), from, chunkStartBefore);
+    if (chunk_it != chunks.begin()) {
+        --chunk_it;
+    }
+    for (; chunk_it != chunks.end(); ++chunk_it) {
+        auto &chunk = **chunk_it;
+        auto seg_it = lower_bound(chunk.begin(), chunk.end(), from, [](const RecordSegment &segment, time_t start_time) {
+            return segment.start_time < start_time;
+        });
+        for (; seg_it != chunk.end(); ++seg_it) {
+            if (seg_it->start_time >= end) {
+                return ret;
+            }
+            if (type >= 0 && seg_it->type != type) {
+                continue;
+            }
+            //time_t与float相加会丢失精度，比较时长与时间差
+            if (seg_it->start_time >= start || seg_it->time_len > (float) (start - seg_it->start_time)) {
+                struct stat st;
+                if (stat(seg_it->file_path.data(), &st) != 0) {
+                    //录像文件在运行期间被删除(例如被清理脚本删除)
+                    continue;
+                }
+                ret.emplace_back(*seg_it);
+                if (max_count && ret.size() >= max_count) {
+                    return ret;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+
+//字符串字段中的\\、\t、\r、\n转义，防止破坏日志的行与字段分隔
+static void escapeField(string &out, const string &field) {
+    for (auto ch : field) {
+        switch (ch) {
+            case '\\': out.append("\\\\"); break;
+            case '\t': out.append("\\t"); break;
+            case '\r': out.append("\\r"); break;
+            case '\n': out.append("\\n"); break;
+            default: out.push_back(ch); break;
+        }
+    }
+}
+
+static string unescapeField(const string &field) {
+    string ret;
+    ret.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] != '\\' || i + 1 == field.size()) {
+            ret.push_back(field[i]);
+            continue;
+        }
+        switch (field[++i]) {
+            case 't': ret.push_back('\t'); break;
+            case 'r': ret.push_back('\r'); break;
+            case 'n': ret.push_back('\n'); break;
+            default: ret.push_back(field[i]); break;
+        }
+    }
+    return ret;
+}
+
+//日志每行为: type start_time time_len file_size vhost app stream file_path url，以\t分隔，字符串字段经过转义
+static bool parseJournalLine(const string &line, RecordCatalog::Entry &entry) {
+    vector<string> fields;
+    size_t pos = 0;
+    while (fields.size() < 8) {
+        auto next = line.find('\t', pos);
+        if (next == string::npos) {
+            return false;
+        }
+        fields.emplace_back(line.substr(pos, next - pos));
+        pos = next + 1;
+    }
+    fields.emplace_back(line.substr(pos));
+    if (fields[0].empty() || fields[7].empty()) {
+        return false;
+    }
+    entry.segment.type = (Recorder::type) atoi(fields[0].data());
+    entry.segment.start_time = (time_t) strtoll(fields[1].data(), nullptr, 10);
+    entry.segment.time_len = (float) atof(fields[2].data());
+    entry.segment.file_size = strtoull(fields[3].data(), nullptr, 10);
+    entry.vhost = unescapeField(fields[4]);
+    entry.app = unescapeField(fields[5]);
+    entry.stream = unescapeField(fields[6]);
+    entry.segment.file_path = unescapeField(fields[7]);
+    entry.segment.url = unescapeField(fields[8]);
+    return true;
+}
+
+static bool writeJournalLine(FILE *fp, const RecordCatalog::Entry &entry) {
+    auto &segment = entry.segment;
+    string line;
+    line.reserve(128 + segment.file_path.size() + segment.url.size());
+    line.append(to_string((int) segment.type)).push_back('\t');
+    line.append(to_string((int64_t) segment.start_time)).push_back('\t');
+    char len[32];
+    snprintf(len, sizeof(len), "%.3f", segment.time_len);
+    line.append(len).push_back('\t');
+    line.append(to_string(segment.file_size)).push_back('\t');
+    escapeField(line, entry.vhost);
+    line.push_back('\t');
+    escapeField(line, entry.app);
+    line.push_back('\t');
+    escapeField(line, entry.stream);
+    line.push_back('\t');
+    escapeField(line, segment.file_path);
+    line.push_back('\t');
+    escapeField(line, segment.url);
+    line.push_back('\n');
+    return fwrite(line.data(), line.size(), 1, fp) == 1;
+}
+
+//从mp4文件的mvhd读取时长，只读取box头，不解析sample表
+static float readMP4Duration(const string &path) {
+    std::shared_ptr<FILE> fp(fopen(path.data(), "rb"), [](FILE *fp) {
+        if (fp) {
+            fclose(fp);
+        }
+    });
+    if (!fp) {
+        return -1;
+    }
+    auto read_box = [&](uint64_t &size, string &type, uint64_t &header) {
+        uint8_t buf[16];
+        if (fread(buf, 8, 1, fp.get()) != 1) {
+            return false;
+        }
+        size = ((uint64_t) buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+        type.assign((char *) buf + 4, 4);
+        header = 8;
+        if (size == 1) {
+            if (fread(buf + 8, 8, 1, fp.get()) != 1) {
+                return false;
+            }
+            size = 0;
+            for (int i = 8; i < 16; ++i) {
+                size = (size << 8) | buf[i];
+            }
+            header = 16;
+        }
+        return size == 0 || size >= header;
+    };
+
+    uint64_t end = UINT64_MAX;
+    uint64_t offset = 0;
+    uint64_t size, header;
+    string type;
+    while (offset < end && fseek64(fp.get(), offset, SEEK_SET) == 0 && read_box(size, type, header)) {
+        if (type == "moov") {
+            //进入moov查找mvhd
+            end = size ? offset + size : UINT64_MAX;
+            offset += header;
+            continue;
+        }
+        if (type == "mvhd") {
+            uint8_t buf[28];
+            if (fread(buf, 28, 1, fp.get()) != 1) {
+                return -1;
+            }
+            auto be32 = [](const uint8_t *p) {
+                return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+            };
+            uint32_t timescale;
+            uint64_t duration;
+            if (buf[0] == 1) {
+                //version 1: creation_time、modification_time与duration为64位
+                timescale = be32(buf + 20);
+                duration = ((uint64_t) be32(buf + 24) << 32);
+                if (fread(buf, 4, 1, fp.get()) != 1) {
+                    return -1;
+                }
+                duration |= be32(buf);
+            } else {
+                timescale = be32(buf + 12);
+                duration = be32(buf + 16);
+            }
+            return timescale ? (float) ((double) duration / timescale) : -1;
+        }
+        if (size == 0) {
+            break;
+        }
+        offset += size;
+    }
+    return -1;
+}
+
+//从录像目录中的相对路径app/stream/日期/时间.mp4解析录像记录
+static bool parseRecordFile(const string &vhost, const string &root, const string &path, RecordCatalog::Entry &entry) {
+    GET_CONFIG(string, recordAppName, Record::kAppName);
+    auto relative = path.substr(root.size());
+    auto date_pos = relative.rfind('/');
+    if (date_pos == string::npos || date_pos == 0) {
+        return false;
+    }
+    auto stream_pos = relative.rfind('/', date_pos - 1);
+    auto app_pos = relative.find('/');
+    if (stream_pos == string::npos || app_pos == string::npos || app_pos >= stream_pos) {
+        return false;
+    }
+    auto date = relative.substr(stream_pos + 1, date_pos - stream_pos - 1);
+    auto time = relative.substr(date_pos + 1);
+    struct tm tm{};
+    if (sscanf(date.data(), "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3 ||
+        sscanf(time.data(), "%d-%d-%d", &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 3) {
+        return false;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+
+    struct stat st;
+    if (stat(path.data(), &st) != 0) {
+        return false;
+    }
+    entry.vhost = vhost;
+    entry.app = relative.substr(0, app_pos);
+    entry.stream = relative.substr(app_pos + 1, stream_pos - app_pos - 1);
+    entry.segment.type = Recorder::type_mp4;
+    //录像文件名为本地时间
+    entry.segment.start_time = mktime(&tm);
+    entry.segment.file_size = st.st_size;
+    entry.segment.file_path = path;
+    entry.segment.url = recordAppName + "/" + relative;
+    entry.segment.time_len = readMP4Duration(path);
+    if (entry.segment.time_len < 0) {
+        //mp4文件不完整时，以最后修改时间估算
+        entry.segment.time_len = (float) MAX(0, (int64_t) st.st_mtime - (int64_t) entry.segment.start_time);
+    }
+    return true;
+}
+
+void RecordCatalog::rebuild() {
+    GET_CONFIG(string, catalogFile, Record::kCatalogFile);
+    GET_CONFIG(string, recordPath, Record::kFilePath);
+    GET_CONFIG(string, recordAppName, Record::kAppName);
+    GET_CONFIG(bool, enableVhost, General::kEnableVhost);
+    Ticker ticker;
+
+    //扫描默认录像根目录下所有已完成的mp4文件(录制中的文件名以.开头，被扫描忽略)
+    vector<pair<string, string> > roots;
+    if (enableVhost) {
+        File::scanDir(File::absolutePath("", recordPath), [&](const string &path, bool is_dir) {
+            if (is_dir) {
+                auto vhost = path.substr(path.rfind('/') + 1);
+                roots.emplace_back(vhost, File::absolutePath(vhost + "/" + recordAppName + "/", recordPath));
+            }
+            return true;
+        });
+    } else {
+        roots.emplace_back(DEFAULT_VHOST, File::absolutePath(recordAppName + "/", recordPath));
+    }
+    //文件路径 -> 录像根目录
+    unordered_map<string, size_t> disk_files;
+    for (size_t i = 0; i < roots.size(); ++i) {
+        File::scanDir(roots[i].second, [&](const string &path, bool is_dir) {
+            if (!is_dir && end_with(path, ".mp4")) {
+                disk_files.emplace(path, i);
+            }
+            return true;
+        }, true);
+    }
+
+    //加载日志，剔除已删除的文件
+    vector<Entry> entries;
+    unordered_map<string, size_t> entry_index;
+    size_t journal_lines = 0;
+    auto journal_path = catalogFile.empty() ? string() : File::absolutePath(catalogFile, "");
+    if (!journal_path.empty()) {
+        std::ifstream fs(journal_path, std::ios::binary);
+        string str;
+        while (std::getline(fs, str)) {
+            ++journal_lines;
+            Entry entry;
+            if (!parseJournalLine(str, entry)) {
+                continue;
+            }
+            auto &file_path = entry.segment.file_path;
+            struct stat st;
+            if (!disk_files.count(file_path) && stat(file_path.data(), &st) != 0) {
+                continue;
+            }
+            //同一文件以最后一条记录为准
+            auto it = entry_index.find(file_path);
+            if (it != entry_index.end()) {
+                entries[it->second] = std::move(entry);
+            } else {
+                entry_index.emplace(file_path, entries.size());
+                entries.emplace_back(std::move(entry));
+            }
+        }
+    }
+    auto journal_entries = entries.size();
+
+    //补充日志中缺失的mp4文件
+    size_t scanned = 0;
+    for (auto &pr : disk_files) {
+        if (entry_index.count(pr.first)) {
+            continue;
+        }
+        Entry entry;
+        auto &root = roots[pr.second];
+        if (parseRecordFile(root.first, root.second, pr.first, entry)) {
+            entry_index.emplace(pr.first, entries.size());
+            entries.emplace_back(std::move(entry));
+            ++scanned;
+        }
+    }
+
+    lock_guard<mutex> lck(_mtx);
+    //合并重建期间完成的录像，这些录像还未写入日志，需要重写日志
+    bool has_pending = !_pending.empty();
+    for (auto &entry : _pending) {
+        auto it = entry_index.find(entry.segment.file_path);
+        if (it != entry_index.end()) {
+            entries[it->second] = std::move(entry);
+        } else {
+            entry_index.emplace(entry.segment.file_path, entries.size());
+            entries.emplace_back(std::move(entry));
+        }
+    }
+    _pending.clear();
+
+    unordered_map<string, vector<RecordSegment> > segments;
+    for (auto &entry : entries) {
+        segments[getStreamKey(entry.vhost, entry.app, entry.stream)].emplace_back(entry.segment);
+    }
+    auto streams = std::make_shared<StreamMap>();
+    for (auto &pr : segments) {
+        stable_sort(pr.second.begin(), pr.second.end(), segmentBefore);
+        auto stream = std::make_shared<Stream>();
+        stream->list = makeStreamList(pr.second);
+        streams->emplace(pr.first, stream);
+    }
+    atomic_store(&_streams, std::shared_ptr<const StreamMap>(streams));
+
+    //日志有变化时重写，先写临时文件再改名
+    if (!journal_path.empty() && (has_pending || journal_lines != journal_entries || entries.size() != journal_entries)) {
+        _journal = nullptr;
+        auto tmp = journal_path + ".tmp";
+        auto fp = File::create_file(tmp.data(), "wb");
+        bool ok = fp != nullptr;
+        for (size_t i = 0; ok && i < entries.size(); ++i) {
+            ok = writeJournalLine(fp, entries[i]);
+        }
+        if (fp) {
+            ok = (fclose(fp) == 0) && ok;
+        }
+        if (!ok || rename(tmp.data(), journal_path.data()) != 0) {
+            WarnL << "重写录像目录日志失败:" << journal_path << " " << get_uv_errmsg();
+            File::delete_file(tmp.data());
+        }
+    }
+    _ready = true;
+    InfoL << "录像目录重建完成, 流个数:" << streams->size() << ", 录像个数:" << entries.size()
+          << ", 扫描补充:" << scanned << ", 耗时:" << ticker.elapsedTime() << "ms";
+}
+
+void RecordCatalog::writeJournal_l(const Entry &entry) {
+    GET_CONFIG(string, catalogFile, Record::kCatalogFile);
+    if (catalogFile.empty()) {
+        return;
+    }
+    if (!_journal) {
+        auto path = File::absolutePath(catalogFile, "");
+        _journal.reset(File::create_file(path.data(), "ab"), [](FILE *fp) {
+            if (fp) {
+                fclose(fp);
+            }
+        });
+        if (!_journal) {
+            WarnL << "打开录像目录日志失败:" << path << " " << get_uv_errmsg();
+            return;
+        }
+    }
+    //每条记录立即写入，进程异常退出时最多丢失不完整的最后一行
+    if (!writeJournalLine(_journal.get(), entry) || fflush(_journal.get()) != 0) {
+        WarnL << "写入录像目录日志失败:" << get_uv_errmsg();
+        _journal = nullptr;
+    }
+}
+
+} /* namespace mediakit */
@@ -0,0 +1,108 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_RECORDCATALOG_H
+#define ZLMEDIAKIT_RECORDCATALOG_H
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Recorder.h"
+using namespace std;
+
+namespace mediakit {
+
+//录像目录中的一条记录，对应一个mp4文件或ts切片
+struct RecordSegment {
+    Recorder::type type;
+    // GMT 标准时间，单位秒
+    time_t start_time;
+    // 录像长度，单位秒
+    float time_len;
+    uint64_t file_size;
+    string file_path;
+    string url;
+};
+
+/**
+ * 录像目录，按vhost/app/stream与开始时间索引所有录制完成的mp4文件与ts切片(不包括会被删除的hls直播切片)
+ * 由kBroadcastRecordMP4/kBroadcastRecordTs事件追加，同时追加写入record.catalogFile日志；
+ * 启动时加载日志并扫描录像目录，剔除已删除的文件，补充日志中缺失的mp4文件
+ * 每个流的记录按开始时间分块保存，块内容不可变，写入时复制被修改的块后原子替换，
+ * 查询不加锁，为两次二分查找，返回前校验录像文件是否仍然存在
+ */
+class RecordCatalog {
+public:
+    static RecordCatalog &Instance();
+
+    /**
+     * 开始监听录制完成事件，并在后台线程重建目录
+     */
+    void start();
+
+    /**
+     * 停止监听录制完成事件
+     */
+    void stop();
+
+    /**
+     * 添加一条录像记录
+     * @param type hls还是MP4录制
+     * @param info 录制完成事件中的录像信息
+     */
+    void add(Recorder::type type, const RecordInfo &info);
+
+    /**
+     * 查找与[start, end)时间段重叠的录像，结果按开始时间排序
+     * @param type 录制类型，小于0时不限
+     * @param max_count 最多返回的条数，0为不限
+     */
+    vector<RecordSegment> find(const string &vhost, const string &app, const string &stream,
+                               time_t start, time_t end, int type = -1, size_t max_count = 0) const;
+
+    /**
+     * 启动时的重建是否已完成
+     */
+    bool isReady() const;
+
+    //录像记录及其所属的流，即日志中的一行
+    struct Entry {
+        string vhost;
+        string app;
+        string stream;
+        RecordSegment segment;
+    };
+
+private:
+    RecordCatalog() = default;
+    struct Stream;
+    struct StreamList;
+    typedef unordered_map<string, std::shared_ptr<Stream> > StreamMap;
+
+    static std::shared_ptr<StreamList> makeStreamList(const vector<RecordSegment> &segments);
+    static std::shared_ptr<const StreamList> insertSegment(const StreamList &old, const RecordSegment &segment);
+    void rebuild();
+    void add_l(const Entry &entry);
+    void writeJournal_l(const Entry &entry);
+
+private:
+    mutable mutex _mtx;
+    bool _ready = false;
+    bool _started = false;
+    //重建期间收到的录制完成事件，重建完成后合并
+    vector<Entry> _pending;
+    std::shared_ptr<FILE> _journal;
+    std::shared_ptr<const StreamMap> _streams = std::make_shared<StreamMap>();
+};
+
+} /* namespace mediakit */
+#endif //ZLMEDIAKIT_RECORDCATALOG_H
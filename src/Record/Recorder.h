@@ -28,6 +28,7 @@ public:
     string app;         // 应用名称
     string stream;      // 流 ID
     string vhost;       // 虚拟主机
+    bool live = false;  // 是否为hls直播切片，直播切片移出m3u8后会被删除
 };
 
 class Recorder{
@@ -45,117 +45,152 @@ void TsMuxer::stampSync(){
 }
 
 void TsMuxer::addTrack(const Track::Ptr &track) {
-    switch (track->getCodecId()) {
+    auto codec = track->getCodecId();
+    switch (codec) {
         case CodecH264: {
             _have_video = true;
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_H264, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_H264, nullptr, 0);
+            info.input = &TsMuxer::inputVideo<CodecH264>;
             break;
         }
 
         case CodecH265: {
             _have_video = true;
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_H265, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_H265, nullptr, 0);
+            info.input = &TsMuxer::inputVideo<CodecH265>;
             break;
         }
 
         case CodecAAC: {
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AAC, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AAC, nullptr, 0);
+            info.input = &TsMuxer::inputAudio<CodecAAC>;
             break;
         }
 
         case CodecG711A: {
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_G711A, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_G711A, nullptr, 0);
+            info.input = &TsMuxer::inputAudio<CodecG711A>;
             break;
         }
 
         case CodecG711U: {
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_G711U, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_G711U, nullptr, 0);
+            info.input = &TsMuxer::inputAudio<CodecG711U>;
             break;
         }
 
         case CodecOpus: {
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_OPUS, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_OPUS, nullptr, 0);
+            info.input = &TsMuxer::inputAudio<CodecOpus>;
             break;
         }
 
         case CodecL16:{
-            _codec_to_trackid[track->getCodecId()].track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_G711U, nullptr, 0);
+            auto &info = _codec_to_trackid[codec];
+            info.track_id = mpeg_ts_add_stream(_context, PSI_STREAM_AUDIO_G711U, nullptr, 0);
+            info.input = &TsMuxer::inputAudio<CodecL16>;
             break;
 
         }
-        default: WarnL << "mpeg-ts 不支持该编码格式,已忽略:" << track->getCodecName(); break;
+        default: WarnL << "mpeg-ts 不支持该编码格式,已忽略:" << track->getCodecName(); return;
     }
+    _codec_to_trackid[codec].stamp.setPlayBack(_playback);
+    //unordered_map扩容时节点地址不变，可以直接保存指针
+    _track_by_codec[codec] = &_codec_to_trackid[codec];
 
     //尝试音视频同步
     stampSync();
 }
 
 void TsMuxer::inputFrame(const Frame::Ptr &frame) {
-    auto it = _codec_to_trackid.find(frame->getCodecId());
-    if (it == _codec_to_trackid.end()) {
+    auto codec = frame->getCodecId();
+    if ((int) codec < 0 || (int) codec >= kCodecCount || !_track_by_codec[codec]) {
         return;
     }
-    auto &track_info = it->second;
-    int64_t dts_out, pts_out;
+    auto &track_info = *_track_by_codec[codec];
     _is_idr_fast_packet = !_have_video;
-    switch (frame->getCodecId()){
-        case CodecH264: {
-            int type = H264_TYPE(*((uint8_t *) frame->data() + frame->prefixSize()));
-            if (type == H264Frame::NAL_SEI) {
-                break;
-            }
-        }
+    (this->*track_info.input)(track_info, frame);
+}
 
-        case CodecH265: {
-            //这里的代码逻辑是让SPS、PPS、IDR这些时间戳相同的帧打包到一起当做一个帧处理，
-            if (!_frameCached.empty() && _frameCached.back()->dts() != frame->dts()) {
-                Frame::Ptr back = _frameCached.back();
-                Buffer::Ptr merged_frame = back;
-                if (_frameCached.size() != 1) {
-                    BufferLikeString merged;
-                    merged.reserve(back->size() + 1024);
-                    _frameCached.for_each([&](const Frame::Ptr &frame) {
-                        if (frame->prefixSize()) {
-                            merged.append(frame->data(), frame->size());
-                        } else {
-                            merged.append("\x00\x00\x00\x01", 4);
-                            merged.append(frame->data(), frame->size());
-                        }
-                        if (frame->keyFrame()) {
-                            _is_idr_fast_packet = true;
-                        }
-                    });
-                    merged_frame = std::make_shared<BufferOffset<BufferLikeString> >(std::move(merged));
-                }
-                track_info.stamp.revise(back->dts(), back->pts(), dts_out, pts_out);
-                //取视频时间戳为TS的时间戳
-                _timestamp = dts_out;
-                mpeg_ts_write(_context, track_info.track_id, back->keyFrame() ? 0x0001 : 0, pts_out * 90LL,dts_out * 90LL, merged_frame->data(), merged_frame->size());
-                _frameCached.clear();
-            }
-            _frameCached.emplace_back(Frame::getCacheAbleFrame(frame));
-            break;
-        }
+template<CodecId codec>
+void TsMuxer::inputVideo(track_info &track_info, const Frame::Ptr &frame) {
+    if (codec == CodecH264 && H264_TYPE(frame->byteAt(frame->prefixSize())) == H264Frame::NAL_SEI) {
+        //h264的sei帧不写入ts
+        return;
+    }
 
-        case CodecAAC: {
-            if (frame->prefixSize() == 0) {
-                WarnL << "必须提供adts头才能mpeg-ts打包";
-                break;
-            }
-        }
+    //这里的代码逻辑是让SPS、PPS、IDR这些时间戳相同的帧打包到一起当做一个帧处理，
+    if (!_frameCached.empty() && _frameCached.back()->dts() != frame->dts()) {
+        writeCachedVideo(track_info);
+    }
+    _frameCached.emplace_back(Frame::getCacheAbleFrame(frame));
+}
 
-        default: {
-            track_info.stamp.revise(frame->dts(), frame->pts(), dts_out, pts_out);
-            if(!_have_video){
-                //没有视频时，才以音频时间戳为TS的时间戳
-                _timestamp = dts_out;
+void TsMuxer::writeCachedVideo(track_info &track_info) {
+    Frame::Ptr back = _frameCached.back();
+    Buffer::Ptr merged_frame = back;
+    if (_frameCached.size() != 1) {
+        BufferLikeString merged;
+        merged.reserve(back->size() + 1024);
+        _frameCached.for_each([&](const Frame::Ptr &frame) {
+            if (!frame->prefixSize()) {
+                merged.append("\x00\x00\x00\x01", 4);
+            }
+            //分片帧直接从各个分片拷贝，不合并分片
+            frame->forEachSlice(0, [&](const char *ptr, uint32_t size) {
+                merged.append(ptr, size);
+            });
+            if (frame->keyFrame()) {
+                _is_idr_fast_packet = true;
             }
-            mpeg_ts_write(_context, track_info.track_id, frame->keyFrame() ? 0x0001 : 0, pts_out * 90LL, dts_out * 90LL, frame->data(), frame->size());
+        });
+        merged_frame = std::make_shared<BufferOffset<BufferLikeString> >(std::move(merged));
+    }
+    int64_t dts_out, pts_out;
+    track_info.stamp.revise(back->dts(), back->pts(), dts_out, pts_out);
+    //取视频时间戳为TS的时间戳
+    _timestamp = dts_out;
+    mpeg_ts_write(_context, track_info.track_id, back->keyFrame() ? 0x0001 : 0, pts_out * 90LL, dts_out * 90LL, merged_frame->data(), merged_frame->size());
+    _frameCached.clear();
+}
+
+void TsMuxer::setPlayBack(bool playback) {
+    _playback = playback;
+}
+
+void TsMuxer::flush() {
+    if (_frameCached.empty()) {
+        return;
+    }
+    for (auto &pr : _codec_to_trackid) {
+        if (getTrackType((CodecId) pr.first) == TrackVideo) {
+            writeCachedVideo(pr.second);
             break;
         }
     }
 }
 
+template<CodecId codec>
+void TsMuxer::inputAudio(track_info &track_info, const Frame::Ptr &frame) {
+    if (codec == CodecAAC && frame->prefixSize() == 0) {
+        WarnL << "必须提供adts头才能mpeg-ts打包";
+        return;
+    }
+    int64_t dts_out, pts_out;
+    track_info.stamp.revise(frame->dts(), frame->pts(), dts_out, pts_out);
+    if(!_have_video){
+        //没有视频时，才以音频时间戳为TS的时间戳
+        _timestamp = dts_out;
+    }
+    mpeg_ts_write(_context, track_info.track_id, frame->keyFrame() ? 0x0001 : 0, pts_out * 90LL, dts_out * 90LL, frame->data(), frame->size());
+}
+
 void TsMuxer::resetTracks() {
     _have_video = false;
     //通知片段中断
@@ -192,6 +227,9 @@ void TsMuxer::uninit() {
         _context = nullptr;
     }
     _codec_to_trackid.clear();
+    for (auto &track : _track_by_codec) {
+        track = nullptr;
+    }
 }
 
 }//namespace mediakit
@@ -42,6 +42,17 @@ public:
      */
     void inputFrame(const Frame::Ptr &frame) override;
 
+    /**
+     * 设置为点播模式，直接使用输入的时间戳，不转换为从0开始的相对时间戳
+     * 请在addTrack之前调用
+     */
+    void setPlayBack(bool playback = true);
+
+    /**
+     * 写入缓存中的最后一帧视频，用于点播切片结束时
+     */
+    void flush();
+
 protected:
     /**
      * 输出mpegts数据回调
@@ -53,23 +64,40 @@ protected:
     virtual void onTs(const void *packet, int bytes,uint32_t timestamp,bool is_idr_fast_packet) = 0;
 
 private:
+    struct track_info;
+    //按照编码类型特化的帧处理函数
+    typedef void (TsMuxer::*InputFunc)(track_info &track, const Frame::Ptr &frame);
+
     void init();
     void uninit();
     //音视频时间戳同步用
     void stampSync();
+    template<CodecId codec>
+    void inputVideo(track_info &track, const Frame::Ptr &frame);
+    template<CodecId codec>
+    void inputAudio(track_info &track, const Frame::Ptr &frame);
+    //合并时间戳相同的视频帧并写入
+    void writeCachedVideo(track_info &track);
 
 private:
-    void *_context = nullptr;
-    char _tsbuf[188];
-    uint32_t _timestamp = 0;
+    static constexpr int kCodecCount = CodecL16 + 1;
     struct track_info {
         int track_id = -1;
         Stamp stamp;
+        //添加track时确定，每帧无需再判断编码类型
+        InputFunc input = nullptr;
     };
+
+    void *_context = nullptr;
+    char _tsbuf[188];
+    uint32_t _timestamp = 0;
     unordered_map<int, track_info> _codec_to_trackid;
+    //按照编码类型索引，避免每帧查找哈希表
+    track_info *_track_by_codec[kCodecCount] = {nullptr};
     List<Frame::Ptr> _frameCached;
     bool _is_idr_fast_packet = false;
     bool _have_video = false;
+    bool _playback = false;
 };
 
 }//namespace mediakit
@@ -86,6 +114,8 @@ public:
     void addTrack(const Track::Ptr &track) override {}
     void resetTracks() override {}
     void inputFrame(const Frame::Ptr &frame) override {}
+    void setPlayBack(bool playback = true) {}
+    void flush() {}
 
 protected:
     virtual void onTs(const void *packet, int bytes,uint32_t timestamp,bool is_idr_fast_packet) = 0;
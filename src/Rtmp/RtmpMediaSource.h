@@ -77,6 +77,15 @@ public:
         return _ring ? _ring->readerCount() : 0;
     }
 
+    /**
+     * 遍历拥有播放器的poller线程
+     */
+    void for_each_reader_poller(const function<void(const EventPoller::Ptr &poller, int reader_count)> &cb) override {
+        if (_ring) {
+            _ring->for_each_poller(cb);
+        }
+    }
+
     /**
      * 获取metadata
      */
@@ -119,6 +128,7 @@ public:
      * @param pkt rtmp包
      */
     void onWrite(RtmpPacket::Ptr pkt, bool = true) override {
+        LatencyScope scope(_latency, getVhost(), getApp(), getId());
         _speed += pkt->size();
         //保存当前时间戳
         switch (pkt->type_id) {
@@ -61,6 +61,7 @@ public:
      * 输入rtmp并解析
      */
     void onWrite(RtmpPacket::Ptr pkt, bool = true) override {
+        LatencyScope scope(_latency, getVhost(), getApp(), getId());
         if (!_all_track_ready || _muxer->isEnabled()) {
             //未获取到所有Track后，或者开启转协议，那么需要解复用rtmp
             _demuxer->inputRtmp(pkt);
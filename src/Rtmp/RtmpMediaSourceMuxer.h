@@ -16,7 +16,7 @@
 
 namespace mediakit {
 
-class RtmpMediaSourceMuxer : public RtmpMuxer, public MediaSourceEventInterceptor,
+class RtmpMediaSourceMuxer : public RtmpMuxer, public MediaSourceEventInterceptor, public MuxerDemandHelper,
                              public std::enable_shared_from_this<RtmpMediaSourceMuxer> {
 public:
     typedef std::shared_ptr<RtmpMediaSourceMuxer> Ptr;
@@ -24,7 +24,7 @@ public:
     RtmpMediaSourceMuxer(const string &vhost,
                          const string &strApp,
                          const string &strId,
-                         const TitleMeta::Ptr &title = nullptr) : RtmpMuxer(title){
+                         const TitleMeta::Ptr &title = nullptr) : RtmpMuxer(title), MuxerDemandHelper("rtmp", true) {
         _media_src = std::make_shared<RtmpMediaSource>(vhost, strApp, strId);
         getRtmpRing()->setDelegate(_media_src);
     }
@@ -51,7 +51,7 @@ public:
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
-        _enabled = rtmp_demand ? size : true;
+        _demand.setEnabled(rtmp_demand ? size : true);
         if (!size && rtmp_demand) {
             _clear_cache = true;
         }
@@ -64,7 +64,7 @@ public:
             _clear_cache = false;
             _media_src->clearCache();
         }
-        if (_enabled || !rtmp_demand) {
+        if (_demand.isEnabled() || !rtmp_demand) {
             RtmpMuxer::inputFrame(frame);
         }
     }
@@ -72,11 +72,16 @@ public:
     bool isEnabled() {
         GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return rtmp_demand ? (_clear_cache ? true : _enabled) : true;
+        return rtmp_demand ? (_clear_cache ? true : _demand.isEnabled()) : true;
+    }
+
+protected:
+    bool isDemand() const override {
+        GET_CONFIG(bool, rtmp_demand, General::kRtmpDemand);
+        return rtmp_demand;
     }
 
 private:
-    bool _enabled = true;
     bool _clear_cache = false;
     RtmpMediaSource::Ptr _media_src;
 };
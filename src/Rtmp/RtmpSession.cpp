@@ -62,6 +62,7 @@ void RtmpSession::onRecv(const Buffer::Ptr &buf) {
     _ticker.resetTime();
     try {
         _total_bytes += buf->size();
+        MediaMetrics::Instance().rtmp.bytes_in.add(buf->size());
         onParseRtmp(buf->data(), buf->size());
     } catch (exception &ex) {
         shutdown(SockException(Err_shutdown, ex.what()));
@@ -489,6 +490,7 @@ void RtmpSession::onRtmpChunk(RtmpPacket &chunk_data) {
             _set_meta_data = true;
             _publisher_src->setMetaData(TitleMeta().getMetadata());
         }
+        MediaMetrics::Instance().rtmp.packets_in.add();
         _publisher_src->onWrite(std::make_shared<RtmpPacket>(std::move(chunk_data)));
         break;
     }
@@ -520,6 +522,7 @@ void RtmpSession::onSendMedia(const RtmpPacket::Ptr &pkt) {
     //rtmp播放器时间戳从零开始
     int64_t dts_out;
     _stamp[pkt->type_id % 2].revise(pkt->time_stamp, 0, dts_out, dts_out);
+    MediaMetrics::Instance().rtmp.packets_out.add();
     sendRtmp(pkt->type_id, pkt->stream_index, pkt, dts_out, pkt->chunk_id);
 }
 
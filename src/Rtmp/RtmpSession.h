@@ -22,6 +22,7 @@
 #include "Util/TimeTicker.h"
 #include "Network/TcpSession.h"
 #include "Common/Stamp.h"
+#include "Common/MediaMetrics.h"
 
 using namespace toolkit;
 
@@ -58,6 +59,7 @@ private:
     void onSendMedia(const RtmpPacket::Ptr &pkt);
     void onSendRawData(Buffer::Ptr buffer) override{
         _total_bytes += buffer->size();
+        MediaMetrics::Instance().rtmp.bytes_out.add(buffer->size());
         send(std::move(buffer));
     }
     void onRtmpChunk(RtmpPacket &chunk_data) override;
@@ -118,7 +118,7 @@ void PSEncoder::inputFrame(const Frame::Ptr &frame) {
     int64_t dts_out, pts_out;
     switch (frame->getCodecId()) {
         case CodecH264: {
-            int type = H264_TYPE(*((uint8_t *) frame->data() + frame->prefixSize()));
+            int type = H264_TYPE(frame->byteAt(frame->prefixSize()));
             if (type == H264Frame::NAL_SEI) {
                 break;
             }
@@ -132,12 +132,13 @@ void PSEncoder::inputFrame(const Frame::Ptr &frame) {
                     BufferLikeString merged;
                     merged.reserve(back->size() + 1024);
                     _frameCached.for_each([&](const Frame::Ptr &frame) {
-                        if (frame->prefixSize()) {
-                            merged.append(frame->data(), frame->size());
-                        } else {
+                        if (!frame->prefixSize()) {
                             merged.append("\x00\x00\x00\x01", 4);
-                            merged.append(frame->data(), frame->size());
                         }
+                        //分片帧直接从各个分片拷贝，不合并分片
+                        frame->forEachSlice(0, [&](const char *ptr, uint32_t size) {
+                            merged.append(ptr, size);
+                        });
                     });
                     merged_frame = std::make_shared<BufferOffset<BufferLikeString> >(std::move(merged));
                 }
@@ -14,6 +14,7 @@
 #include "RtpSplitter.h"
 #include "Util/File.h"
 #include "Http/HttpTSPlayer.h"
+#include "Common/MediaMetrics.h"
 
 #define RTP_APP_NAME "rtp"
 
@@ -92,6 +93,8 @@ bool RtpProcess::inputRtp(bool is_udp, const Socket::Ptr &sock, const char *data
     }
 
     _total_bytes += len;
+    MediaMetrics::Instance().rtp.bytes_in.add(len);
+    MediaMetrics::Instance().rtp.packets_in.add();
     if (_save_file_rtp) {
         uint16_t size = len;
         size = htons(size);
@@ -109,6 +112,7 @@ bool RtpProcess::inputRtp(bool is_udp, const Socket::Ptr &sock, const char *data
         return false;
     }
 
+    LatencyScope scope(_latency, _media_info._vhost, _media_info._app, _media_info._streamid);
     bool ret = _process ? _process->inputRtp(is_udp, data, len) : false;
     if (dts_out) {
         *dts_out = _dts;
@@ -89,6 +89,7 @@ private:
     std::shared_ptr<FILE> _save_file_video;
     ProcessInterface::Ptr _process;
     MultiMediaSourceMuxer::Ptr _muxer;
+    StreamLatency::Ptr _latency;
 };
 
 }//namespace mediakit
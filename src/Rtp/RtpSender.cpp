@@ -13,6 +13,7 @@
 #include "Rtsp/RtspSession.h"
 #include "Thread/WorkThreadPool.h"
 #include "RtpCache.h"
+#include "Common/MediaMetrics.h"
 
 namespace mediakit{
 
@@ -121,7 +122,10 @@ void RtpSender::onFlushRtpList(shared_ptr<List<Buffer::Ptr> > rtp_list) {
     _poller->async([rtp_list, is_udp, socket]() {
         int i = 0;
         int size = rtp_list->size();
+        auto &metrics = MediaMetrics::Instance().rtp;
+        metrics.packets_out.add(size);
         rtp_list->for_each([&](Buffer::Ptr &packet) {
+            metrics.bytes_out.add(packet->size() - (is_udp ? 4 : 2));
             if (is_udp) {
                 //udp模式，rtp over tcp前4个字节可以忽略
                 socket->send(std::make_shared<BufferRtp>(std::move(packet), 4), nullptr, 0, ++i == size);
@@ -23,8 +23,14 @@ RtpServer::~RtpServer() {
 }
 
 void RtpServer::start(uint16_t local_port, const string &stream_id,  bool enable_tcp, const char *local_ip) {
+    GET_CONFIG(bool, reuse_port_enabled, General::kReusePort);
+    GET_CONFIG(int, reuse_port_steering, General::kReusePortSteering);
+    //未指定流id的固定端口会接收大量推流，每个poller线程独立绑定该端口，由内核按4元组分配数据包
+    bool reuse_port = reuse_port_enabled && local_port != 0 && stream_id.empty();
+
     //创建udp服务器
     Socket::Ptr udp_server = Socket::createSocket(nullptr, true);
+    vector<Socket::Ptr> udp_server_clones;
     if (local_port == 0) {
         //随机端口，rtp端口采用偶数
         Socket::Ptr rtcp_server = Socket::createSocket(nullptr, true);
@@ -32,18 +38,37 @@ void RtpServer::start(uint16_t local_port, const string &stream_id,  bool enable
         makeSockPair(pair, local_ip);
         //取偶数端口
         udp_server = pair.first;
-    } else if (!udp_server->bindUdpSock(local_port, local_ip)) {
+    } else if (!udp_server->bindUdpSock(local_port, local_ip, reuse_port)) {
         //用户指定端口
         throw std::runtime_error(StrPrinter << "bindUdpSock on " << local_ip << ":" << local_port << " failed:" << get_uv_errmsg(true));
     }
     //设置udp socket读缓存
     SockUtil::setRecvBuf(udp_server->rawFD(), 4 * 1024 * 1024);
 
+    if (reuse_port) {
+        EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+            auto poller = dynamic_pointer_cast<EventPoller>(executor);
+            if (!poller || poller == udp_server->getPoller()) {
+                return;
+            }
+            auto clone = Socket::createSocket(poller, true);
+            if (!clone->bindUdpSock(local_port, local_ip, true)) {
+                throw std::runtime_error(StrPrinter << "bindUdpSock on " << local_ip << ":" << local_port << " failed:" << get_uv_errmsg(true));
+            }
+            SockUtil::setRecvBuf(clone->rawFD(), 4 * 1024 * 1024);
+            udp_server_clones.emplace_back(clone);
+        });
+        if (reuse_port_steering) {
+            SockUtil::setReusePortSteering(udp_server->rawFD(), reuse_port_steering, 1 + udp_server_clones.size());
+        }
+    }
+
     TcpServer::Ptr tcp_server;
     if (enable_tcp) {
         //创建tcp服务器
         tcp_server = std::make_shared<TcpServer>(udp_server->getPoller());
         (*tcp_server)[RtpSession::kStreamID] = stream_id;
+        tcp_server->setReusePort(reuse_port, reuse_port_steering);
         tcp_server->start<RtpSession>(udp_server->get_local_port(), local_ip);
     }
 
@@ -60,11 +85,24 @@ void RtpServer::start(uint16_t local_port, const string &stream_id,  bool enable
         udp_server->setOnRead([&ref, udp_server](const Buffer::Ptr &buf, struct sockaddr *addr, int) {
             ref.inputRtp(udp_server, buf->data(), buf->size(), addr);
         });
+        //同一推流端的数据包固定由内核分配到同一个socket，rtp处理器不会被多线程同时访问
+        for (auto &clone : udp_server_clones) {
+            weak_ptr<Socket> weak_clone = clone;
+            clone->setOnRead([&ref, weak_clone](const Buffer::Ptr &buf, struct sockaddr *addr, int) {
+                auto strong_clone = weak_clone.lock();
+                if (strong_clone) {
+                    ref.inputRtp(strong_clone, buf->data(), buf->size(), addr);
+                }
+            });
+        }
     }
 
-    _on_clearup = [udp_server, process, stream_id]() {
+    _on_clearup = [udp_server, udp_server_clones, process, stream_id]() {
         //去除循环引用
         udp_server->setOnRead(nullptr);
+        for (auto &clone : udp_server_clones) {
+            clone->setOnRead(nullptr);
+        }
         if (process) {
             //删除rtp处理器
             RtpSelector::Instance().delProcess(stream_id, process.get());
@@ -73,6 +111,7 @@ void RtpServer::start(uint16_t local_port, const string &stream_id,  bool enable
 
     _tcp_server = tcp_server;
     _udp_server = udp_server;
+    _udp_server_clones = udp_server_clones;
     _rtp_process = process;
 }
 
@@ -59,6 +59,8 @@ public:
 
 protected:
     Socket::Ptr _udp_server;
+    //开启SO_REUSEPORT时，其他poller线程中绑定同一端口的udp socket
+    vector<Socket::Ptr> _udp_server_clones;
     TcpServer::Ptr _tcp_server;
     RtpProcess::Ptr _rtp_process;
     function<void()> _on_clearup;
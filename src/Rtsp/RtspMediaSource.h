@@ -72,6 +72,15 @@ public:
         return _ring ? _ring->readerCount() : 0;
     }
 
+    /**
+     * 遍历拥有播放器的poller线程
+     */
+    void for_each_reader_poller(const function<void(const EventPoller::Ptr &poller, int reader_count)> &cb) override {
+        if (_ring) {
+            _ring->for_each_poller(cb);
+        }
+    }
+
     /**
      * 获取该源的sdp
      */
@@ -157,6 +166,7 @@ public:
      * @param keyPos 该包是否为关键帧的第一个包
      */
     void onWrite(RtpPacket::Ptr rtp, bool keyPos) override {
+        LatencyScope scope(_latency, getVhost(), getApp(), getId());
         _speed += rtp->size();
         assert(rtp->type >= 0 && rtp->type < TrackMax);
         auto &track = _tracks[rtp->type];
@@ -16,7 +16,7 @@
 
 namespace mediakit {
 
-class RtspMediaSourceMuxer : public RtspMuxer, public MediaSourceEventInterceptor,
+class RtspMediaSourceMuxer : public RtspMuxer, public MediaSourceEventInterceptor, public MuxerDemandHelper,
                              public std::enable_shared_from_this<RtspMediaSourceMuxer> {
 public:
     typedef std::shared_ptr<RtspMediaSourceMuxer> Ptr;
@@ -24,7 +24,7 @@ public:
     RtspMediaSourceMuxer(const string &vhost,
                          const string &strApp,
                          const string &strId,
-                         const TitleSdp::Ptr &title = nullptr) : RtspMuxer(title){
+                         const TitleSdp::Ptr &title = nullptr) : RtspMuxer(title), MuxerDemandHelper("rtsp", true) {
         _media_src = std::make_shared<RtspMediaSource>(vhost,strApp,strId);
         getRtpRing()->setDelegate(_media_src);
     }
@@ -50,7 +50,7 @@ public:
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
-        _enabled = rtsp_demand ? size : true;
+        _demand.setEnabled(rtsp_demand ? size : true);
         if (!size && rtsp_demand) {
             _clear_cache = true;
         }
@@ -63,7 +63,7 @@ public:
             _clear_cache = false;
             _media_src->clearCache();
         }
-        if (_enabled || !rtsp_demand) {
+        if (_demand.isEnabled() || !rtsp_demand) {
             RtspMuxer::inputFrame(frame);
         }
     }
@@ -71,11 +71,16 @@ public:
     bool isEnabled() {
         GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return rtsp_demand ? (_clear_cache ? true : _enabled) : true;
+        return rtsp_demand ? (_clear_cache ? true : _demand.isEnabled()) : true;
+    }
+
+protected:
+    bool isDemand() const override {
+        GET_CONFIG(bool, rtsp_demand, General::kRtspDemand);
+        return rtsp_demand;
     }
 
 private:
-    bool _enabled = true;
     bool _clear_cache = false;
     RtspMediaSource::Ptr _media_src;
 };
@@ -11,6 +11,7 @@
 #include <atomic>
 #include <iomanip>
 #include "Common/config.h"
+#include "Common/MediaMetrics.h"
 #include "UDPServer.h"
 #include "RtspSession.h"
 #include "Util/mini.h"
@@ -119,6 +120,7 @@ void RtspSession::onManager() {
 void RtspSession::onRecv(const Buffer::Ptr &buf) {
     _alive_ticker.resetTime();
     _bytes_usage += buf->size();
+    MediaMetrics::Instance().rtsp.bytes_in.add(buf->size());
     if (_on_recv) {
         //http poster的请求数据转发给http getter处理
         _on_recv(buf);
@@ -969,6 +971,7 @@ void RtspSession::onRtpSorted(const RtpPacket::Ptr &rtp, int track_idx) {
     }
     //时间戳增量
     rtp->timeStamp -= _start_stamp[track_idx];
+    MediaMetrics::Instance().rtsp.packets_in.add();
     _push_src->onWrite(rtp, false);
 }
 
@@ -978,6 +981,7 @@ inline void RtspSession::onRcvPeerUdpData(int interleaved, const Buffer::Ptr &bu
     if (interleaved % 2 == 0) {
         if (_push_src) {
             //这是rtsp推流上来的rtp包
+            MediaMetrics::Instance().rtsp.bytes_in.add(buf->size());
             auto &ref = _sdp_track[interleaved / 2];
             handleOneRtp(interleaved / 2, ref->_type, ref->_samplerate, (unsigned char *) buf->data(), buf->size());
         } else if (!_udp_connected_flags.count(interleaved)) {
@@ -1093,6 +1097,7 @@ int RtspSession::send(Buffer::Ptr pkt){
 		DebugP(this) << pkt->data();
 	}
     _bytes_usage += pkt->size();
+    MediaMetrics::Instance().rtsp.bytes_out.add(pkt->size());
     return TcpSession::send(std::move(pkt));
 }
 
@@ -1194,6 +1199,7 @@ inline void RtspSession::onSendRtpPacket(const RtpPacket::Ptr &pkt){
 }
 
 void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
+    MediaMetrics::Instance().rtsp.packets_out.add(pkt->size());
     switch (_rtp_type) {
         case Rtsp::RTP_TCP: {            
             int i = 0;
@@ -1221,6 +1227,7 @@ void RtspSession::sendRtpPacket(const RtspMediaSource::RingDataType &pkt) {
                 }
                 BufferRtp::Ptr buffer(new BufferRtp(rtp, 4));
                 _bytes_usage += buffer->size();
+                MediaMetrics::Instance().rtsp.bytes_out.add(buffer->size());
 
                 pSock->send(std::move(buffer), nullptr, 0, ++i == size);
                 
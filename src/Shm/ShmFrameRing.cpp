@@ -0,0 +1,425 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ShmFrameRing.h"
+#include "Extension/H264.h"
+#include "Extension/H265.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/uv_errno.h"
+using namespace toolkit;
+
+namespace mediakit {
+
+//"ZLSM"
+static constexpr uint32_t kShmMagic = 0x5A4C534D;
+static constexpr uint32_t kShmVersion = 1;
+static constexpr uint64_t kInvalidPos = ~0ULL;
+static constexpr size_t kMaxReader = 32;
+static constexpr size_t kMaxTrackInfo = 8 * 1024;
+static constexpr uint8_t kFlagGopStart = 0x01;
+//共享内存只允许同一用户的进程读写，多个MediaServer进程需以同一用户运行
+static constexpr mode_t kShmMode = 0600;
+
+struct ShmReaderSlot {
+    atomic<int32_t> pid;
+    atomic<uint64_t> stamp;
+};
+
+/**
+ * 共享内存头部，其后为环形缓存数据区
+ * 位置均为累计写入的字节数，对缓存大小取余后为数据区偏移；
+ * 写者先更新reserve_pos再写入数据，最后更新write_pos，
+ * 读者拷贝数据后检查reserve_pos，判断拷贝期间数据是否被覆盖
+ */
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint32_t track_info_size;
+    int32_t pid;
+    atomic<uint64_t> reserve_pos;
+    atomic<uint64_t> write_pos;
+    //最近gop起始帧的位置
+    atomic<uint64_t> gop_pos;
+    //写者心跳，1970年至今的毫秒数
+    atomic<uint64_t> stamp;
+    atomic<uint32_t> closed;
+    ShmReaderSlot readers[kMaxReader];
+    char track_info[kMaxTrackInfo];
+};
+
+/**
+ * 帧记录头部，其后为帧数据，记录总长度8字节对齐
+ */
+struct ShmFrameHeader {
+    uint32_t size;
+    uint32_t frame_size;
+    uint32_t dts;
+    uint32_t pts;
+    uint16_t codec;
+    uint8_t prefix_size;
+    uint8_t flags;
+    uint32_t reserved;
+};
+
+static size_t headerSize() {
+    //数据区按缓存行对齐
+    return (sizeof(ShmRingHeader) + 63) & ~((size_t) 63);
+}
+
+ShmFrameRing::ShmFrameRing(const string &name, bool writer) {
+    _name = name;
+    _writer = writer;
+}
+
+ShmFrameRing::~ShmFrameRing() {
+    if (_header) {
+        if (_writer) {
+            setClosed();
+            shm_unlink(_name.data());
+        } else if (_slot >= 0) {
+            //读者位可能已被写者释放并由其他读者占用，只释放本进程占用的
+            int32_t expected = getpid();
+            _header->readers[_slot].pid.compare_exchange_strong(expected, 0);
+        }
+        munmap(_header, _map_size);
+    }
+}
+
+bool ShmFrameRing::map(int fd, size_t size) {
+    auto ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        WarnL << "mmap共享内存失败:" << _name << " " << get_uv_errmsg();
+        return false;
+    }
+    _map_size = size;
+    _header = (ShmRingHeader *) ptr;
+    _data = (char *) ptr + headerSize();
+    return true;
+}
+
+ShmFrameRing::Ptr ShmFrameRing::create(const string &name, size_t capacity, const string &track_info) {
+    if (track_info.size() > kMaxTrackInfo) {
+        WarnL << "track描述过长:" << track_info.size();
+        return nullptr;
+    }
+    //同名共享内存可能是本进程pid被复用前残留的
+    shm_unlink(name.data());
+    int fd = shm_open(name.data(), O_RDWR | O_CREAT | O_EXCL, kShmMode);
+    if (fd == -1) {
+        WarnL << "创建共享内存失败:" << name << " " << get_uv_errmsg();
+        return nullptr;
+    }
+    capacity = (capacity + 7) & ~((size_t) 7);
+    auto size = headerSize() + capacity;
+    if (ftruncate(fd, size) == -1) {
+        WarnL << "设置共享内存大小失败:" << name << " " << get_uv_errmsg();
+        close(fd);
+        shm_unlink(name.data());
+        return nullptr;
+    }
+    Ptr ret(new ShmFrameRing(name, true));
+    if (!ret->map(fd, size)) {
+        shm_unlink(name.data());
+        return nullptr;
+    }
+    //ftruncate后内容全为0，只需设置非0字段
+    auto header = ret->_header;
+    header->capacity = capacity;
+    header->pid = getpid();
+    header->track_info_size = track_info.size();
+    memcpy(header->track_info, track_info.data(), track_info.size());
+    header->gop_pos.store(kInvalidPos, memory_order_relaxed);
+    header->stamp.store(getCurrentMillisecond(true), memory_order_relaxed);
+    header->version = kShmVersion;
+    //magic最后写入，读者据此判断初始化是否完成
+    atomic_thread_fence(memory_order_release);
+    header->magic = kShmMagic;
+    ret->_capacity = capacity;
+    return ret;
+}
+
+ShmFrameRing::Ptr ShmFrameRing::open(const string &name) {
+    int fd = shm_open(name.data(), O_RDWR, kShmMode);
+    if (fd == -1) {
+        WarnL << "打开共享内存失败:" << name << " " << get_uv_errmsg();
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t) st.st_size <= headerSize()) {
+        WarnL << "共享内存大小异常:" << name;
+        close(fd);
+        return nullptr;
+    }
+    Ptr ret(new ShmFrameRing(name, false));
+    if (!ret->map(fd, st.st_size)) {
+        return nullptr;
+    }
+    auto header = ret->_header;
+    if (header->magic != kShmMagic || header->version != kShmVersion ||
+        header->capacity + headerSize() != (uint64_t) st.st_size || header->track_info_size > kMaxTrackInfo) {
+        WarnL << "共享内存格式不匹配:" << name;
+        return nullptr;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    ret->_capacity = header->capacity;
+
+    //占用一个读者位，写者据此判断是否有读者
+    if (!ret->claimSlot()) {
+        WarnL << "共享内存读者过多:" << name;
+        return nullptr;
+    }
+
+    //从最近的gop起始处开始读取，这样可以立即从关键帧开始解码
+    auto gop_pos = header->gop_pos.load(memory_order_acquire);
+    if (gop_pos != kInvalidPos && ret->isValid(gop_pos)) {
+        ret->_read_pos = gop_pos;
+    } else {
+        ret->_read_pos = header->write_pos.load(memory_order_acquire);
+        ret->_wait_gop = true;
+    }
+    return ret;
+}
+
+const string &ShmFrameRing::getName() const {
+    return _name;
+}
+
+string ShmFrameRing::getTrackInfo() const {
+    //头部可被其他进程改写，长度不可信
+    return string(_header->track_info, std::min<size_t>(_header->track_info_size, kMaxTrackInfo));
+}
+
+void ShmFrameRing::copyIn(uint64_t pos, const void *data, size_t len) {
+    auto offset = pos % _capacity;
+    auto first = std::min<uint64_t>(len, _capacity - offset);
+    memcpy(_data + offset, data, first);
+    if (first < len) {
+        //绕回数据区开头
+        memcpy(_data, (const char *) data + first, len - first);
+    }
+}
+
+void ShmFrameRing::copyOut(uint64_t pos, size_t len, const function<void(const char *data, size_t len)> &cb) const {
+    auto offset = pos % _capacity;
+    auto first = std::min<uint64_t>(len, _capacity - offset);
+    cb(_data + offset, first);
+    if (first < len) {
+        cb(_data, len - first);
+    }
+}
+
+bool ShmFrameRing::write(const Frame::Ptr &frame, bool gop_start) {
+    uint64_t size = (sizeof(ShmFrameHeader) + frame->size() + 7) & ~((uint64_t) 7);
+    if (size > _capacity / 4) {
+        WarnL << "帧过大，无法写入共享内存:" << frame->size();
+        return false;
+    }
+    ShmFrameHeader header;
+    header.size = size;
+    header.frame_size = frame->size();
+    header.dts = frame->dts();
+    header.pts = frame->pts();
+    header.codec = frame->getCodecId();
+    header.prefix_size = frame->prefixSize();
+    header.flags = gop_start ? kFlagGopStart : 0;
+    header.reserved = 0;
+
+    auto pos = _header->write_pos.load(memory_order_relaxed);
+    //先声明将要覆盖的区域，再写入数据
+    _header->reserve_pos.store(pos + size, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    copyIn(pos, &header, sizeof(header));
+    copyIn(pos + sizeof(header), frame->data(), frame->size());
+    _header->write_pos.store(pos + size, memory_order_release);
+    if (gop_start) {
+        _header->gop_pos.store(pos, memory_order_release);
+    }
+    return true;
+}
+
+void ShmFrameRing::clearGop() {
+    _header->gop_pos.store(kInvalidPos, memory_order_release);
+}
+
+void ShmFrameRing::keepAlive() {
+    _header->stamp.store(getCurrentMillisecond(true), memory_order_release);
+}
+
+void ShmFrameRing::setClosed() {
+    _header->closed.store(1, memory_order_release);
+}
+
+int ShmFrameRing::readerCount(uint64_t timeout_ms) const {
+    auto now = getCurrentMillisecond(true);
+    int count = 0;
+    for (auto &slot : _header->readers) {
+        if (!slot.pid.load(memory_order_acquire)) {
+            continue;
+        }
+        if (now - slot.stamp.load(memory_order_acquire) > timeout_ms) {
+            //读者进程可能已经崩溃，释放其读者位；期间该位被重新占用时不释放
+            auto pid = slot.pid.load(memory_order_acquire);
+            if (now - slot.stamp.load(memory_order_acquire) > timeout_ms) {
+                slot.pid.compare_exchange_strong(pid, 0);
+            }
+            continue;
+        }
+        ++count;
+    }
+    return count;
+}
+
+bool ShmFrameRing::isWriterGone(uint64_t timeout_ms) const {
+    if (_header->closed.load(memory_order_acquire)) {
+        return _read_pos >= _header->write_pos.load(memory_order_acquire);
+    }
+    return getCurrentMillisecond(true) - _header->stamp.load(memory_order_acquire) > timeout_ms;
+}
+
+uint64_t ShmFrameRing::getOverrunCount() const {
+    return _overrun;
+}
+
+bool ShmFrameRing::isValid(uint64_t pos) const {
+    //写者最多写到reserve_pos，比它早一个缓存大小以上的数据可能已被覆盖
+    return _header->reserve_pos.load(memory_order_relaxed) <= pos + _capacity;
+}
+
+void ShmFrameRing::skip() {
+    ++_overrun;
+    auto write_pos = _header->write_pos.load(memory_order_acquire);
+    auto gop_pos = _header->gop_pos.load(memory_order_acquire);
+    if (gop_pos != kInvalidPos && gop_pos > _read_pos && isValid(gop_pos)) {
+        //跳到更新的gop起始处
+        _read_pos = gop_pos;
+        _wait_gop = false;
+    } else {
+        //等待下一个gop
+        _read_pos = write_pos;
+        _wait_gop = true;
+    }
+    WarnL << "共享内存读取落后，跳过部分帧:" << _name;
+}
+
+static FrameImp::Ptr makeFrame(CodecId codec) {
+    switch (codec) {
+        case CodecH264: return std::make_shared<H264Frame>();
+        case CodecH265: return std::make_shared<H265Frame>();
+        default: {
+            auto frame = std::make_shared<FrameImp>();
+            frame->_codec_id = codec;
+            return frame;
+        }
+    }
+}
+
+bool ShmFrameRing::claimSlot() {
+    auto pid = getpid();
+    for (size_t i = 0; i < kMaxReader; ++i) {
+        auto &slot = _header->readers[i];
+        //先更新心跳，防止占用后立即被写者判定为超时
+        int32_t expected = 0;
+        if (slot.pid.load(memory_order_acquire) == 0) {
+            slot.stamp.store(getCurrentMillisecond(true), memory_order_release);
+        }
+        if (slot.pid.compare_exchange_strong(expected, pid)) {
+            slot.stamp.store(getCurrentMillisecond(true), memory_order_release);
+            _slot = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ShmFrameRing::read(const onFrame &cb) {
+    if (_slot >= 0) {
+        auto &slot = _header->readers[_slot];
+        slot.stamp.store(getCurrentMillisecond(true), memory_order_release);
+        if (slot.pid.load(memory_order_acquire) != getpid()) {
+            //长时间未读取被写者释放了读者位，重新占用空闲的读者位，不能覆盖其他读者已占用的位
+            int32_t expected = 0;
+            if (!slot.pid.compare_exchange_strong(expected, getpid())) {
+                _slot = -1;
+            }
+        }
+    }
+    if (_slot < 0) {
+        //读者位已满时仍然读取，只是写者统计的读者数不含本读者
+        claimSlot();
+    }
+
+    int count = 0;
+    auto write_pos = _header->write_pos.load(memory_order_acquire);
+    while (_read_pos < write_pos) {
+        if (!isValid(_read_pos)) {
+            skip();
+            write_pos = _header->write_pos.load(memory_order_acquire);
+            continue;
+        }
+        ShmFrameHeader header;
+        auto ptr = (char *) &header;
+        copyOut(_read_pos, sizeof(header), [&](const char *data, size_t len) {
+            memcpy(ptr, data, len);
+            ptr += len;
+        });
+        atomic_thread_fence(memory_order_acquire);
+        if (!isValid(_read_pos)) {
+            //拷贝期间被覆盖
+            continue;
+        }
+        if (header.size < sizeof(header) || header.size > _capacity / 4 || header.frame_size > header.size - sizeof(header)) {
+            WarnL << "共享内存帧记录损坏:" << _name;
+            skip();
+            write_pos = _header->write_pos.load(memory_order_acquire);
+            continue;
+        }
+        auto pos = _read_pos;
+        _read_pos += header.size;
+        if (_wait_gop) {
+            if (!(header.flags & kFlagGopStart)) {
+                continue;
+            }
+            _wait_gop = false;
+        }
+
+        auto frame = makeFrame((CodecId) header.codec);
+        frame->_dts = header.dts;
+        frame->_pts = header.pts;
+        frame->_prefix_size = header.prefix_size;
+        frame->_buffer.reserve(header.frame_size);
+        copyOut(pos + sizeof(header), header.frame_size, [&](const char *data, size_t len) {
+            if (len) {
+                frame->_buffer.append(data, len);
+            }
+        });
+        atomic_thread_fence(memory_order_acquire);
+        if (!isValid(pos)) {
+            _read_pos = pos;
+            continue;
+        }
+        cb(frame);
+        ++count;
+    }
+    return count;
+}
+
+} /* namespace mediakit */
+
+#endif //!defined(_WIN32)
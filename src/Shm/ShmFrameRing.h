@@ -0,0 +1,132 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_SHMFRAMERING_H
+#define ZLMEDIAKIT_SHMFRAMERING_H
+
+#if !defined(_WIN32)
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <functional>
+#include "Extension/Frame.h"
+using namespace std;
+
+namespace mediakit {
+
+struct ShmRingHeader;
+
+/**
+ * 跨进程的共享内存帧环形缓存，一个写者(导出流的进程)，多个读者(其他进程)
+ * 写者按顺序写入帧记录，读者各自维护读取位置并轮询读取；
+ * 写者不等待读者，读者落后超过缓存大小时跳到最近的gop起始处继续读取
+ */
+class ShmFrameRing {
+public:
+    typedef std::shared_ptr<ShmFrameRing> Ptr;
+    typedef function<void(const Frame::Ptr &frame)> onFrame;
+
+    /**
+     * 创建共享内存并作为写者打开
+     * @param name 共享内存名，以/开头
+     * @param capacity 环形缓存大小，单位字节
+     * @param track_info 流的track描述(sdp)，供读者重建track
+     * @return 失败时返回空
+     */
+    static Ptr create(const string &name, size_t capacity, const string &track_info);
+
+    /**
+     * 作为读者打开其他进程创建的共享内存，并从最近的gop起始处开始读取
+     * @return 共享内存不存在或格式不匹配时返回空
+     */
+    static Ptr open(const string &name);
+
+    ~ShmFrameRing();
+
+    const string &getName() const;
+
+    /**
+     * 获取写者写入的track描述
+     */
+    string getTrackInfo() const;
+
+    ////////////写者接口////////////
+
+    /**
+     * 写入一帧，帧过大(超过缓存的1/4)时丢弃
+     * @param gop_start 是否为gop起始帧，读者落后或刚打开时从gop起始帧开始读取
+     */
+    bool write(const Frame::Ptr &frame, bool gop_start);
+
+    /**
+     * 清除gop起始位置，停止写入时调用，防止新的读者从过期的gop开始读取
+     */
+    void clearGop();
+
+    /**
+     * 刷新写者心跳，读者据此判断写者进程是否存活
+     */
+    void keepAlive();
+
+    /**
+     * 标记流已结束，读者读完剩余帧后停止
+     */
+    void setClosed();
+
+    /**
+     * 心跳未超时的读者个数
+     */
+    int readerCount(uint64_t timeout_ms) const;
+
+    ////////////读者接口////////////
+
+    /**
+     * 读取所有新写入的帧
+     * @return 读取的帧数
+     */
+    int read(const onFrame &cb);
+
+    /**
+     * 写者是否已结束或者心跳超时
+     */
+    bool isWriterGone(uint64_t timeout_ms) const;
+
+    /**
+     * 因落后被覆盖而跳过的次数
+     */
+    uint64_t getOverrunCount() const;
+
+private:
+    ShmFrameRing(const string &name, bool writer);
+    bool map(int fd, size_t size);
+    bool isValid(uint64_t pos) const;
+    bool claimSlot();
+    void skip();
+    void copyIn(uint64_t pos, const void *data, size_t len);
+    void copyOut(uint64_t pos, size_t len, const function<void(const char *data, size_t len)> &cb) const;
+
+private:
+    bool _writer;
+    int _slot = -1;
+    bool _wait_gop = false;
+    string _name;
+    size_t _map_size = 0;
+    uint64_t _capacity = 0;
+    uint64_t _read_pos = 0;
+    uint64_t _overrun = 0;
+    char *_data = nullptr;
+    ShmRingHeader *_header = nullptr;
+};
+
+} /* namespace mediakit */
+
+#endif //!defined(_WIN32)
+#endif //ZLMEDIAKIT_SHMFRAMERING_H
@@ -0,0 +1,542 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include "ShmMediaBus.h"
+#include "Common/config.h"
+#include "Extension/Factory.h"
+#include "Rtsp/Rtsp.h"
+#include "Thread/WorkThreadPool.h"
+#include "Util/uv_errno.h"
+
+namespace mediakit {
+
+//写者每隔该时长刷新心跳、检查读者
+static constexpr float kExportTickSec = 0.2f;
+//读者心跳超时，超时后视为读者进程已退出
+static constexpr uint64_t kReaderTimeoutMS = 5 * 1000;
+//写者心跳超时，超时后视为写者进程已退出
+static constexpr uint64_t kWriterTimeoutMS = 5 * 1000;
+
+static string getStreamKey(const string &vhost, const string &app, const string &stream) {
+    return vhost + "/" + app + "/" + stream;
+}
+
+/////////////////////////////////////ShmRegistry/////////////////////////////////////
+
+struct ShmRegistryItem {
+    string vhost;
+    string app;
+    string stream;
+    string shm_name;
+    int pid;
+};
+
+static bool isProcessAlive(int pid) {
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/**
+ * 加文件锁读取注册表，write为true时回调后写回
+ */
+static void accessRegistry(bool write, const function<void(vector<ShmRegistryItem> &items)> &cb) {
+    GET_CONFIG(string, path, Shm::kRegistry);
+    //与共享内存一样只允许同一用户的进程读写
+    int fd = open(path.data(), O_RDWR | O_CREAT, 0600);
+    if (fd == -1) {
+        WarnL << "打开共享内存流注册表失败:" << path << " " << get_uv_errmsg();
+        return;
+    }
+    flock(fd, write ? LOCK_EX : LOCK_SH);
+
+    string content;
+    char buf[4 * 1024];
+    ssize_t size;
+    while ((size = read(fd, buf, sizeof(buf))) > 0) {
+        content.append(buf, size);
+    }
+    vector<ShmRegistryItem> items;
+    for (auto &line : split(content, "\n")) {
+        auto fields = split(line, " ");
+        if (fields.size() != 5) {
+            continue;
+        }
+        ShmRegistryItem item;
+        item.vhost = fields[0];
+        item.app = fields[1];
+        item.stream = fields[2];
+        item.shm_name = fields[3];
+        item.pid = atoi(fields[4].data());
+        items.emplace_back(std::move(item));
+    }
+
+    cb(items);
+
+    if (write) {
+        _StrPrinter printer;
+        for (auto &item : items) {
+            if (!isProcessAlive(item.pid)) {
+                //清除已退出进程的记录，以及其异常退出时未释放的共享内存
+                shm_unlink(item.shm_name.data());
+                continue;
+            }
+            printer << item.vhost << " " << item.app << " " << item.stream << " " << item.shm_name << " " << item.pid << "\n";
+        }
+        string out = printer;
+        if (ftruncate(fd, 0) == -1 || pwrite(fd, out.data(), out.size(), 0) != (ssize_t) out.size()) {
+            WarnL << "写入共享内存流注册表失败:" << path << " " << get_uv_errmsg();
+        }
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+void ShmRegistry::add(const string &vhost, const string &app, const string &stream, const string &shm_name) {
+    accessRegistry(true, [&](vector<ShmRegistryItem> &items) {
+        ShmRegistryItem item;
+        item.vhost = vhost;
+        item.app = app;
+        item.stream = stream;
+        item.shm_name = shm_name;
+        item.pid = getpid();
+        items.emplace_back(std::move(item));
+    });
+}
+
+void ShmRegistry::remove(const string &shm_name) {
+    accessRegistry(true, [&](vector<ShmRegistryItem> &items) {
+        for (auto it = items.begin(); it != items.end();) {
+            if (it->shm_name == shm_name) {
+                it = items.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    });
+}
+
+string ShmRegistry::find(const string &vhost, const string &app, const string &stream) {
+    string ret;
+    accessRegistry(false, [&](vector<ShmRegistryItem> &items) {
+        //同一个流可能被多个进程导出过，取最后注册的
+        for (auto it = items.rbegin(); it != items.rend(); ++it) {
+            if (it->vhost == vhost && it->app == app && it->stream == stream &&
+                it->pid != getpid() && isProcessAlive(it->pid)) {
+                ret = it->shm_name;
+                break;
+            }
+        }
+    });
+    return ret;
+}
+
+/////////////////////////////////////ShmMediaExporter/////////////////////////////////////
+
+ShmMediaExporter::Ptr ShmMediaExporter::create(const MediaSource::Ptr &src) {
+    //track描述采用sdp格式，读者可以直接通过Factory::getTrackBySdp重建track
+    string sdp = std::make_shared<TitleSdp>()->getSdp();
+    bool have_video = false;
+    for (auto &track : src->getTracks(true)) {
+        auto track_sdp = track->getSdp();
+        if (!track_sdp) {
+            WarnL << "该编码格式不支持导出至共享内存:" << track->getCodecName();
+            continue;
+        }
+        sdp.append(track_sdp->getSdp());
+        have_video = have_video || track->getTrackType() == TrackVideo;
+    }
+
+    static atomic<uint32_t> s_index{0};
+    string name = StrPrinter << "/zlm_" << getpid() << "_" << ++s_index;
+    GET_CONFIG(uint32_t, ring_size_kb, Shm::kRingSizeKB);
+    auto ring = ShmFrameRing::create(name, (size_t) ring_size_kb * 1024, sdp);
+    if (!ring) {
+        return nullptr;
+    }
+
+    Ptr ret(new ShmMediaExporter);
+    ret->_have_video = have_video;
+    ret->_source = src;
+    ret->_ring = ring;
+    //写共享内存在后台线程，不阻塞网络线程
+    ret->_poller = WorkThreadPool::Instance().getPoller();
+    ShmRegistry::add(src->getVhost(), src->getApp(), src->getId(), name);
+    ret->start();
+    InfoL << "导出至共享内存:" << getStreamKey(src->getVhost(), src->getApp(), src->getId()) << " " << name;
+    return ret;
+}
+
+ShmMediaExporter::~ShmMediaExporter() {
+    ShmRegistry::remove(_ring->getName());
+    //订阅者在其poller线程中释放
+    auto subscriber = std::move(_subscriber);
+    _poller->async([subscriber]() {}, false);
+}
+
+void ShmMediaExporter::start() {
+    weak_ptr<ShmMediaExporter> weak_self = shared_from_this();
+    _timer = std::make_shared<Timer>(kExportTickSec, [weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return false;
+        }
+        return strong_self->onTick();
+    }, _poller);
+}
+
+MediaSource::Ptr ShmMediaExporter::getSource() const {
+    lock_guard<recursive_mutex> lck(_mtx);
+    return _source.lock();
+}
+
+const string &ShmMediaExporter::getShmName() const {
+    return _ring->getName();
+}
+
+void ShmMediaExporter::setSource(const MediaSource::Ptr &src) {
+    lock_guard<recursive_mutex> lck(_mtx);
+    _source = src;
+}
+
+bool ShmMediaExporter::onTick() {
+    _ring->keepAlive();
+    auto src = getSource();
+    bool have_reader = src && _ring->readerCount(kReaderTimeoutMS) > 0;
+    if (have_reader && !_subscriber) {
+        //有其他进程读取，开始订阅，先回放gop缓存，这样读者可以立即从关键帧开始解码
+        auto subscriber = std::make_shared<FrameSubscriber>(_poller, true);
+        weak_ptr<ShmMediaExporter> weak_self = shared_from_this();
+        subscriber->setOnFrame([weak_self](const Frame::Ptr &frame) {
+            auto strong_self = weak_self.lock();
+            if (strong_self) {
+                strong_self->onFrame(frame);
+            }
+        });
+        if (subscriber->attach(src)) {
+            _last_key = false;
+            _subscriber = subscriber;
+            InfoL << "共享内存有读者，开始写入:" << _ring->getName();
+        }
+    } else if (!have_reader && _subscriber) {
+        //无人读取时取消订阅，以免影响媒体源的无人观看判断
+        _subscriber = nullptr;
+        _ring->clearGop();
+        InfoL << "共享内存无读者，停止写入:" << _ring->getName();
+    }
+    return true;
+}
+
+void ShmMediaExporter::onFrame(const Frame::Ptr &frame) {
+    bool gop_start = true;
+    if (_have_video) {
+        //连续的sps/pps/idr中的第一帧作为gop起始
+        if (frame->getTrackType() == TrackVideo) {
+            bool key = frame->configFrame() || frame->keyFrame();
+            gop_start = key && !_last_key;
+            _last_key = key;
+        } else {
+            gop_start = false;
+        }
+    }
+    _ring->write(frame, gop_start);
+}
+
+/////////////////////////////////////ShmMediaImporter/////////////////////////////////////
+
+ShmMediaImporter::ShmMediaImporter(const string &vhost, const string &app, const string &stream, const EventPoller::Ptr &poller) {
+    _vhost = vhost;
+    _app = app;
+    _stream = stream;
+    _poller = poller;
+}
+
+ShmMediaImporter::~ShmMediaImporter() {}
+
+void ShmMediaImporter::setOnClose(const function<void()> &cb) {
+    _on_close = cb;
+}
+
+bool ShmMediaImporter::start(const string &shm_name) {
+    _shm_name = shm_name;
+    _ring = ShmFrameRing::open(shm_name);
+    if (!_ring) {
+        return false;
+    }
+    vector<Track::Ptr> tracks;
+    SdpParser parser(_ring->getTrackInfo());
+    for (auto &sdp_track : parser.getAvailableTrack()) {
+        auto track = Factory::getTrackBySdp(sdp_track);
+        if (track) {
+            tracks.emplace_back(track);
+        }
+    }
+    if (tracks.empty()) {
+        WarnL << "共享内存中无可用的track:" << shm_name;
+        _ring = nullptr;
+        return false;
+    }
+
+    //源进程已经按配置生成hls与录制mp4，共享同一个www目录时再生成会覆盖并删除源进程的hls切片，所以关闭
+    auto muxer = std::make_shared<MultiMediaSourceMuxer>(_vhost, _app, _stream, 0, true, true, false, false);
+    muxer->setMediaListener(shared_from_this());
+    for (auto &track : tracks) {
+        muxer->addTrack(track);
+    }
+    //track均由sdp生成，此时已就绪，媒体源立即注册
+    muxer->addTrackCompleted();
+    //totalReaderCount可能在其他线程中读取
+    std::atomic_store(&_muxer, muxer);
+
+    GET_CONFIG(uint32_t, poll_ms, Shm::kPollMS);
+    weak_ptr<ShmMediaImporter> weak_self = shared_from_this();
+    _timer = std::make_shared<Timer>(MAX(poll_ms, 1) / 1000.0f, [weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self) {
+            return false;
+        }
+        return strong_self->onPoll();
+    }, _poller);
+    InfoL << "从共享内存导入:" << getStreamKey(_vhost, _app, _stream) << " " << shm_name;
+    return true;
+}
+
+bool ShmMediaImporter::onPoll() {
+    if (!_ring) {
+        return false;
+    }
+    auto frames = _ring->read([&](const Frame::Ptr &frame) {
+        _muxer->inputFrame(frame);
+    });
+    _frames += frames;
+    _overrun = _ring->getOverrunCount();
+    if (_ring->isWriterGone(kWriterTimeoutMS)) {
+        WarnL << "共享内存流已结束:" << getStreamKey(_vhost, _app, _stream) << " " << _shm_name;
+        shutdown();
+        return false;
+    }
+    return true;
+}
+
+void ShmMediaImporter::shutdown() {
+    if (!_ring) {
+        return;
+    }
+    _none_reader_timer = nullptr;
+    std::atomic_store(&_muxer, MultiMediaSourceMuxer::Ptr());
+    _ring = nullptr;
+    if (_on_close) {
+        _on_close();
+    }
+}
+
+bool ShmMediaImporter::close(MediaSource &sender, bool force) {
+    if (!force && totalReaderCount(sender)) {
+        return false;
+    }
+    weak_ptr<ShmMediaImporter> weak_self = shared_from_this();
+    _poller->async_first([weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (strong_self) {
+            strong_self->shutdown();
+        }
+    });
+    WarnL << sender.getSchema() << "/" << sender.getVhost() << "/" << sender.getApp() << "/" << sender.getId() << " " << force;
+    return true;
+}
+
+int ShmMediaImporter::totalReaderCount(MediaSource &sender) {
+    auto muxer = std::atomic_load(&_muxer);
+    return muxer ? muxer->totalReaderCount() : 0;
+}
+
+MediaOriginType ShmMediaImporter::getOriginType(MediaSource &sender) const {
+    return MediaOriginType::shm_relay;
+}
+
+string ShmMediaImporter::getOriginUrl(MediaSource &sender) const {
+    return "shm://" + _shm_name;
+}
+
+map<string, int64_t> ShmMediaImporter::getOriginStat(MediaSource &sender) const {
+    map<string, int64_t> ret;
+    ret["shmFrames"] = _frames;
+    ret["shmOverrun"] = _overrun;
+    return ret;
+}
+
+void ShmMediaImporter::onReaderChanged(MediaSource &sender, int size) {
+    if (size || totalReaderCount(sender)) {
+        return;
+    }
+    //导入的流是播放时按需创建的，无人观看时自动关闭，导出端随之停止写入
+    GET_CONFIG(int, stream_none_reader_delay, General::kStreamNoneReaderDelayMS);
+    weak_ptr<ShmMediaImporter> weak_self = shared_from_this();
+    _poller->async([weak_self]() {
+        auto strong_self = weak_self.lock();
+        if (!strong_self || !strong_self->_ring) {
+            return;
+        }
+        strong_self->_none_reader_timer = std::make_shared<Timer>(stream_none_reader_delay / 1000.0f, [weak_self]() {
+            auto strong_self = weak_self.lock();
+            if (strong_self && strong_self->_muxer && !strong_self->_muxer->totalReaderCount()) {
+                WarnL << "共享内存导入的流无人观看,自动关闭:" << getStreamKey(strong_self->_vhost, strong_self->_app, strong_self->_stream);
+                strong_self->shutdown();
+            }
+            return false;
+        }, strong_self->_poller);
+    }, false);
+}
+
+/////////////////////////////////////ShmMediaBus/////////////////////////////////////
+
+ShmMediaBus &ShmMediaBus::Instance() {
+    //共享内存在stop()中释放，对象本身不释放，防止退出时仍有事件回调
+    static ShmMediaBus *s_instance = new ShmMediaBus;
+    return *s_instance;
+}
+
+void ShmMediaBus::start() {
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastMediaChanged, [this](BroadcastMediaChangedArgs) {
+        onMediaChanged(bRegist, sender);
+    });
+    NoticeCenter::Instance().addListener(this, Broadcast::kBroadcastNotFoundStream, [this](BroadcastNotFoundStreamArgs) {
+        onNotFoundStream(args);
+    });
+}
+
+void ShmMediaBus::stop() {
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastMediaChanged);
+    NoticeCenter::Instance().delListener(this, Broadcast::kBroadcastNotFoundStream);
+    unordered_map<string, ShmMediaExporter::Ptr> exporters;
+    {
+        lock_guard<mutex> lck(_mtx);
+        exporters.swap(_exporters);
+    }
+    //在锁外释放，移除注册表记录
+    exporters.clear();
+}
+
+void ShmMediaBus::onMediaChanged(bool regist, MediaSource &sender) {
+    auto key = getStreamKey(sender.getVhost(), sender.getApp(), sender.getId());
+    if (!regist) {
+        //在锁外释放，移除注册表记录
+        ShmMediaExporter::Ptr removed;
+        lock_guard<mutex> lck(_mtx);
+        auto it = _exporters.find(key);
+        if (it == _exporters.end()) {
+            return;
+        }
+        auto src = it->second->getSource();
+        if (src && src.get() != &sender) {
+            return;
+        }
+        //同一个流的其他协议媒体源未注销时，切换到该媒体源继续导出
+        auto other = MediaSource::find(sender.getVhost(), sender.getApp(), sender.getId());
+        if (other) {
+            it->second->setSource(other);
+            return;
+        }
+        removed = std::move(it->second);
+        _exporters.erase(it);
+        return;
+    }
+
+    GET_CONFIG(bool, enable_export, Shm::kExport);
+    if (!enable_export) {
+        return;
+    }
+    auto origin_type = sender.getOriginType();
+    if (origin_type == MediaOriginType::shm_relay || origin_type == MediaOriginType::mp4_vod) {
+        //不导出其他进程导入的流，防止循环；点播无需导出
+        return;
+    }
+    {
+        lock_guard<mutex> lck(_mtx);
+        auto it = _exporters.find(key);
+        if (it != _exporters.end() && it->second->getSource()) {
+            //该流的其他协议媒体源已导出
+            return;
+        }
+    }
+    //创建共享内存与写注册表均有文件操作，不在锁内执行
+    auto exporter = ShmMediaExporter::create(sender.shared_from_this());
+    if (!exporter) {
+        return;
+    }
+    //被替换或未采用的导出器在锁外释放，移除注册表记录
+    ShmMediaExporter::Ptr removed;
+    lock_guard<mutex> lck(_mtx);
+    auto &ref = _exporters[key];
+    if (ref && ref->getSource()) {
+        //期间该流的其他协议媒体源已导出
+        removed = std::move(exporter);
+        return;
+    }
+    removed = std::move(ref);
+    ref = std::move(exporter);
+}
+
+void ShmMediaBus::onNotFoundStream(const MediaInfo &info) {
+    GET_CONFIG(bool, enable_import, Shm::kImport);
+    if (!enable_import) {
+        return;
+    }
+    auto key = getStreamKey(info._vhost, info._app, info._streamid);
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (_importers.find(key) != _importers.end()) {
+            //正在导入
+            return;
+        }
+    }
+    auto shm_name = ShmRegistry::find(info._vhost, info._app, info._streamid);
+    if (shm_name.empty()) {
+        return;
+    }
+
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto importer = std::make_shared<ShmMediaImporter>(info._vhost, info._app, info._streamid, poller);
+    {
+        lock_guard<mutex> lck(_mtx);
+        if (!_importers.emplace(key, importer).second) {
+            return;
+        }
+    }
+    weak_ptr<ShmMediaImporter> weak_importer = importer;
+    importer->setOnClose([this, key, weak_importer]() {
+        auto strong_importer = weak_importer.lock();
+        if (strong_importer) {
+            removeImporter(key, strong_importer);
+        }
+    });
+    poller->async([this, key, importer, shm_name]() {
+        if (!importer->start(shm_name)) {
+            removeImporter(key, importer);
+        }
+    });
+}
+
+void ShmMediaBus::removeImporter(const string &key, const ShmMediaImporter::Ptr &importer) {
+    lock_guard<mutex> lck(_mtx);
+    auto it = _importers.find(key);
+    if (it != _importers.end() && it->second == importer) {
+        _importers.erase(it);
+    }
+}
+
+} /* namespace mediakit */
+
+#endif //!defined(_WIN32)
@@ -0,0 +1,173 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef ZLMEDIAKIT_SHMMEDIABUS_H
+#define ZLMEDIAKIT_SHMMEDIABUS_H
+
+#if !defined(_WIN32)
+
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include "Poller/Timer.h"
+#include "ShmFrameRing.h"
+#include "Common/MediaSource.h"
+#include "Common/FrameSubscriber.h"
+#include "Common/MultiMediaSourceMuxer.h"
+using namespace std;
+using namespace toolkit;
+
+namespace mediakit {
+
+/**
+ * 共享内存流注册表，记录本机各进程导出的流与共享内存名的对应关系
+ * 每行格式为: vhost app stream shm_name pid，读写时加文件锁，
+ * 进程已退出的记录在查找时忽略，在下次修改时清除
+ */
+class ShmRegistry {
+public:
+    static void add(const string &vhost, const string &app, const string &stream, const string &shm_name);
+    static void remove(const string &shm_name);
+
+    /**
+     * 查找其他进程导出的流
+     * @return 共享内存名，未找到时返回空
+     */
+    static string find(const string &vhost, const string &app, const string &stream);
+};
+
+/**
+ * 把本进程的一个媒体源导出至共享内存
+ * 只有其他进程读取时才订阅媒体源的帧并写入共享内存，无人读取时不影响媒体源的无人观看判断
+ */
+class ShmMediaExporter : public std::enable_shared_from_this<ShmMediaExporter> {
+public:
+    typedef std::shared_ptr<ShmMediaExporter> Ptr;
+
+    /**
+     * 创建共享内存并写入注册表
+     * @return 媒体源Track未就绪或共享内存创建失败时返回空
+     */
+    static Ptr create(const MediaSource::Ptr &src);
+    ~ShmMediaExporter();
+
+    MediaSource::Ptr getSource() const;
+
+    /**
+     * 获取共享内存名
+     */
+    const string &getShmName() const;
+
+    /**
+     * 同一个流的其他协议媒体源，原媒体源注销时切换到该媒体源
+     */
+    void setSource(const MediaSource::Ptr &src);
+
+private:
+    ShmMediaExporter() = default;
+    void start();
+    bool onTick();
+    void onFrame(const Frame::Ptr &frame);
+
+private:
+    bool _have_video = false;
+    bool _last_key = false;
+    mutable recursive_mutex _mtx;
+    std::weak_ptr<MediaSource> _source;
+    EventPoller::Ptr _poller;
+    ShmFrameRing::Ptr _ring;
+    FrameSubscriber::Ptr _subscriber;
+    Timer::Ptr _timer;
+};
+
+/**
+ * 读取其他进程导出的共享内存，并在本进程注册为媒体源
+ * 帧直接输入MultiMediaSourceMuxer，省去协议的打包、收发与解析
+ */
+class ShmMediaImporter : public MediaSourceEvent, public std::enable_shared_from_this<ShmMediaImporter> {
+public:
+    typedef std::shared_ptr<ShmMediaImporter> Ptr;
+
+    ShmMediaImporter(const string &vhost, const string &app, const string &stream, const EventPoller::Ptr &poller);
+    ~ShmMediaImporter() override;
+
+    /**
+     * 打开共享内存并注册媒体源，请在poller线程中调用
+     */
+    bool start(const string &shm_name);
+
+    /**
+     * 设置共享内存流结束或本地无人观看而关闭时的回调
+     */
+    void setOnClose(const function<void()> &cb);
+
+protected:
+    ///////MediaSourceEvent override///////
+    bool close(MediaSource &sender, bool force) override;
+    int totalReaderCount(MediaSource &sender) override;
+    MediaOriginType getOriginType(MediaSource &sender) const override;
+    string getOriginUrl(MediaSource &sender) const override;
+    map<string, int64_t> getOriginStat(MediaSource &sender) const override;
+    void onReaderChanged(MediaSource &sender, int size) override;
+
+private:
+    bool onPoll();
+    void shutdown();
+
+private:
+    string _vhost;
+    string _app;
+    string _stream;
+    string _shm_name;
+    atomic<uint64_t> _frames{0};
+    atomic<uint64_t> _overrun{0};
+    function<void()> _on_close;
+    EventPoller::Ptr _poller;
+    ShmFrameRing::Ptr _ring;
+    MultiMediaSourceMuxer::Ptr _muxer;
+    Timer::Ptr _timer;
+    Timer::Ptr _none_reader_timer;
+};
+
+/**
+ * 同一主机上多个MediaServer进程间的共享内存媒体总线
+ * 开启导出时，本进程注册的直播流均写入注册表；
+ * 开启导入时，播放本进程不存在的流时查找注册表，并从对应共享内存读取
+ */
+class ShmMediaBus {
+public:
+    static ShmMediaBus &Instance();
+
+    /**
+     * 开始监听媒体注册、流未找到事件
+     */
+    void start();
+
+    /**
+     * 停止监听并释放所有导出的共享内存
+     */
+    void stop();
+
+private:
+    ShmMediaBus() = default;
+    void onMediaChanged(bool regist, MediaSource &sender);
+    void onNotFoundStream(const MediaInfo &info);
+    void removeImporter(const string &key, const ShmMediaImporter::Ptr &importer);
+
+private:
+    mutex _mtx;
+    unordered_map<string, ShmMediaExporter::Ptr> _exporters;
+    unordered_map<string, ShmMediaImporter::Ptr> _importers;
+};
+
+} /* namespace mediakit */
+
+#endif //!defined(_WIN32)
+#endif //ZLMEDIAKIT_SHMMEDIABUS_H
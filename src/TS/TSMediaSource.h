@@ -59,6 +59,15 @@ public:
         return _ring ? _ring->readerCount() : 0;
     }
 
+    /**
+     * 遍历拥有播放器的poller线程
+     */
+    void for_each_reader_poller(const function<void(const EventPoller::Ptr &poller, int reader_count)> &cb) override {
+        if (_ring) {
+            _ring->for_each_poller(cb);
+        }
+    }
+
     /**
      * 输入TS包
      * @param packet TS包
@@ -16,14 +16,14 @@
 
 namespace mediakit {
 
-class TSMediaSourceMuxer : public TsMuxer, public MediaSourceEventInterceptor,
+class TSMediaSourceMuxer : public TsMuxer, public MediaSourceEventInterceptor, public MuxerDemandHelper,
                            public std::enable_shared_from_this<TSMediaSourceMuxer> {
 public:
     using Ptr = std::shared_ptr<TSMediaSourceMuxer>;
 
     TSMediaSourceMuxer(const string &vhost,
                        const string &app,
-                       const string &stream_id) {
+                       const string &stream_id) : MuxerDemandHelper("ts", true) {
         _media_src = std::make_shared<TSMediaSource>(vhost, app, stream_id);
         _pool.setSize(256);
     }
@@ -41,7 +41,7 @@ public:
 
     void onReaderChanged(MediaSource &sender, int size) override {
         GET_CONFIG(bool, ts_demand, General::kTSDemand);
-        _enabled = ts_demand ? size : true;
+        _demand.setEnabled(ts_demand ? size : true);
         if (!size && ts_demand) {
             _clear_cache = true;
         }
@@ -54,7 +54,7 @@ public:
             _clear_cache = false;
             _media_src->clearCache();
         }
-        if (_enabled || !ts_demand) {
+        if (_demand.isEnabled() || !ts_demand) {
             TsMuxer::inputFrame(frame);
         }
     }
@@ -62,10 +62,15 @@ public:
     bool isEnabled() {
         GET_CONFIG(bool, ts_demand, General::kTSDemand);
         //缓存尚未清空时，还允许触发inputFrame函数，以便及时清空缓存
-        return ts_demand ? (_clear_cache ? true : _enabled) : true;
+        return ts_demand ? (_clear_cache ? true : _demand.isEnabled()) : true;
     }
 
 protected:
+    bool isDemand() const override {
+        GET_CONFIG(bool, ts_demand, General::kTSDemand);
+        return ts_demand;
+    }
+
     void onTs(const void *data, int len,uint32_t timestamp,bool is_idr_fast_packet) override{
         if(!data || !len){
             return;
@@ -77,7 +82,6 @@ protected:
     }
 
 private:
-    bool _enabled = true;
     bool _clear_cache = false;
     TSMediaSource::PoolType _pool;
     TSMediaSource::Ptr _media_src;
@@ -0,0 +1,348 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "jsoncpp/json.h"
+#include "Util/CMD.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Common/MediaSource.h"
+#include "Extension/H264.h"
+#include "Extension/AAC.h"
+#include "Http/ApiJsonWriter.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+class CMD_apiJsonBenchmark : public CMD {
+public:
+    CMD_apiJsonBenchmark() {
+        _parser.reset(new OptionParser(nullptr));
+        (*_parser) << Option('s', "streams", Option::ArgRequired, "5000", false, "注册的流个数", nullptr);
+        (*_parser) << Option('n', "sessions", Option::ArgRequired, "50000", false, "会话个数", nullptr);
+        (*_parser) << Option('l', "loops", Option::ArgRequired, "3", false, "每项测试的重复次数，取平均值", nullptr);
+    }
+
+    ~CMD_apiJsonBenchmark() override {}
+
+    const char *description() const override {
+        return "getMediaList/getAllSession序列化性能测试：Json::Value树与流式json输出对比";
+    }
+};
+
+/**
+ * 只用于测试序列化的媒体源，带有一个视频和一个音频Track
+ */
+class BenchMediaSource : public MediaSource {
+public:
+    typedef std::shared_ptr<BenchMediaSource> Ptr;
+
+    BenchMediaSource(const string &app, const string &stream) : MediaSource(RTSP_SCHEMA, DEFAULT_VHOST, app, stream) {
+        _tracks.emplace_back(std::make_shared<H264Track>());
+        _tracks.emplace_back(std::make_shared<AACTrack>());
+    }
+
+    ~BenchMediaSource() override {}
+
+    //注册至全局注册表，析构时自动注销
+    void start() {
+        regist();
+    }
+
+    int readerCount() override {
+        return 0;
+    }
+
+    vector<Track::Ptr> getTracks(bool ready = true) const override {
+        return _tracks;
+    }
+
+private:
+    vector<Track::Ptr> _tracks;
+};
+
+/**
+ * 模拟的tcp会话信息，与getAllSession输出的字段一致
+ */
+class BenchSession : public SockInfo {
+public:
+    string get_local_ip() override {
+        return local_ip;
+    }
+
+    uint16_t get_local_port() override {
+        return local_port;
+    }
+
+    string get_peer_ip() override {
+        return peer_ip;
+    }
+
+    uint16_t get_peer_port() override {
+        return peer_port;
+    }
+
+    string getIdentifier() const override {
+        return id;
+    }
+
+public:
+    string peer_ip;
+    uint16_t peer_port;
+    string local_ip;
+    uint16_t local_port;
+    string id;
+    string type_id;
+};
+
+static double elapsedMS(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//当前堆内存占用字节数
+static uint64_t heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (uint32_t) mallinfo().uordblks;
+#else
+    return 0;
+#endif
+}
+
+//修改前getMediaList的序列化方式，逐个构造Json::Value
+static Json::Value makeMediaSourceJson(const MediaSource::Ptr &media) {
+    Json::Value item;
+    item["schema"] = media->getSchema();
+    item["vhost"] = media->getVhost();
+    item["app"] = media->getApp();
+    item["stream"] = media->getId();
+    item["createStamp"] = (Json::UInt64) media->getCreateStamp();
+    item["aliveSecond"] = (Json::UInt64) media->getAliveSecond();
+    item["bytesSpeed"] = media->getBytesSpeed();
+    item["readerCount"] = media->readerCount();
+    item["totalReaderCount"] = media->totalReaderCount();
+    item["originType"] = (int) media->getOriginType();
+    item["originTypeStr"] = getOriginTypeString(media->getOriginType());
+    item["originUrl"] = media->getOriginUrl();
+    item["originSock"] = Json::nullValue;
+    item["muxers"] = Json::arrayValue;
+    for (auto &track : media->getTracks()) {
+        Json::Value obj;
+        auto codec_type = track->getTrackType();
+        obj["codec_id"] = track->getCodecId();
+        obj["codec_id_name"] = track->getCodecName();
+        obj["ready"] = track->ready();
+        obj["codec_type"] = codec_type;
+        if (codec_type == TrackAudio) {
+            auto audio_track = dynamic_pointer_cast<AudioTrack>(track);
+            obj["sample_rate"] = audio_track->getAudioSampleRate();
+            obj["channels"] = audio_track->getAudioChannel();
+            obj["sample_bit"] = audio_track->getAudioSampleBit();
+        } else {
+            auto video_track = dynamic_pointer_cast<VideoTrack>(track);
+            obj["width"] = video_track->getVideoWidth();
+            obj["height"] = video_track->getVideoHeight();
+            obj["fps"] = round(video_track->getVideoFps());
+        }
+        item["tracks"].append(obj);
+    }
+    return item;
+}
+
+//修改前getAllSession的序列化方式
+static Json::Value makeSessionJson(BenchSession &session) {
+    Json::Value item;
+    item["peer_ip"] = session.get_peer_ip();
+    item["peer_port"] = session.get_peer_port();
+    item["local_ip"] = session.get_local_ip();
+    item["local_port"] = session.get_local_port();
+    item["id"] = session.getIdentifier();
+    item["typeid"] = session.type_id;
+    return item;
+}
+
+struct BenchResult {
+    double ms = 0;
+    uint64_t heap = 0;
+    string body;
+};
+
+/**
+ * 修改前的方式：构造整个Json::Value树后再转换为带缩进的字符串
+ * @param heap 构造完成时相对开始时增加的堆内存(Json::Value树与字符串同时存在)
+ */
+template<typename LIST, typename FUNC>
+static BenchResult runJsonValue(LIST &list, FUNC &&make_item, int loops) {
+    BenchResult ret;
+    for (int i = 0; i < loops; ++i) {
+        auto heap_start = heapInUse();
+        auto start = std::chrono::steady_clock::now();
+        Json::Value val;
+        val["code"] = 0;
+        for (auto &item : list) {
+            val["data"].append(make_item(item));
+        }
+        auto body = val.toStyledString();
+        ret.ms += elapsedMS(start) / loops;
+        ret.heap = std::max(ret.heap, heapInUse() - std::min(heap_start, heapInUse()));
+        ret.body = std::move(body);
+    }
+    return ret;
+}
+
+/**
+ * 流式输出，直接序列化至分块缓存
+ * @param heap 输出完成时相对开始时增加的堆内存
+ */
+template<typename LIST, typename FUNC>
+static BenchResult runStreamWriter(LIST &list, FUNC &&write_item, int loops) {
+    BenchResult ret;
+    for (int i = 0; i < loops; ++i) {
+        auto heap_start = heapInUse();
+        auto start = std::chrono::steady_clock::now();
+        JsonStreamWriter writer;
+        writer.startObject();
+        writer.member("code", 0);
+        writer.member("total", (uint64_t) list.size());
+        writer.key("data");
+        writer.startArray();
+        for (auto &item : list) {
+            writer.startObject();
+            write_item(writer, item);
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.endObject();
+        auto body = writer.takeBody();
+        ret.ms += elapsedMS(start) / loops;
+        ret.heap = std::max(ret.heap, heapInUse() - std::min(heap_start, heapInUse()));
+        //合并body仅用于校验输出，不计入耗时
+        string str;
+        str.reserve(body->remainSize());
+        while (auto buf = body->readData(64 * 1024)) {
+            str.append(buf->data(), buf->size());
+        }
+        ret.body = std::move(str);
+    }
+    return ret;
+}
+
+//两种方式的输出解析后data数组应一致
+static bool checkSame(const BenchResult &old_result, const BenchResult &new_result) {
+    Json::Reader reader;
+    Json::Value old_val, new_val;
+    if (!reader.parse(old_result.body, old_val) || !reader.parse(new_result.body, new_val)) {
+        return false;
+    }
+    return old_val["data"] == new_val["data"];
+}
+
+static void printResult(const char *name, size_t count, const BenchResult &old_result, const BenchResult &new_result) {
+    printf("%s x %zu:\n", name, count);
+    printf("  Json::Value   : %8.1f ms, heap %8.1f MB, body %8.1f MB\n",
+           old_result.ms, old_result.heap / 1024.0 / 1024.0, old_result.body.size() / 1024.0 / 1024.0);
+    printf("  stream writer : %8.1f ms, heap %8.1f MB, body %8.1f MB\n",
+           new_result.ms, new_result.heap / 1024.0 / 1024.0, new_result.body.size() / 1024.0 / 1024.0);
+}
+
+int main(int argc, char *argv[]) {
+    CMD_apiJsonBenchmark cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    //加载默认配置
+    loadIniConfig();
+
+    auto streams = cmd_main["streams"].as<size_t>();
+    auto sessions = cmd_main["sessions"].as<size_t>();
+    auto loops = std::max(1, cmd_main["loops"].as<int>());
+    int failed = 0;
+
+    //1、注册媒体源，测试注册表遍历，分为10个app
+    vector<BenchMediaSource::Ptr> sources;
+    for (size_t i = 0; i < streams; ++i) {
+        auto src = std::make_shared<BenchMediaSource>("live" + to_string(i % 10), "stream_" + to_string(i));
+        src->start();
+        sources.emplace_back(std::move(src));
+    }
+
+    size_t found_all = 0, found_app = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; ++i) {
+        found_all = 0;
+        MediaSource::for_each_media([&](const MediaSource::Ptr &src) { ++found_all; });
+    }
+    auto cost_all = elapsedMS(start) / loops;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; ++i) {
+        found_app = 0;
+        MediaSource::for_each_media([&](const MediaSource::Ptr &src) { ++found_app; }, RTSP_SCHEMA, DEFAULT_VHOST, "live3");
+    }
+    auto cost_app = elapsedMS(start) / loops;
+    printf("for_each_media x %zu: all %.2f ms (%zu), app filter %.2f ms (%zu)\n", streams, cost_all, found_all, cost_app, found_app);
+    failed += found_all != streams || found_app != streams / 10 + (streams % 10 > 3);
+
+    //2、getMediaList序列化
+    vector<MediaSource::Ptr> media_list;
+    MediaSource::for_each_media([&](const MediaSource::Ptr &src) { media_list.emplace_back(src); });
+    auto old_media = runJsonValue(media_list, makeMediaSourceJson, loops);
+    //与WebApi相同，调用ApiJsonWriter输出所有字段
+    ApiListArgs list_args(0, 0, "");
+    auto new_media = runStreamWriter(media_list, [&](JsonStreamWriter &writer, const MediaSource::Ptr &media) {
+        writeMediaSourceJson(writer, media, list_args);
+    }, loops);
+    printResult("getMediaList", media_list.size(), old_media, new_media);
+    if (!checkSame(old_media, new_media)) {
+        printf("getMediaList output mismatch\n");
+        ++failed;
+    }
+    media_list.clear();
+
+    //3、getAllSession序列化
+    vector<BenchSession> session_list(sessions);
+    for (size_t i = 0; i < sessions; ++i) {
+        auto &session = session_list[i];
+        session.peer_ip = "10." + to_string(i >> 16 & 0xFF) + "." + to_string(i >> 8 & 0xFF) + "." + to_string(i & 0xFF);
+        session.peer_port = 10000 + i % 50000;
+        session.local_ip = "192.168.1.100";
+        session.local_port = i % 2 ? 554 : 1935;
+        session.id = to_string(140000000000000 + i * 64);
+        session.type_id = i % 2 ? "N8mediakit11RtspSessionE" : "N8mediakit11RtmpSessionE";
+    }
+    auto old_session = runJsonValue(session_list, makeSessionJson, loops);
+    SessionJsonWriter session_writer(list_args);
+    auto new_session = runStreamWriter(session_list, [&](JsonStreamWriter &writer, BenchSession &session) {
+        session_writer.write(writer, session, session.type_id.data());
+    }, loops);
+    printResult("getAllSession", session_list.size(), old_session, new_session);
+    if (!checkSame(old_session, new_session)) {
+        printf("getAllSession output mismatch\n");
+        ++failed;
+    }
+
+    sources.clear();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? -1 : 0;
+}
@@ -9,70 +9,1023 @@
  */
 
 #include <signal.h>
+#include <math.h>
 #include <atomic>
+#include <fstream>
 #include <iostream>
 #include <list>
+#include <map>
+#include "Util/CMD.h"
+#include "Util/util.h"
 #include "Util/logger.h"
 #include "Util/onceToken.h"
-#include "Rtsp/UDPServer.h"
-#include "Network/sockutil.h"
+#include "Util/TimeTicker.h"
+#include "Network/TcpClient.h"
 #include "Poller/EventPoller.h"
+#include "Poller/Timer.h"
+#include "Common/config.h"
 #include "Player/PlayerProxy.h"
+#include "Pusher/MediaPusher.h"
+#include "Http/HttpClientImp.h"
+#include "Http/WebSocketClient.h"
 
 using namespace std;
 using namespace toolkit;
 using namespace mediakit;
 
+/**
+ * 无锁直方图，用于统计延时类指标(单位毫秒)
+ * 0~1000ms精度为1ms，1000ms~60000ms精度为100ms，超过60秒的样本计入最后一个桶
+ */
+class Histogram {
+public:
+    Histogram() {
+        for (auto &bucket : _buckets) {
+            bucket = 0;
+        }
+    }
+
+    void add(double ms) {
+        if (ms < 0) {
+            ms = 0;
+        }
+        _buckets[index(ms)].fetch_add(1, memory_order_relaxed);
+        _count.fetch_add(1, memory_order_relaxed);
+        _sum_us.fetch_add((uint64_t) (ms * 1000), memory_order_relaxed);
+        auto max_us = (uint64_t) (ms * 1000);
+        auto old_max = _max_us.load(memory_order_relaxed);
+        while (max_us > old_max && !_max_us.compare_exchange_weak(old_max, max_us, memory_order_relaxed));
+    }
+
+    uint64_t count() const {
+        return _count.load(memory_order_relaxed);
+    }
+
+    /**
+     * 获取百分位数
+     * @param ratio 百分比，取值范围0~1
+     */
+    double percentile(double ratio) const {
+        auto total = count();
+        if (!total) {
+            return 0;
+        }
+        uint64_t target = (uint64_t) ceil(total * ratio);
+        uint64_t acc = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            acc += _buckets[i].load(memory_order_relaxed);
+            if (acc >= target && acc) {
+                return value(i);
+            }
+        }
+        return value(kBucketCount - 1);
+    }
+
+    void dump(ostream &out) const {
+        auto total = count();
+        out << "{\"count\":" << total
+            << ",\"avg\":" << (total ? _sum_us.load(memory_order_relaxed) / 1000.0 / total : 0)
+            << ",\"p50\":" << percentile(0.50)
+            << ",\"p90\":" << percentile(0.90)
+            << ",\"p99\":" << percentile(0.99)
+            << ",\"max\":" << _max_us.load(memory_order_relaxed) / 1000.0 << "}";
+    }
+
+private:
+    static constexpr size_t kFineCount = 1000;
+    static constexpr size_t kBucketCount = kFineCount + 590 + 1;
+
+    static size_t index(double ms) {
+        if (ms < kFineCount) {
+            return (size_t) ms;
+        }
+        auto ret = kFineCount + (size_t) ((ms - kFineCount) / 100);
+        return MIN(ret, kBucketCount - 1);
+    }
+
+    static double value(size_t index) {
+        if (index < kFineCount) {
+            return index;
+        }
+        return kFineCount + (index - kFineCount) * 100.0;
+    }
+
+private:
+    atomic<uint64_t> _buckets[kBucketCount];
+    atomic<uint64_t> _count{0};
+    atomic<uint64_t> _sum_us{0};
+    atomic<uint64_t> _max_us{0};
+};
+
+/**
+ * 一组同协议客户端(播放器或推流器)的汇总统计
+ */
+class FleetStat {
+public:
+    typedef std::shared_ptr<FleetStat> Ptr;
+
+    FleetStat(const string &protocol, const string &url, int target) {
+        _protocol = protocol;
+        _url = url;
+        _target = target;
+    }
+
+    void dump(ostream &out, float duration_sec) const {
+        auto bytes = _bytes.load(memory_order_relaxed);
+        out << "{\"protocol\":\"" << _protocol << "\""
+            << ",\"url\":\"" << _url << "\""
+            << ",\"target\":" << _target
+            << ",\"started\":" << _started.load(memory_order_relaxed)
+            << ",\"connected\":" << _connected.load(memory_order_relaxed)
+            << ",\"failed\":" << _failed.load(memory_order_relaxed)
+            << ",\"disconnected\":" << _disconnected.load(memory_order_relaxed)
+            << ",\"alive\":" << _alive.load(memory_order_relaxed)
+            << ",\"frames\":" << _frames.load(memory_order_relaxed)
+            << ",\"bytes\":" << bytes
+            << ",\"bitrate_kbps\":" << (duration_sec > 0 ? bytes * 8 / 1000.0 / duration_sec : 0)
+            << ",\"stalls\":" << _stalls.load(memory_order_relaxed)
+            << ",\"connect_ms\":";
+        _connect_ms.dump(out);
+        out << ",\"first_frame_ms\":";
+        _first_frame_ms.dump(out);
+        out << ",\"delay_ms\":";
+        _delay_ms.dump(out);
+        out << ",\"jitter_ms\":";
+        _jitter_ms.dump(out);
+        out << "}";
+    }
+
+public:
+    string _protocol;
+    string _url;
+    int _target;
+    atomic<uint64_t> _started{0};
+    atomic<uint64_t> _connected{0};
+    atomic<uint64_t> _failed{0};
+    atomic<uint64_t> _disconnected{0};
+    atomic<int64_t> _alive{0};
+    atomic<uint64_t> _frames{0};
+    atomic<uint64_t> _bytes{0};
+    atomic<uint64_t> _stalls{0};
+    Histogram _connect_ms;
+    Histogram _first_frame_ms;
+    Histogram _delay_ms;
+    Histogram _jitter_ms;
+};
+
+/**
+ * 单个客户端的测量探针，只在客户端所在poller线程中访问
+ * 延时以帧内时间戳计算：每帧的(到达时刻 - 帧时间戳)减去迄今为止的最小值，
+ * 即相对于最快一帧的额外延时；抖动按照rfc3550的方式平滑计算
+ */
+class StreamProbe {
+public:
+    StreamProbe(const FleetStat::Ptr &stat, uint64_t stall_ms) {
+        _stat = stat;
+        _stall_ms = stall_ms;
+        _start_ms = getCurrentMillisecond();
+        _stat->_started.fetch_add(1, memory_order_relaxed);
+    }
+
+    ~StreamProbe() {
+        if (_connected && !_shutdown) {
+            _stat->_alive.fetch_sub(1, memory_order_relaxed);
+        }
+    }
+
+    void onConnected(const SockException &ex) {
+        if (_shutdown) {
+            return;
+        }
+        if (ex) {
+            _shutdown = true;
+            _stat->_failed.fetch_add(1, memory_order_relaxed);
+            WarnL << _stat->_protocol << " " << ex.what();
+            return;
+        }
+        _connected = true;
+        _stat->_connected.fetch_add(1, memory_order_relaxed);
+        _stat->_alive.fetch_add(1, memory_order_relaxed);
+        _stat->_connect_ms.add(getCurrentMillisecond() - _start_ms);
+    }
+
+    void onShutdown(const SockException &ex) {
+        if (_shutdown) {
+            return;
+        }
+        if (!_connected) {
+            //还未连接成功就断开了，视为失败
+            onConnected(ex ? ex : SockException(Err_shutdown, "shutdown before connected"));
+            return;
+        }
+        _shutdown = true;
+        _stat->_disconnected.fetch_add(1, memory_order_relaxed);
+        _stat->_alive.fetch_sub(1, memory_order_relaxed);
+        WarnL << _stat->_protocol << " " << ex.what();
+    }
+
+    void onBytes(size_t bytes) {
+        _stat->_bytes.fetch_add(bytes, memory_order_relaxed);
+    }
+
+    /**
+     * 收到一帧
+     * @param stamp_ms 帧时间戳，单位毫秒
+     * @param is_video 是否为视频帧；出现视频后只使用视频时间戳
+     */
+    void onStamp(int64_t stamp_ms, bool is_video) {
+        if (!is_video && _video_seen) {
+            return;
+        }
+        auto now = (int64_t) getCurrentMillisecond();
+        if (is_video && !_video_seen) {
+            //切换到视频时间戳，重置延时基准
+            _video_seen = true;
+            _frame_count = 0;
+        }
+        _stat->_frames.fetch_add(1, memory_order_relaxed);
+
+        if (!_first_frame) {
+            _first_frame = true;
+            _stat->_first_frame_ms.add(now - (int64_t) _start_ms);
+        }
+
+        auto transit = now - stamp_ms;
+        if (_frame_count++ == 0) {
+            _min_transit = transit;
+            _last_transit = transit;
+            _last_arrive = now;
+            return;
+        }
+
+        if (now - _last_arrive > (int64_t) _stall_ms) {
+            _stat->_stalls.fetch_add(1, memory_order_relaxed);
+        }
+        _last_arrive = now;
+
+        _min_transit = MIN(_min_transit, transit);
+        _stat->_delay_ms.add(transit - _min_transit);
+
+        auto diff = transit - _last_transit;
+        _last_transit = transit;
+        _jitter += (fabs((double) diff) - _jitter) / 16;
+        _stat->_jitter_ms.add(_jitter);
+    }
+
+private:
+    FleetStat::Ptr _stat;
+    uint64_t _stall_ms;
+    uint64_t _start_ms;
+    bool _connected = false;
+    bool _shutdown = false;
+    bool _first_frame = false;
+    bool _video_seen = false;
+    uint64_t _frame_count = 0;
+    int64_t _min_transit = 0;
+    int64_t _last_transit = 0;
+    int64_t _last_arrive = 0;
+    double _jitter = 0;
+};
+
+static inline uint32_t load_be16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t load_be24(const uint8_t *p) {
+    return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+static inline uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline uint64_t load_be64(const uint8_t *p) {
+    return ((uint64_t) load_be32(p) << 32) | load_be32(p + 4);
+}
+
+/**
+ * 从字节流中提取帧时间戳的轻量解析器，只解析到能拿到时间戳的程度
+ */
+class StampParser {
+public:
+    typedef std::shared_ptr<StampParser> Ptr;
+    typedef function<void(int64_t stamp_ms, bool is_video)> onStamp;
+
+    virtual ~StampParser() {}
+    virtual void input(const char *data, size_t len) = 0;
+
+    void setOnStamp(const onStamp &cb) {
+        _on_stamp = cb;
+    }
+
+protected:
+    onStamp _on_stamp;
+};
+
+/**
+ * flv tag解析，忽略script tag以及音视频的sequence header
+ */
+class FlvStampParser : public StampParser {
+public:
+    void input(const char *data, size_t len) override {
+        _buffer.append(data, len);
+        auto ptr = (const uint8_t *) _buffer.data();
+        size_t offset = 0;
+        if (!_header_done) {
+            if (_buffer.size() < 13) {
+                return;
+            }
+            if (memcmp(ptr, "FLV", 3) != 0) {
+                WarnL << "可能不是flv流";
+            }
+            offset = load_be32(ptr + 5) + 4;
+            _header_done = true;
+        }
+
+        while (_buffer.size() - offset >= 11) {
+            auto tag = ptr + offset;
+            auto type = tag[0] & 0x1F;
+            auto data_size = load_be24(tag + 1);
+            auto stamp = load_be24(tag + 4) | (tag[7] << 24);
+            auto total = 11 + data_size + 4;
+            if (_buffer.size() - offset < total) {
+                break;
+            }
+            auto body = tag + 11;
+            if (type == 9 && data_size >= 2) {
+                //h264/h265的sequence header不计入
+                auto codec = body[0] & 0x0F;
+                if (!((codec == 7 || codec == 12) && body[1] == 0)) {
+                    _on_stamp(stamp, true);
+                }
+            } else if (type == 8 && data_size >= 2) {
+                //aac的sequence header不计入
+                if (!((body[0] >> 4) == 10 && body[1] == 0)) {
+                    _on_stamp(stamp, false);
+                }
+            }
+            offset += total;
+        }
+        _buffer.erase(0, offset);
+    }
+
+private:
+    bool _header_done = false;
+    string _buffer;
+};
+
+/**
+ * ts包解析，提取pes头中的pts
+ */
+class TsStampParser : public StampParser {
+public:
+    void input(const char *data, size_t len) override {
+        _buffer.append(data, len);
+        auto ptr = (const uint8_t *) _buffer.data();
+        size_t offset = 0;
+        while (_buffer.size() - offset >= 188) {
+            auto packet = ptr + offset;
+            if (packet[0] != 0x47) {
+                //重新同步
+                ++offset;
+                continue;
+            }
+            offset += 188;
+            bool unit_start = packet[1] & 0x40;
+            auto adaptation = (packet[3] >> 4) & 0x03;
+            if (!unit_start || !(adaptation & 0x01)) {
+                continue;
+            }
+            size_t payload = 4;
+            if (adaptation & 0x02) {
+                payload += 1 + packet[4];
+            }
+            if (payload + 14 > 188) {
+                continue;
+            }
+            auto pes = packet + payload;
+            if (load_be24(pes) != 0x000001 || !(pes[7] & 0x80)) {
+                continue;
+            }
+            auto stream_id = pes[3];
+            bool is_video = (stream_id & 0xF0) == 0xE0;
+            bool is_audio = (stream_id & 0xE0) == 0xC0;
+            if (!is_video && !is_audio) {
+                continue;
+            }
+            uint64_t pts = ((uint64_t) (pes[9] >> 1) & 0x07) << 30;
+            pts |= (uint64_t) load_be16(pes + 10) >> 1 << 15;
+            pts |= (uint64_t) load_be16(pes + 12) >> 1;
+            _on_stamp(pts / 90, is_video);
+        }
+        _buffer.erase(0, offset);
+    }
+
+private:
+    string _buffer;
+};
+
+/**
+ * fmp4解析，从moov中获取各track的timescale，再从moof/traf/tfdt中获取时间戳
+ * mdat不缓存，直接跳过
+ */
+class Fmp4StampParser : public StampParser {
+public:
+    void input(const char *data, size_t len) override {
+        while (len && _skip) {
+            auto skip = MIN((uint64_t) len, _skip);
+            data += skip;
+            len -= skip;
+            _skip -= skip;
+        }
+        _buffer.append(data, len);
+        auto ptr = (const uint8_t *) _buffer.data();
+        size_t offset = 0;
+        while (_buffer.size() - offset >= 16) {
+            auto box = ptr + offset;
+            uint64_t box_size = load_be32(box);
+            size_t header = 8;
+            if (box_size == 1) {
+                box_size = load_be64(box + 8);
+                header = 16;
+            }
+            string type((char *) box + 4, 4);
+            if (box_size < header) {
+                //不支持box_size为0(直至文件末尾)的情况
+                WarnL << "可能不是fmp4流";
+                offset = _buffer.size();
+                break;
+            }
+            if (type == "mdat") {
+                auto remain = _buffer.size() - offset;
+                if (remain >= box_size) {
+                    offset += box_size;
+                    continue;
+                }
+                _skip = box_size - remain;
+                offset = _buffer.size();
+                break;
+            }
+            if (_buffer.size() - offset < box_size) {
+                break;
+            }
+            if (type == "moov") {
+                onMoov(box + header, box_size - header);
+            } else if (type == "moof") {
+                onMoof(box + header, box_size - header);
+            }
+            offset += box_size;
+        }
+        _buffer.erase(0, offset);
+    }
+
+private:
+    struct TrackInfo {
+        uint32_t timescale = 1000;
+        bool is_video = false;
+    };
+
+    template<typename FUNC>
+    static void forEachBox(const uint8_t *ptr, size_t size, FUNC &&func) {
+        while (size >= 8) {
+            uint64_t box_size = load_be32(ptr);
+            size_t header = 8;
+            if (box_size == 1) {
+                if (size < 16) {
+                    break;
+                }
+                box_size = load_be64(ptr + 8);
+                header = 16;
+            } else if (box_size == 0) {
+                box_size = size;
+            }
+            if (box_size < header || box_size > size) {
+                break;
+            }
+            func(string((char *) ptr + 4, 4), ptr + header, (size_t) (box_size - header));
+            ptr += box_size;
+            size -= box_size;
+        }
+    }
+
+    void onMoov(const uint8_t *ptr, size_t size) {
+        forEachBox(ptr, size, [&](const string &type, const uint8_t *trak, size_t trak_size) {
+            if (type != "trak") {
+                return;
+            }
+            uint32_t track_id = 0;
+            TrackInfo info;
+            forEachBox(trak, trak_size, [&](const string &type, const uint8_t *box, size_t box_size) {
+                if (type == "tkhd" && box_size >= 24) {
+                    track_id = load_be32(box + (box[0] == 1 ? 20 : 12));
+                } else if (type == "mdia") {
+                    forEachBox(box, box_size, [&](const string &type, const uint8_t *box, size_t box_size) {
+                        if (type == "mdhd" && box_size >= 24) {
+                            info.timescale = load_be32(box + (box[0] == 1 ? 20 : 12));
+                        } else if (type == "hdlr" && box_size >= 12) {
+                            info.is_video = memcmp(box + 8, "vide", 4) == 0;
+                        }
+                    });
+                }
+            });
+            if (info.timescale) {
+                _tracks[track_id] = info;
+            }
+        });
+    }
+
+    void onMoof(const uint8_t *ptr, size_t size) {
+        forEachBox(ptr, size, [&](const string &type, const uint8_t *traf, size_t traf_size) {
+            if (type != "traf") {
+                return;
+            }
+            uint32_t track_id = 0;
+            forEachBox(traf, traf_size, [&](const string &type, const uint8_t *box, size_t box_size) {
+                if (type == "tfhd" && box_size >= 8) {
+                    track_id = load_be32(box + 4);
+                } else if (type == "tfdt" && box_size >= 8) {
+                    uint64_t decode_time = box[0] == 1 && box_size >= 12 ? load_be64(box + 4) : load_be32(box + 4);
+                    auto it = _tracks.find(track_id);
+                    if (it != _tracks.end()) {
+                        _on_stamp(decode_time * 1000 / it->second.timescale, it->second.is_video);
+                    }
+                }
+            });
+        });
+    }
+
+private:
+    uint64_t _skip = 0;
+    string _buffer;
+    map<uint32_t, TrackInfo> _tracks;
+};
+
+/**
+ * 压测客户端基类
+ */
+class BenchClient {
+public:
+    typedef std::shared_ptr<BenchClient> Ptr;
+    virtual ~BenchClient() {}
+    virtual void start(const string &url) = 0;
+};
+
+/**
+ * rtsp/rtmp/hls播放器，通过track代理获取帧时间戳
+ */
+class PlayerBenchClient : public BenchClient {
+public:
+    PlayerBenchClient(const FleetStat::Ptr &stat, uint64_t stall_ms, int rtp_type, bool benchmark_mode) {
+        _probe = std::make_shared<StreamProbe>(stat, stall_ms);
+        _player = std::make_shared<MediaPlayer>();
+        (*_player)[kRtpType] = rtp_type;
+        (*_player)[kBenchmarkMode] = benchmark_mode;
+    }
+
+    ~PlayerBenchClient() override {
+        //player可能在其他线程析构，先清空回调
+        _player->setOnPlayResult(nullptr);
+        _player->setOnShutdown(nullptr);
+    }
+
+    void start(const string &url) override {
+        std::weak_ptr<StreamProbe> weak_probe = _probe;
+        std::weak_ptr<MediaPlayer> weak_player = _player;
+        _player->setOnPlayResult([weak_probe, weak_player](const SockException &ex) {
+            auto probe = weak_probe.lock();
+            auto player = weak_player.lock();
+            if (!probe || !player) {
+                return;
+            }
+            probe->onConnected(ex);
+            if (ex) {
+                return;
+            }
+            auto tracks = player->getTracks(false);
+            for (auto &track : tracks) {
+                bool is_video = track->getTrackType() == TrackVideo;
+                track->addDelegate(std::make_shared<FrameWriterInterfaceHelper>([weak_probe, is_video](const Frame::Ptr &frame) {
+                    auto probe = weak_probe.lock();
+                    if (!probe || frame->configFrame()) {
+                        return;
+                    }
+                    probe->onBytes(frame->size());
+                    probe->onStamp(frame->dts(), is_video);
+                }));
+            }
+        });
+        _player->setOnShutdown([weak_probe](const SockException &ex) {
+            auto probe = weak_probe.lock();
+            if (probe) {
+                probe->onShutdown(ex);
+            }
+        });
+        _player->play(url);
+    }
+
+private:
+    std::shared_ptr<StreamProbe> _probe;
+    MediaPlayer::Ptr _player;
+};
+
+/**
+ * http-flv/http-ts/http-fmp4播放器
+ */
+class HttpBenchClient : public BenchClient, public HttpClientImp {
+public:
+    HttpBenchClient(const FleetStat::Ptr &stat, uint64_t stall_ms, const StampParser::Ptr &parser) : _probe(stat, stall_ms) {
+        _parser = parser;
+        _parser->setOnStamp([this](int64_t stamp_ms, bool is_video) {
+            _probe.onStamp(stamp_ms, is_video);
+        });
+    }
+
+    void start(const string &url) override {
+        setMethod("GET");
+        sendRequest(url, 10);
+    }
+
+protected:
+    int64_t onResponseHeader(const string &status, const HttpHeader &headers) override {
+        if (status != "200" && status != "206") {
+            _probe.onConnected(SockException(Err_other, StrPrinter << "bad http status code:" << status));
+            _probe_done = true;
+            shutdown(SockException(Err_other, "bad http status code"));
+            return 0;
+        }
+        _probe.onConnected(SockException());
+        //后续是不定长content
+        return -1;
+    }
+
+    void onResponseBody(const char *buf, int64_t size, int64_t recvedSize, int64_t totalSize) override {
+        _probe.onBytes(size);
+        _parser->input(buf, size);
+    }
+
+    void onResponseCompleted() override {
+        shutdown(SockException(Err_success, "play completed"));
+    }
+
+    void onDisconnect(const SockException &ex) override {
+        if (!_probe_done) {
+            _probe_done = true;
+            _probe.onShutdown(ex);
+        }
+    }
+
+private:
+    bool _probe_done = false;
+    StreamProbe _probe;
+    StampParser::Ptr _parser;
+};
+
+/**
+ * ws-flv播放器使用的TcpClient，收到的数据为websocket负载
+ */
+class WsFlvTcpClient : public TcpClient {
+public:
+    WsFlvTcpClient(const FleetStat::Ptr &stat, uint64_t stall_ms) : _probe(stat, stall_ms) {
+        _parser.setOnStamp([this](int64_t stamp_ms, bool is_video) {
+            _probe.onStamp(stamp_ms, is_video);
+        });
+    }
+
+protected:
+    void onConnect(const SockException &ex) override {
+        _probe.onConnected(ex);
+        _probe_done = (bool) ex;
+    }
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        _probe.onBytes(buf->size());
+        _parser.input(buf->data(), buf->size());
+    }
+
+    void onErr(const SockException &ex) override {
+        if (!_probe_done) {
+            _probe_done = true;
+            _probe.onShutdown(ex);
+        }
+    }
+
+private:
+    bool _probe_done = false;
+    StreamProbe _probe;
+    FlvStampParser _parser;
+};
+
+class WsFlvBenchClient : public BenchClient, public WebSocketClient<WsFlvTcpClient, WebSocketHeader::BINARY> {
+public:
+    WsFlvBenchClient(const FleetStat::Ptr &stat, uint64_t stall_ms) :
+            WebSocketClient<WsFlvTcpClient, WebSocketHeader::BINARY>(stat, stall_ms) {}
+
+    void start(const string &url) override {
+        startWebSocket(url, 10);
+    }
+};
+
+/**
+ * 根据url创建对应协议的客户端
+ * url可以加上tcp:、udp:、multicast:前缀以指定rtsp的rtp传输方式
+ */
+class FleetFactory {
+public:
+    FleetFactory(const string &url, int count, uint64_t stall_ms, int rtp_type, bool benchmark_mode) {
+        _url = url;
+        _rtp_type = rtp_type;
+        _stall_ms = stall_ms;
+        _benchmark_mode = benchmark_mode;
+
+        static const pair<const char *, int> rtp_prefix[] = {{"tcp:",       Rtsp::RTP_TCP},
+                                                             {"udp:",       Rtsp::RTP_UDP},
+                                                             {"multicast:", Rtsp::RTP_MULTICAST}};
+        for (auto &pr : rtp_prefix) {
+            if (start_with(_url, pr.first)) {
+                _url = _url.substr(strlen(pr.first));
+                _rtp_type = pr.second;
+                break;
+            }
+        }
+
+        auto path = split(_url, "?")[0];
+        if (start_with(_url, "rtsp")) {
+            static const char *rtp_name[] = {"tcp", "udp", "multicast"};
+            _protocol = string("rtsp-") + rtp_name[_rtp_type % 3];
+            _type = type_player;
+        } else if (start_with(_url, "rtmp")) {
+            _protocol = "rtmp";
+            _type = type_player;
+        } else if (end_with(path, ".m3u8")) {
+            _protocol = "hls";
+            _type = type_player;
+        } else if (start_with(_url, "ws") && end_with(path, ".flv")) {
+            _protocol = "ws-flv";
+            _type = type_ws_flv;
+        } else if (end_with(path, ".flv")) {
+            _protocol = "http-flv";
+            _type = type_http_flv;
+        } else if (end_with(path, ".ts")) {
+            _protocol = "http-ts";
+            _type = type_http_ts;
+        } else if (end_with(path, ".mp4")) {
+            _protocol = "http-fmp4";
+            _type = type_http_fmp4;
+        } else {
+            throw std::invalid_argument(StrPrinter << "不支持的url:" << url);
+        }
+        _stat = std::make_shared<FleetStat>(_protocol, _url, count);
+    }
+
+    BenchClient::Ptr create() {
+        BenchClient::Ptr ret;
+        switch (_type) {
+            case type_player: ret = std::make_shared<PlayerBenchClient>(_stat, _stall_ms, _rtp_type, _benchmark_mode); break;
+            case type_http_flv: ret = std::make_shared<HttpBenchClient>(_stat, _stall_ms, std::make_shared<FlvStampParser>()); break;
+            case type_http_ts: ret = std::make_shared<HttpBenchClient>(_stat, _stall_ms, std::make_shared<TsStampParser>()); break;
+            case type_http_fmp4: ret = std::make_shared<HttpBenchClient>(_stat, _stall_ms, std::make_shared<Fmp4StampParser>()); break;
+            case type_ws_flv: ret = std::make_shared<WsFlvBenchClient>(_stat, _stall_ms); break;
+        }
+        ret->start(_url);
+        return ret;
+    }
+
+    const FleetStat::Ptr &getStat() const {
+        return _stat;
+    }
+
+private:
+    enum ClientType {
+        type_player = 0,
+        type_http_flv,
+        type_http_ts,
+        type_http_fmp4,
+        type_ws_flv
+    };
+
+    string _url;
+    string _protocol;
+    ClientType _type;
+    int _rtp_type;
+    uint64_t _stall_ms;
+    bool _benchmark_mode;
+    FleetStat::Ptr _stat;
+};
+
+/**
+ * rtsp/rtmp推流器集群，所有推流器共用一个拉流代理产生的源
+ */
+class PusherFleet {
+public:
+    PusherFleet(const string &pull_url, const string &push_url, int count) {
+        _pull_url = pull_url;
+        _push_url = push_url;
+        _schema = start_with(push_url, "rtmp") ? RTMP_SCHEMA : RTSP_SCHEMA;
+        _stat = std::make_shared<FleetStat>(string(_schema) + "-push", push_url, count);
+    }
+
+    void startProxy() {
+        _proxy = std::make_shared<PlayerProxy>(DEFAULT_VHOST, "benchmark", "source", false, false);
+        _proxy->play(_pull_url);
+    }
+
+    /**
+     * 创建一个推流器
+     * @return 源还未就绪时返回false
+     */
+    bool create(int index) {
+        auto src = MediaSource::find(_schema, DEFAULT_VHOST, "benchmark", "source");
+        if (!src) {
+            return false;
+        }
+        auto url = _push_url;
+        replace(url, "{}", to_string(index));
+        auto probe = std::make_shared<StreamProbe>(_stat, 0);
+        auto pusher = std::make_shared<MediaPusher>(src);
+        std::weak_ptr<StreamProbe> weak_probe = probe;
+        pusher->setOnPublished([weak_probe](const SockException &ex) {
+            auto probe = weak_probe.lock();
+            if (probe) {
+                probe->onConnected(ex);
+            }
+        });
+        pusher->setOnShutdown([weak_probe](const SockException &ex) {
+            auto probe = weak_probe.lock();
+            if (probe) {
+                probe->onShutdown(ex);
+            }
+        });
+        pusher->publish(url);
+        _pushers.emplace_back(std::move(pusher));
+        _probes.emplace_back(std::move(probe));
+        return true;
+    }
+
+    const FleetStat::Ptr &getStat() const {
+        return _stat;
+    }
+
+private:
+    string _pull_url;
+    string _push_url;
+    const char *_schema;
+    FleetStat::Ptr _stat;
+    PlayerProxy::Ptr _proxy;
+    list<MediaPusher::Ptr> _pushers;
+    list<std::shared_ptr<StreamProbe> > _probes;
+};
+
+class CMD_benchmark : public CMD {
+public:
+    CMD_benchmark() {
+        _parser.reset(new OptionParser(nullptr));
+        (*_parser) << Option('u', "url", Option::ArgRequired, "rtsp://127.0.0.1/live/0", false,
+                             "播放url，多个url以逗号分隔；rtsp url可加tcp:/udp:/multicast:前缀指定rtp方式，"
+                             "支持rtsp/rtmp/hls/http-flv/ws-flv/http-ts/http-fmp4", nullptr);
+        (*_parser) << Option('c', "count", Option::ArgRequired, "100", false, "每个url启动的播放器个数", nullptr);
+        (*_parser) << Option('i', "interval", Option::ArgRequired, "50", false, "启动客户端的间隔，单位毫秒", nullptr);
+        (*_parser) << Option('t', "rtp", Option::ArgRequired, "0", false, "rtsp默认rtp方式，0:tcp,1:udp,2:multicast", nullptr);
+        (*_parser) << Option('d', "duration", Option::ArgRequired, "0", false, "测试时长，单位秒，0代表直到ctrl+c", nullptr);
+        (*_parser) << Option('s', "stall", Option::ArgRequired, "1000", false, "帧间隔超过该值视为卡顿，单位毫秒", nullptr);
+        (*_parser) << Option('o', "out", Option::ArgRequired, "", false, "json报告输出文件，为空则输出到标准输出", nullptr);
+        (*_parser) << Option('b', "benchmark", Option::ArgNone, nullptr, false,
+                             "rtsp/rtmp播放器不解析负载以降低客户端开销，此时无帧级指标", nullptr);
+        (*_parser) << Option('p', "pull", Option::ArgRequired, "", false, "推流压测的源url", nullptr);
+        (*_parser) << Option('P', "push", Option::ArgRequired, "", false,
+                             "推流url模板，{}会被替换为推流器序号，例如rtmp://127.0.0.1/bench/push_{}", nullptr);
+        (*_parser) << Option('n', "push_count", Option::ArgRequired, "0", false, "推流器个数", nullptr);
+        (*_parser) << Option('l', "level", Option::ArgRequired, to_string(LInfo).data(), false, "日志等级,LTrace~LError(0~4)", nullptr);
+    }
+
+    ~CMD_benchmark() override {}
+
+    const char *description() const override {
+        return "多协议压测工具";
+    }
+};
+
+static void dumpReport(ostream &out, const list<FleetFactory> &fleets, const std::shared_ptr<PusherFleet> &pushers, float duration_sec) {
+    out << "{\"duration_sec\":" << duration_sec << ",\"players\":[";
+    bool first = true;
+    for (auto &fleet : fleets) {
+        if (!first) {
+            out << ",";
+        }
+        first = false;
+        fleet.getStat()->dump(out, duration_sec);
+    }
+    out << "],\"pushers\":[";
+    if (pushers) {
+        pushers->getStat()->dump(out, duration_sec);
+    }
+    out << "]}" << endl;
+}
+
 int main(int argc, char *argv[]) {
+    CMD_benchmark cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+
     //设置退出信号处理函数
     static semaphore sem;
     signal(SIGINT, [](int) { sem.post(); });// 设置退出信号
 
     //设置日志
-    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    LogLevel level = (LogLevel) cmd_main["level"].as<int>();
+    level = MIN(MAX(level, LTrace), LError);
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", level));
     Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
 
-    if (argc != 5) {
-        ErrorL << "\r\n测试方法:./test_benchmark player_count play_interval rtxp_url rtp_type\r\n"
-               << "例如你想每隔50毫秒启动共计100个播放器（tcp方式播放rtsp://127.0.0.1/live/0 ）可以输入以下命令:\r\n"
-               << "./test_benchmark 100 50 rtsp://127.0.0.1/live/0 0\r\n"
-               << endl;
-        return 0;
+    auto count = cmd_main["count"].as<int>();
+    auto interval_ms = cmd_main["interval"].as<int>();
+    auto duration = cmd_main["duration"].as<int>();
+    uint64_t stall_ms = cmd_main["stall"].as<int>();
+    bool benchmark_mode = cmd_main.hasKey("benchmark");
+
+    list<FleetFactory> fleets;
+    try {
+        for (auto &url : split(cmd_main["url"], ",")) {
+            fleets.emplace_back(trim(url), count, stall_ms, cmd_main["rtp"].as<int>(), benchmark_mode);
+        }
+    } catch (std::exception &ex) {
+        ErrorL << ex.what();
+        return -1;
+    }
 
+    std::shared_ptr<PusherFleet> pushers;
+    auto push_count = cmd_main["push_count"].as<int>();
+    if (push_count > 0 && !cmd_main["pull"].empty() && !cmd_main["push"].empty()) {
+        pushers = std::make_shared<PusherFleet>(cmd_main["pull"], cmd_main["push"], push_count);
+        pushers->startProxy();
     }
-    list<MediaPlayer::Ptr> playerList;
-    auto playerCnt = atoi(argv[1]);//启动的播放器个数
-    atomic_int alivePlayerCnt(0);
 
-    //由于所有播放器都是再一个timer里面创建的，默认情况下所有播放器会绑定该timer所在的poller线程
+    //由于所有客户端都是在一个timer里面创建的，默认情况下所有客户端会绑定该timer所在的poller线程
     //为了提高性能，poller分配策略关闭优先返回当前线程的策略
     EventPollerPool::Instance().preferCurrentThread(false);
 
-    //每隔若干毫秒启动一个播放器（如果一次性全部启动，服务器和客户端可能都承受不了）
-    Timer timer0(atoi(argv[2])/1000.0f,[&]() {
-        MediaPlayer::Ptr player(new MediaPlayer());
-        player->setOnPlayResult([&](const SockException &ex) {
-            if (!ex) {
-                ++alivePlayerCnt;
-            }
-        });
-        player->setOnShutdown([&](const SockException &ex) {
-            --alivePlayerCnt;
-        });
-        (*player)[kBenchmarkMode] = true;
-        (*player)[kRtpType] = atoi(argv[4]);
-        player->play(argv[3]);
-        playerList.push_back(player);
-        return playerCnt--;
-    }, nullptr);
+    list<BenchClient::Ptr> clients;
+    int player_index = 0;
+    int push_index = 0;
+    auto interval = MAX(interval_ms, 1) / 1000.0f;
+    auto poller = EventPollerPool::Instance().getPoller();
 
+    //每隔若干毫秒启动一批客户端(如果一次性全部启动，服务器和客户端可能都承受不了)
+    auto timer0 = std::make_shared<Timer>(interval, [&]() {
+        bool player_done = player_index >= count;
+        if (!player_done) {
+            for (auto &fleet : fleets) {
+                clients.emplace_back(fleet.create());
+            }
+            ++player_index;
+        }
+        bool push_done = !pushers || push_index >= push_count;
+        if (!push_done && pushers->create(push_index)) {
+            ++push_index;
+        }
+        return !player_done || !push_done;
+    }, poller);
 
-    Timer timer1(1,[&]() {
-        InfoL << "存活播放器个数:" << alivePlayerCnt.load();
+    Ticker ticker;
+    auto timer1 = std::make_shared<Timer>(1, [&]() {
+        _StrPrinter printer;
+        for (auto &fleet : fleets) {
+            auto &stat = fleet.getStat();
+            printer << stat->_protocol << ":" << stat->_alive.load() << "/" << stat->_started.load() << " ";
+        }
+        if (pushers) {
+            printer << "push:" << pushers->getStat()->_alive.load() << "/" << pushers->getStat()->_started.load();
+        }
+        InfoL << "存活客户端个数:" << printer;
+        if (duration > 0 && ticker.elapsedTime() >= (uint64_t) duration * 1000) {
+            sem.post();
+            return false;
+        }
         return true;
-    }, nullptr);
+    }, poller);
 
     sem.wait();
+    timer0 = nullptr;
+    timer1 = nullptr;
+    auto elapsed = ticker.elapsedTime() / 1000.0f;
+
+    //先输出报告再释放客户端，防止析构过程中的断开事件影响统计
+    auto out_file = cmd_main["out"];
+    if (out_file.empty()) {
+        dumpReport(cout, fleets, pushers, elapsed);
+    } else {
+        ofstream out(out_file);
+        dumpReport(out, fleets, pushers, elapsed);
+        InfoL << "测试报告已保存至:" << out_file;
+    }
+
+    //在各客户端所属poller线程之外析构，需要等待poller线程结束任务后再退出
+    poller->sync([&]() {
+        clients.clear();
+        pushers = nullptr;
+    });
     return 0;
 }
-
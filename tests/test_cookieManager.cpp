@@ -0,0 +1,174 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <iostream>
+#include "Util/CMD.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Http/HttpCookieManager.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+static const string kCookieName = "STRESS_COOKIE";
+
+class CMD_cookieManager : public CMD {
+public:
+    CMD_cookieManager() {
+        _parser.reset(new OptionParser(nullptr));
+        (*_parser) << Option('c', "count", Option::ArgRequired, "100000", false, "cookie个数", nullptr);
+        (*_parser) << Option('t', "threads", Option::ArgRequired, "8", false, "并发线程数", nullptr);
+        (*_parser) << Option('d', "duration", Option::ArgRequired, "5", false, "并发查找测试时长，单位秒", nullptr);
+    }
+
+    ~CMD_cookieManager() override {}
+
+    const char *description() const override {
+        return "HttpCookieManager压力测试：并发添加、查找、挤占登录与过期清理";
+    }
+};
+
+static double elapsedSecond(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * 多线程执行任务，每个线程处理[begin, end)区间
+ */
+static void runThreads(int threads, size_t count, const function<void(int index, size_t begin, size_t end)> &task) {
+    vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+            task(i, count * i / threads, count * (i + 1) / threads);
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+/**
+ * 添加cookie
+ * @param life cookie有效期，单位秒
+ */
+static vector<HttpServerCookie::Ptr> addCookies(const string &prefix, size_t count, int threads, uint64_t life) {
+    vector<HttpServerCookie::Ptr> cookies(count);
+    runThreads(threads, count, [&](int index, size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i) {
+            cookies[i] = HttpCookieManager::Instance().addCookie(kCookieName, prefix + to_string(i), life);
+        }
+    });
+    return cookies;
+}
+
+int main(int argc, char *argv[]) {
+    CMD_cookieManager cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    //加载默认配置
+    loadIniConfig();
+
+    auto count = cmd_main["count"].as<size_t>();
+    auto threads = cmd_main["threads"].as<int>();
+    auto duration = cmd_main["duration"].as<double>();
+    int failed = 0;
+
+    //1、并发添加长期有效的cookie
+    auto start = std::chrono::steady_clock::now();
+    auto cookies = addCookies("user_", count, threads, COOKIE_DEFAULT_LIFE);
+    auto cost = elapsedSecond(start);
+    printf("add %zu cookies: %.3fs, %.0f ops/s\n", count, cost, count / cost);
+
+    //2、并发查找并刷新过期时间，模拟hls切片请求
+    atomic<uint64_t> lookups{0};
+    atomic<uint64_t> misses{0};
+    start = std::chrono::steady_clock::now();
+    runThreads(threads, count, [&](int index, size_t begin, size_t end) {
+        std::mt19937 rng(index);
+        uint64_t ops = 0, miss = 0;
+        StrCaseMap header;
+        while (elapsedSecond(start) < duration) {
+            for (int i = 0; i < 1000; ++i, ++ops) {
+                auto &cookie = cookies[rng() % count];
+                header["Cookie"] = kCookieName + "=" + cookie->getCookie();
+                auto found = HttpCookieManager::Instance().getCookie(kCookieName, header);
+                if (found != cookie) {
+                    ++miss;
+                    continue;
+                }
+                auto lck = found->getLock();
+                found->updateTime();
+            }
+        }
+        lookups += ops;
+        misses += miss;
+    });
+    cost = elapsedSecond(start);
+    printf("lookup with %d threads: %.0f ops/s, misses: %llu\n", threads, lookups / cost, (unsigned long long) misses.load());
+    failed += misses.load() != 0;
+
+    //3、同一账号挤占登录，只保留最后登录的cookie
+    vector<HttpServerCookie::Ptr> kicked(threads);
+    runThreads(threads, threads, [&](int index, size_t begin, size_t end) {
+        for (int i = 0; i < 100; ++i) {
+            kicked[index] = HttpCookieManager::Instance().addCookie(kCookieName, "kick_" + to_string(index), COOKIE_DEFAULT_LIFE, 1);
+        }
+    });
+    for (int i = 0; i < threads; ++i) {
+        auto found = HttpCookieManager::Instance().getCookieByUid(kCookieName, "kick_" + to_string(i));
+        if (found != kicked[i]) {
+            printf("kick check failed, uid: kick_%d\n", i);
+            ++failed;
+        }
+    }
+
+    //4、短期cookie过期后由时间轮清理，不再被管理器持有
+    vector<std::weak_ptr<HttpServerCookie> > short_lived;
+    {
+        auto tmp = addCookies("short_", count, threads, 1);
+        for (auto &cookie : tmp) {
+            short_lived.emplace_back(cookie);
+        }
+    }
+    start = std::chrono::steady_clock::now();
+    size_t alive = count;
+    while (alive && elapsedSecond(start) < 60) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        alive = 0;
+        for (auto &cookie : short_lived) {
+            alive += !cookie.expired();
+        }
+    }
+    printf("expire %zu short-lived cookies: %.1fs, remaining: %zu\n", count, elapsedSecond(start), alive);
+    failed += alive != 0;
+
+    //长期cookie不受清理影响
+    size_t lost = 0;
+    for (auto &cookie : cookies) {
+        lost += HttpCookieManager::Instance().getCookie(kCookieName, cookie->getCookie()) != cookie;
+    }
+    printf("long-lived cookies lost: %zu\n", lost);
+    failed += lost != 0;
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,198 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <iostream>
+#include <vector>
+#include "Util/CMD.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+#include "Common/config.h"
+#include "Common/MediaSink.h"
+#include "Common/SyntheticSource.h"
+#include "Extension/H264Rtp.h"
+#include "Extension/H265Rtp.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 测试rtp解复用生成分片帧时的内存拷贝量：
+ * 先把合成源的视频帧打包为rtp，再解复用为帧，校验帧内容与原始帧一致，
+ * 并统计解复用时实际拷贝的字节数(仅帧头)与连续内存组帧时需要拷贝的字节数(整帧)
+ */
+
+/**
+ * 收集经过Track处理后的视频帧
+ */
+class VideoCollector : public MediaSink {
+public:
+    typedef std::shared_ptr<VideoCollector> Ptr;
+    vector<Frame::Ptr> frames;
+
+protected:
+    void onAllTrackReady() override {}
+
+    void onTrackFrame(const Frame::Ptr &frame) override {
+        if (frame->getTrackType() == TrackVideo) {
+            frames.emplace_back(Frame::getCacheAbleFrame(frame));
+        }
+    }
+};
+
+class RtpCollector : public RingDelegate<RtpPacket::Ptr> {
+public:
+    vector<RtpPacket::Ptr> packets;
+
+    void onWrite(RtpPacket::Ptr in, bool is_key) override {
+        packets.emplace_back(std::move(in));
+    }
+};
+
+static RtpCodec::Ptr createEncoder(CodecId codec) {
+    switch (codec) {
+        case CodecH264: return std::make_shared<H264RtpEncoder>(0);
+        case CodecH265: return std::make_shared<H265RtpEncoder>(0);
+        default: return nullptr;
+    }
+}
+
+static RtpCodec::Ptr createDecoder(CodecId codec) {
+    switch (codec) {
+        case CodecH264: return std::make_shared<H264RtpDecoder>();
+        case CodecH265: return std::make_shared<H265RtpDecoder>();
+        default: return nullptr;
+    }
+}
+
+static vector<RtpPacket::Ptr> encodeRtp(CodecId codec, const vector<Frame::Ptr> &frames) {
+    auto collector = std::make_shared<RtpCollector>();
+    auto ring = std::make_shared<RtpRing::RingType>();
+    ring->setDelegate(collector);
+    auto encoder = createEncoder(codec);
+    encoder->setRtpRing(ring);
+    for (auto &frame : frames) {
+        encoder->inputFrame(frame);
+    }
+    return std::move(collector->packets);
+}
+
+/**
+ * 解复用全部rtp包
+ * @param merge 是否对每帧调用data()，模拟连续内存组帧时对整帧的拷贝
+ * @return 单帧耗时，单位纳秒
+ */
+static double decodeRtp(CodecId codec, const vector<RtpPacket::Ptr> &packets, bool merge, vector<Frame::Ptr> *out) {
+    auto decoder = createDecoder(codec);
+    size_t count = 0;
+    decoder->addDelegate(std::make_shared<FrameWriterInterfaceHelper>([&](const Frame::Ptr &frame) {
+        ++count;
+        if (merge) {
+            frame->data();
+        }
+        if (out) {
+            out->emplace_back(frame);
+        }
+    }));
+    auto start = MetricTimer::now();
+    for (auto &rtp : packets) {
+        decoder->inputRtp(rtp, false);
+    }
+    return count ? (MetricTimer::now() - start) * 1000.0 / count : 0;
+}
+
+static double bestOf(int rounds, const function<double()> &func) {
+    double best = 0;
+    for (int i = 0; i < rounds; ++i) {
+        auto ns = func();
+        if (i == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+class CMD_frameSliced : public CMD {
+public:
+    CMD_frameSliced() {
+        _parser.reset(new OptionParser(nullptr));
+        (*_parser) << Option('d', "duration", Option::ArgRequired, "60", false, "合成视频时长，单位秒", nullptr);
+        (*_parser) << Option('r', "rounds", Option::ArgRequired, "10", false, "解复用测试轮数，取最快的一轮", nullptr);
+        (*_parser) << Option('b', "bitrate", Option::ArgRequired, "4194304", false, "合成视频码率，单位bit/s", nullptr);
+    }
+
+    ~CMD_frameSliced() override {}
+
+    const char *description() const override {
+        return "rtp解复用分片帧内存拷贝测试";
+    }
+};
+
+int main(int argc, char *argv[]) {
+    CMD_frameSliced cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    //加载默认配置
+    loadIniConfig();
+
+    auto duration_ms = cmd_main["duration"].as<uint64_t>() * 1000;
+    auto rounds = cmd_main["rounds"].as<int>();
+
+    printf("%-8s%10s%16s%16s%14s%14s\n", "codec", "frames", "payload(B)", "copied(B)", "sliced(ns)", "merged(ns)");
+    for (auto codec : {CodecH264, CodecH265}) {
+        SyntheticVideoInfo video;
+        SyntheticAudioInfo audio;
+        video.codecId = codec;
+        video.iBitRate = cmd_main["bitrate"].as<int>();
+        audio.codecId = CodecInvalid;
+        auto collector = std::make_shared<VideoCollector>();
+        SyntheticSource source(collector, video, audio);
+        source.generate(duration_ms);
+        auto packets = encodeRtp(codec, collector->frames);
+
+        vector<Frame::Ptr> decoded;
+        decodeRtp(codec, packets, false, &decoded);
+        if (decoded.size() != collector->frames.size()) {
+            ErrorL << getCodecName(codec) << " 解复用帧数不一致:" << decoded.size() << " != " << collector->frames.size();
+            return -1;
+        }
+
+        //解复用时只拷贝帧头，负载由各个分片直接引用rtp包
+        uint64_t payload = 0, copied = 0;
+        for (size_t i = 0; i < decoded.size(); ++i) {
+            auto &frame = decoded[i];
+            auto &origin = collector->frames[i];
+            bool head = true;
+            frame->forEachSlice(0, [&](const char *ptr, uint32_t size) {
+                if (head) {
+                    copied += size;
+                    head = false;
+                }
+            });
+            payload += frame->size();
+            if (frame->size() != origin->size() || memcmp(frame->data(), origin->data(), frame->size())) {
+                ErrorL << getCodecName(codec) << " 第" << i << "帧内容与原始帧不一致";
+                return -1;
+            }
+        }
+
+        auto sliced = bestOf(rounds, [&]() { return decodeRtp(codec, packets, false, nullptr); });
+        auto merged = bestOf(rounds, [&]() { return decodeRtp(codec, packets, true, nullptr); });
+        printf("%-8s%10zu%16llu%16llu%14.1f%14.1f\n", getCodecName(codec), decoded.size(),
+               (unsigned long long) payload, (unsigned long long) copied, sliced, merged);
+    }
+    return 0;
+}
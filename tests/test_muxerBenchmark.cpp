@@ -0,0 +1,147 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <iostream>
+#include <vector>
+#include <functional>
+#include "Util/CMD.h"
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Util/Metrics.h"
+#include "Common/config.h"
+#include "Common/MediaSink.h"
+#include "Common/SyntheticSource.h"
+#include "Rtsp/RtspMuxer.h"
+#include "Rtmp/RtmpMuxer.h"
+#include "Record/TsMuxer.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 收集经过Track处理(拆分nal、插入sps/pps等)后的帧，即各muxer实际收到的帧
+ */
+class FrameCollector : public MediaSink {
+public:
+    typedef std::shared_ptr<FrameCollector> Ptr;
+    vector<Track::Ptr> tracks;
+    vector<Frame::Ptr> frames;
+
+protected:
+    void onAllTrackReady() override {
+        tracks = getTracks(true);
+    }
+
+    void onTrackFrame(const Frame::Ptr &frame) override {
+        frames.emplace_back(frame);
+    }
+};
+
+#if defined(ENABLE_HLS)
+class TsMuxerBench : public TsMuxer {
+public:
+    uint64_t bytes = 0;
+
+protected:
+    void onTs(const void *packet, int bytes_in, uint32_t timestamp, bool is_idr_fast_packet) override {
+        bytes += bytes_in;
+    }
+};
+#endif
+
+/**
+ * 每轮新建muxer并输入全部帧，取各轮中最快的一轮，降低调度、缓存冷启动的干扰
+ * @return 单帧耗时，单位纳秒
+ */
+static double benchMuxer(const FrameCollector::Ptr &collector, int rounds, const function<MediaSinkInterface::Ptr()> &create) {
+    double best = 0;
+    for (int i = 0; i < rounds; ++i) {
+        auto muxer = create();
+        for (auto &track : collector->tracks) {
+            muxer->addTrack(track);
+        }
+        auto start = MetricTimer::now();
+        for (auto &frame : collector->frames) {
+            muxer->inputFrame(frame);
+        }
+        double ns = (MetricTimer::now() - start) * 1000.0 / collector->frames.size();
+        if (i == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+class CMD_muxerBenchmark : public CMD {
+public:
+    CMD_muxerBenchmark() {
+        _parser.reset(new OptionParser(nullptr));
+        (*_parser) << Option('d', "duration", Option::ArgRequired, "60", false, "每轮输入的媒体时长，单位秒", nullptr);
+        (*_parser) << Option('r', "rounds", Option::ArgRequired, "10", false, "每个muxer测试轮数，取最快的一轮", nullptr);
+    }
+
+    ~CMD_muxerBenchmark() override {}
+
+    const char *description() const override {
+        return "rtsp/rtmp/ts muxer单帧耗时测试";
+    }
+};
+
+int main(int argc, char *argv[]) {
+    CMD_muxerBenchmark cmd_main;
+    try {
+        cmd_main.operator()(argc, argv);
+    } catch (std::exception &ex) {
+        cout << ex.what() << endl;
+        return -1;
+    }
+    Logger::Instance().add(std::make_shared<ConsoleChannel>("ConsoleChannel", LError));
+    //加载默认配置
+    loadIniConfig();
+
+    auto duration_ms = cmd_main["duration"].as<uint64_t>() * 1000;
+    auto rounds = cmd_main["rounds"].as<int>();
+
+    struct {
+        CodecId video;
+        CodecId audio;
+    } cases[] = {
+            {CodecH264, CodecAAC},
+            {CodecH265, CodecAAC},
+            {CodecH264, CodecG711A},
+            {CodecH264, CodecOpus},
+    };
+
+    printf("%-16s%10s%14s%14s%14s\n", "codec", "frames", "rtsp(ns)", "rtmp(ns)", "ts(ns)");
+    for (auto &item : cases) {
+        SyntheticVideoInfo video;
+        SyntheticAudioInfo audio;
+        video.codecId = item.video;
+        audio.codecId = item.audio;
+        auto collector = std::make_shared<FrameCollector>();
+        SyntheticSource source(collector, video, audio);
+        source.generate(duration_ms);
+        if (collector->tracks.size() != 2) {
+            WarnL << "track未就绪:" << getCodecName(item.video) << "/" << getCodecName(item.audio);
+            continue;
+        }
+
+        auto rtsp = benchMuxer(collector, rounds, []() { return std::make_shared<RtspMuxer>(); });
+        auto rtmp = benchMuxer(collector, rounds, []() { return std::make_shared<RtmpMuxer>(nullptr); });
+        double ts = 0;
+#if defined(ENABLE_HLS)
+        ts = benchMuxer(collector, rounds, []() { return std::make_shared<TsMuxerBench>(); });
+#endif
+        auto name = string(getCodecName(item.video)) + "+" + getCodecName(item.audio);
+        printf("%-16s%10zu%14.1f%14.1f%14.1f\n", name.data(), collector->frames.size(), rtsp, rtmp, ts);
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <atomic>
+#include <iostream>
+#include "Util/logger.h"
+#include "Network/sockutil.h"
+#include "Network/TcpServer.h"
+#include "Poller/EventPoller.h"
+#include "Thread/WorkThreadPool.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace toolkit;
+
+/**
+ * 测试TcpSession在poller线程间迁移：
+ * 1、迁移成功后会话从源TcpServer移至目标TcpServer，后续收发与onError都在目标poller线程触发
+ * 2、迁移到没有克隆TcpServer的poller时失败，会话仍由源TcpServer管理
+ */
+
+static atomic<int> s_migrate_ok{0};
+static atomic<int> s_migrate_fail{0};
+static atomic<int> s_err_count{0};
+static atomic<bool> s_err_on_target{false};
+static EventPoller::Ptr s_source;
+static EventPoller::Ptr s_target;
+
+class TestServer : public TcpServer {
+public:
+    typedef std::shared_ptr<TestServer> Ptr;
+    using TcpServer::TcpServer;
+
+    size_t sessionCount(const EventPoller::Ptr &poller) {
+        size_t ret = 0;
+        poller->sync([&]() {
+            auto server = getServer(poller.get());
+            ret = server ? server->getSessionCount() : 0;
+        });
+        return ret;
+    }
+
+protected:
+    TcpServer::Ptr onCreatServer(const EventPoller::Ptr &poller) override {
+        return std::make_shared<TestServer>(poller);
+    }
+};
+
+class MigrateSession : public TcpSession {
+public:
+    MigrateSession(const Socket::Ptr &sock) : TcpSession(sock) {}
+
+    void onRecv(const Buffer::Ptr &buf) override {
+        string cmd(buf->data(), buf->size());
+        if (cmd == "migrate") {
+            s_source = getPoller();
+            //取线程池中另一个poller作为迁移目标
+            EventPollerPool::Instance().for_each([&](const TaskExecutor::Ptr &executor) {
+                auto poller = dynamic_pointer_cast<EventPoller>(executor);
+                if (poller != s_source) {
+                    s_target = poller;
+                }
+            });
+            weak_ptr<TcpSession> weak_self = shared_from_this();
+            migrateTo(s_target, [weak_self](bool success) {
+                auto strong_self = weak_self.lock();
+                if (success && strong_self && strong_self->getPoller() == s_target && s_target->isCurrentThread()) {
+                    ++s_migrate_ok;
+                    strong_self->SockSender::send("migrated");
+                }
+            });
+            return;
+        }
+        if (cmd == "orphan") {
+            //WorkThreadPool中的poller没有对应的TcpServer，迁移应当失败
+            migrateTo(WorkThreadPool::Instance().getPoller(), [this](bool success) {
+                if (!success && getPoller()->isCurrentThread()) {
+                    ++s_migrate_fail;
+                    SockSender::send("stayed");
+                }
+            });
+            return;
+        }
+        //普通数据回显，并附带当前是否处于目标poller线程
+        SockSender::send(cmd + (getPoller()->isCurrentThread() && getPoller() == s_target ? "@target" : "@other"));
+    }
+
+    void onError(const SockException &err) override {
+        ++s_err_count;
+        s_err_on_target = s_target && s_target->isCurrentThread();
+    }
+
+    void onManager() override {}
+};
+
+static bool sendAndRecv(int fd, const string &data, const string &expect) {
+    if (::send(fd, data.data(), data.size(), 0) != (ssize_t) data.size()) {
+        return false;
+    }
+    char buf[256];
+    auto size = ::recv(fd, buf, sizeof(buf), 0);
+    if (size <= 0) {
+        return false;
+    }
+    string reply(buf, size);
+    if (reply != expect) {
+        WarnL << "期望回复:" << expect << ",实际:" << reply;
+        return false;
+    }
+    return true;
+}
+
+#define CHECK(exp) \
+    if (!(exp)) { \
+        ErrorL << "检查失败:" << #exp; \
+        return -1; \
+    }
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+    EventPollerPool::setPoolSize(2);
+
+    auto server = std::make_shared<TestServer>();
+    server->start<MigrateSession>(0, "127.0.0.1");
+
+    auto fd = SockUtil::connect("127.0.0.1", server->getPort(), false);
+    CHECK(fd != -1);
+    struct timeval tv = {3, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof(tv));
+
+    //迁移到其他poller
+    CHECK(sendAndRecv(fd, "migrate", "migrated"));
+    CHECK(s_migrate_ok == 1);
+    CHECK(server->sessionCount(s_source) == 0);
+    CHECK(server->sessionCount(s_target) == 1);
+    CHECK(sendAndRecv(fd, "ping", "ping@target"));
+
+    //迁移到没有TcpServer的poller，会话应当留在原TcpServer
+    CHECK(sendAndRecv(fd, "orphan", "stayed"));
+    CHECK(s_migrate_fail == 1);
+    CHECK(server->sessionCount(s_target) == 1);
+    CHECK(sendAndRecv(fd, "ping", "ping@target"));
+
+    //关闭客户端，onError应当在目标poller线程触发，并从目标TcpServer移除
+    CHECK(s_err_count == 0);
+    close(fd);
+    for (int i = 0; i < 100 && s_err_count == 0; ++i) {
+        usleep(10 * 1000);
+    }
+    CHECK(s_err_count == 1);
+    CHECK(s_err_on_target);
+    CHECK(server->sessionCount(s_target) == 0);
+    CHECK(server->sessionCount(s_source) == 0);
+
+    InfoL << "会话迁移测试通过";
+    return 0;
+}
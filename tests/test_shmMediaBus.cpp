@@ -0,0 +1,158 @@
+﻿/*
+ * Copyright (c) 2016 The ZLMediaKit project authors. All Rights Reserved.
+ *
+ * This file is part of ZLMediaKit(https://github.com/xiongziliang/ZLMediaKit).
+ *
+ * Use of this source code is governed by MIT license that can be found in the
+ * LICENSE file in the root of the source tree. All contributing project authors
+ * may be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include "Util/util.h"
+#include "Util/logger.h"
+#include "Common/config.h"
+#include "Common/SyntheticSource.h"
+#include "Common/FrameSubscriber.h"
+#include "Shm/ShmMediaBus.h"
+
+using namespace std;
+using namespace toolkit;
+using namespace mediakit;
+
+/**
+ * 共享内存导出、导入往返测试：
+ * 合成源导出至共享内存，再在本进程以另一个流id导入，
+ * 校验导入流的每一帧都能在源流中找到编码、时间戳与内容一致的帧，且从关键帧开始
+ */
+
+#define CHECK(exp) \
+    if (!(exp)) { \
+        ErrorL << "检查失败:" << #exp; \
+        return -1; \
+    }
+
+class FrameCollector {
+public:
+    typedef std::shared_ptr<FrameCollector> Ptr;
+
+    void onFrame(const Frame::Ptr &frame) {
+        lock_guard<mutex> lck(_mtx);
+        _frames.emplace_back(Frame::getCacheAbleFrame(frame));
+    }
+
+    vector<Frame::Ptr> getFrames() {
+        lock_guard<mutex> lck(_mtx);
+        return _frames;
+    }
+
+private:
+    mutex _mtx;
+    vector<Frame::Ptr> _frames;
+};
+
+static FrameSubscriber::Ptr subscribe(const MediaSource::Ptr &src, const FrameCollector::Ptr &collector) {
+    auto subscriber = std::make_shared<FrameSubscriber>(nullptr, false);
+    subscriber->setOnFrame([collector](const Frame::Ptr &frame) {
+        collector->onFrame(frame);
+    });
+    return subscriber->attach(src) ? subscriber : nullptr;
+}
+
+static MediaSource::Ptr waitSource(const string &stream) {
+    for (int i = 0; i < 300; ++i) {
+        auto src = MediaSource::find(DEFAULT_VHOST, "live", stream);
+        if (src) {
+            return src;
+        }
+        usleep(10 * 1000);
+    }
+    return nullptr;
+}
+
+static bool sameFrame(const Frame::Ptr &a, const Frame::Ptr &b) {
+    return a->getCodecId() == b->getCodecId() && a->dts() == b->dts() && a->pts() == b->pts() &&
+           a->prefixSize() == b->prefixSize() && a->size() == b->size() && !memcmp(a->data(), b->data(), a->size());
+}
+
+int main(int argc, char *argv[]) {
+    Logger::Instance().add(std::make_shared<ConsoleChannel>());
+    Logger::Instance().setWriter(std::make_shared<AsyncLogWriter>());
+    //加载默认配置
+    loadIniConfig();
+    string registry = StrPrinter << "/tmp/zlm_shm_test_" << getpid();
+    mINI::Instance()[Shm::kRegistry] = registry;
+    NoticeCenter::Instance().emitEvent(Broadcast::kBroadcastReloadConfig);
+
+    SyntheticVideoInfo video;
+    SyntheticAudioInfo audio;
+    auto source = SyntheticSource::create(DEFAULT_VHOST, "live", "shm_src", video, audio);
+    source->start();
+    auto src = waitSource("shm_src");
+    CHECK(src);
+
+    auto origin = std::make_shared<FrameCollector>();
+    auto origin_subscriber = subscribe(src, origin);
+    CHECK(origin_subscriber);
+
+    auto exporter = ShmMediaExporter::create(src);
+    CHECK(exporter);
+
+    //注册表查找会跳过本进程导出的流，所以直接使用共享内存名导入
+    auto poller = EventPollerPool::Instance().getPoller();
+    auto importer = std::make_shared<ShmMediaImporter>(DEFAULT_VHOST, "live", "shm_dst", poller);
+    bool started = false;
+    poller->sync([&]() { started = importer->start(exporter->getShmName()); });
+    CHECK(started);
+    auto dst = waitSource("shm_dst");
+    CHECK(dst);
+    CHECK(dst->getOriginType() == MediaOriginType::shm_relay);
+
+    auto imported = std::make_shared<FrameCollector>();
+    auto imported_subscriber = subscribe(dst, imported);
+    CHECK(imported_subscriber);
+
+    //写者每200毫秒检查一次读者，留出订阅与至少一个gop的时间
+    sleep(4);
+    source->stop();
+    //等待剩余帧被读取
+    usleep(500 * 1000);
+
+    auto origin_frames = origin->getFrames();
+    auto imported_frames = imported->getFrames();
+    InfoL << "源流帧数:" << origin_frames.size() << ",导入流帧数:" << imported_frames.size();
+    CHECK(imported_frames.size() > 50);
+
+    //导入流从gop起始开始
+    auto &first = imported_frames.front();
+    CHECK(first->getTrackType() != TrackVideo || first->configFrame() || first->keyFrame());
+
+    multimap<uint32_t, Frame::Ptr> origin_by_dts;
+    for (auto &frame : origin_frames) {
+        origin_by_dts.emplace(frame->dts(), frame);
+    }
+    size_t index = 0;
+    for (auto &frame : imported_frames) {
+        bool found = false;
+        auto range = origin_by_dts.equal_range(frame->dts());
+        for (auto it = range.first; it != range.second && !found; ++it) {
+            found = sameFrame(frame, it->second);
+        }
+        if (!found) {
+            ErrorL << "导入流第" << index << "帧在源流中不存在:" << frame->getCodecName() << " dts:" << frame->dts() << " size:" << frame->size();
+            return -1;
+        }
+        ++index;
+    }
+
+    imported_subscriber = nullptr;
+    poller->sync([&]() { importer = nullptr; });
+    exporter = nullptr;
+    origin_subscriber = nullptr;
+    unlink(registry.data());
+    InfoL << "共享内存往返测试通过";
+    return 0;
+}